@@ -23,4 +23,9 @@ RbMake.module(:EksTest, :Eks) do |l, p|
   l.sources = [ '**/*' ]
 end
 
+# benchmarks print one JSON line per measurement, so runs can be compared by script.
+RbMake.module(:EksBenchmark, :Eks) do |l, p|
+  l.sources = [ '**/*' ]
+end
+
 RbMake.import_modules('Eks*')
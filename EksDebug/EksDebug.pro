@@ -16,7 +16,24 @@ SOURCES += \
     src/XDebugInterface.cpp \
     src/XDebugLogger.cpp \
     src/XDebugManagerImpl.cpp \
-    src/XDebugController.cpp
+    src/XDebugController.cpp \
+    src/XDebugStagingRing.cpp \
+    src/XDebugPreConnectBuffer.cpp \
+    src/XDebugTransport.cpp \
+    src/XDebugSharedMemoryTransport.cpp \
+    src/XDebugCompactEncoding.cpp \
+    src/XDebugLz.cpp \
+    src/XDebugCompression.cpp \
+    src/XDebugReceiveBuffer.cpp \
+    src/XDebugFrameParser.cpp \
+    src/XDebugCaptureWriter.cpp \
+    src/XDebugFanOut.cpp \
+    src/XDebugManagerMonitor.cpp \
+    src/XDebugMetrics.cpp \
+    src/XDebugAllocatorTracker.cpp \
+    src/XDebugProfiler.cpp \
+    src/XDebugTimestamp.cpp \
+    src/XDebugTrace.cpp
 
 HEADERS += \
     include/XDebugGlobal.h \
@@ -24,7 +41,24 @@ HEADERS += \
     include/XDebugInterface.h \
     include/XDebugLogger.h \
     include/XDebugManagerImpl.h \
-    include/XDebugController.h
+    include/XDebugController.h \
+    include/XDebugStagingRing.h \
+    include/XDebugPreConnectBuffer.h \
+    include/XDebugTransport.h \
+    include/XDebugSharedMemoryTransport.h \
+    include/XDebugCompactEncoding.h \
+    include/XDebugLz.h \
+    include/XDebugCompression.h \
+    include/XDebugReceiveBuffer.h \
+    include/XDebugFrameParser.h \
+    include/XDebugCaptureWriter.h \
+    include/XDebugFanOut.h \
+    include/XDebugManagerMonitor.h \
+    include/XDebugMetrics.h \
+    include/XDebugAllocatorTracker.h \
+    include/XDebugProfiler.h \
+    include/XDebugTimestamp.h \
+    include/XDebugTrace.h
 
 
 LIBS += -lEksCore
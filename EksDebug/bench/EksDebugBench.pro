@@ -0,0 +1,24 @@
+#-------------------------------------------------
+#
+# EksDebug benchmarks
+#
+#-------------------------------------------------
+
+QT       += network
+QT       -= gui
+
+include("../../EksCore/GeneralOptions.pri")
+
+TARGET = EksDebugBench
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+
+SOURCES += XDebugBenchmark.cpp
+
+INCLUDEPATH += $$ROOT/Eks/EksCore/include \
+    $$ROOT/Eks/EksDebug/include
+
+LIBS += -lEksCore -lEksDebug
@@ -0,0 +1,1234 @@
+#include "XDebugInterface.h"
+#include "XDebugManager.h"
+#include "XDebugFrameParser.h"
+#include "XDebugCompression.h"
+#include "XDebugCaptureWriter.h"
+#include "XDebugCompactEncoding.h"
+#include "XDebugLogger.h"
+#include "XDebugTimestamp.h"
+#include "XDebugTransport.h"
+#include "Math/XMathHelpers.h"
+#include "XCore"
+#include "QCoreApplication"
+#include "QDebug"
+#include "QElapsedTimer"
+#include "QJsonDocument"
+#include "QJsonObject"
+#include "QTcpServer"
+#include "QTcpSocket"
+#include "QLocalServer"
+#include "QLocalSocket"
+#include "QThread"
+#include "QDir"
+#include "QFile"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace Eks
+{
+
+class BenchInterface : public DebugInterface
+  {
+  X_DEBUG_INTERFACE(BenchInterface)
+
+public:
+  struct Value
+    {
+    enum
+      {
+      DebugMessageType = 1
+      };
+
+    xuint32 value;
+    };
+
+  struct Blob
+    {
+    enum
+      {
+      DebugMessageType = 2
+      };
+
+    QByteArray payload;
+    };
+
+  void send(const Value &v) { sendData(v); }
+  void send(const Blob &b) { sendData(b); }
+
+  xuint64 recieved;
+
+private:
+  void onValue(const Value &)
+    {
+    ++recieved;
+    }
+
+  void onBlob(const Blob &)
+    {
+    ++recieved;
+    }
+  };
+
+QDataStream &operator<<(QDataStream &s, const BenchInterface::Value &v)
+  {
+  return s << v.value;
+  }
+
+QDataStream &operator>>(QDataStream &s, BenchInterface::Value &v)
+  {
+  return s >> v.value;
+  }
+
+QDataStream &operator<<(QDataStream &s, const BenchInterface::Blob &b)
+  {
+  return s << b.payload;
+  }
+
+QDataStream &operator>>(QDataStream &s, BenchInterface::Blob &b)
+  {
+  return s >> b.payload;
+  }
+
+X_IMPLEMENT_DEBUG_INTERFACE(BenchInterface)
+
+BenchInterface::BenchInterface(DebugManager *, bool)
+    : recieved(0)
+  {
+  static Reciever recv[] =
+    {
+    recieveFunction<Value, BenchInterface, &BenchInterface::onValue>(),
+    recieveFunction<Blob, BenchInterface, &BenchInterface::onBlob>(),
+    };
+
+  static const DispatchTable dispatch(recv, X_ARRAY_COUNT(recv));
+  setRecievers(dispatch);
+  }
+
+}
+
+namespace
+{
+
+typedef Eks::DebugManager::Transport Transport;
+
+const xsize SmallSize = 4;
+const xsize MediumSize = 1024;
+const xsize LargeSize = 64 * 1024;
+// frame header, then the message type byte.
+const xsize FrameOverhead = 2 * sizeof(xuint32) + 1;
+// a QByteArray is serialised behind its length.
+const xsize BlobOverhead = sizeof(xuint32);
+
+/// Writes one benchmark's figures as a line of JSON, so runs can be compared by script.
+void report(const char *name, xuint64 messages, xuint64 bytes, qint64 ns, QJsonObject extra = QJsonObject())
+  {
+  extra["benchmark"] = QString(name);
+  extra["messages"] = (double)messages;
+  extra["bytes"] = (double)bytes;
+  extra["ns"] = (double)ns;
+  extra["ns_per_message"] = messages ? (double)ns / messages : 0.0;
+  extra["mb_per_second"] = ns ? (bytes / (1024.0 * 1024.0)) / (ns / 1e9) : 0.0;
+
+  printf("%s\n", QJsonDocument(extra).toJson(QJsonDocument::Compact).constData());
+  fflush(stdout);
+  }
+
+/// Compressible, but not trivially, like most debug payloads.
+QByteArray payload(xsize size, xuint32 seed)
+  {
+  QByteArray data((int)size, Qt::Uninitialized);
+  for(int i = 0; i < data.size(); ++i)
+    {
+    data[i] = (char)((i % 7 == 0) ? seed * 31 + i : i % 13);
+    }
+  return data;
+  }
+
+/// Wait for every staged frame to reach the transport.
+void waitForDrain()
+  {
+  Eks::DebugManager::flush();
+  while(Eks::DebugManager::queueStatistics().queuedBytes)
+    {
+    QThread::yieldCurrentThread();
+    }
+  }
+
+/// A framed stream of [count] Blob messages, as a client would write it.
+QByteArray recordStream(xuint32 id, xsize size, xuint32 count)
+  {
+  QByteArray stream;
+  QDataStream s(&stream, QIODevice::WriteOnly);
+  for(xuint32 i = 0; i < count; ++i)
+    {
+    Eks::BenchInterface::Blob blob = { payload(size, i) };
+
+    QByteArray frame;
+    QDataStream f(&frame, QIODevice::WriteOnly);
+    f << (xuint8)Eks::BenchInterface::Blob::DebugMessageType << blob;
+
+    s << id << (xuint32)frame.size();
+    s.writeRawData(frame.constData(), frame.size());
+    }
+  return stream;
+  }
+
+void benchSendSmall(const char *name)
+  {
+  const xuint32 count = 2000000;
+
+  Eks::DebugManager manager(true, 0, Transport::Null);
+  Eks::BenchInterface ifc(0, true);
+  waitForDrain();
+
+  QElapsedTimer timer;
+  timer.start();
+  for(xuint32 i = 0; i < count; ++i)
+    {
+    Eks::BenchInterface::Value v = { i };
+    ifc.send(v);
+    }
+  const qint64 sendNs = timer.nsecsElapsed();
+  waitForDrain();
+  const qint64 ns = timer.nsecsElapsed();
+
+  QJsonObject extra;
+  extra["producer_ns_per_message"] = (double)sendNs / count;
+  report(name, count, count * (FrameOverhead + SmallSize), ns, extra);
+  }
+
+/// Several threads sending through one interface, so anything the interface's sends share
+/// between threads, like its counters, is contended.
+void benchSendShared(const char *name)
+  {
+  static const xuint32 ThreadCount = 4;
+  const xuint32 count = 500000;
+
+  Eks::DebugManager manager(true, 0, Transport::Null);
+  Eks::BenchInterface ifc(0, true);
+  waitForDrain();
+
+  QElapsedTimer timer;
+  timer.start();
+  std::vector<std::thread> threads;
+  for(xuint32 t = 0; t < ThreadCount; ++t)
+    {
+    threads.emplace_back([&ifc, count]()
+      {
+      for(xuint32 i = 0; i < count; ++i)
+        {
+        Eks::BenchInterface::Value v = { i };
+        ifc.send(v);
+        }
+      });
+    }
+  for(auto &t : threads)
+    {
+    t.join();
+    }
+  const qint64 sendNs = timer.nsecsElapsed();
+  waitForDrain();
+  const qint64 ns = timer.nsecsElapsed();
+
+  const xuint64 messages = (xuint64)ThreadCount * count;
+  QJsonObject extra;
+  extra["producer_ns_per_message"] = (double)sendNs / count;
+  extra["threads"] = (double)ThreadCount;
+  report(name, messages, messages * (FrameOverhead + SmallSize), ns, extra);
+  }
+
+void benchSendBlob(const char *name, xsize size, xuint32 count, const QString &capture = QString())
+  {
+  Eks::DebugManager manager(true, 0, Transport::Null);
+  Eks::BenchInterface ifc(0, true);
+  waitForDrain();
+
+  if(!capture.isEmpty() && !Eks::DebugManager::startCapture(capture))
+    {
+    qWarning() << "Failed to start capture" << capture;
+    return;
+    }
+
+  // serialising the payload is measured, building it isn't.
+  Eks::BenchInterface::Blob blob = { payload(size, 1) };
+
+  QElapsedTimer timer;
+  timer.start();
+  for(xuint32 i = 0; i < count; ++i)
+    {
+    ifc.send(blob);
+    }
+  const qint64 sendNs = timer.nsecsElapsed();
+  waitForDrain();
+  const qint64 ns = timer.nsecsElapsed();
+
+  QJsonObject extra;
+  extra["producer_ns_per_message"] = (double)sendNs / count;
+
+  if(!capture.isEmpty())
+    {
+    Eks::DebugManager::stopCapture();
+    const Eks::DebugManager::CaptureStatistics stats = Eks::DebugManager::captureStatistics();
+    extra["recorded_bytes"] = (double)stats.recordedBytes;
+    extra["dropped_batches"] = (double)stats.droppedBatches;
+    QFile::remove(capture);
+    }
+
+  report(name, count, count * (FrameOverhead + BlobOverhead + size), ns, extra);
+  }
+
+void benchSendMedium(const char *name)
+  {
+  benchSendBlob(name, MediumSize, 200000);
+  }
+
+void benchSendLarge(const char *name)
+  {
+  benchSendBlob(name, LargeSize, 4000);
+  }
+
+void benchCapture(const char *name)
+  {
+  benchSendBlob(name, MediumSize, 200000, QDir::temp().filePath("EksDebugBench.capture"));
+  }
+
+void benchLockOutputStream(const char *name)
+  {
+  const xuint32 count = 2000000;
+
+  Eks::DebugManager manager(true, 0, Transport::Null);
+  Eks::BenchInterface ifc(0, true);
+  waitForDrain();
+
+  // an empty frame, just the header and its lock.
+  QElapsedTimer timer;
+  timer.start();
+  for(xuint32 i = 0; i < count; ++i)
+    {
+    Eks::DebugManager::lockOutputStream(&ifc);
+    Eks::DebugManager::unlockOutputStream();
+    }
+  const qint64 ns = timer.nsecsElapsed();
+  waitForDrain();
+
+  report(name, count, count * (FrameOverhead - 1), ns);
+  }
+
+void benchFlush(const char *name)
+  {
+  const xuint32 bursts = 20000;
+  const xuint32 burstSize = 32;
+
+  Eks::DebugManager manager(true, 0, Transport::Null);
+  Eks::BenchInterface ifc(0, true);
+  waitForDrain();
+
+  // bursts smaller than a batch, each flushed and drained before the next.
+  QElapsedTimer timer;
+  timer.start();
+  for(xuint32 b = 0; b < bursts; ++b)
+    {
+    for(xuint32 i = 0; i < burstSize; ++i)
+      {
+      Eks::BenchInterface::Value v = { i };
+      ifc.send(v);
+      }
+    waitForDrain();
+    }
+  const qint64 ns = timer.nsecsElapsed();
+
+  QJsonObject extra;
+  extra["ns_per_flush"] = (double)ns / bursts;
+  report(name, bursts * burstSize, bursts * burstSize * (FrameOverhead + SmallSize), ns, extra);
+  }
+
+void benchParse(const char *name, xsize size, xuint32 count)
+  {
+  const QByteArray stream = recordStream(1, size, count);
+
+  QElapsedTimer timer;
+  timer.start();
+
+  // read the stream in transport sized chunks, as onDataReady does.
+  Eks::DebugFrameParser parser;
+  xuint64 frames = 0;
+  for(int pos = 0; pos < stream.size(); pos += 64 * 1024)
+    {
+    parser.buffer().append(stream.constData() + pos, xMin(64 * 1024, stream.size() - pos));
+
+    Eks::DebugFrameParser::Frame frame;
+    while(parser.nextFrame(frame))
+      {
+      ++frames;
+      }
+    }
+  const qint64 ns = timer.nsecsElapsed();
+
+  if(frames != count)
+    {
+    qWarning() << name << "parsed" << frames << "of" << count << "frames";
+    }
+  report(name, frames, stream.size(), ns);
+  }
+
+void benchParseSmall(const char *name)
+  {
+  benchParse(name, SmallSize, 1000000);
+  }
+
+void benchParseMedium(const char *name)
+  {
+  benchParse(name, MediumSize, 200000);
+  }
+
+void benchDispatch(const char *name)
+  {
+  const xuint32 count = 2000000;
+
+  Eks::DebugManager manager(false, 0, Transport::Null);
+  Eks::BenchInterface ifc(0, false);
+
+  QByteArray messages;
+  QDataStream w(&messages, QIODevice::WriteOnly);
+  for(xuint32 i = 0; i < count; ++i)
+    {
+    Eks::BenchInterface::Value v = { i };
+    w << (xuint8)Eks::BenchInterface::Value::DebugMessageType << v;
+    }
+
+  // messages back to back on one stream, so only the dispatch and decode are measured.
+  QDataStream s(messages);
+  QElapsedTimer timer;
+  timer.start();
+  for(xuint32 i = 0; i < count; ++i)
+    {
+    ifc.onDataRecieved(s);
+    }
+  const qint64 ns = timer.nsecsElapsed();
+
+  if(ifc.recieved != count)
+    {
+    qWarning() << name << "dispatched" << ifc.recieved << "of" << count << "messages";
+    }
+  report(name, count, messages.size(), ns);
+  }
+
+/// Compresses [stream] in blocks, then decompresses and parses it as the debugger would.
+void benchCompressStream(const char *name, xuint32 frames, const QByteArray &stream, QJsonObject extra = QJsonObject())
+  {
+  QByteArray compressed;
+  QElapsedTimer timer;
+  timer.start();
+  Eks::DebugStreamCompressor::compressBlocks(stream.constData(), stream.size(), compressed);
+  const qint64 compressNs = timer.nsecsElapsed();
+
+  Eks::DebugStreamDecompressor decompressor;
+  Eks::DebugFrameParser parser;
+  xsize decoded = 0;
+  timer.restart();
+  for(int pos = 0; pos < compressed.size(); pos += 64 * 1024)
+    {
+    decompressor.input().append(compressed.constData() + pos, xMin(64 * 1024, compressed.size() - pos));
+
+    xsize produced = 0;
+    decompressor.decode(parser.buffer(), produced);
+    decoded += produced;
+
+    // keep the parser's buffer from growing, as dispatch would.
+    Eks::DebugFrameParser::Frame frame;
+    while(parser.nextFrame(frame))
+      {
+      }
+    }
+  const qint64 decompressNs = timer.nsecsElapsed();
+
+  if(decoded != (xsize)stream.size())
+    {
+    qWarning() << name << "decoded" << decoded << "of" << stream.size() << "bytes";
+    }
+
+  extra["compressed_bytes"] = compressed.size();
+  extra["ratio"] = (double)stream.size() / compressed.size();
+  extra["decompress_mb_per_second"] = (stream.size() / (1024.0 * 1024.0)) / (decompressNs / 1e9);
+  report(name, frames, stream.size(), compressNs, extra);
+  }
+
+void benchCompression(const char *name)
+  {
+  const xuint32 count = 50000;
+  benchCompressStream(name, count, recordStream(1, MediumSize, count));
+  }
+
+/// Records a capture of DebugLogger traffic, scopes, moments and log records from several
+/// threads, which is what a real client mostly sends.
+bool recordLoggerCapture(const QString &path, QJsonObject &extra)
+  {
+  typedef Eks::DebugLogger Logger;
+
+  static const xuint32 ThreadCount = 4;
+  static const xuint32 Frames = 20000;
+
+  static Logger::Location frame = { __FILE__, Q_FUNC_INFO, __LINE__, "Frame", { Logger::InvalidLocation } };
+  static Logger::Location update = { __FILE__, Q_FUNC_INFO, __LINE__, "Update", { Logger::InvalidLocation } };
+  static Logger::Location render = { __FILE__, Q_FUNC_INFO, __LINE__, "Render", { Logger::InvalidLocation } };
+  static Logger::Location present = { __FILE__, Q_FUNC_INFO, __LINE__, "Present", { Logger::InvalidLocation } };
+  static Logger::Location frameLog =
+    { __FILE__, Q_FUNC_INFO, __LINE__, "Frame %1 took %2ms", { Logger::InvalidLocation } };
+
+  Eks::DebugManager manager(true, 0, Transport::Null);
+  xuint64 dropped = 0;
+  xuint64 droppedLogs = 0;
+    {
+    Logger logger(0, true);
+    waitForDrain();
+
+    if(!Eks::DebugManager::startCapture(path))
+      {
+      qWarning() << "Failed to start capture" << path;
+      return false;
+      }
+
+    std::vector<std::thread> threads;
+    for(xuint32 t = 0; t < ThreadCount; ++t)
+      {
+      threads.emplace_back([]()
+        {
+        for(xuint32 i = 0; i < Frames; ++i)
+          {
+          Logger::Scope f(frame);
+            {
+            Logger::Scope u(update);
+            }
+            {
+            Logger::Scope r(render);
+            }
+          Logger::moment(present);
+          if(i % 16 == 0)
+            {
+            Logger::log(frameLog, i, 16.6);
+            }
+          }
+        });
+      }
+
+    for(auto &t : threads)
+      {
+      t.join();
+      }
+
+    dropped = logger.droppedEvents();
+    droppedLogs = logger.droppedLogRecords();
+    }
+  waitForDrain();
+  Eks::DebugManager::stopCapture();
+
+  extra["dropped_events"] = (double)dropped;
+  extra["dropped_log_records"] = (double)droppedLogs;
+  extra["dropped_capture_bytes"] = (double)Eks::DebugManager::captureStatistics().droppedBytes;
+  return true;
+  }
+
+/// The ratio on a recorded stream rather than synthetic blobs. EKSDEBUG_BENCH_CAPTURE names a
+/// capture recorded from an application with DebugManager::startCapture, otherwise one of
+/// DebugLogger traffic is recorded.
+void benchCompressionCapture(const char *name)
+  {
+  QJsonObject extra;
+
+  QString path = QString::fromLocal8Bit(qgetenv("EKSDEBUG_BENCH_CAPTURE"));
+  const bool recorded = path.isEmpty();
+  if(recorded)
+    {
+    path = QDir::temp().filePath("EksDebugBench.logger.capture");
+    if(!recordLoggerCapture(path, extra))
+      {
+      return;
+      }
+    }
+
+  QFile file(path);
+  if(!file.open(QIODevice::ReadOnly) || file.size() < Eks::DebugCaptureWriter::HeaderSize)
+    {
+    qWarning() << name << "failed to read capture" << path;
+    return;
+    }
+  file.seek(Eks::DebugCaptureWriter::HeaderSize);
+  const QByteArray stream = file.readAll();
+  file.close();
+
+  if(recorded)
+    {
+    QFile::remove(path);
+    }
+
+  Eks::DebugFrameParser parser;
+  parser.buffer().append(stream.constData(), stream.size());
+  xuint32 frames = 0;
+  Eks::DebugFrameParser::Frame frame;
+  while(parser.nextFrame(frame))
+    {
+    ++frames;
+    }
+
+  extra["capture"] = recorded ? QString("logger") : path;
+  benchCompressStream(name, frames, stream, extra);
+  }
+
+void benchEncoding(const char *name)
+  {
+  const xuint32 count = 1000000;
+  const QString text("Frame finished");
+
+  // a log entry: thread, time, level and text.
+  QByteArray plain;
+  QDataStream plainStream(&plain, QIODevice::WriteOnly);
+  QElapsedTimer timer;
+  timer.start();
+  for(xuint32 i = 0; i < count; ++i)
+    {
+    plainStream << (xuint64)1 << (xint64)i * 1000 << (xuint32)2 << text;
+    }
+  const qint64 plainNs = timer.nsecsElapsed();
+
+  QByteArray compact;
+  QDataStream compactStream(&compact, QIODevice::WriteOnly);
+  timer.restart();
+  for(xuint32 i = 0; i < count; ++i)
+    {
+    Eks::DebugCompactWriter w(compactStream);
+    w.writeUnsigned(1);
+    w.writeThreadTime(1, (xint64)i * 1000);
+    w.writeUnsigned(2);
+    w.writeString(text);
+    }
+  const qint64 compactNs = timer.nsecsElapsed();
+
+  QJsonObject extra;
+  extra["bytes_per_message"] = (double)compact.size() / count;
+  extra["qdatastream_bytes_per_message"] = (double)plain.size() / count;
+  extra["qdatastream_ns_per_message"] = (double)plainNs / count;
+  report(name, count, compact.size(), compactNs, extra);
+  }
+
+/// Decoding the log entries benchEncoding writes, compact against QDataStream.
+void benchDecoding(const char *name)
+  {
+  const xuint32 count = 1000000;
+  const QString text("Frame finished");
+
+  // a server, which holds the thread times compact deltas are decoded against. A thread
+  // benchEncoding doesn't use, so the first time written is a keyframe.
+  Eks::DebugManager manager(false, 0, Transport::Null);
+
+  QByteArray plain;
+  QDataStream plainOut(&plain, QIODevice::WriteOnly);
+  QByteArray compact;
+  QDataStream compactOut(&compact, QIODevice::WriteOnly);
+  for(xuint32 i = 0; i < count; ++i)
+    {
+    plainOut << (xuint64)2 << (xint64)i * 1000 << (xuint32)2 << text;
+
+    Eks::DebugCompactWriter w(compactOut);
+    w.writeUnsigned(2);
+    w.writeThreadTime(2, (xint64)i * 1000);
+    w.writeUnsigned(2);
+    w.writeString(text);
+    }
+
+  xuint64 thread = 0;
+  xint64 time = 0;
+  xuint32 level = 0;
+  QString message;
+
+  QDataStream plainIn(plain);
+  QElapsedTimer timer;
+  timer.start();
+  for(xuint32 i = 0; i < count; ++i)
+    {
+    plainIn >> thread >> time >> level >> message;
+    }
+  const qint64 plainNs = timer.nsecsElapsed();
+
+  Eks::DebugCompactReader::resetThreadTimes();
+  QDataStream compactIn(compact);
+  timer.restart();
+  for(xuint32 i = 0; i < count; ++i)
+    {
+    Eks::DebugCompactReader r(compactIn);
+    thread = r.readUnsigned();
+    r.readThreadTime(thread, time);
+    level = (xuint32)r.readUnsigned();
+    message = r.readString();
+    }
+  const qint64 compactNs = timer.nsecsElapsed();
+
+  if(compactIn.status() != QDataStream::Ok || time != (xint64)(count - 1) * 1000)
+    {
+    qWarning() << name << "decoded the wrong entries";
+    }
+
+  QJsonObject extra;
+  extra["qdatastream_ns_per_message"] = (double)plainNs / count;
+  report(name, count, compact.size(), compactNs, extra);
+  }
+
+/// The cost of stamping an event with [source], against Eks::Time::now().
+void benchTimestamp(const char *name, Eks::DebugTimestamp::Source source)
+  {
+  const xuint32 count = 10000000;
+
+  if(!Eks::DebugTimestamp::setSource(source))
+    {
+    qWarning() << name << "source isn't available";
+    return;
+    }
+
+  QElapsedTimer timer;
+  timer.start();
+  xint64 sum = 0;
+  for(xuint32 i = 0; i < count; ++i)
+    {
+    sum += Eks::DebugTimestamp::now();
+    }
+  const qint64 ns = timer.nsecsElapsed();
+
+  timer.restart();
+  for(xuint32 i = 0; i < count; ++i)
+    {
+    sum += Eks::Time::now().nanoseconds();
+    }
+  const qint64 timeNs = timer.nsecsElapsed();
+
+  Eks::DebugTimestamp::setSource(Eks::DebugTimestamp::Source::Clock);
+
+  QJsonObject extra;
+  extra["time_now_ns_per_message"] = (double)timeNs / count;
+  // keeps the reads from being optimised out.
+  extra["checksum"] = (double)(sum & 0xFFFF);
+  report(name, count, 0, ns, extra);
+  }
+
+void benchTimestampClock(const char *name)
+  {
+  benchTimestamp(name, Eks::DebugTimestamp::Source::Clock);
+  }
+
+void benchTimestampTsc(const char *name)
+  {
+  benchTimestamp(name, Eks::DebugTimestamp::Source::Tsc);
+  }
+
+void silentHandler(QtMsgType, const QMessageLogContext &, const QString &)
+  {
+  }
+
+/// Logs [count] messages through [log] with a client DebugLogger, how long the calls take is
+/// what the application feels, the total includes draining them to a Null transport.
+template <typename Log> void benchLog(const char *name, Log log)
+  {
+  const xuint32 count = 1000000;
+
+  // the logger passes messages on to the handler it replaced, which shouldn't be measured.
+  QtMessageHandler oldHandler = qInstallMessageHandler(silentHandler);
+
+  Eks::DebugManager manager(true, 0, Transport::Null);
+  QElapsedTimer timer;
+  qint64 logNs = 0;
+  xuint64 dropped = 0;
+    {
+    Eks::DebugLogger logger(0, true);
+    waitForDrain();
+
+    timer.start();
+    for(xuint32 i = 0; i < count; ++i)
+      {
+      log(logger, i);
+      }
+    logNs = timer.nsecsElapsed();
+    dropped = logger.droppedLogRecords();
+    }
+  waitForDrain();
+  const qint64 ns = timer.nsecsElapsed();
+
+  qInstallMessageHandler(oldHandler);
+
+  QJsonObject extra;
+  extra["producer_ns_per_message"] = (double)logNs / count;
+  extra["dropped"] = (double)dropped;
+  report(name, count, 0, ns, extra);
+  }
+
+/// The path before binary records, formatting on the calling thread and sending a LogEntry.
+void benchLogEntry(const char *name)
+  {
+  benchLog(name, [](Eks::DebugLogger &logger, xuint32 i)
+    {
+    Eks::DebugLogger::LogEntry e;
+    e.time = Eks::Time::now();
+    e.thread = QThread::currentThread();
+    e.level = QtDebugMsg;
+    e.entry = QString("Frame %1 took %2ms").arg(i).arg(16.6);
+    logger.emitLogMessage(e);
+    });
+  }
+
+void benchLogQtMessage(const char *name)
+  {
+  benchLog(name, [](Eks::DebugLogger &, xuint32 i)
+    {
+    qDebug("Frame %u took %.1fms", i, 16.6);
+    });
+  }
+
+/// Qt messages too long for a record, sent whole as a LogEntry from the logging thread.
+void benchLogQtMessageLong(const char *name)
+  {
+  static const QByteArray text(Eks::DebugLogger::LogRecord::MaxUtf16Argument * 2, 'x');
+
+  benchLog(name, [](Eks::DebugLogger &, xuint32 i)
+    {
+    qDebug("Frame %u: %s", i, text.constData());
+    });
+  }
+
+void benchLogBinary(const char *name)
+  {
+  static Eks::DebugLogger::Location location =
+    { __FILE__, Q_FUNC_INFO, __LINE__, "Frame %1 took %2ms", { Eks::DebugLogger::InvalidLocation } };
+
+  benchLog(name, [](Eks::DebugLogger &, xuint32 i)
+    {
+    Eks::DebugLogger::log(location, i, 16.6);
+    });
+  }
+
+/// Small messages paced at a fixed rate from another thread, counting the transport writes
+/// they cost. Without batching, each send asks for a drain as soon as it is staged.
+void benchBatching(const char *name, bool batched)
+  {
+  const xuint32 count = 1000000;
+  // one event a microsecond, 1M a second.
+  const qint64 intervalNs = 1000;
+
+  Eks::DebugManager manager(true, 0, Transport::Null);
+  Eks::BenchInterface ifc(0, true);
+  waitForDrain();
+
+  const xuint64 writesBefore = Eks::DebugManager::queueStatistics().transportWrites;
+
+  QElapsedTimer timer;
+  timer.start();
+  std::thread producer([&ifc, &timer, batched, count, intervalNs]()
+    {
+    for(xuint32 i = 0; i < count; ++i)
+      {
+      while(timer.nsecsElapsed() < (qint64)i * intervalNs)
+        {
+        }
+
+      Eks::BenchInterface::Value v = { i };
+      ifc.send(v);
+      if(!batched)
+        {
+        Eks::DebugManager::flush();
+        }
+      }
+    });
+  producer.join();
+  const qint64 sendNs = timer.nsecsElapsed();
+  waitForDrain();
+
+  const xuint64 writes = Eks::DebugManager::queueStatistics().transportWrites - writesBefore;
+
+  QJsonObject extra;
+  extra["events_per_second"] = count / (sendNs / 1e9);
+  extra["writes"] = (double)writes;
+  extra["writes_per_second"] = writes / (timer.nsecsElapsed() / 1e9);
+  extra["events_per_write"] = writes ? (double)count / writes : 0.0;
+  report(name, count, count * (FrameOverhead + sizeof(xuint32)), timer.nsecsElapsed(), extra);
+  }
+
+void benchBatched(const char *name)
+  {
+  benchBatching(name, true);
+  }
+
+void benchUnbatched(const char *name)
+  {
+  benchBatching(name, false);
+  }
+
+/// Application frames of a fixed tick, each sending a burst. How long each frame's sends take
+/// is what a debugged application feels. Between frames the application runs its event loop,
+/// which drains the stream when the manager shares its thread.
+void benchJitter(const char *name, bool ioThread)
+  {
+  const xuint32 ticks = 2000;
+  const xuint32 perTick = 64;
+  const qint64 tickNs = 1000000;
+
+  Eks::DebugManager manager(true, 0, Transport::Null, 0, ioThread);
+  Eks::BenchInterface ifc(0, true);
+  waitForDrain();
+
+  Eks::BenchInterface::Blob blob = { payload(MediumSize, 1) };
+
+  std::vector<qint64> work;
+  work.reserve(ticks);
+
+  QElapsedTimer timer;
+  timer.start();
+  for(xuint32 t = 0; t < ticks; ++t)
+    {
+    const qint64 start = timer.nsecsElapsed();
+    for(xuint32 i = 0; i < perTick; ++i)
+      {
+      ifc.send(blob);
+      }
+    const qint64 end = timer.nsecsElapsed();
+    work.push_back(end - start);
+
+    const qint64 next = (t + 1) * tickNs;
+    while(timer.nsecsElapsed() < next)
+      {
+      QCoreApplication::processEvents();
+      }
+    }
+  waitForDrain();
+
+  std::sort(work.begin(), work.end());
+  QJsonObject extra;
+  extra["frame_p50_ns"] = (double)work[work.size() / 2];
+  extra["frame_p99_ns"] = (double)work[work.size() * 99 / 100];
+  extra["frame_max_ns"] = (double)work.back();
+  report(name, ticks * perTick, ticks * perTick * (FrameOverhead + BlobOverhead + MediumSize), timer.nsecsElapsed(), extra);
+  }
+
+void benchJitterIOThread(const char *name)
+  {
+  benchJitter(name, true);
+  }
+
+/// The baseline, the transport on the sending thread as before the I/O thread.
+void benchJitterManagerThread(const char *name)
+  {
+  benchJitter(name, false);
+  }
+
+/// Sends through a real transport, to a reader on this thread.
+template <typename Server, typename Socket> void benchTransport(
+    const char *name,
+    Transport transport,
+    Server &server,
+    std::function<bool()> listen)
+  {
+  const xuint32 count = 100000;
+
+  if(!listen())
+    {
+    qWarning() << name << "couldn't listen";
+    return;
+    }
+
+  Eks::DebugManager manager(true, 0, transport);
+  if(!server.waitForNewConnection(5000))
+    {
+    qWarning() << name << "client didn't connect";
+    return;
+    }
+  Socket *reader = static_cast<Socket *>(server.nextPendingConnection());
+
+  Eks::BenchInterface ifc(0, true);
+  Eks::BenchInterface::Blob blob = { payload(MediumSize, 1) };
+
+  QElapsedTimer timer;
+  timer.start();
+  std::thread producer([&ifc, &blob, count]()
+    {
+    for(xuint32 i = 0; i < count; ++i)
+      {
+      ifc.send(blob);
+      }
+    Eks::DebugManager::flush();
+    });
+
+  Eks::DebugFrameParser parser;
+  xuint64 frames = 0;
+  xuint64 bytes = 0;
+  while(frames < count && timer.elapsed() < 60000)
+    {
+    reader->waitForReadyRead(10);
+    const QByteArray data = reader->readAll();
+    parser.buffer().append(data.constData(), data.size());
+    bytes += data.size();
+
+    Eks::DebugFrameParser::Frame frame;
+    while(parser.nextFrame(frame))
+      {
+      // the controller's frames aren't part of the measurement.
+      frames += frame.id != 0;
+      }
+    }
+  const qint64 ns = timer.nsecsElapsed();
+  producer.join();
+
+  if(frames != count)
+    {
+    qWarning() << name << "recieved" << frames << "of" << count << "frames";
+    }
+  report(name, frames, bytes, ns);
+  }
+
+void benchTcp(const char *name)
+  {
+  QTcpServer server;
+  benchTransport<QTcpServer, QTcpSocket>(name, Transport::Tcp, server, [&server]()
+    {
+    return server.listen(QHostAddress::LocalHost, 12345);
+    });
+  }
+
+void benchLocalSocket(const char *name)
+  {
+  // the name DebugTransport connects to.
+  static const char *ServerName = "EksDebug";
+
+  QLocalServer server;
+  benchTransport<QLocalServer, QLocalSocket>(name, Transport::LocalSocket, server, [&server]()
+    {
+    QLocalServer::removeServer(ServerName);
+    return server.listen(ServerName);
+    });
+  }
+
+/// The debugger's end of the shared memory transport, shaped like a QTcpServer for benchTransport.
+class SharedMemoryServer
+  {
+public:
+  SharedMemoryServer()
+      : transport(Eks::DebugTransport::create(Transport::SharedMemory, 0)),
+        _pending(0)
+    {
+    }
+
+  ~SharedMemoryServer()
+    {
+    delete transport;
+    }
+
+  bool listen()
+    {
+    return transport->listen();
+    }
+
+  /// The connection is noticed by the transport's poll timer.
+  bool waitForNewConnection(int msecs)
+    {
+    QElapsedTimer timer;
+    timer.start();
+    while(!_pending && timer.elapsed() < msecs)
+      {
+      QCoreApplication::processEvents();
+      _pending = transport->nextPendingConnection();
+      QThread::msleep(1);
+      }
+    return _pending != 0;
+    }
+
+  QIODevice *nextPendingConnection()
+    {
+    QIODevice *dev = _pending;
+    _pending = 0;
+    return dev;
+    }
+
+  Eks::DebugTransport *transport;
+
+private:
+  QIODevice *_pending;
+  };
+
+void benchSharedMemory(const char *name)
+  {
+  SharedMemoryServer server;
+  benchTransport<SharedMemoryServer, QIODevice>(name, Transport::SharedMemory, server, [&server]()
+    {
+    return server.listen();
+    });
+  }
+
+xint64 steadyNanoseconds()
+  {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+/// Time from each send to the reader parsing its frame, messages sent at a steady rate with
+/// the default batching, so it includes the time a frame waits for its batch.
+template <typename Server, typename Socket> void benchLatency(
+    const char *name,
+    Transport transport,
+    Server &server,
+    std::function<bool()> listen)
+  {
+  const xuint32 count = 20000;
+  const qint64 intervalNs = 50000;
+
+  if(!listen())
+    {
+    qWarning() << name << "couldn't listen";
+    return;
+    }
+
+  Eks::DebugManager manager(true, 0, transport);
+  if(!server.waitForNewConnection(5000))
+    {
+    qWarning() << name << "client didn't connect";
+    return;
+    }
+  Socket *reader = static_cast<Socket *>(server.nextPendingConnection());
+
+  Eks::BenchInterface ifc(0, true);
+
+  std::thread producer([&ifc, count, intervalNs]()
+    {
+    const xint64 start = steadyNanoseconds();
+    for(xuint32 i = 0; i < count; ++i)
+      {
+      while(steadyNanoseconds() - start < (xint64)i * intervalNs)
+        {
+        }
+
+      // the payload is the send time.
+      const xint64 sent = steadyNanoseconds();
+      Eks::BenchInterface::Blob blob = { QByteArray((const char *)&sent, sizeof(sent)) };
+      ifc.send(blob);
+      }
+    });
+
+  QElapsedTimer timer;
+  timer.start();
+
+  std::vector<xint64> latencies;
+  latencies.reserve(count);
+  Eks::DebugFrameParser parser;
+  while(latencies.size() < count && timer.elapsed() < 60000)
+    {
+    reader->waitForReadyRead(1);
+    const QByteArray data = reader->readAll();
+    parser.buffer().append(data.constData(), data.size());
+
+    Eks::DebugFrameParser::Frame frame;
+    while(parser.nextFrame(frame))
+      {
+      const xsize blobHeader = 1 + BlobOverhead;
+      if(frame.id == 0 || frame.size != blobHeader + sizeof(xint64))
+        {
+        continue;
+        }
+
+      xint64 sent;
+      memcpy(&sent, frame.data + blobHeader, sizeof(sent));
+      latencies.push_back(steadyNanoseconds() - sent);
+      }
+    }
+  producer.join();
+
+  if(latencies.size() != count)
+    {
+    qWarning() << name << "recieved" << latencies.size() << "of" << count << "frames";
+    if(latencies.empty())
+      {
+      return;
+      }
+    }
+
+  std::sort(latencies.begin(), latencies.end());
+  QJsonObject extra;
+  extra["latency_p50_ns"] = (double)latencies[latencies.size() / 2];
+  extra["latency_p99_ns"] = (double)latencies[latencies.size() * 99 / 100];
+  extra["latency_max_ns"] = (double)latencies.back();
+  report(name, latencies.size(), 0, timer.nsecsElapsed(), extra);
+  }
+
+void benchLatencyTcp(const char *name)
+  {
+  QTcpServer server;
+  benchLatency<QTcpServer, QTcpSocket>(name, Transport::Tcp, server, [&server]()
+    {
+    return server.listen(QHostAddress::LocalHost, 12345);
+    });
+  }
+
+void benchLatencySharedMemory(const char *name)
+  {
+  SharedMemoryServer server;
+  benchLatency<SharedMemoryServer, QIODevice>(name, Transport::SharedMemory, server, [&server]()
+    {
+    return server.listen();
+    });
+  }
+
+struct Benchmark
+  {
+  const char *name;
+  void (*run)(const char *name);
+  };
+
+const Benchmark g_benchmarks[] =
+  {
+  { "sendData/small", benchSendSmall },
+  { "sendData/shared", benchSendShared },
+  { "sendData/medium", benchSendMedium },
+  { "sendData/large", benchSendLarge },
+  { "lockOutputStream", benchLockOutputStream },
+  { "flush", benchFlush },
+  { "batching/batched", benchBatched },
+  { "batching/unbatched", benchUnbatched },
+  { "onDataReady/parse/small", benchParseSmall },
+  { "onDataReady/parse/medium", benchParseMedium },
+  { "onDataRecieved/dispatch", benchDispatch },
+  { "compression", benchCompression },
+  { "compression/capture", benchCompressionCapture },
+  { "encoding/compact", benchEncoding },
+  { "encoding/compactDecode", benchDecoding },
+  { "log/logEntry", benchLogEntry },
+  { "log/qtMessage", benchLogQtMessage },
+  { "log/qtMessageLong", benchLogQtMessageLong },
+  { "log/binary", benchLogBinary },
+  { "timestamp/clock", benchTimestampClock },
+  { "timestamp/tsc", benchTimestampTsc },
+  { "capture", benchCapture },
+  { "jitter", benchJitterIOThread },
+  { "jitter/managerThread", benchJitterManagerThread },
+  { "transport/tcp", benchTcp },
+  { "transport/local", benchLocalSocket },
+  { "transport/shm", benchSharedMemory },
+  { "latency/tcp", benchLatencyTcp },
+  { "latency/shm", benchLatencySharedMemory },
+  };
+
+}
+
+/// EksDebugBench [filter], runs the benchmarks whose name contains [filter], one JSON line each.
+int main(int argc, char *argv[])
+  {
+  QCoreApplication app(argc, argv);
+  Eks::Core core;
+
+  const QString filter = argc > 1 ? QString(argv[1]) : QString();
+  for(const Benchmark &b : g_benchmarks)
+    {
+    if(filter.isEmpty() || QString(b.name).contains(filter))
+      {
+      b.run(b.name);
+      }
+    }
+
+  return 0;
+  }
@@ -0,0 +1,183 @@
+#ifndef XDEBUGALLOCATORTRACKER_H
+#define XDEBUGALLOCATORTRACKER_H
+
+#include "QtCore/QObject"
+#include "XDebugInterface.h"
+#include "Memory/XAllocatorBase.h"
+#include "QAbstractTableModel"
+#include "QVector"
+#include "QElapsedTimer"
+#include <atomic>
+
+namespace Eks
+{
+
+class DebugAllocatorModel;
+
+/// \brief Passes allocations to [parent], counting them for DebugAllocatorInterface.
+/// \note  Only memory allocated through the tracker may be freed through it. Wrap the allocator a
+///        system is given, TemporaryAllocator and FixedSizeBucketAllocator take any AllocatorBase.
+class EKSDEBUG_EXPORT DebugTrackingAllocator : public AllocatorBase
+  {
+public:
+  DebugTrackingAllocator(AllocatorBase *parent, const QString &name);
+  ~DebugTrackingAllocator();
+
+  void *alloc(xsize size, xsize alignment) X_OVERRIDE;
+  void free(void *mem) X_OVERRIDE;
+
+  const QString &name() const { return _name; }
+  AllocatorBase *parent() const { return _parent; }
+
+  xuint64 liveBytes() const { return _liveBytes.load(std::memory_order_relaxed); }
+  xuint64 liveAllocations() const { return _liveAllocations.load(std::memory_order_relaxed); }
+  xuint64 peakBytes() const { return _peakBytes.load(std::memory_order_relaxed); }
+  xuint64 allocations() const { return _allocations.load(std::memory_order_relaxed); }
+  xuint64 allocatedBytes() const { return _allocatedBytes.load(std::memory_order_relaxed); }
+
+private:
+  AllocatorBase *_parent;
+  QString _name;
+  xuint32 _id;
+
+  std::atomic<xuint64> _liveBytes;
+  std::atomic<xuint64> _liveAllocations;
+  std::atomic<xuint64> _peakBytes;
+  std::atomic<xuint64> _allocations;
+  std::atomic<xuint64> _allocatedBytes;
+
+  // trackers alive, for DebugAllocatorInterface to report.
+  DebugTrackingAllocator *_next;
+
+  friend class DebugAllocatorInterface;
+  };
+
+/// \brief Reports every DebugTrackingAllocator to the debugger.
+/// \note  A client sends a summary every SummaryInterval, on the thread which created it.
+///        Allocation call sites are sampled once setSampleInterval is given a non zero interval.
+class EKSDEBUG_EXPORT DebugAllocatorInterface
+    : public QObject,
+      public DebugInterface
+  {
+  Q_OBJECT
+
+  X_DEBUG_INTERFACE(DebugAllocatorInterface)
+
+public:
+  enum
+    {
+    // ms between summaries.
+    SummaryInterval = 500,
+    // call sites sent with each summary, those allocating most.
+    MaxSummarySites = 16,
+    // frames kept for each sampled call site.
+    SiteFrames = 4
+    };
+
+  struct Summary
+    {
+    enum
+      {
+      DebugMessageType = 1
+      };
+
+    struct AllocatorEntry
+      {
+      xuint32 id;
+      QString name;
+      xuint64 liveBytes;
+      xuint64 liveAllocations;
+      xuint64 peakBytes;
+      // totals since the tracker was created, rates follow from the difference.
+      xuint64 allocations;
+      xuint64 allocatedBytes;
+      };
+
+    struct SiteEntry
+      {
+      QString location;
+      xuint64 samples;
+      xuint64 bytes;
+      };
+
+    xuint32 interval;
+    xuint32 sampleInterval;
+    QVector<AllocatorEntry> allocators;
+    QVector<SiteEntry> sites;
+    };
+
+  ~DebugAllocatorInterface();
+
+  /// \brief Sample the call site of one in [interval] tracked allocations, 0 stops sampling.
+  static void setSampleInterval(xuint32 interval);
+  static xuint32 sampleInterval();
+
+  Summary summarise();
+  void sendSummary();
+
+protected:
+  void timerEvent(QTimerEvent *) X_OVERRIDE;
+
+private:
+  static void sample(xsize size);
+
+  void onSummary(const Summary &s);
+
+  QElapsedTimer _sinceSummary;
+  Eks::UniquePointer<DebugAllocatorModel> _model;
+
+  friend class DebugTrackingAllocator;
+  };
+
+/// \brief Server: the sampled call sites of the latest summary.
+class EKSDEBUG_EXPORT DebugAllocatorSiteModel : public QAbstractTableModel
+  {
+  Q_OBJECT
+
+public:
+  DebugAllocatorSiteModel();
+
+  void setSites(const QVector<DebugAllocatorInterface::Summary::SiteEntry> &sites, xuint32 sampleInterval);
+
+  int rowCount(const QModelIndex &parent) const X_OVERRIDE;
+  int columnCount(const QModelIndex &parent) const X_OVERRIDE;
+  QVariant data(const QModelIndex &index, int role) const X_OVERRIDE;
+  QVariant headerData(int section, Qt::Orientation orientation, int role) const X_OVERRIDE;
+
+private:
+  QVector<DebugAllocatorInterface::Summary::SiteEntry> _sites;
+  xuint32 _sampleInterval;
+  };
+
+/// \brief Server: a row per tracked allocator, with its rates over the last summary.
+class EKSDEBUG_EXPORT DebugAllocatorModel : public QAbstractTableModel
+  {
+  Q_OBJECT
+
+public:
+  DebugAllocatorModel();
+
+  DebugAllocatorSiteModel *sites() { return &_sites; }
+
+  void setSummary(const DebugAllocatorInterface::Summary &s);
+
+  int rowCount(const QModelIndex &parent) const X_OVERRIDE;
+  int columnCount(const QModelIndex &parent) const X_OVERRIDE;
+  QVariant data(const QModelIndex &index, int role) const X_OVERRIDE;
+  QVariant headerData(int section, Qt::Orientation orientation, int role) const X_OVERRIDE;
+
+private:
+  struct Row
+    {
+    DebugAllocatorInterface::Summary::AllocatorEntry entry;
+    double allocationRate;
+    double byteRate;
+    };
+
+  QVector<Row> _rows;
+  DebugAllocatorSiteModel _sites;
+  };
+
+}
+
+#endif // XDEBUGALLOCATORTRACKER_H
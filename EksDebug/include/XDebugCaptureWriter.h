@@ -0,0 +1,74 @@
+#ifndef XDEBUGCAPTUREWRITER_H
+#define XDEBUGCAPTUREWRITER_H
+
+#include "XDebugManager.h"
+#include "XDebugStagingRing.h"
+#include "QFile"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace Eks
+{
+
+/// \brief Records the framed stream to a memory mapped capture file, on a thread of its own.
+/// \note  The manager thread only copies into a staging ring. A batch which doesn't fit is
+///        dropped whole, so the capture never blocks the manager and always holds whole frames.
+///        The file is a CaptureMagic header followed by frames, a capture cut short by a crash
+///        ends at the first all zero header.
+class DebugCaptureWriter
+  {
+public:
+  enum
+    {
+    RingCapacity = 8 * 1024 * 1024,
+    SegmentSize = 16 * 1024 * 1024,
+    HeaderSize = 8
+    };
+
+  static const char CaptureMagic[HeaderSize];
+
+  DebugCaptureWriter();
+  ~DebugCaptureWriter();
+
+  bool start(const QString &path);
+  void stop();
+
+  // manager thread
+  void write(const char *data, xsize size);
+  void commit();
+
+  DebugManager::CaptureStatistics statistics() const;
+
+private:
+  struct Segment
+    {
+    uchar *data;
+    xsize base;
+    };
+
+  void run();
+  bool mapSegment(xsize base, Segment &segment);
+  void unmapSegment(Segment &segment);
+
+  DebugStagingRing _ring;
+  bool _batchOverflowed;
+
+  // writer thread, once started
+  QFile _file;
+  xsize _fileSize;
+
+  std::thread _thread;
+  std::atomic<bool> _stop;
+  std::mutex _wakeLock;
+  std::condition_variable _wake;
+
+  std::atomic<xuint64> _recordedBytes;
+  xuint64 _droppedBatches;
+  xuint64 _droppedBytes;
+  };
+
+}
+
+#endif // XDEBUGCAPTUREWRITER_H
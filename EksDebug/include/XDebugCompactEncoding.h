@@ -0,0 +1,124 @@
+#ifndef XDEBUGCOMPACTENCODING_H
+#define XDEBUGCOMPACTENCODING_H
+
+#include "XDebugGlobal.h"
+#include "QDataStream"
+#include "QString"
+
+namespace Eks
+{
+
+/// \brief Opt a message type into the compact wire encoding by specialising this with Enabled = 1,
+///        and providing operator<< for DebugCompactWriter and operator>> for DebugCompactReader.
+/// \note  The QDataStream operators are still needed, for sessions without the capability.
+template <typename T> struct DebugCompactEncoding
+  {
+  enum
+    {
+    Enabled = 0
+    };
+  };
+
+/// \brief Writes LEB128 varints, zigzag signed values, UTF-8 strings and per thread time deltas.
+class EKSDEBUG_EXPORT DebugCompactWriter
+  {
+public:
+  DebugCompactWriter(QDataStream &stream);
+  ~DebugCompactWriter();
+
+  void writeUnsigned(xuint64 value);
+  void writeSigned(xint64 value);
+  void writeString(const QString &value);
+  void writeBytes(const char *data, xsize size);
+
+  /// \brief Write [nanoseconds] as a delta from the last time written on this thread for [thread].
+  /// \note  A full keyframe is written periodically, so readers recover after dropped frames.
+  void writeThreadTime(xuint64 thread, xint64 nanoseconds);
+  /// \brief Make every thread's next writeThreadTime a keyframe, for a reader joining now.
+  static void forceKeyframes();
+
+  void flush();
+
+private:
+  enum
+    {
+    BufferSize = 256,
+    MaxVarintSize = 10
+    };
+
+  void put(const char *data, xsize size);
+
+  QDataStream &_stream;
+  char _buffer[BufferSize];
+  xsize _used;
+  };
+
+class EKSDEBUG_EXPORT DebugCompactReader
+  {
+public:
+  DebugCompactReader(QDataStream &stream);
+
+  xuint64 readUnsigned();
+  xint64 readSigned();
+  QString readString();
+  void readBytes(char *data, xsize size);
+
+  /// \brief True if [size] bytes are left to read, otherwise the reader fails.
+  /// \note  Check decoded lengths before allocating for them.
+  bool canRead(xuint64 size);
+
+  /// \brief Read a time written with writeThreadTime into [nanoseconds].
+  /// \note  Deltas following a gap in the thread's sequence, or read before the thread's
+  ///        first keyframe, can't be resolved. They return false and zero [nanoseconds].
+  bool readThreadTime(xuint64 thread, xint64 &nanoseconds);
+
+  /// \brief Forget decoded thread times, when a new stream begins.
+  static void resetThreadTimes();
+
+  bool isValid() const { return _stream.status() == QDataStream::Ok; }
+
+private:
+  xuint8 readByte();
+
+  QDataStream &_stream;
+  };
+
+inline DebugCompactWriter &operator<<(DebugCompactWriter &w, xuint32 v)
+  {
+  w.writeUnsigned(v);
+  return w;
+  }
+
+inline DebugCompactWriter &operator<<(DebugCompactWriter &w, xuint64 v)
+  {
+  w.writeUnsigned(v);
+  return w;
+  }
+
+inline DebugCompactWriter &operator<<(DebugCompactWriter &w, const QString &v)
+  {
+  w.writeString(v);
+  return w;
+  }
+
+inline DebugCompactReader &operator>>(DebugCompactReader &r, xuint32 &v)
+  {
+  v = (xuint32)r.readUnsigned();
+  return r;
+  }
+
+inline DebugCompactReader &operator>>(DebugCompactReader &r, xuint64 &v)
+  {
+  v = r.readUnsigned();
+  return r;
+  }
+
+inline DebugCompactReader &operator>>(DebugCompactReader &r, QString &v)
+  {
+  v = r.readString();
+  return r;
+  }
+
+}
+
+#endif // XDEBUGCOMPACTENCODING_H
@@ -0,0 +1,53 @@
+#ifndef XDEBUGCOMPRESSION_H
+#define XDEBUGCOMPRESSION_H
+
+#include "XDebugReceiveBuffer.h"
+#include "QObject"
+#include "QByteArray"
+
+namespace Eks
+{
+
+/// \brief Compresses the framed stream into blocks, on a thread of its own.
+/// \note  Each block is [raw size][stored size], big endian, then the data. Blocks
+///        which don't shrink are stored raw, flagged in the top bit of the stored size.
+class EKSDEBUG_EXPORT DebugStreamCompressor : public QObject
+  {
+  Q_OBJECT
+
+public:
+  enum
+    {
+    BlockHeaderSize = 2 * sizeof(xuint32),
+    StoredRawFlag = 0x80000000
+    };
+
+  static void compressBlocks(const char *data, xsize size, QByteArray &out);
+
+public Q_SLOTS:
+  void compress(const QByteArray &data);
+
+Q_SIGNALS:
+  void compressed(const QByteArray &data);
+  };
+
+/// \brief Decodes the blocks written by DebugStreamCompressor.
+class EKSDEBUG_EXPORT DebugStreamDecompressor
+  {
+public:
+  DebugStreamDecompressor();
+
+  /// \brief Compressed bytes received, waiting for decode.
+  DebugReceiveBuffer &input() { return _input; }
+
+  /// \brief Decode every complete block in input() onto [out], false if one is corrupt.
+  /// \note  [produced] is the number of bytes decoded.
+  bool decode(DebugReceiveBuffer &out, xsize &produced);
+
+private:
+  DebugReceiveBuffer _input;
+  };
+
+}
+
+#endif // XDEBUGCOMPRESSION_H
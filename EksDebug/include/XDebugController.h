@@ -4,12 +4,23 @@
 #include "Containers/XVector.h"
 #include "XDebugGlobal.h"
 #include "XDebugInterface.h"
+#include "QHash"
+#include "QPair"
+#include "QVector"
+#include <atomic>
+#include <mutex>
 
 namespace Eks
 {
 
 struct Init;
 struct SetupInterface;
+struct SetupInterfaceByName;
+struct CompressionStart;
+struct GrantCredit;
+struct SetSendLimit;
+struct InterfaceStatistics;
+struct InterfaceState;
 
 class DebugController : public DebugInterface
   {
@@ -19,16 +30,52 @@ public:
   ~DebugController();
 
   void onDebuggerConnected(bool client);
-  void setupInterface(DebugInterface *ifc);
+
+  /// \brief Reserve the next interface id, callable from any thread.
+  xuint32 allocateInterfaceID();
+  /// \brief Send the setup message for [ifc], on the manager thread only.
+  void announceInterface(DebugInterface *ifc);
+  /// \brief The frame marking the end of the uncompressed stream.
+  /// \note  Only the debugger decompresses, so the manager writes it straight to the
+  ///        transport, never to captures or subscribers.
+  QByteArray compressionStartFrame();
+  /// \brief Server: allow the client to send [bytes] more.
+  void sendCredit(xuint64 bytes);
+  /// \brief Server: ask the client to apply [limit] to [ifc].
+  void sendSendLimit(DebugInterface *ifc, const DebugManager::SendLimit &limit);
+  /// \brief Client: report the send statistics of each of [interfaces].
+  void sendInterfaceStatistics(const Eks::Vector<DebugInterface *> &interfaces);
+  /// \brief Client: send [message] for [ifc], keeping it for later snapshots. Any thread.
+  void sendInterfaceState(DebugInterface *ifc, const QByteArray &message);
+  /// \brief Client: drop the state kept for [ifc], on the manager thread only.
+  void forgetState(DebugInterface *ifc);
+
+  /// \brief Controller frames a new reader of the stream needs before anything else:
+  ///        Init, then the setup of each interface in [interfaces], each naming its type,
+  ///        then the state interfaces have sent.
+  QByteArray setupSnapshot(const Eks::Vector<DebugInterface *> &interfaces);
 
 private:
   void onInit(const Init &);
   void onSetupInterface(const SetupInterface &);
+  void onSetupInterfaceByName(const SetupInterfaceByName &);
+  void onCompressionStart(const CompressionStart &);
+  void onGrantCredit(const GrantCredit &);
+  void onSetSendLimit(const SetSendLimit &);
+  void onInterfaceStatistics(const InterfaceStatistics &);
+  void onInterfaceState(const InterfaceState &);
 
   DebugManager *_manager;
-  xuint32 _maxInteface;
+  std::atomic<xuint32> _maxInteface;
   Eks::Vector<DebugInterface *> _createdInterfaces;
+  // type names sent (client) or recieved (server) this session, by type hash.
+  QHash<xuint32, QString> _typeNames;
   bool _isClient;
+  // server: the version the client sent with Init.
+  xuint32 _remoteVersion;
+  // client: state sent by each interface, in the order it was sent.
+  std::mutex _stateLock;
+  QVector<QPair<DebugInterface *, QByteArray>> _state;
   };
 
 }
@@ -0,0 +1,79 @@
+#ifndef XDEBUGFANOUT_H
+#define XDEBUGFANOUT_H
+
+#include "XDebugManager.h"
+#include "QObject"
+#include "QByteArray"
+#include "QList"
+
+class QIODevice;
+
+namespace Eks
+{
+
+/// \brief Shares the drained stream between subscriber connections, each writing from its own position.
+/// \note  Bytes are appended once, into shared blocks which are released once every subscriber has
+///        written them. A subscriber falling further behind than the backlog limit is dropped, without
+///        holding up the others.
+class DebugFanOut : public QObject
+  {
+  Q_OBJECT
+
+public:
+  enum
+    {
+    BlockSize = 64 * 1024,
+    DefaultBacklogLimit = 16 * 1024 * 1024,
+    // most handed to a device's own buffer at once, the backlog stays shared.
+    WriteHighWater = 256 * 1024
+    };
+
+  DebugFanOut();
+  ~DebugFanOut();
+
+  /// \brief Take ownership of [device], writing [snapshot] and then the stream appended from now on.
+  void addSubscriber(QIODevice *device, const QByteArray &snapshot);
+  /// \brief Close and delete every subscriber.
+  void clear();
+  bool hasSubscribers() const { return !_subscribers.isEmpty(); }
+
+  void setBacklogLimit(xsize bytes) { _backlogLimit = bytes; }
+  DebugManager::SubscriberStatistics statistics() const;
+
+  void append(const char *data, xsize size);
+
+public Q_SLOTS:
+  /// \brief Write what each subscriber's device will take, then release blocks all have written.
+  void pump();
+
+private:
+  struct Block
+    {
+    xuint64 start;
+    QByteArray data;
+    };
+
+  struct Subscriber
+    {
+    QIODevice *device;
+    xuint64 position;
+    QByteArray snapshot;
+    xsize snapshotWritten;
+    };
+
+  bool write(Subscriber &sub);
+  void drop(int index);
+  void removeDevice(QIODevice *device);
+  void releaseBlocks();
+
+  QList<Block> _blocks;
+  xuint64 _end;
+
+  QList<Subscriber> _subscribers;
+  xsize _backlogLimit;
+  xuint64 _droppedSubscribers;
+  };
+
+}
+
+#endif // XDEBUGFANOUT_H
@@ -0,0 +1,85 @@
+#ifndef XDEBUGFRAMEPARSER_H
+#define XDEBUGFRAMEPARSER_H
+
+#include "XDebugReceiveBuffer.h"
+#include "QIODevice"
+#include "QDataStream"
+
+namespace Eks
+{
+
+/// \brief Splits the received stream into frames, however it was fragmented in transit.
+/// \note  Fill buffer() then call nextFrame until it fails. A frame's data points into the
+///        buffer, and stays valid until the buffer is next reserved.
+class EKSDEBUG_EXPORT DebugFrameParser
+  {
+public:
+  struct Frame
+    {
+    xuint32 id;
+    const char *data;
+    xsize size;
+    };
+
+  enum
+    {
+    HeaderSize = 2 * sizeof(xuint32),
+    InitialCapacity = 256 * 1024
+    };
+
+  DebugFrameParser();
+
+  DebugReceiveBuffer &buffer() { return _buffer; }
+  const DebugReceiveBuffer &buffer() const { return _buffer; }
+
+  /// \brief Find the next complete frame, false if more data is needed.
+  bool nextFrame(Frame &frame);
+
+  /// \brief A stream reading [frame], reused for every frame.
+  QDataStream &stream(const Frame &frame);
+
+  /// \brief Move the bytes following the last frame returned to [dst].
+  /// \note  Used when the rest of the stream needs decoding before it's parsed.
+  void takeUnparsed(DebugReceiveBuffer &dst);
+
+  void clear();
+
+private:
+  class View : public QIODevice
+    {
+  public:
+    View();
+    void reset(const char *data, xsize size);
+
+    bool isSequential() const X_OVERRIDE { return true; }
+    qint64 bytesAvailable() const X_OVERRIDE;
+
+  protected:
+    qint64 readData(char *data, qint64 len) X_OVERRIDE;
+    qint64 writeData(const char *, qint64) X_OVERRIDE;
+
+  private:
+    const char *_data;
+    xsize _size;
+    xsize _read;
+    };
+
+  enum State
+    {
+    ReadingHeader,
+    ReadingPayload
+    };
+
+  DebugReceiveBuffer _buffer;
+
+  State _state;
+  xuint32 _frameID;
+  xuint32 _frameLength;
+
+  View _view;
+  QDataStream _stream;
+  };
+
+}
+
+#endif // XDEBUGFRAMEPARSER_H
@@ -4,13 +4,19 @@
 #include "XDebugGlobal.h"
 #include "Utilities/XAssert.h"
 #include "XDebugManager.h"
+#include "XDebugCompactEncoding.h"
+#include "QByteArray"
+#include "QDataStream"
 #include "QString"
+#include <atomic>
+#include <cstring>
 
 class QObject;
 class QAbstractItemModel;
 
 #define X_DEBUG_INTERFACE(cls) public: cls(DebugManager *m, bool client=true); \
   QString typeName() X_OVERRIDE { static QString n(#cls); return n; } \
+  xuint32 typeHash() X_OVERRIDE { static const xuint32 h = Eks::detail::debugTypeHash(#cls); return h; } \
   private:
 
 #ifdef X_ENABLE_APPLICATION_DEBUGGING
@@ -31,24 +37,103 @@ class DebugInterfaceType
   {
 public:
   QString type;
+  xuint32 typeHash;
   DebugManager::CreateInterfaceFunction create;
   DebugManager::DestroyInterfaceFunction destroy;
+  // next type in the same registry bucket
   DebugInterfaceType *next;
   };
 
+namespace detail
+{
+
+/// \brief FNV-1a hash of an interface's type name, identifying the type on the wire.
+X_CONST_EXPR inline xuint32 debugTypeHash(const char *name, xuint32 hash = 2166136261U)
+  {
+  return *name ? debugTypeHash(name + 1, (hash ^ (xuint8)*name) * 16777619U) : hash;
+  }
+
+template <typename T, bool Compact = DebugCompactEncoding<T>::Enabled != 0> struct DebugMessageCodec
+  {
+  static void write(QDataStream &s, const T &t)
+    {
+    s << t;
+    }
+
+  static void read(QDataStream &s, T &t)
+    {
+    s >> t;
+    }
+  };
+
+template <typename T> struct DebugMessageCodec<T, true>
+  {
+  static void write(QDataStream &s, const T &t)
+    {
+    if(DebugManager::capabilities() & DebugManager::CompactEncoding)
+      {
+      DebugCompactWriter w(s);
+      w << t;
+      }
+    else
+      {
+      s << t;
+      }
+    }
+
+  static void read(QDataStream &s, T &t)
+    {
+    if(DebugManager::capabilities() & DebugManager::CompactEncoding)
+      {
+      DebugCompactReader r(s);
+      r >> t;
+      }
+    else
+      {
+      s >> t;
+      }
+    }
+  };
+
+}
+
 class EKSDEBUG_EXPORT DebugInterface
   {
 XProperties:
-  XProperty(xuint32, interfaceID, setInterfaceID);
   XROProperty(QObject *, dataModel);
 
 public:
+  static const xuint32 InvalidInterfaceID = 0xFFFFFFFF;
+  // set while one thread assigns the id, other senders wait for it.
+  static const xuint32 PendingInterfaceID = 0xFFFFFFFE;
+  // counted in shared atomics, once every per thread counter slot is held.
+  static const xuint32 NoCounterSlot = 0xFFFFFFFF;
+
   virtual ~DebugInterface();
 
+  xuint32 interfaceID() const { return _interfaceID.load(std::memory_order_acquire); }
+  void setInterfaceID(xuint32 id) { _interfaceID.store(id, std::memory_order_release); }
+
   virtual QString typeName() = 0;
+  virtual xuint32 typeHash() = 0;
 
   void onDataRecieved(QDataStream &data);
 
+  /// \brief How this interface's sends behave once the debugger falls behind, Block by default.
+  /// \note  Sample keeps one frame in every [sampleInterval].
+  void setFlowControlPolicy(DebugManager::FlowControlPolicy policy, xuint32 sampleInterval = 8);
+  DebugManager::FlowControlPolicy flowControlPolicy() const { return _flowControlPolicy; }
+
+  /// \brief Sample and rate limit this interface's sends, a debugger can also request this.
+  /// \note  Dropped messages are never serialised, so cost little more than the check.
+  void setSendLimit(const DebugManager::SendLimit &limit);
+  const DebugManager::SendLimit &sendLimit() const { return _sendLimit; }
+
+  /// \brief Messages sent and dropped by the send limit. On a debugger, the counts the client
+  ///        last reported.
+  DebugManager::SendStatistics sendStatistics() const;
+  void setSendStatistics(const DebugManager::SendStatistics &stats);
+
 protected:
   struct Reciever
     {
@@ -63,6 +148,34 @@ protected:
     RecieveFunction fn;
     };
 
+  enum
+    {
+    MessageTypeCount = 256
+    };
+
+  /// \brief A type's recievers indexed by message type byte, built once per type as a
+  ///        function-local static and shared by its instances.
+  class DispatchTable
+    {
+  public:
+    DispatchTable(const Reciever *r, xsize recCount)
+      {
+      memset(_fns, 0, sizeof(_fns));
+      for(xsize i = 0; i < recCount; ++i)
+        {
+        xAssert(r[i].type < MessageTypeCount);
+        xAssert(!_fns[r[i].type]);
+        _fns[r[i].type] = r[i].fn;
+        }
+      }
+
+    // null for types the interface doesn't accept.
+    Reciever::RecieveFunction find(xuint8 type) const { return _fns[type]; }
+
+  private:
+    Reciever::RecieveFunction _fns[MessageTypeCount];
+    };
+
   class OutputTunnel
     {
   public:
@@ -77,13 +190,35 @@ protected:
 
   DebugInterface();
 
-  void setRecievers(const Reciever*, xsize recCount);
+  /// \brief Dispatch recieved messages through [table], which must outlive the interface.
+  void setRecievers(const DispatchTable &table) { _dispatch = &table; }
 
   template <typename T> void sendData(const T &data)
     {
     xAssert(T::DebugMessageType < std::numeric_limits<xuint8>::max());
+    if(_sendLimited.load(std::memory_order_relaxed) && !admitSend())
+      {
+      return;
+      }
+
     OutputTunnel t(this);
-    t.stream() << (xuint8)T::DebugMessageType << data;
+    t.stream() << (xuint8)T::DebugMessageType;
+    detail::DebugMessageCodec<T>::write(t.stream(), data);
+    }
+
+  /// \brief Send a message later messages can't be decoded without, as a controller frame.
+  /// \note  State isn't dropped by send limits, flow control or the pre-connect buffer, and
+  ///        captures and subscribers which start later are sent it with their setups.
+  template <typename T> void sendState(const T &data)
+    {
+    xAssert(T::DebugMessageType < std::numeric_limits<xuint8>::max());
+
+    QByteArray message;
+    QDataStream s(&message, QIODevice::WriteOnly);
+    s << (xuint8)T::DebugMessageType;
+    detail::DebugMessageCodec<T>::write(s, data);
+
+    DebugManager::sendInterfaceState(this, message);
     }
 
   X_CONST_EXPR template <typename T,
@@ -105,21 +240,49 @@ protected:
     }
 
 private:
+  /// \brief Apply the send limit, counting the message as dropped if it fails.
+  bool admitSend();
+
   template <typename T, typename CLS, void (CLS::*FN)(const T& data)>
       static void recieveImpl(xuint32 type, DebugInterface *ifc, QDataStream &data)
     {
     (void)type;
 
     T t;
-    data >> t;
+    detail::DebugMessageCodec<T>::read(data, t);
 
     CLS* cls = static_cast<CLS*>(ifc);
 
     (cls->*FN)(t);
     }
 
-  const Reciever* _recievers;
-  xsize _recieverCount;
+  // shared by every instance of the type, null until setRecievers.
+  const DispatchTable *_dispatch;
+
+  DebugManager::FlowControlPolicy _flowControlPolicy;
+  xuint32 _sampleInterval;
+  std::atomic<xuint32> _sampleCounter;
+
+  DebugManager::SendLimit _sendLimit;
+  std::atomic<bool> _sendLimited;
+  std::atomic<xuint32> _sendSampleInterval;
+  std::atomic<xuint32> _sendSampleCounter;
+  // the rate limit's token bucket, as the time it would be empty again (GCRA).
+  std::atomic<xint64> _emissionInterval;
+  std::atomic<xint64> _burstTolerance;
+  std::atomic<xint64> _theoreticalArrival;
+  std::atomic<xuint64> _droppedMessages;
+  // sends are counted in each thread's output under [_counterSlot], these offset the
+  // slot's sum so a reused slot starts from zero. Without a slot they are the totals.
+  std::atomic<xuint64> _sentMessages;
+  std::atomic<xuint64> _sentBytes;
+  xuint32 _counterSlot;
+
+  std::atomic<xuint32> _interfaceID;
+  xuint32 _pendingID;
+  DebugInterface *_nextPendingSetup;
+
+  friend class DebugManagerImpl;
   };
 
 template <typename T> class DebugInterfaceRegisterer
@@ -130,6 +293,7 @@ public:
     type.create = createFn;
     type.destroy = destroyFn;
     type.type = typeName;
+    type.typeHash = detail::debugTypeHash(typeName);
 
     DebugManager::registerInterfaceType(&type);
     }
@@ -1,27 +1,58 @@
 #ifndef XDEBUGLOGGER_H
 #define XDEBUGLOGGER_H
 
-#if 0
-
 #include "QtCore/QObject"
 #include "XDebugInterface.h"
-#include "Utilities/XEventLogger.h"
-#include "Containers/XUnorderedMap.h"
-#include "Memory/XTemporaryAllocator.h"
+#include "XDebugTimestamp.h"
 #include "Utilities/XTime.h"
+#include "Containers/XVector.h"
+#include "QVector"
+#include "QVariant"
+#include "QHash"
+#include <atomic>
+#include <thread>
+#include <type_traits>
+
+#ifdef X_ENABLE_APPLICATION_DEBUGGING
+# define X_DEBUG_LOGGER_CONCAT_IMPL(a, b) a##b
+# define X_DEBUG_LOGGER_CONCAT(a, b) X_DEBUG_LOGGER_CONCAT_IMPL(a, b)
+
+# define X_DEBUG_EVENT_LOCATION(name, data) \
+  static Eks::DebugLogger::Location name = { __FILE__, Q_FUNC_INFO, __LINE__, data, { Eks::DebugLogger::InvalidLocation } }
+
+# define X_DEBUG_MOMENT(data) do { \
+  X_DEBUG_EVENT_LOCATION(xDebugLocation, data); \
+  Eks::DebugLogger::moment(xDebugLocation); } while(0)
 
-class QStandardItem;
-class QStandardItemModel;
+# define X_DEBUG_SCOPE(data) \
+  X_DEBUG_EVENT_LOCATION(X_DEBUG_LOGGER_CONCAT(xDebugLocation, __LINE__), data); \
+  Eks::DebugLogger::Scope X_DEBUG_LOGGER_CONCAT(xDebugScope, __LINE__)(X_DEBUG_LOGGER_CONCAT(xDebugLocation, __LINE__))
+
+// [format] is a static QString::arg format, "%1 of %2", formatted by the debugger.
+# define X_DEBUG_LOG(format, ...) do { \
+  X_DEBUG_EVENT_LOCATION(xDebugLocation, format); \
+  Eks::DebugLogger::log(xDebugLocation, ##__VA_ARGS__); } while(0)
+#else
+# define X_DEBUG_MOMENT(data) do { } while(0)
+# define X_DEBUG_SCOPE(data)
+# define X_DEBUG_LOG(format, ...) do { } while(0)
+#endif
 
 namespace Eks
 {
 
 class DebugLoggerData;
+class DebugEventRing;
 
+/// \brief Streams Qt log messages, X_DEBUG_LOG records, and events timed with X_DEBUG_SCOPE
+///        and X_DEBUG_MOMENT.
+/// \note  Each thread records events into its own ring with plain stores. A drain thread
+///        encodes the rings into the stream as events arrive, in frames of MaxEventsPerFrame.
+///        Log records are the format's location and the raw arguments, copied into a second
+///        ring on the thread, the debugger formats them.
 class EKSDEBUG_EXPORT DebugLogger
     : public QObject,
-      public DebugInterface//,
-      //private EventLogger::Watcher
+      public DebugInterface
   {
   Q_OBJECT
 
@@ -30,6 +61,65 @@ class EKSDEBUG_EXPORT DebugLogger
 public:
   ~DebugLogger();
 
+  enum class EventType : xuint8
+    {
+    Begin,
+    End,
+    Moment
+    };
+
+  enum
+    {
+    // events each thread's ring holds, those recorded while it is full are dropped.
+    EventRingCapacity = 4096,
+    MaxEventsPerFrame = 256,
+    // ms the drain thread sleeps once every ring is empty.
+    DrainIdleInterval = 1,
+    // bytes of log records each thread's ring holds.
+    LogRingCapacity = 64 * 1024,
+    // bytes one record holds, longer string arguments are cut short. Qt messages too long
+    // for a record are sent whole, as a LogEntry from the logging thread.
+    MaxLogRecordSize = 1024,
+    MaxLogBytesPerFrame = 16 * 1024,
+    // ms between the timestamp calibrations sent.
+    CalibrationInterval = 1000
+    };
+
+  enum class LogArgumentType : xuint8
+    {
+    Signed,
+    Unsigned,
+    Double,
+    Pointer,
+    // UTF-8, behind an xuint32 byte count.
+    String,
+    // UTF-16 code units, behind an xuint32 count.
+    Utf16String
+    };
+
+  static const xuint32 InvalidLocation = 0xFFFFFFFF;
+
+  /// \brief Where events are recorded, static and declared by X_DEBUG_EVENT_LOCATION.
+  struct Location
+    {
+    const char *file;
+    const char *function;
+    xuint32 line;
+    const char *data;
+    // assigned when the location is first recorded.
+    std::atomic<xuint32> id;
+    };
+
+  struct Event
+    {
+    // a DebugTimestamp stamp, converted with the last Clock sent.
+    xint64 time;
+    xuint32 location;
+    // pairs a Begin with its End, unique on the recording thread.
+    xuint32 id;
+    EventType type;
+    };
+
   struct LogEntry
     {
     enum
@@ -41,6 +131,8 @@ public:
     const void *thread;
     xuint32 level;
     QString entry;
+    // set when decoding, false if the compact encoding's time couldn't be resolved.
+    bool timeKnown;
     };
 
   struct EventList
@@ -50,19 +142,94 @@ public:
       DebugMessageType = 2
       };
 
-    EventList()
-        : alloc(Eks::Core::temporaryAllocator()),
-          inPlaceEvents(&alloc)
+    xuint64 thread;
+
+    // client: the events are encoded straight from the ring, the second span once it wraps.
+    const Event *spans[2];
+    xsize spanSizes[2];
+
+    // server: the decoded events.
+    QVector<Event> events;
+    };
+
+  struct LogRecordList
+    {
+    enum
+      {
+      DebugMessageType = 4
+      };
+
+    xuint64 thread;
+
+    // client: whole records, straight from the ring, the second span once it wraps.
+    const char *spans[2];
+    xsize spanSizes[2];
+
+    struct Record
+      {
+      xint64 time;
+      xuint32 location;
+      xuint32 level;
+      QVector<QVariant> arguments;
+      };
+
+    // server: the decoded records.
+    QVector<Record> records;
+    };
+
+  /// \brief A log record being built on the stack, little endian, [size, location, stamp, level]
+  ///        then each argument's type and value.
+  class LogRecord
+    {
+  public:
+    enum
+      {
+      HeaderSize = sizeof(xuint32) * 2 + sizeof(xint64) + sizeof(xuint8),
+      // UTF-16 code units a record's only argument holds before it is cut.
+      MaxUtf16Argument = (MaxLogRecordSize - HeaderSize - 1 - sizeof(xuint32)) / sizeof(xuint16)
+      };
+
+    LogRecord() : _size(HeaderSize) { }
+
+    template <typename T> typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type add(T v)
+      {
+      addValue(LogArgumentType::Signed, (xuint64)(xint64)v);
+      }
+    template <typename T> typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value>::type add(T v)
       {
+      addValue(LogArgumentType::Unsigned, (xuint64)v);
       }
+    template <typename T> typename std::enable_if<std::is_floating_point<T>::value>::type add(T v)
+      {
+      addDouble((double)v);
+      }
+    void add(const void *v) { addValue(LogArgumentType::Pointer, (xuint64)v); }
+    void add(const char *v);
+    void add(const QString &v);
 
-    const void *thread;
-    //const ThreadEventLogger::EventVector *events;
+    const char *data() const { return _data; }
+    xsize size() const { return _size; }
+    char *header() { return _data; }
 
-    Eks::TemporaryAllocator alloc;
-    //ThreadEventLogger::EventVector inPlaceEvents;
+  private:
+    void addValue(LogArgumentType type, xuint64 v);
+    void addDouble(double v);
+    bool reserve(xsize size);
+
+    char _data[MaxLogRecordSize];
+    xsize _size;
     };
 
+  /// \brief How to convert the stamps which follow to Eks::Time.
+  struct Clock
+    {
+    enum
+      {
+      DebugMessageType = 5
+      };
+
+    DebugTimestamp::Calibration calibration;
+    };
 
   class DebugLocation
     {
@@ -79,6 +246,10 @@ public:
     XProperty(QString, data, setData);
     };
 
+  /// \brief Locations not yet sent, and the strings they use not yet sent.
+  /// \note  Strings and locations are numbered in the order they are sent, each file or
+  ///        function string is sent once however many locations use it. Lists are sent as
+  ///        state, so a reader always has every earlier list.
   struct LocationList
     {
     enum
@@ -86,33 +257,144 @@ public:
       DebugMessageType = 3
       };
 
-    const EventLogger::EventLocationVector *embeddedLocations;
-    Eks::Vector<DebugLocationWithData, 1024> allocatedLocations;
+    struct Record
+      {
+      xuint32 file;
+      xuint32 function;
+      xuint32 line;
+      xuint32 data;
+      };
+
+    // UTF-8, the first numbered [firstString].
+    xuint32 firstString;
+    QVector<QByteArray> strings;
+
+    xuint32 firstLocation;
+    QVector<Record> locations;
     };
 
+  class Scope
+    {
+  public:
+    Scope(Location &l) : _id(begin(l)) { }
+    ~Scope() { end(_id); }
+
+  private:
+    xuint32 _id;
+    };
+
+  /// \brief Record a moment at [l], from any thread.
+  static void moment(Location &l);
+  /// \brief Begin a duration at [l], returning the id to end it with on the same thread.
+  static xuint32 begin(Location &l);
+  static void end(xuint32 duration);
+
+  /// \brief Record [args] against the format at [l], from any thread.
+  template <typename... Args> static void log(Location &l, const Args &... args)
+    {
+    if(!isRecording())
+      {
+      return;
+      }
+
+    LogRecord r;
+    int unused[] = { 0, (r.add(args), 0)... };
+    (void)unused;
+    recordLog(l, 0, r);
+    }
+
+  static bool isRecording();
+  /// \brief Record [r] against the format at [l], [level] is the QtMsgType it is shown as.
+  static void recordLog(Location &l, xuint32 level, LogRecord &r);
+
+  /// \brief Log records dropped because their thread's ring was full.
+  xuint64 droppedLogRecords() const;
+
+  /// \brief Events dropped because their thread's ring was full.
+  xuint64 droppedEvents() const;
+
   void emitLogMessage(const LogEntry &e);
 
   struct ServerData
     {
     Eks::UniquePointer<DebugLoggerData> model;
     Eks::Vector<DebugLocationWithData, 1024> _locations;
+    // the locations' strings share these.
+    QVector<QString> _strings;
+    DebugTimestamp::Calibration clock;
+    // log messages whose compact encoded time couldn't be resolved, so weren't shown.
+    xuint64 untimedLogMessages;
     };
-  const DebugLocationWithData *findLocation(const Eks::EventLocation::ID id);
+  const DebugLocationWithData *findLocation(xuint32 id);
+  /// \brief Server: log messages not shown, because their time was lost with an earlier frame.
+  xuint64 untimedLogMessages() const { return _server ? _server->untimedLogMessages : 0; }
 
 protected:
   void onLogMessage(const LogEntry &e);
   void onEventList(const EventList &e);
   void onCodeLocations(const LocationList &e);
+  void onLogRecords(const LogRecordList &l);
+  void onClock(const Clock &c);
+
+private:
+  static void record(EventType type, xuint32 location, xuint32 id);
+  static xuint32 locationID(Location &l);
 
-  void timerEvent(QTimerEvent* event) X_OVERRIDE;
-  void onEvents(
-      const QThread *thread,
-      const ThreadEventLogger::EventVector &) X_OVERRIDE;
-  void onLocations(const EventLogger::EventLocationVector &) X_OVERRIDE;
+  DebugEventRing *ring();
+  void drainLoop();
+  bool drain();
+  bool drainEvents(DebugEventRing *ring);
+  bool drainLogs(DebugEventRing *ring);
+  void sendLocations();
+  void sendCalibration();
+
+  // identifies the logger to each thread's cached ring.
+  const xuint32 _generation;
+  std::atomic<DebugEventRing *> _rings;
+
+  std::atomic<bool> _draining;
+  std::thread _drainThread;
+  xsize _sentLocations;
+  // the drain thread's interned location strings, by their ids.
+  QHash<QByteArray, xuint32> _sentStrings;
+  // Eks::Time nanoseconds the last calibration was sent at, 0 before the first.
+  xint64 _calibrationSent;
 
   Eks::UniquePointer<ServerData> _server;
   };
 
+template <> struct DebugCompactEncoding<DebugLogger::LogEntry>
+  {
+  enum
+    {
+    Enabled = 1
+    };
+  };
+
+template <> struct DebugCompactEncoding<DebugLogger::EventList>
+  {
+  enum
+    {
+    Enabled = 1
+    };
+  };
+
+template <> struct DebugCompactEncoding<DebugLogger::LocationList>
+  {
+  enum
+    {
+    Enabled = 1
+    };
+  };
+
+template <> struct DebugCompactEncoding<DebugLogger::LogRecordList>
+  {
+  enum
+    {
+    Enabled = 1
+    };
+  };
+
 class EKSDEBUG_EXPORT DebugLoggerData : public QObject
   {
   Q_OBJECT
@@ -120,7 +402,7 @@ class EKSDEBUG_EXPORT DebugLoggerData : public QObject
 Q_SIGNALS:
   void eventCreated(
       const Eks::Time &time,
-      ThreadEventLogger::EventType type,
+      DebugLogger::EventType type,
       xuint64 thread,
       const QString &display,
       const xsize durationId,
@@ -133,5 +415,3 @@ Q_SIGNALS:
 Q_DECLARE_METATYPE(const Eks::DebugLogger::DebugLocationWithData*)
 
 #endif // XDEBUGLOGGER_H
-
-#endif
@@ -0,0 +1,35 @@
+#ifndef XDEBUGLZ_H
+#define XDEBUGLZ_H
+
+#include "XDebugGlobal.h"
+
+namespace Eks
+{
+
+/// \brief Small LZ77 block codec producing the LZ4 block format, used to compress the debug stream.
+/// \note  Greedy single probe matching, favouring speed over ratio. Blocks must be at most 64KB.
+namespace DebugLz
+{
+
+enum
+  {
+  MaxBlockSize = 64 * 1024
+  };
+
+/// \brief Largest compressed size for [size] input bytes.
+inline xsize compressBound(xsize size)
+  {
+  return size + size / 255 + 16;
+  }
+
+/// \brief Compress [size] bytes to [dst], which holds at least compressBound(size) bytes.
+xsize compress(const char *src, xsize size, char *dst);
+
+/// \brief Decompress exactly [dstSize] bytes, false if [src] is malformed.
+bool decompress(const char *src, xsize srcSize, char *dst, xsize dstSize);
+
+}
+
+}
+
+#endif // XDEBUGLZ_H
@@ -25,23 +25,204 @@ public:
   public:
     virtual void onInterfaceRegistered(Eks::DebugInterface *) = 0;
     virtual void onInterfaceUnregistered(Eks::DebugInterface *) = 0;
+    /// \brief A replay started with replayCapture reached the end of its capture, or was
+    ///        replaced by a client or another replay.
+    virtual void onReplayFinished() { }
     };
 
-  DebugManager(bool client, Watcher *watch = 0);
+  enum class PreConnectPolicy
+    {
+    DropOldest,
+    DropNewest,
+    SpillToFile
+    };
+
+  struct PreConnectStatistics
+    {
+    xsize bufferedBytes;
+    xuint64 droppedFrames;
+    xuint64 droppedBytes;
+    xuint64 spilledFrames;
+    xuint64 spilledBytes;
+    // controller frames refused once those held reached DebugPreConnectBuffer::MaxControlBytes.
+    xuint64 droppedControlFrames;
+    xuint64 droppedControlBytes;
+    };
+
+  struct CaptureStatistics
+    {
+    xuint64 recordedBytes;
+    xuint64 droppedBatches;
+    xuint64 droppedBytes;
+    };
+
+  enum class Transport
+    {
+    Tcp,
+    LocalSocket,
+    SharedMemory,
+    // discards the stream, a client is connected at once. For benchmarks and tests.
+    Null
+    };
+
+  /// \brief Optional stream features, a client announces the ones it uses in Init.
+  /// \note  Compression and FlowControl are only requested, the client uses them once the
+  ///        server accepts them. CompactEncoding is one sided, the client encodes with it from
+  ///        its first frame, so only request it of servers which read Init's capabilities.
+  enum Capability
+    {
+    CompactEncoding = 1 << 0,
+    Compression = 1 << 1,
+    FlowControl = 1 << 2,
+    // the client reports each interface's SendStatistics periodically.
+    SendStatistics = 1 << 3,
+    // the client reports its own overhead through a DebugManagerMonitor.
+    Monitor = 1 << 4
+    };
+
+  /// \brief What an interface's sends do once the client is out of credit, and the sending
+  ///        thread has staged more than the flow control bound.
+  enum class FlowControlPolicy
+    {
+    // wait for the debugger to grant credit.
+    Block,
+    // discard new frames.
+    Drop,
+    // keep one frame in each sample interval, discarding the rest.
+    Sample
+    };
+
+  /// \brief Limits an interface applies in sendData, before a message is serialised.
+  /// \note  Sampling applies first, the rate limit to the messages sampling keeps.
+  struct SendLimit
+    {
+    // messages per second, 0 is unlimited.
+    xuint32 rate;
+    // messages which may be sent at once, before the rate applies.
+    xuint32 burst;
+    // keep one message in every [sampleInterval], 0 or 1 keeps them all.
+    xuint32 sampleInterval;
+    };
+
+  struct SendStatistics
+    {
+    xuint64 sent;
+    xuint64 dropped;
+    };
+
+  struct SubscriberStatistics
+    {
+    xsize subscribers;
+    xuint64 droppedSubscribers;
+    // stream bytes held for subscribers still to write them.
+    xuint64 bufferedBytes;
+    xuint64 largestBacklog;
+    };
+
+  struct QueueStatistics
+    {
+    // client: bytes it may still send, server: bytes granted and not yet processed.
+    xint64 credit;
+    // client: bytes staged in thread rings, server: bytes recieved but not yet dispatched.
+    xuint64 queuedBytes;
+    // bytes the transport holds, waiting to be written (client) or read (server).
+    xuint64 transportBytes;
+    xuint64 droppedFrames;
+    xuint64 sampledOutFrames;
+    // writes issued to the transport, each a drained span or compressed block.
+    xuint64 transportWrites;
+    // client: staging rings held, one per sending thread until it exits and is drained.
+    xsize threadOutputs;
+    };
+
+  /// \brief Create the manager, a client connects to a debugger over [transport], a server
+  ///        (the debugger) listens on it. Both ends must choose the same transport.
+  /// \note  A client's transport, and everything written to it, runs on a dedicated I/O thread,
+  ///        sending threads only stage frames. Interfaces recieve the debugger's messages on that
+  ///        thread. A server stays on the thread creating it, where its interfaces recieve.
+  ///        Without [ioThread] a client also stays on the creating thread, which must then run
+  ///        an event loop, for comparison with the I/O thread.
+  DebugManager(
+      bool client,
+      Watcher *watch = 0,
+      Transport transport = Transport::Tcp,
+      xuint32 capabilities = 0,
+      bool ioThread = true);
   ~DebugManager();
 
 
   typedef DebugInterface *(*CreateInterfaceFunction)(DebugManager *m, bool client);
   typedef void (*DestroyInterfaceFunction)(DebugInterface *ifc);
+  /// \brief Find a registered type by its hash, see detail::debugTypeHash.
+  static const DebugInterfaceType *findInterfaceType(xuint32 typeHash);
   static const DebugInterfaceType *findInterfaceType(const QString &);
   static void registerInterfaceType(DebugInterfaceType *);
   static void registerInterface(DebugInterface *ifc);
   static void unregisterInterface(DebugInterface *ifc);
   static void addInterfaceLookup(DebugInterface *ifc);
+  /// \brief The interface announced with [id], on the manager thread only.
+  static DebugInterface *findInterface(xuint32 id);
+
+  /// \brief Capabilities in use for this session.
+  static xuint32 capabilities();
+  static void setRemoteCapabilities(xuint32 caps);
+
+  /// \brief Client: start using the requested capabilities the server accepted.
+  ///        Server: start serving the capabilities it accepted.
+  static void setAcceptedCapabilities(xuint32 caps);
+  /// \brief Server: decompress everything after the marker being read.
+  static void beginDecompression();
+  /// \brief Client: the server processed data, allowing [bytes] more to be sent.
+  static void grantCredit(xuint64 bytes);
+
+  /// \brief Staged bytes per sending thread above which congested interfaces apply their
+  ///        FlowControlPolicy, the default is half a thread's staging ring.
+  static void setFlowControlBound(xsize bytes);
+  static QueueStatistics queueStatistics();
+
+  /// \brief Server: ask the client to apply [limit] to its end of [ifc].
+  static void requestSendLimit(DebugInterface *ifc, const SendLimit &limit);
 
   static QDataStream &lockOutputStream(DebugInterface *ifc);
   static void unlockOutputStream();
 
+  /// \brief Client: send [message], a message for [ifc], as state through the controller.
+  static void sendInterfaceState(DebugInterface *ifc, const QByteArray &message);
+  /// \brief The messages [ifc] has sent, summed over every sending thread.
+  static xuint64 sentMessages(const DebugInterface *ifc);
+
+  /// \brief Write staged messages to the transport now, rather than when the batch fills or
+  ///        its latency timer fires. Off the manager thread (on a client, any thread
+  ///        but its I/O thread) this requests a drain.
+  static void flush();
+
+  /// \brief Bound the data held until a debugger connects, the default is 4MB, dropping oldest.
+  /// \note  SpillToFile moves frames over budget to [spillPath], and replays them on connect.
+  static void setPreConnectBudget(
+      xsize bytes,
+      PreConnectPolicy policy,
+      const QString &spillPath = QString());
+  static PreConnectStatistics preConnectStatistics();
+
+  /// \brief Record the framed stream to [path], a memory mapped capture EksDebugger can replay.
+  /// \note  The capture begins with the setup of every interface announced so far.
+  static bool startCapture(const QString &path);
+  static void stopCapture();
+  /// \brief Statistics for the current capture, or the last one stopped.
+  static CaptureStatistics captureStatistics();
+
+  /// \brief Client: also stream to [device], an open connection to another debugger, recorder or tap.
+  /// \note  The manager owns [device]. It is sent the setup of every interface, then the stream
+  ///        from now on, uncompressed and without flow control. A subscriber which falls further
+  ///        behind than the backlog limit is closed, without affecting the others.
+  static void addSubscriber(QIODevice *device);
+  static void setSubscriberBacklogLimit(xsize bytes);
+  static SubscriberStatistics subscriberStatistics();
+
+  /// \brief Server: feed a capture through the interfaces, as if a client were sending it.
+  /// \note  The capture is fed in chunks from the event loop, the watcher is told once it ends.
+  static bool replayCapture(const QString &path);
+
 private:
   typedef DebugManagerImpl Impl;
   };
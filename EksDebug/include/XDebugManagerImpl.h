@@ -3,57 +3,297 @@
 
 #include "XDebugManager.h"
 #include "XDebugController.h"
+#include "XDebugStagingRing.h"
+#include "XDebugPreConnectBuffer.h"
+#include "XDebugFrameParser.h"
+#include "XDebugFanOut.h"
 #include "QObject"
-#include "QBuffer"
+#include "QIODevice"
+#include "QTimer"
+#include "QVector"
 #include "Containers/XUnorderedMap.h"
+#include "Containers/XVector.h"
+#include <atomic>
+#include <functional>
 
-class QTcpSocket;
-class QTcpServer;
+class QThread;
+class QFile;
 
 namespace Eks
 {
 
+class DebugManagerImpl;
+class DebugTransport;
+class DebugStreamCompressor;
+class DebugStreamDecompressor;
+class DebugCaptureWriter;
+class DebugManagerMonitor;
+
+/// \brief Output state owned by one sending thread.
+/// \note  Messages are serialised straight into [ring] behind a reserved header, which
+///        is backpatched with the length, so producers never share a stream or take a lock.
+class DebugThreadOutput
+  {
+public:
+  enum
+    {
+    // interfaces counted per thread, any more share one atomic counter each.
+    CounterSlots = 64
+    };
+
+  DebugThreadOutput(DebugManagerImpl *manager, xsize ringCapacity);
+
+  class RingDevice : public QIODevice
+    {
+  public:
+    RingDevice(DebugThreadOutput *out);
+
+    bool isSequential() const X_OVERRIDE { return true; }
+
+  protected:
+    qint64 readData(char *, qint64) X_OVERRIDE;
+    qint64 writeData(const char *data, qint64 len) X_OVERRIDE;
+
+  private:
+    DebugThreadOutput *_output;
+    };
+
+  DebugStagingRing ring;
+  RingDevice device;
+  QDataStream stream;
+
+  DebugManagerImpl *manager;
+  DebugInterface *locked;
+  xsize frameStart;
+  bool overflowed;
+  // the locked frame is discarded by flow control, nothing is staged.
+  bool discarding;
+
+  // totals for DebugManagerMonitor, only this thread writes them.
+  std::atomic<xuint64> frames;
+  std::atomic<xuint64> bytes;
+  std::atomic<xuint64> serialiseNanoseconds;
+  std::atomic<xuint64> serialiseSamples;
+  // when the locked frame began, if it is being timed.
+  xint64 serialiseStart;
+  // the thread exited, the manager frees the output once it is drained.
+  std::atomic<bool> retired;
+  // per interface totals, indexed by the interface's counter slot, only this thread writes them.
+  std::atomic<xuint64> sentMessages[CounterSlots];
+  std::atomic<xuint64> sentBytes[CounterSlots];
+
+  DebugThreadOutput *next;
+  };
+
 class DebugManagerImpl : private QObject
   {
   Q_OBJECT
 
 public:
-  DebugManagerImpl(DebugManager *m, bool client);
+  enum
+    {
+    StagingRingCapacity = 256 * 1024,
+    // staged bytes on one thread which force a drain rather than waiting for the batch.
+    BatchFlushSize = 64 * 1024,
+    // longest a staged frame waits before it is written to the transport, in ms.
+    BatchMaxLatency = 5,
+    HeaderSize = 2 * sizeof(xuint32),
+    // most read from the transport into the parser at once.
+    ReadChunkSize = 64 * 1024,
+    // capture bytes replayed per event loop pass.
+    ReplayChunkSize = 4 * 1024 * 1024,
+    // credit a server grants on accepting flow control, then in steps as it processes frames.
+    InitialCredit = 1024 * 1024,
+    CreditGrantSize = 256 * 1024,
+    // how often a client reports send statistics, in ms.
+    SendStatisticsInterval = 1000,
+    // while monitoring, one frame in this many per thread has its serialisation timed.
+    SerialiseSampleInterval = 64
+    };
+
+  struct ThreadTime
+    {
+    ThreadTime() : last(0), nextSequence(0), valid(false) { }
+
+    xint64 last;
+    xuint8 nextSequence;
+    bool valid;
+    };
+
+  DebugManagerImpl(
+      DebugManager *m,
+      bool client,
+      DebugManager::Transport transport,
+      xuint32 capabilities,
+      bool ioThread);
   ~DebugManagerImpl();
 
   DebugController *_controller;
   DebugManager::Watcher *_watcher;
 
-  Eks::UnorderedMap<xuint32, DebugInterface *> _interfaceMap;
+  // indexed by interface id, ids are dense so this stays small. Null once unregistered.
+  Eks::Vector<DebugInterface *> _interfaceTable;
   QList<DebugInterface *> _interfaces;
 
-  QByteArray _preConnectClientData;
+  DebugPreConnectBuffer _preConnect;
   QDataStream _clientStream;
+  DebugFrameParser _parser;
+
+  // every live thread which has sent data, pushed lock free on first use. Only the
+  // manager thread walks it, as it unlinks the outputs of exited threads.
+  std::atomic<DebugThreadOutput *> _outputs;
+  // counter slots no registered interface holds.
+  QVector<xuint32> _freeCounterSlots;
+  DebugThreadOutput *_localOutput;
+  xuint32 _generation;
 
-  QBuffer _scratchImpl;
-  QDataStream _scratchBuffer;
+  // interfaces with an id but no SetupInterface sent yet, pushed lock free.
+  std::atomic<DebugInterface *> _pendingSetups;
 
-  DebugInterface *_outputLocked;
+  std::atomic<bool> _drainScheduled;
+  std::atomic<bool> _batchScheduled;
+  QTimer _batchTimer;
+  bool _draining;
 
-  QTcpServer *_server;
-  QTcpSocket *_client;
+  DebugTransport *_transport;
+  QIODevice *_client;
+  bool _isClient;
 
-  xuint32 _readingID;
-  xuint32 _bytesNeeded;
+  // client: capabilities it encodes with, server: those the client announced.
+  xuint32 _capabilities;
+
+  // client: drained bytes wait in [_compressInput] until the drain ends, then
+  // go to [_compressor] on [_compressThread].
+  QThread *_compressThread;
+  DebugStreamCompressor *_compressor;
+  QByteArray _compressInput;
+  // server: decodes the client's stream once it sends CompressionStart.
+  DebugStreamDecompressor *_decompressor;
+
+  // client: the server grants credit, and a drain writes no more than it allows.
+  // server: grants credit as it processes frames, [_credit] is what is outstanding.
+  bool _flowControlled;
+  bool _grantingCredit;
+  xint64 _credit;
+  xuint64 _processedBytes;
+  // client is out of credit, producers apply their interface's policy past the bound.
+  std::atomic<bool> _congested;
+  std::atomic<xsize> _flowControlBound;
+  std::atomic<xuint64> _droppedFrames;
+  std::atomic<xuint64> _sampledOutFrames;
+
+  // client: reports send statistics once the server accepts them.
+  QTimer _statisticsTimer;
+
+  // client: reports the manager's own overhead once the server accepts Monitor.
+  DebugManagerMonitor *_monitor;
+  QTimer _monitorTimer;
+  std::atomic<bool> _monitoring;
+  // when the oldest undrained request to drain was made, 0 if none.
+  std::atomic<xint64> _drainRequested;
+  QVector<xuint32> _flushLatency;
+  xuint64 _dataReadyIterations;
+  xuint64 _transportWrites;
+
+  // client: extra connections sharing the stream.
+  DebugFanOut _fanOut;
+
+  // records everything written to the transport while capturing.
+  DebugCaptureWriter *_capture;
+  DebugManager::CaptureStatistics _lastCaptureStatistics;
+
+  // server: a capture being fed through the parser, a chunk at a time.
+  QFile *_replayFile;
+  const uchar *_replayData;
+  xsize _replaySize;
+  xsize _replayPosition;
+  // compact encoding time decoder state, per sending thread.
+  Eks::UnorderedMap<xuint64, ThreadTime> _threadTimes;
 
   DebugManager *_manager;
 
+  // client: the manager, its transport and every drain live here, off the application's threads.
+  QThread *_ioThread;
+  // the thread the manager is handed back to for destruction.
+  QThread *_ownerThread;
+
+  QThread *managerThread() const { return thread(); }
+  /// \brief Run [fn] on the manager thread, waiting for it to finish.
+  void runOnManagerThread(const std::function<void()> &fn);
+
   void setupController();
   void clear();
 
+  DebugThreadOutput *threadOutput();
+  void setupInterface(DebugInterface *ifc);
+  void beginFrame(DebugThreadOutput *out);
+  bool reserve(DebugThreadOutput *out, xsize size);
+  void endFrame(DebugThreadOutput *out);
+  void countSent(DebugThreadOutput *out, DebugInterface *ifc, xuint64 bytes);
+
+  void assignCounterSlot(DebugInterface *ifc);
+  void releaseCounterSlot(DebugInterface *ifc);
+  /// \brief Sum [slot] over every thread's output, on the manager thread.
+  void sumCounterSlot(xuint32 slot, xuint64 &messages, xuint64 &bytes) const;
+  /// \brief The messages and bytes [ifc] has sent, on the manager thread.
+  void sentTotals(const DebugInterface *ifc, xuint64 &messages, xuint64 &bytes) const;
+
+  void announcePendingInterfaces(DebugInterface *skip = 0);
   void flush();
+
+  void acceptCapabilities(xuint32 caps);
+  void beginCompression();
+  void beginDecompression();
+  void grantCredit(xuint64 bytes);
+  DebugManager::QueueStatistics queueStatistics() const;
+
+  void addSubscriber(QIODevice *device);
+
+  bool startCapture(const QString &path);
+  void stopCapture();
+  DebugManager::CaptureStatistics captureStatistics() const;
+  bool replayCapture(const QString &path);
+
   void setupClient();
   void addInterfaceLookup(DebugInterface *ifc);
+  void removeInterfaceLookup(DebugInterface *ifc);
+  DebugInterface *findInterface(xuint32 id) const;
+
+private:
+  void start(DebugManager::Transport transport, bool client);
+  void shutdown();
+  bool event(QEvent *e) X_OVERRIDE;
+
+  void scheduleDrain();
+  void scheduleBatch(DebugThreadOutput *out);
+  void drainOutput(DebugThreadOutput *out);
+  /// \brief Unlink and free drained outputs of exited threads, keeping their totals.
+  void releaseRetiredOutputs();
+  void writeStaged(DebugThreadOutput *out);
+  void writeRing(DebugThreadOutput *out, xsize end);
+  xsize creditedEnd(DebugThreadOutput *out, xsize end) const;
+  bool discardFrame(DebugThreadOutput *out);
+  void submitCompression();
+  void finishDrain();
+  void noteDrainRequest();
+  void endCompression();
+  bool readInput();
+  /// \brief Stop replaying, telling the watcher unless [notify] is false.
+  void endReplay(bool notify = true);
+  void dispatchFrame(const DebugFrameParser::Frame &frame);
+
+public Q_SLOTS:
+  void drain();
 
 private Q_SLOTS:
+  void startBatchTimer();
   void onNewConnection();
   void onDataReady();
   void onConnected();
+  void onCompressed(const QByteArray &data);
+  void continueReplay();
+  void reportSendStatistics();
+  void reportMonitor();
   };
 
 }
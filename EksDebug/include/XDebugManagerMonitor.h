@@ -0,0 +1,100 @@
+#ifndef XDEBUGMANAGERMONITOR_H
+#define XDEBUGMANAGERMONITOR_H
+
+#include "XDebugInterface.h"
+#include "QAbstractTableModel"
+#include "QVector"
+#include "QPair"
+
+namespace Eks
+{
+
+class DebugMonitorModel;
+
+/// \brief Reports what the debug stream costs the client, to the debugger.
+/// \note  A client creates one once the server accepts the Monitor capability, and reports
+///        every ReportInterval. The counters behind each report are kept per sending thread.
+class EKSDEBUG_EXPORT DebugManagerMonitor : public DebugInterface
+  {
+  X_DEBUG_INTERFACE(DebugManagerMonitor)
+
+public:
+  enum
+    {
+    // ms between reports.
+    ReportInterval = 100,
+    // bucket n counts drains with a latency under 2^n us, the last holds the rest.
+    FlushLatencyBuckets = 16
+    };
+
+  struct Report
+    {
+    enum
+      {
+      DebugMessageType = 1
+      };
+
+    struct InterfaceEntry
+      {
+      xuint32 id;
+      xuint64 messages;
+      xuint64 bytes;
+      };
+
+    // totals since the client started.
+    QVector<InterfaceEntry> interfaces;
+    xuint64 frames;
+    xuint64 bytes;
+    xuint64 serialiseNanoseconds;
+    xuint64 serialiseSamples;
+    xuint64 dataReadyIterations;
+
+    // current values.
+    xuint64 preConnectBytes;
+    xuint64 writeQueueBytes;
+
+    // drains since the last report, by latency from the first request.
+    QVector<xuint32> flushLatency;
+    };
+
+  ~DebugManagerMonitor();
+
+  static xsize flushLatencyBucket(xint64 nanoseconds);
+
+  void sendReport(const Report &r);
+
+private:
+  void onReport(const Report &r);
+
+  Eks::UniquePointer<DebugMonitorModel> _model;
+  };
+
+/// \brief Server: the latest report, as name and value rows.
+class EKSDEBUG_EXPORT DebugMonitorModel : public QAbstractTableModel
+  {
+  Q_OBJECT
+
+public:
+  DebugMonitorModel();
+
+  void setReport(const DebugManagerMonitor::Report &r);
+
+  int rowCount(const QModelIndex &parent) const X_OVERRIDE;
+  int columnCount(const QModelIndex &parent) const X_OVERRIDE;
+  QVariant data(const QModelIndex &index, int role) const X_OVERRIDE;
+  QVariant headerData(int section, Qt::Orientation orientation, int role) const X_OVERRIDE;
+
+private:
+  typedef QVector<QPair<QString, QString> > Rows;
+
+  Rows _rows;
+
+  // flush latency accumulated over every report.
+  QVector<xuint64> _flushLatency;
+  xuint64 _lastSerialiseNanoseconds;
+  xuint64 _lastSerialiseSamples;
+  };
+
+}
+
+#endif // XDEBUGMANAGERMONITOR_H
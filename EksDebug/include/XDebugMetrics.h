@@ -0,0 +1,208 @@
+#ifndef XDEBUGMETRICS_H
+#define XDEBUGMETRICS_H
+
+#include "QtCore/QObject"
+#include "XDebugInterface.h"
+#include "Utilities/XTime.h"
+#include "QVector"
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Eks
+{
+
+class DebugMetricsData;
+
+/// \brief Numeric gauges, counters and histograms, recorded from any thread.
+/// \note  Each recording thread writes its own shard without locking. The client sums the shards
+///        every SummaryInterval, on the thread which created the interface, and only sends the
+///        summaries to the debugger.
+class EKSDEBUG_EXPORT DebugMetricsInterface
+    : public QObject,
+      public DebugInterface
+  {
+  Q_OBJECT
+
+  X_DEBUG_INTERFACE(DebugMetricsInterface)
+
+public:
+  enum class MetricType : xuint8
+    {
+    Gauge,
+    Counter,
+    Histogram
+    };
+
+  typedef xuint32 Metric;
+  static const Metric InvalidMetric = 0xFFFFFFFF;
+
+  enum
+    {
+    // ms between summaries.
+    SummaryInterval = 250,
+    MaxMetrics = 256,
+    // histogram values keep this many significant bits, so a bucket is at most 1/16 of its values.
+    HistogramSubBucketBits = 4,
+    HistogramSubBuckets = 1 << HistogramSubBucketBits,
+    HistogramBuckets = (63 - HistogramSubBucketBits + 1) * HistogramSubBuckets,
+    // definitions are sent again with every nth summary, for debuggers which missed them.
+    DefinitionInterval = 20
+    };
+
+  struct Definition
+    {
+    enum
+      {
+      DebugMessageType = 1
+      };
+
+    Metric metric;
+    MetricType type;
+    QString name;
+    };
+
+  struct Summary
+    {
+    enum
+      {
+      DebugMessageType = 2
+      };
+
+    struct Entry
+      {
+      Metric metric;
+      MetricType type;
+      // a gauge's value, a counter's total or the mean of a histogram's new values.
+      xint64 value;
+      // values added to a counter, or recorded in a histogram, since the last summary.
+      xint64 count;
+      // histogram only, each is the lowest value of its bucket.
+      xint64 min;
+      xint64 p50;
+      xint64 p90;
+      xint64 p99;
+      xint64 max;
+      };
+
+    Eks::Time time;
+    QVector<Entry> entries;
+    };
+
+  ~DebugMetricsInterface();
+
+  /// \brief Add a metric, returns InvalidMetric once there are MaxMetrics.
+  Metric addMetric(const QString &name, MetricType type);
+
+  /// \brief Set a gauge, summaries send the last value set.
+  void setGauge(Metric metric, xint64 value);
+  /// \brief Add [delta] to a counter.
+  void addCount(Metric metric, xint64 delta = 1);
+  /// \brief Record a value, a latency in ns for example, negative values are recorded as 0.
+  void recordValue(Metric metric, xint64 value);
+
+  /// \brief Sum every thread's shard, into a summary of the changes since the last one.
+  Summary summarise();
+  /// \brief Send a summary now, the client's timer calls this every SummaryInterval.
+  void sendSummary();
+
+  static xsize histogramBucket(xint64 value);
+  /// \brief The lowest value recorded in [bucket].
+  static xint64 histogramBucketValue(xsize bucket);
+
+protected:
+  void timerEvent(QTimerEvent *) X_OVERRIDE;
+
+private:
+  struct Histogram
+    {
+    Histogram();
+
+    std::atomic<xuint64> buckets[HistogramBuckets];
+    std::atomic<xint64> sum;
+    };
+
+  struct Shard
+    {
+    Shard();
+
+    std::thread::id thread;
+    std::atomic<xint64> counters[MaxMetrics];
+    // allocated by the recording thread when it first records to the metric.
+    std::atomic<Histogram *> histograms[MaxMetrics];
+    Shard *next;
+    };
+
+  // the histogram totals as of the last summary.
+  struct HistogramTotals
+    {
+    std::vector<xuint64> buckets;
+    xint64 sum;
+    };
+
+  Shard *shard();
+  Histogram *histogram(Shard *s, Metric metric);
+  void sendDefinitions();
+
+  void onDefinition(const Definition &d);
+  void onSummary(const Summary &s);
+
+  // identifies the interface to each thread's cached shard, never reused.
+  const xuint32 _serial;
+  std::atomic<Shard *> _shards;
+
+  std::mutex _definitionLock;
+  std::atomic<xuint32> _metricCount;
+  MetricType _types[MaxMetrics];
+  QString _names[MaxMetrics];
+  std::atomic<xint64> _gauges[MaxMetrics];
+
+  std::atomic<xuint32> _summaries;
+  std::mutex _summaryLock;
+  xint64 _lastCounters[MaxMetrics];
+  std::vector<HistogramTotals> _lastHistograms;
+
+  Eks::UniquePointer<DebugMetricsData> _model;
+  };
+
+/// \brief Server: every summary recieved, as a series per metric.
+class EKSDEBUG_EXPORT DebugMetricsData : public QObject
+  {
+  Q_OBJECT
+
+public:
+  struct Point
+    {
+    Eks::Time time;
+    DebugMetricsInterface::Summary::Entry entry;
+    };
+
+  struct Series
+    {
+    DebugMetricsInterface::Metric metric;
+    DebugMetricsInterface::MetricType type;
+    QString name;
+    QVector<Point> points;
+    };
+
+  xsize seriesCount() const { return _series.size(); }
+  const Series &series(xsize i) const { return _series[(int)i]; }
+
+  void setDefinition(const DebugMetricsInterface::Definition &d);
+  void addSummary(const DebugMetricsInterface::Summary &s);
+
+Q_SIGNALS:
+  void seriesAdded(xsize index);
+  void seriesChanged(xsize index);
+  void summaryAdded(const Eks::Time &time);
+
+private:
+  xsize findSeries(DebugMetricsInterface::Metric metric) const;
+
+  QVector<Series> _series;
+  };
+
+}
+
+#endif // XDEBUGMETRICS_H
@@ -0,0 +1,76 @@
+#ifndef XDEBUGPRECONNECTBUFFER_H
+#define XDEBUGPRECONNECTBUFFER_H
+
+#include "XDebugManager.h"
+#include "QIODevice"
+#include "QFile"
+
+namespace Eks
+{
+
+/// \brief Holds the framed stream written before a debugger connects, within a byte budget.
+/// \note  Controller frames (Init, SetupInterface, InterfaceState) are kept outside the budget,
+///        and replayed first, so whatever data survives can always be decoded. They grow with
+///        the interfaces and the state they send, not with time, so should stay within
+///        MaxControlBytes. Any beyond it are dropped and counted, their interfaces can't be decoded.
+class EKSDEBUG_EXPORT DebugPreConnectBuffer : public QIODevice
+  {
+public:
+  enum
+    {
+    MaxControlBytes = 16 * 1024 * 1024
+    };
+
+  DebugPreConnectBuffer();
+  ~DebugPreConnectBuffer();
+
+  void configure(xsize budget, DebugManager::PreConnectPolicy policy, const QString &spillPath);
+  DebugManager::PreConnectStatistics statistics() const;
+
+  /// \brief Write everything held to [device], then empty the buffer.
+  void replay(QIODevice *device);
+  void clear();
+
+  bool isSequential() const X_OVERRIDE { return true; }
+
+protected:
+  qint64 readData(char *, qint64) X_OVERRIDE;
+  qint64 writeData(const char *data, qint64 len) X_OVERRIDE;
+
+private:
+  enum
+    {
+    HeaderSize = 2 * sizeof(xuint32)
+    };
+
+  void beginFrame();
+  void appendFrameBytes(const char *data, xsize size);
+  bool makeSpace(xsize size);
+  void evictOldest();
+
+  void ringWrite(const char *data, xsize size);
+  void ringRead(xsize position, char *data, xsize size) const;
+
+  DebugManager::PreConnectPolicy _policy;
+  QString _spillPath;
+  QFile _spill;
+
+  QByteArray _controlFrames;
+
+  QByteArray _ring;
+  xsize _head;
+  xsize _tail;
+
+  // frame currently being written
+  char _header[HeaderSize];
+  xsize _headerBytes;
+  xuint32 _frameID;
+  xsize _frameRemaining;
+  bool _frameDropped;
+
+  DebugManager::PreConnectStatistics _statistics;
+  };
+
+}
+
+#endif // XDEBUGPRECONNECTBUFFER_H
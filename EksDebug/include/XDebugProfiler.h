@@ -0,0 +1,212 @@
+#ifndef XDEBUGPROFILER_H
+#define XDEBUGPROFILER_H
+
+#include "QtCore/QObject"
+#include "XDebugInterface.h"
+#include "QAbstractTableModel"
+#include "QElapsedTimer"
+#include "QVector"
+#include "QHash"
+#include "QPair"
+
+class QProcess;
+
+namespace Eks
+{
+
+class DebugProfilerModel;
+
+/// \brief A sampling CPU profiler, streaming the stacks it samples to the debugger.
+/// \note  SIGPROF fires as the process uses CPU, on the thread using it, so each thread is
+///        sampled in proportion to its CPU time. The handler only copies the stack into a ring
+///        allocated up front. The client sends the samples every SendInterval, as module and
+///        offset frames, each distinct stack once. The debugger does the symbolising.
+///        Only one client interface profiles at a time, and only on Linux and OS X.
+class EKSDEBUG_EXPORT DebugProfilerInterface
+    : public QObject,
+      public DebugInterface
+  {
+  Q_OBJECT
+
+  X_DEBUG_INTERFACE(DebugProfilerInterface)
+
+public:
+  enum
+    {
+    // ms between sends.
+    SendInterval = 250,
+    DefaultSampleRate = 100,
+    MaxSampleRate = 10000,
+    // frames kept from each sample.
+    MaxDepth = 32,
+    // samples the ring holds between sends, later ones are dropped.
+    RingCapacity = 4096
+    };
+
+  struct Module
+    {
+    enum
+      {
+      DebugMessageType = 1
+      };
+
+    xuint32 id;
+    QString path;
+    // the link time address of the module's base, frame offsets are from the base. Zero for
+    // position independent modules, a non-PIE executable's is its fixed load address.
+    xuint64 linkBase;
+    };
+
+  struct Frame
+    {
+    xuint32 module;
+    xuint64 offset;
+    };
+
+  struct Stack
+    {
+    enum
+      {
+      DebugMessageType = 2
+      };
+
+    xuint32 id;
+    // the sampled frame first.
+    QVector<Frame> frames;
+    };
+
+  struct Samples
+    {
+    enum
+      {
+      DebugMessageType = 3
+      };
+
+    struct Entry
+      {
+      xuint64 thread;
+      xuint32 stack;
+      xuint32 count;
+      };
+
+    xuint32 interval;
+    xuint32 sampleRate;
+    xuint32 dropped;
+    QVector<Entry> entries;
+    };
+
+  struct SetSampleRate
+    {
+    enum
+      {
+      DebugMessageType = 4
+      };
+
+    xuint32 rate;
+    };
+
+  ~DebugProfilerInterface();
+
+  /// \brief Samples per second of CPU time, 0 stops profiling. False if this client can't profile.
+  bool setSampleRate(xuint32 rate);
+  xuint32 sampleRate() const { return _sampleRate; }
+  /// \brief True while addr2line runs for frames already sampled.
+  bool isSymbolising() const { return !_lookups.isEmpty(); }
+
+  /// \brief Server: ask the client to sample at [rate].
+  void requestSampleRate(xuint32 rate);
+
+  /// \brief Take the samples from the ring, queueing any modules and stacks not yet sent.
+  Samples collect();
+  void sendSamples();
+
+protected:
+  void timerEvent(QTimerEvent *) X_OVERRIDE;
+
+private:
+  bool resolveFrame(void *address, bool returnAddress, Frame &frame);
+
+  void onModule(const Module &m);
+  void onStack(const Stack &s);
+  void onSamples(const Samples &s);
+  void onSetSampleRate(const SetSampleRate &r);
+
+  xuint32 _sampleRate;
+  bool _profiling;
+  QElapsedTimer _sinceSend;
+
+  QHash<QString, xuint32> _moduleIds;
+  QHash<QByteArray, xuint32> _stackIds;
+  QVector<Module> _pendingModules;
+  QVector<Stack> _pendingStacks;
+
+  Eks::UniquePointer<DebugProfilerModel> _model;
+  };
+
+/// \brief Server: functions by the samples they were running in, symbolised with addr2line.
+/// \note  addr2line runs in the background, one run per module at a time. Frames show as
+///        module and offset until their names arrive and the rows are rebuilt.
+class EKSDEBUG_EXPORT DebugProfilerModel : public QAbstractTableModel
+  {
+  Q_OBJECT
+
+public:
+  DebugProfilerModel();
+
+  void addModule(const DebugProfilerInterface::Module &m);
+  void addStack(const DebugProfilerInterface::Stack &s);
+  void addSamples(const DebugProfilerInterface::Samples &s);
+  void clear();
+
+  xuint32 sampleRate() const { return _sampleRate; }
+
+  int rowCount(const QModelIndex &parent) const X_OVERRIDE;
+  int columnCount(const QModelIndex &parent) const X_OVERRIDE;
+  QVariant data(const QModelIndex &index, int role) const X_OVERRIDE;
+  QVariant headerData(int section, Qt::Orientation orientation, int role) const X_OVERRIDE;
+
+Q_SIGNALS:
+  void sampleRateChanged(xuint32 rate);
+
+private Q_SLOTS:
+  void onLookupFinished();
+
+private:
+  typedef QPair<xuint32, xuint64> FrameKey;
+
+  struct Lookup
+    {
+    xuint32 module;
+    QVector<xuint64> offsets;
+    };
+
+  void symbolise(const QVector<xuint32> &stacks);
+  void startLookup(xuint32 module);
+  QString symbol(const DebugProfilerInterface::Frame &f) const;
+  void rebuildRows();
+
+  struct Row
+    {
+    QString function;
+    xuint64 self;
+    xuint64 total;
+    };
+
+  QHash<xuint32, DebugProfilerInterface::Module> _modules;
+  QHash<xuint32, QVector<DebugProfilerInterface::Frame> > _stacks;
+  // empty while a frame's lookup is queued or running.
+  QHash<FrameKey, QString> _symbols;
+  // offsets waiting for their module's running lookup to finish.
+  QHash<xuint32, QVector<xuint64> > _queuedOffsets;
+  QHash<QProcess *, Lookup> _lookups;
+  QHash<xuint32, xuint64> _stackSamples;
+
+  QVector<Row> _rows;
+  QHash<QString, int> _rowIndex;
+  xuint64 _samples;
+  xuint32 _sampleRate;
+  };
+
+}
+
+#endif // XDEBUGPROFILER_H
@@ -0,0 +1,41 @@
+#ifndef XDEBUGRECEIVEBUFFER_H
+#define XDEBUGRECEIVEBUFFER_H
+
+#include "XDebugGlobal.h"
+#include "QByteArray"
+
+namespace Eks
+{
+
+/// \brief Byte buffer filled from a transport and consumed from the front.
+/// \note  Unread bytes stay contiguous, they move to the front only when space is reserved,
+///        and the storage only grows for a single run larger than it. Pointers into the
+///        buffer stay valid until the next reserve.
+class EKSDEBUG_EXPORT DebugReceiveBuffer
+  {
+public:
+  DebugReceiveBuffer(xsize capacity);
+
+  const char *data() const { return _data.constData() + _begin; }
+  xsize size() const { return _end - _begin; }
+  xsize capacity() const { return (xsize)_data.size(); }
+
+  /// \brief Find [size] contiguous bytes of space after the unread data, fill them then commit.
+  char *reserve(xsize size);
+  void commit(xsize size);
+  void append(const char *data, xsize size);
+
+  void consume(xsize size);
+  /// \brief Keep only the first [size] unread bytes.
+  void truncate(xsize size);
+  void clear();
+
+private:
+  QByteArray _data;
+  xsize _begin;
+  xsize _end;
+  };
+
+}
+
+#endif // XDEBUGRECEIVEBUFFER_H
@@ -0,0 +1,149 @@
+#ifndef XDEBUGSHAREDMEMORYTRANSPORT_H
+#define XDEBUGSHAREDMEMORYTRANSPORT_H
+
+#include "XDebugTransport.h"
+#include "QIODevice"
+#include "QElapsedTimer"
+#include "QSharedMemory"
+#include "QTimer"
+#include <atomic>
+
+namespace Eks
+{
+
+/// \brief One direction of a shared memory connection, a byte ring with a writer in one
+///        process and a reader in the other.
+struct DebugSharedMemoryRing
+  {
+  enum
+    {
+    Capacity = 4 * 1024 * 1024
+    };
+
+  void reset();
+
+  xsize write(const char *data, xsize size);
+  xsize read(char *data, xsize size);
+  xsize available() const;
+
+  alignas(64) std::atomic<xuint64> head;
+  alignas(64) std::atomic<xuint64> tail;
+  char data[Capacity];
+  };
+
+/// \brief Output which doesn't fit the ring is held until it does, up to MaxOverflow. Beyond
+///        that writes wait for the other end to read, failing if it doesn't within WriteTimeout.
+/// \note  A client's device counts a heartbeat whenever it polls or waits, which the debugger
+///        watches to find clients which died without detaching.
+class DebugSharedMemoryDevice : public QIODevice
+  {
+public:
+  enum
+    {
+    MaxOverflow = DebugSharedMemoryRing::Capacity,
+    // ms a write waits for the reader to make room.
+    WriteTimeout = 5000
+    };
+
+  DebugSharedMemoryDevice(QObject *parent);
+
+  /// \brief Use [input] and [output]. A client also counts [heartbeat], and abandons the rings
+  ///        once [session] moves on from its value now.
+  void attach(
+      DebugSharedMemoryRing *input,
+      DebugSharedMemoryRing *output,
+      std::atomic<xuint64> *heartbeat = 0,
+      const std::atomic<xuint32> *session = 0);
+  /// \brief Stop using the rings for good, discarding output from now on.
+  void abandon();
+  /// \brief Client: the debugger dropped it, and may have given the rings to another.
+  bool isDropped() const;
+  /// \brief Push deferred output and signal arrived data, driven by the transport timer.
+  void poll();
+
+  bool isSequential() const X_OVERRIDE { return true; }
+  qint64 bytesAvailable() const X_OVERRIDE;
+  qint64 bytesToWrite() const X_OVERRIDE;
+  bool waitForBytesWritten(int msecs) X_OVERRIDE;
+
+protected:
+  qint64 readData(char *data, qint64 maxSize) X_OVERRIDE;
+  qint64 writeData(const char *data, qint64 size) X_OVERRIDE;
+
+private:
+  void pushOverflow();
+
+  DebugSharedMemoryRing *_input;
+  DebugSharedMemoryRing *_output;
+  std::atomic<xuint64> *_heartbeat;
+  const std::atomic<xuint32> *_session;
+  xuint32 _sessionID;
+  bool _abandoned;
+
+  // output which didn't fit in the ring yet, kept in order.
+  QByteArray _overflow;
+  };
+
+/// \brief Moves the stream through a shared memory segment polled by both ends, avoiding
+///        any socket stack, the segment is created by the debugger and attached to by the client.
+/// \note  A client whose heartbeat stops for ClientTimeout, because it crashed or was killed,
+///        is dropped so another can attach. A client dropped while only stalled finds the
+///        session changed when it next polls, and stops sending.
+class DebugSharedMemoryTransport : public DebugTransport
+  {
+public:
+  enum
+    {
+    // ms without a client heartbeat before the debugger drops it.
+    ClientTimeout = 3000
+    };
+
+  DebugSharedMemoryTransport(QObject *parent);
+  ~DebugSharedMemoryTransport();
+
+  QIODevice *connectToServer() X_OVERRIDE;
+  bool listen() X_OVERRIDE;
+  QIODevice *nextPendingConnection() X_OVERRIDE;
+  void flush(QIODevice *device, int msecs) X_OVERRIDE;
+
+private:
+  enum ClientState
+    {
+    // a client may attach.
+    ClientFree,
+    ClientAttached,
+    // the client left, the debugger resets the rings before another may attach.
+    ClientDetached
+    };
+
+  struct Layout
+    {
+    std::atomic<xuint32> clientState;
+    // bumped by the debugger each time it frees the slot.
+    std::atomic<xuint32> session;
+    std::atomic<xuint64> clientHeartbeat;
+    DebugSharedMemoryRing toServer;
+    DebugSharedMemoryRing toClient;
+    };
+
+  void poll();
+  bool attachClient();
+  void onClientDetached();
+  Layout *layout();
+
+  QSharedMemory _memory;
+  QTimer _poll;
+
+  bool _isServer;
+  DebugSharedMemoryDevice *_device;
+  DebugSharedMemoryDevice *_pendingConnection;
+  // server: the last client's device, closed, deleted once the manager has a new one.
+  DebugSharedMemoryDevice *_detached;
+  // server: the client's last heartbeat, and how long since it changed.
+  xuint64 _lastHeartbeat;
+  QElapsedTimer _heartbeatTimer;
+  };
+
+}
+
+#endif // XDEBUGSHAREDMEMORYTRANSPORT_H
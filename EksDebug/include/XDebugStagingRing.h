@@ -0,0 +1,72 @@
+#ifndef XDEBUGSTAGINGRING_H
+#define XDEBUGSTAGINGRING_H
+
+#include "XDebugGlobal.h"
+#include "Math/XMathHelpers.h"
+#include "QByteArray"
+#include <atomic>
+
+namespace Eks
+{
+
+/// \brief Lock free byte ring with exactly one writing thread and one reading thread.
+/// \note  The producer appends any number of byte runs and then commits them together,
+///        so the consumer only ever observes whole records.
+class DebugStagingRing
+  {
+public:
+  DebugStagingRing(xsize capacity);
+
+  xsize capacity() const { return _mask + 1; }
+
+  // Producer side.
+  bool canAppend(xsize size) const;
+  void append(const void *data, xsize size);
+  void commit();
+  /// \brief Discard everything appended since the last commit.
+  void rollback();
+
+  /// \brief Position of the next appended byte, usable with [patch] until committed.
+  xsize position() const { return _pending; }
+  /// \brief Bytes appended but not yet committed.
+  xsize uncommitted() const { return _pending - _committed; }
+  /// \brief Bytes appended and not yet consumed.
+  xsize used() const { return _pending - _tail.load(std::memory_order_relaxed); }
+  void patch(xsize position, const void *data, xsize size);
+
+  // Consumer side.
+  /// \brief Find the committed end of the ring, acquiring the producer's writes.
+  xsize acquire() const;
+  /// \brief Position of the next byte to consume.
+  xsize tail() const { return _tail.load(std::memory_order_relaxed); }
+  /// \brief Copy [size] acquired bytes from [position], which must not be consumed yet.
+  void read(xsize position, void *data, xsize size) const;
+  /// \brief Pass each contiguous span up to [end] to [fn], then release the space.
+  template <typename Fn> void consume(xsize end, Fn fn)
+    {
+    xsize tail = _tail.load(std::memory_order_relaxed);
+    while(tail != end)
+      {
+      const xsize offset = tail & _mask;
+      const xsize run = xMin(end - tail, capacity() - offset);
+      fn(_data.constData() + offset, run);
+      tail += run;
+      }
+    _tail.store(tail, std::memory_order_release);
+    }
+
+private:
+  QByteArray _data;
+  xsize _mask;
+
+  // producer only
+  xsize _pending;
+  xsize _committed;
+
+  alignas(64) std::atomic<xsize> _head;
+  alignas(64) std::atomic<xsize> _tail;
+  };
+
+}
+
+#endif // XDEBUGSTAGINGRING_H
@@ -0,0 +1,57 @@
+#ifndef XDEBUGTIMESTAMP_H
+#define XDEBUGTIMESTAMP_H
+
+#include "XDebugGlobal.h"
+#include "Utilities/XTime.h"
+
+namespace Eks
+{
+
+/// \brief Stamps debug events, with Eks::Time's clock or, where the CPU has an invariant one,
+///        the time stamp counter.
+/// \note  Counter ticks are stamped raw, calibrate() relates them to Eks::Time, and whoever
+///        decodes the stamps converts them with the calibration they were sent.
+class EKSDEBUG_EXPORT DebugTimestamp
+  {
+public:
+  enum class Source : xuint8
+    {
+    // stamps are Eks::Time nanoseconds.
+    Clock,
+    Tsc
+    };
+
+  struct Calibration
+    {
+    Source source;
+    // a stamp, and the Eks::Time it was taken at.
+    xint64 stamp;
+    xint64 nanoseconds;
+    double nanosecondsPerStamp;
+    };
+
+  /// \brief True if the counter ticks at a constant rate across cores and power states.
+  /// \note  The invariant TSC bit says nothing about counters on different sockets agreeing,
+  ///        a multi-socket machine whose firmware doesn't synchronise them stamps events
+  ///        with offsets that depend on the core they were recorded on.
+  static bool tscAvailable();
+
+  /// \brief Stamp with [source] from now on, false if it isn't available or a client
+  ///        DebugLogger exists.
+  /// \note  The logger's drain thread calibrates against the base set here, and stamps
+  ///        already taken can't be converted once it changes.
+  static bool setSource(Source source);
+  static Source source();
+
+  static xint64 now();
+
+  /// \brief Relate stamps to Eks::Time now, the rate is measured since the source was set.
+  static Calibration calibrate();
+
+  static xint64 toNanoseconds(xint64 stamp, const Calibration &c);
+  static Eks::Time toTime(xint64 stamp, const Calibration &c);
+  };
+
+}
+
+#endif // XDEBUGTIMESTAMP_H
@@ -0,0 +1,177 @@
+#ifndef XDEBUGTRACE_H
+#define XDEBUGTRACE_H
+
+#include "XDebugLogger.h"
+#include "QFile"
+#include "QHash"
+#include "QPair"
+#include "QSet"
+#include "QVector"
+
+namespace Eks
+{
+
+/// \brief Writes DebugLogger events to a columnar trace, a directory with a file per field.
+/// \note  Rows are written in blocks of at most BlockRows. Each column is little endian and
+///        fixed width, so a row is found by its index alone. The index file holds each
+///        block's first row and its min and max time, and is appended only once the block's
+///        columns are written, so a trace cut short by a crash ends at its last whole block.
+///        Durations are written when they end, so times within a block aren't ordered.
+///        Location and thread ids restart with each client, so rows and locations carry the
+///        session they were recorded in, and are only related within it.
+class EKSDEBUG_EXPORT DebugTraceWriter
+  {
+public:
+  enum
+    {
+    BlockRows = 4096,
+    // 2: the session column, locations are stored with their session.
+    FormatVersion = 2,
+    // firstRow, rows, minTime, maxTime.
+    IndexEntrySize = sizeof(xuint64) + sizeof(xuint32) + sizeof(xint64) * 2
+    };
+
+  static const char IndexMagic[8];
+
+  enum class RowType : xuint8
+    {
+    Moment,
+    Duration,
+    Log
+    };
+
+  struct Row
+    {
+    // Eks::Time nanoseconds.
+    xint64 time;
+    // from beginSession, the thread and location ids are only unique within it.
+    xuint32 session;
+    xuint64 thread;
+    xuint32 location;
+    // 0 for moments and logs, -1 for durations which never ended.
+    xint64 duration;
+    RowType type;
+    QString message;
+    };
+
+  DebugTraceWriter();
+  ~DebugTraceWriter();
+
+  /// \brief Write to the trace in [directory], continuing after its last whole block.
+  bool open(const QString &directory);
+  void close();
+  bool isOpen() const { return _index.isOpen(); }
+
+  /// \brief Start a session for a new client, numbered after every session in the trace.
+  xuint32 beginSession();
+
+  void addRow(const Row &row);
+  void addLocation(xuint32 session, const DebugLogger::DebugLocationWithData &location);
+  bool hasLocation(xuint32 session, xuint32 id) const { return _locations.contains(qMakePair(session, id)); }
+
+  /// \brief Write the rows added since the last block, as a block.
+  bool flush();
+
+  xuint64 rowCount() const { return _rows + _times.size(); }
+
+private:
+  bool openColumn(QFile &file, const QString &name, xuint64 size);
+  void clearBlock();
+
+  QString _directory;
+  QFile _index;
+  QFile _time;
+  QFile _session;
+  QFile _thread;
+  QFile _location;
+  QFile _duration;
+  QFile _type;
+  QFile _messageEnd;
+  QFile _messageData;
+  QFile _locationFile;
+
+  // rows in whole blocks, and the message bytes they use.
+  xuint64 _rows;
+  xuint64 _messageBytes;
+  xuint32 _lastSession;
+  QSet<QPair<xuint32, xuint32>> _locations;
+
+  // the block being built.
+  QVector<xint64> _times;
+  QVector<xuint32> _sessions;
+  QVector<xuint64> _threads;
+  QVector<xuint32> _locationIds;
+  QVector<xint64> _durations;
+  QVector<xuint8> _types;
+  QVector<xuint64> _messageEnds;
+  QByteArray _messages;
+  };
+
+/// \brief Reads a trace written by DebugTraceWriter.
+class EKSDEBUG_EXPORT DebugTraceReader
+  {
+public:
+  struct Block
+    {
+    xuint64 firstRow;
+    xuint32 rows;
+    xint64 minTime;
+    xint64 maxTime;
+    };
+
+  bool open(const QString &directory);
+
+  const QVector<Block> &blocks() const { return _blocks; }
+  /// \brief Locations by session and id.
+  const QHash<QPair<xuint32, xuint32>, DebugLogger::DebugLocationWithData> &locations() const { return _locations; }
+  /// \brief The location a row from [session] refers to as [id], null if it wasn't recorded.
+  const DebugLogger::DebugLocationWithData *location(xuint32 session, xuint32 id) const;
+
+  /// \brief The rows with times in [from, to], reading only the blocks whose range overlaps it.
+  QVector<DebugTraceWriter::Row> query(xint64 from, xint64 to) const;
+
+private:
+  QString _directory;
+  QVector<Block> _blocks;
+  QHash<QPair<xuint32, xuint32>, DebugLogger::DebugLocationWithData> _locations;
+  };
+
+/// \brief Records a server DebugLogger's events to a DebugTraceWriter as they arrive.
+/// \note  Blocks are flushed every FlushInterval, so a recorder left running loses little
+///        when it is killed. Each recorder is a new session, create one per client logger.
+class EKSDEBUG_EXPORT DebugTraceRecorder : public QObject
+  {
+  Q_OBJECT
+
+public:
+  enum
+    {
+    // ms between flushes.
+    FlushInterval = 1000,
+    // durations waiting for their end, beyond which begins are written as never ending.
+    MaxOpenDurations = 64 * 1024
+    };
+
+  DebugTraceRecorder(DebugTraceWriter *writer, DebugLoggerData *data);
+  ~DebugTraceRecorder();
+
+protected:
+  void timerEvent(QTimerEvent *) X_OVERRIDE;
+
+private:
+  struct OpenDuration
+    {
+    xint64 time;
+    xuint32 location;
+    };
+
+  void addLocation(const DebugLogger::DebugLocationWithData *location);
+
+  DebugTraceWriter *_writer;
+  xuint32 _session;
+  QHash<QPair<xuint64, xsize>, OpenDuration> _open;
+  };
+
+}
+
+#endif // XDEBUGTRACE_H
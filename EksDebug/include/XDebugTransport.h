@@ -0,0 +1,48 @@
+#ifndef XDEBUGTRANSPORT_H
+#define XDEBUGTRANSPORT_H
+
+#include "XDebugManager.h"
+#include "QObject"
+
+class QIODevice;
+
+namespace Eks
+{
+
+/// \brief Carries the framed debug stream between a client and a debugger.
+/// \note  Connections are plain QIODevices, so framing and dispatch are the same on every transport.
+class EKSDEBUG_EXPORT DebugTransport : public QObject
+  {
+  Q_OBJECT
+
+public:
+  enum
+    {
+    TcpPort = 12345
+    };
+
+  static const char *ServerName;
+
+  static DebugTransport *create(DebugManager::Transport type, QObject *parent);
+
+  /// \brief Start connecting to a debugger, [connected] is emitted once it succeeds.
+  virtual QIODevice *connectToServer() = 0;
+
+  /// \brief Accept debugger clients, [newConnection] is emitted as they arrive.
+  virtual bool listen() = 0;
+  virtual QIODevice *nextPendingConnection() = 0;
+
+  /// \brief Push buffered output on [device], waiting at most [msecs].
+  virtual void flush(QIODevice *device, int msecs) = 0;
+
+Q_SIGNALS:
+  void connected();
+  void newConnection();
+
+protected:
+  DebugTransport(QObject *parent);
+  };
+
+}
+
+#endif // XDEBUGTRANSPORT_H
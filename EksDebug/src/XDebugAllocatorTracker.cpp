@@ -0,0 +1,524 @@
+#include "XDebugAllocatorTracker.h"
+#include "Math/XMathHelpers.h"
+#include "QDataStream"
+#include "QHash"
+#include "QByteArray"
+#include "QStringList"
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+#if defined(Q_OS_WIN)
+# include <windows.h>
+#elif defined(Q_OS_LINUX) || defined(Q_OS_MAC)
+# define X_DEBUG_ALLOCATOR_BACKTRACE
+# include <execinfo.h>
+# include <dlfcn.h>
+# include <cxxabi.h>
+# include <cstdlib>
+#endif
+
+namespace Eks
+{
+
+X_IMPLEMENT_DEBUG_INTERFACE(DebugAllocatorInterface)
+
+namespace
+{
+
+// stored just before each block, so free can find the parent's block and its size.
+struct AllocationHeader
+  {
+  xsize size;
+  xsize offset;
+  };
+
+std::mutex g_trackersLock;
+DebugTrackingAllocator *g_trackers = 0;
+xuint32 g_nextTrackerID = 0;
+
+std::atomic<xuint32> g_sampleInterval(0);
+
+struct SampledSite
+  {
+  void *frames[DebugAllocatorInterface::SiteFrames];
+  int frameCount;
+  xuint64 samples;
+  xuint64 bytes;
+  QString location;
+  };
+
+// keyed by the site's frames.
+typedef QHash<QByteArray, SampledSite> SiteHash;
+
+std::mutex g_sitesLock;
+
+SiteHash &sampledSites()
+  {
+  static SiteHash sites;
+  return sites;
+  }
+
+QString frameName(void *frame)
+  {
+#if defined(X_DEBUG_ALLOCATOR_BACKTRACE)
+  Dl_info info;
+  if(dladdr(frame, &info) && info.dli_sname)
+    {
+    int status = 0;
+    char *demangled = abi::__cxa_demangle(info.dli_sname, 0, 0, &status);
+    const QString name = QString::fromUtf8(status == 0 && demangled ? demangled : info.dli_sname);
+    ::free(demangled);
+    return name;
+    }
+
+  if(info.dli_fname)
+    {
+    return QString("%1+0x%2")
+      .arg(QString::fromUtf8(info.dli_fname).section('/', -1))
+      .arg((quintptr)frame - (quintptr)info.dli_fbase, 0, 16);
+    }
+#endif
+
+  return QString("0x%1").arg((quintptr)frame, 0, 16);
+  }
+
+}
+
+QDataStream &operator<<(QDataStream &s, const DebugAllocatorInterface::Summary &sum)
+  {
+  s << sum.interval << sum.sampleInterval;
+
+  s << (xuint32)sum.allocators.size();
+  xForeach(const DebugAllocatorInterface::Summary::AllocatorEntry &e, sum.allocators)
+    {
+    s << e.id << e.name << e.liveBytes << e.liveAllocations << e.peakBytes << e.allocations << e.allocatedBytes;
+    }
+
+  s << (xuint32)sum.sites.size();
+  xForeach(const DebugAllocatorInterface::Summary::SiteEntry &e, sum.sites)
+    {
+    s << e.location << e.samples << e.bytes;
+    }
+
+  return s;
+  }
+
+QDataStream &operator>>(QDataStream &s, DebugAllocatorInterface::Summary &sum)
+  {
+  s >> sum.interval >> sum.sampleInterval;
+
+  xuint32 count = 0;
+  s >> count;
+  sum.allocators.clear();
+  for(xuint32 i = 0; i < count && s.status() == QDataStream::Ok; ++i)
+    {
+    DebugAllocatorInterface::Summary::AllocatorEntry e;
+    s >> e.id >> e.name >> e.liveBytes >> e.liveAllocations >> e.peakBytes >> e.allocations >> e.allocatedBytes;
+    sum.allocators << e;
+    }
+
+  count = 0;
+  s >> count;
+  sum.sites.clear();
+  for(xuint32 i = 0; i < count && s.status() == QDataStream::Ok; ++i)
+    {
+    DebugAllocatorInterface::Summary::SiteEntry e;
+    s >> e.location >> e.samples >> e.bytes;
+    sum.sites << e;
+    }
+
+  return s;
+  }
+
+DebugTrackingAllocator::DebugTrackingAllocator(AllocatorBase *parent, const QString &name)
+    : _parent(parent),
+      _name(name),
+      _liveBytes(0),
+      _liveAllocations(0),
+      _peakBytes(0),
+      _allocations(0),
+      _allocatedBytes(0)
+  {
+  xAssert(_parent);
+
+  std::lock_guard<std::mutex> lock(g_trackersLock);
+  _id = g_nextTrackerID++;
+  _next = g_trackers;
+  g_trackers = this;
+  }
+
+DebugTrackingAllocator::~DebugTrackingAllocator()
+  {
+  xAssert(liveAllocations() == 0);
+
+  std::lock_guard<std::mutex> lock(g_trackersLock);
+  for(DebugTrackingAllocator **t = &g_trackers; *t; t = &(*t)->_next)
+    {
+    if(*t == this)
+      {
+      *t = _next;
+      break;
+      }
+    }
+  }
+
+void *DebugTrackingAllocator::alloc(xsize size, xsize alignment)
+  {
+  // the header sits in front of the block, keeping the block aligned.
+  const xsize offset = xMax(alignment, sizeof(AllocationHeader));
+  xAssert((offset & (offset - 1)) == 0);
+
+  xuint8 *mem = (xuint8 *)_parent->alloc(size + offset, alignment);
+  if(!mem)
+    {
+    return 0;
+    }
+
+  xuint8 *block = mem + offset;
+  AllocationHeader *header = (AllocationHeader *)block - 1;
+  header->size = size;
+  header->offset = offset;
+
+  _allocations.fetch_add(1, std::memory_order_relaxed);
+  _allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+  _liveAllocations.fetch_add(1, std::memory_order_relaxed);
+
+  const xuint64 live = _liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+  xuint64 peak = _peakBytes.load(std::memory_order_relaxed);
+  while(live > peak && !_peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+    {
+    }
+
+  const xuint32 interval = g_sampleInterval.load(std::memory_order_relaxed);
+  if(interval)
+    {
+    static thread_local xuint32 t_countdown = 0;
+    if(t_countdown == 0 || t_countdown > interval)
+      {
+      t_countdown = interval;
+      }
+
+    if(--t_countdown == 0)
+      {
+      DebugAllocatorInterface::sample(size);
+      }
+    }
+
+  return block;
+  }
+
+void DebugTrackingAllocator::free(void *mem)
+  {
+  if(!mem)
+    {
+    return;
+    }
+
+  const AllocationHeader *header = (AllocationHeader *)mem - 1;
+  const xsize size = header->size;
+  xuint8 *parentMem = (xuint8 *)mem - header->offset;
+
+  _liveBytes.fetch_sub(size, std::memory_order_relaxed);
+  _liveAllocations.fetch_sub(1, std::memory_order_relaxed);
+
+  _parent->free(parentMem);
+  }
+
+DebugAllocatorInterface::DebugAllocatorInterface(DebugManager *, bool client)
+  {
+  if(client)
+    {
+    _sinceSummary.start();
+    startTimer(SummaryInterval);
+    }
+  else
+    {
+    _model = createDataModel<DebugAllocatorModel>();
+    }
+
+  static Reciever recv[] =
+    {
+    recieveFunction<Summary, DebugAllocatorInterface, &DebugAllocatorInterface::onSummary>(),
+    };
+
+  static const DispatchTable dispatch(recv, X_ARRAY_COUNT(recv));
+  setRecievers(dispatch);
+  }
+
+DebugAllocatorInterface::~DebugAllocatorInterface()
+  {
+  }
+
+void DebugAllocatorInterface::setSampleInterval(xuint32 interval)
+  {
+  g_sampleInterval.store(interval, std::memory_order_relaxed);
+  }
+
+xuint32 DebugAllocatorInterface::sampleInterval()
+  {
+  return g_sampleInterval.load(std::memory_order_relaxed);
+  }
+
+void DebugAllocatorInterface::sample(xsize size)
+  {
+  // skip this function and the tracker's alloc.
+  static const int SkippedFrames = 2;
+
+  void *frames[SiteFrames + SkippedFrames];
+  int count = 0;
+#if defined(Q_OS_WIN)
+  count = CaptureStackBackTrace(SkippedFrames, SiteFrames, frames, 0);
+#elif defined(X_DEBUG_ALLOCATOR_BACKTRACE)
+  count = xMax(backtrace(frames, SiteFrames + SkippedFrames) - SkippedFrames, 0);
+  memmove(frames, frames + SkippedFrames, count * sizeof(void *));
+#endif
+
+  const QByteArray key((const char *)frames, count * (int)sizeof(void *));
+
+  std::lock_guard<std::mutex> lock(g_sitesLock);
+  SiteHash &sites = sampledSites();
+
+  auto it = sites.find(key);
+  if(it == sites.end())
+    {
+    SampledSite site;
+    std::copy(frames, frames + count, site.frames);
+    site.frameCount = count;
+    site.samples = 0;
+    site.bytes = 0;
+    it = sites.insert(key, site);
+    }
+
+  ++it->samples;
+  it->bytes += size;
+  }
+
+DebugAllocatorInterface::Summary DebugAllocatorInterface::summarise()
+  {
+  Summary summary;
+  summary.interval = (xuint32)_sinceSummary.restart();
+  summary.sampleInterval = sampleInterval();
+
+    {
+    std::lock_guard<std::mutex> lock(g_trackersLock);
+    for(DebugTrackingAllocator *t = g_trackers; t; t = t->_next)
+      {
+      const Summary::AllocatorEntry e =
+        {
+        t->_id,
+        t->name(),
+        t->liveBytes(),
+        t->liveAllocations(),
+        t->peakBytes(),
+        t->allocations(),
+        t->allocatedBytes()
+        };
+      summary.allocators << e;
+      }
+    }
+
+  // sites are counted since sampling began, so the heaviest stay on top.
+  std::lock_guard<std::mutex> lock(g_sitesLock);
+  SiteHash &sites = sampledSites();
+
+  QVector<SampledSite *> heaviest;
+  heaviest.reserve(sites.size());
+  for(auto it = sites.begin(); it != sites.end(); ++it)
+    {
+    heaviest << &it.value();
+    }
+
+  const int sent = xMin((int)MaxSummarySites, heaviest.size());
+  std::partial_sort(
+    heaviest.begin(),
+    heaviest.begin() + sent,
+    heaviest.end(),
+    [](const SampledSite *a, const SampledSite *b) { return a->bytes > b->bytes; });
+
+  for(int i = 0; i < sent; ++i)
+    {
+    SampledSite *site = heaviest[i];
+
+    // named once, when first sent.
+    if(site->location.isEmpty())
+      {
+      QStringList names;
+      for(int f = 0; f < site->frameCount; ++f)
+        {
+        names << frameName(site->frames[f]);
+        }
+      site->location = names.isEmpty() ? QString("Unknown") : names.join(" < ");
+      }
+
+    const Summary::SiteEntry e = { site->location, site->samples, site->bytes };
+    summary.sites << e;
+    }
+
+  return summary;
+  }
+
+void DebugAllocatorInterface::sendSummary()
+  {
+  sendData(summarise());
+  }
+
+void DebugAllocatorInterface::timerEvent(QTimerEvent *)
+  {
+  sendSummary();
+  }
+
+void DebugAllocatorInterface::onSummary(const Summary &s)
+  {
+  if(_model.value())
+    {
+    _model->setSummary(s);
+    }
+  }
+
+DebugAllocatorSiteModel::DebugAllocatorSiteModel()
+    : _sampleInterval(0)
+  {
+  }
+
+void DebugAllocatorSiteModel::setSites(
+    const QVector<DebugAllocatorInterface::Summary::SiteEntry> &sites,
+    xuint32 sampleInterval)
+  {
+  beginResetModel();
+  _sites = sites;
+  _sampleInterval = sampleInterval;
+  endResetModel();
+  }
+
+int DebugAllocatorSiteModel::rowCount(const QModelIndex &parent) const
+  {
+  return parent.isValid() ? 0 : _sites.size();
+  }
+
+int DebugAllocatorSiteModel::columnCount(const QModelIndex &parent) const
+  {
+  return parent.isValid() ? 0 : 4;
+  }
+
+QVariant DebugAllocatorSiteModel::data(const QModelIndex &index, int role) const
+  {
+  if(role != Qt::DisplayRole || !index.isValid() || index.row() >= _sites.size())
+    {
+    return QVariant();
+    }
+
+  const DebugAllocatorInterface::Summary::SiteEntry &site = _sites[index.row()];
+  switch(index.column())
+    {
+  case 0:
+    return site.location;
+  case 1:
+    return QString::number(site.samples);
+  case 2:
+    return QString::number(site.bytes);
+  default:
+    // each sample stands for an interval's worth of allocations.
+    return QString::number(site.bytes * _sampleInterval);
+    }
+  }
+
+QVariant DebugAllocatorSiteModel::headerData(int section, Qt::Orientation orientation, int role) const
+  {
+  if(role != Qt::DisplayRole || orientation != Qt::Horizontal)
+    {
+    return QVariant();
+    }
+
+  static const char *headers[] = { "Call site", "Samples", "Sampled bytes", "Estimated bytes" };
+  return section < (int)X_ARRAY_COUNT(headers) ? QString(headers[section]) : QVariant();
+  }
+
+DebugAllocatorModel::DebugAllocatorModel()
+  {
+  }
+
+void DebugAllocatorModel::setSummary(const DebugAllocatorInterface::Summary &s)
+  {
+  QVector<Row> rows;
+  xForeach(const DebugAllocatorInterface::Summary::AllocatorEntry &e, s.allocators)
+    {
+    Row row = { e, 0.0, 0.0 };
+    xForeach(const Row &last, _rows)
+      {
+      if(last.entry.id == e.id && s.interval)
+        {
+        const double seconds = s.interval / 1000.0;
+        row.allocationRate = (e.allocations - last.entry.allocations) / seconds;
+        row.byteRate = (e.allocatedBytes - last.entry.allocatedBytes) / seconds;
+        break;
+        }
+      }
+    rows << row;
+    }
+
+  if(rows.size() == _rows.size())
+    {
+    _rows = rows;
+    if(_rows.size())
+      {
+      emit dataChanged(index(0, 0), index(_rows.size() - 1, columnCount(QModelIndex()) - 1));
+      }
+    }
+  else
+    {
+    beginResetModel();
+    _rows = rows;
+    endResetModel();
+    }
+
+  _sites.setSites(s.sites, s.sampleInterval);
+  }
+
+int DebugAllocatorModel::rowCount(const QModelIndex &parent) const
+  {
+  return parent.isValid() ? 0 : _rows.size();
+  }
+
+int DebugAllocatorModel::columnCount(const QModelIndex &parent) const
+  {
+  return parent.isValid() ? 0 : 6;
+  }
+
+QVariant DebugAllocatorModel::data(const QModelIndex &index, int role) const
+  {
+  if(role != Qt::DisplayRole || !index.isValid() || index.row() >= _rows.size())
+    {
+    return QVariant();
+    }
+
+  const Row &row = _rows[index.row()];
+  switch(index.column())
+    {
+  case 0:
+    return row.entry.name;
+  case 1:
+    return QString::number(row.entry.liveBytes);
+  case 2:
+    return QString::number(row.entry.liveAllocations);
+  case 3:
+    return QString::number(row.entry.peakBytes);
+  case 4:
+    return QString::number(row.allocationRate, 'f', 0);
+  default:
+    return QString::number(row.byteRate, 'f', 0);
+    }
+  }
+
+QVariant DebugAllocatorModel::headerData(int section, Qt::Orientation orientation, int role) const
+  {
+  if(role != Qt::DisplayRole || orientation != Qt::Horizontal)
+    {
+    return QVariant();
+    }
+
+  static const char *headers[] = { "Allocator", "Live bytes", "Live allocations", "Peak bytes", "Allocations/s", "Bytes/s" };
+  return section < (int)X_ARRAY_COUNT(headers) ? QString(headers[section]) : QVariant();
+  }
+
+}
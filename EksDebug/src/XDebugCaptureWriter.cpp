@@ -0,0 +1,207 @@
+#include "XDebugCaptureWriter.h"
+#include "Utilities/XAssert.h"
+#include "Math/XMathHelpers.h"
+#include "QDebug"
+#include <cstring>
+
+namespace Eks
+{
+
+const char DebugCaptureWriter::CaptureMagic[HeaderSize] = { 'E', 'k', 's', 'C', 'a', 'p', '0', '1' };
+
+DebugCaptureWriter::DebugCaptureWriter()
+    : _ring(RingCapacity),
+      _batchOverflowed(false),
+      _fileSize(0),
+      _stop(false),
+      _recordedBytes(0),
+      _droppedBatches(0),
+      _droppedBytes(0)
+  {
+  }
+
+DebugCaptureWriter::~DebugCaptureWriter()
+  {
+  stop();
+  }
+
+bool DebugCaptureWriter::start(const QString &path)
+  {
+  xAssert(!_thread.joinable());
+
+  _file.setFileName(path);
+  if(!_file.open(QIODevice::ReadWrite | QIODevice::Truncate))
+    {
+    qWarning() << "Failed to open capture" << path << _file.errorString();
+    return false;
+    }
+
+  // the magic goes through the ring like any other bytes.
+  _ring.append(CaptureMagic, HeaderSize);
+  _ring.commit();
+
+  _stop = false;
+  _thread = std::thread([this]() { run(); });
+  return true;
+  }
+
+void DebugCaptureWriter::stop()
+  {
+  if(!_thread.joinable())
+    {
+    return;
+    }
+
+    {
+    std::lock_guard<std::mutex> l(_wakeLock);
+    _stop = true;
+    }
+  _wake.notify_one();
+  _thread.join();
+  }
+
+void DebugCaptureWriter::write(const char *data, xsize size)
+  {
+  if(_batchOverflowed || !_ring.canAppend(size))
+    {
+    _batchOverflowed = true;
+    _droppedBytes += size;
+    return;
+    }
+
+  _ring.append(data, size);
+  }
+
+void DebugCaptureWriter::commit()
+  {
+  if(_batchOverflowed)
+    {
+    // parts of the batch already copied are counted as dropped too.
+    _droppedBytes += _ring.uncommitted();
+    ++_droppedBatches;
+    _ring.rollback();
+    _batchOverflowed = false;
+    return;
+    }
+
+  if(_ring.uncommitted())
+    {
+    _ring.commit();
+    _wake.notify_one();
+    }
+  }
+
+DebugManager::CaptureStatistics DebugCaptureWriter::statistics() const
+  {
+  DebugManager::CaptureStatistics stats;
+  stats.recordedBytes = _recordedBytes.load(std::memory_order_relaxed);
+  stats.droppedBatches = _droppedBatches;
+  stats.droppedBytes = _droppedBytes;
+  return stats;
+  }
+
+void DebugCaptureWriter::run()
+  {
+  Segment current = { 0, 0 };
+  Segment next = { 0, 0 };
+  xsize offset = 0;
+  xsize consumed = 0;
+  bool failed = false;
+
+  for(;;)
+    {
+    const xsize end = _ring.acquire();
+    if(end == consumed)
+      {
+      std::unique_lock<std::mutex> l(_wakeLock);
+      if(_stop && _ring.acquire() == consumed)
+        {
+        break;
+        }
+
+      _wake.wait_for(l, std::chrono::milliseconds(10));
+      continue;
+      }
+
+    _ring.consume(end, [&](const char *data, xsize size)
+      {
+      while(size && !failed)
+        {
+        if(!current.data || offset == current.base + SegmentSize)
+          {
+          unmapSegment(current);
+          current = next;
+          next.data = 0;
+
+          if(!current.data && !mapSegment(offset, current))
+            {
+            failed = true;
+            break;
+            }
+          }
+
+        const xsize run = xMin(size, current.base + SegmentSize - offset);
+        memcpy(current.data + (offset - current.base), data, run);
+
+        offset += run;
+        data += run;
+        size -= run;
+        }
+      });
+    consumed = end;
+
+    if(failed)
+      {
+      // keep releasing the ring, so the manager sees space, but record nothing more.
+      continue;
+      }
+
+    _recordedBytes.store(offset, std::memory_order_relaxed);
+
+    // map the next segment while this one still has room, so the copy never waits on it.
+    if(!next.data && offset - current.base > SegmentSize / 2 && !mapSegment(current.base + SegmentSize, next))
+      {
+      failed = true;
+      }
+    }
+
+  unmapSegment(current);
+  unmapSegment(next);
+
+  _file.resize(offset);
+  _file.close();
+  }
+
+bool DebugCaptureWriter::mapSegment(xsize base, Segment &segment)
+  {
+  if(_fileSize < base + SegmentSize)
+    {
+    _fileSize = base + SegmentSize;
+    if(!_file.resize(_fileSize))
+      {
+      qWarning() << "Failed to grow capture" << _file.errorString();
+      return false;
+      }
+    }
+
+  segment.data = _file.map(base, SegmentSize);
+  segment.base = base;
+  if(!segment.data)
+    {
+    qWarning() << "Failed to map capture" << _file.errorString();
+    return false;
+    }
+
+  return true;
+  }
+
+void DebugCaptureWriter::unmapSegment(Segment &segment)
+  {
+  if(segment.data)
+    {
+    _file.unmap(segment.data);
+    segment.data = 0;
+    }
+  }
+
+}
@@ -0,0 +1,263 @@
+#include "XDebugCompactEncoding.h"
+#include "XDebugManagerImpl.h"
+#include "Math/XMathHelpers.h"
+#include "QIODevice"
+#include <atomic>
+#include <cstring>
+
+namespace Eks
+{
+
+extern DebugManagerImpl *g_manager;
+
+namespace
+{
+
+// a full time is sent at least this often per thread.
+const xuint8 KeyframeInterval = 64;
+
+struct ThreadTimeEncoder
+  {
+  xuint64 thread;
+  xint64 last;
+  xuint32 generation;
+  xuint8 sequence;
+  xuint8 sinceKeyframe;
+  bool valid;
+  };
+
+thread_local ThreadTimeEncoder t_timeEncoder = { 0, 0, 0, 0, 0, false };
+
+// bumped when a reader joins mid stream, each thread's next time is then a keyframe.
+std::atomic<xuint32> g_keyframeGeneration(0);
+
+inline xuint64 zigzag(xint64 v)
+  {
+  return ((xuint64)v << 1) ^ (xuint64)(v >> 63);
+  }
+
+inline xint64 unzigzag(xuint64 v)
+  {
+  return (xint64)(v >> 1) ^ -(xint64)(v & 1);
+  }
+
+}
+
+DebugCompactWriter::DebugCompactWriter(QDataStream &stream)
+    : _stream(stream),
+      _used(0)
+  {
+  }
+
+DebugCompactWriter::~DebugCompactWriter()
+  {
+  flush();
+  }
+
+void DebugCompactWriter::writeUnsigned(xuint64 value)
+  {
+  char bytes[MaxVarintSize];
+  xsize count = 0;
+  do
+    {
+    xuint8 byte = value & 0x7F;
+    value >>= 7;
+    if(value)
+      {
+      byte |= 0x80;
+      }
+    bytes[count++] = (char)byte;
+    } while(value);
+
+  put(bytes, count);
+  }
+
+void DebugCompactWriter::writeSigned(xint64 value)
+  {
+  writeUnsigned(zigzag(value));
+  }
+
+void DebugCompactWriter::writeString(const QString &value)
+  {
+  const QByteArray utf8 = value.toUtf8();
+  writeUnsigned((xuint64)utf8.size());
+  writeBytes(utf8.constData(), utf8.size());
+  }
+
+void DebugCompactWriter::writeBytes(const char *data, xsize size)
+  {
+  if(size > BufferSize)
+    {
+    flush();
+    _stream.writeRawData(data, (int)size);
+    return;
+    }
+
+  put(data, size);
+  }
+
+void DebugCompactWriter::writeThreadTime(xuint64 thread, xint64 nanoseconds)
+  {
+  ThreadTimeEncoder &enc = t_timeEncoder;
+
+  if(!enc.valid || enc.thread != thread)
+    {
+    enc.thread = thread;
+    enc.sequence = 0;
+    enc.sinceKeyframe = KeyframeInterval;
+    enc.valid = true;
+    }
+
+  const xuint32 generation = g_keyframeGeneration.load(std::memory_order_relaxed);
+  if(enc.generation != generation)
+    {
+    enc.generation = generation;
+    enc.sinceKeyframe = KeyframeInterval;
+    }
+
+  const char sequence = (char)enc.sequence++;
+  put(&sequence, 1);
+
+  // the low bit marks a keyframe, holding the full time rather than a delta.
+  if(enc.sinceKeyframe >= KeyframeInterval)
+    {
+    writeUnsigned((zigzag(nanoseconds) << 1) | 1);
+    enc.sinceKeyframe = 0;
+    }
+  else
+    {
+    writeUnsigned(zigzag(nanoseconds - enc.last) << 1);
+    ++enc.sinceKeyframe;
+    }
+
+  enc.last = nanoseconds;
+  }
+
+void DebugCompactWriter::forceKeyframes()
+  {
+  g_keyframeGeneration.fetch_add(1, std::memory_order_relaxed);
+  }
+
+void DebugCompactWriter::flush()
+  {
+  if(_used)
+    {
+    _stream.writeRawData(_buffer, (int)_used);
+    _used = 0;
+    }
+  }
+
+void DebugCompactWriter::put(const char *data, xsize size)
+  {
+  if(_used + size > BufferSize)
+    {
+    flush();
+    }
+
+  memcpy(_buffer + _used, data, size);
+  _used += size;
+  }
+
+DebugCompactReader::DebugCompactReader(QDataStream &stream)
+    : _stream(stream)
+  {
+  }
+
+xuint64 DebugCompactReader::readUnsigned()
+  {
+  xuint64 value = 0;
+  for(xsize shift = 0; shift < 64; shift += 7)
+    {
+    const xuint8 byte = readByte();
+    value |= (xuint64)(byte & 0x7F) << shift;
+
+    if(!(byte & 0x80))
+      {
+      break;
+      }
+    }
+
+  return value;
+  }
+
+xint64 DebugCompactReader::readSigned()
+  {
+  return unzigzag(readUnsigned());
+  }
+
+QString DebugCompactReader::readString()
+  {
+  const xuint64 size = readUnsigned();
+  if(!size || !canRead(size))
+    {
+    return QString();
+    }
+
+  QByteArray utf8((int)size, Qt::Uninitialized);
+  readBytes(utf8.data(), (xsize)size);
+  return QString::fromUtf8(utf8);
+  }
+
+bool DebugCompactReader::canRead(xuint64 size)
+  {
+  QIODevice *dev = _stream.device();
+  if(!isValid() || (dev && size > (xuint64)dev->bytesAvailable()))
+    {
+    _stream.setStatus(QDataStream::ReadPastEnd);
+    return false;
+    }
+  return true;
+  }
+
+void DebugCompactReader::readBytes(char *data, xsize size)
+  {
+  if(_stream.readRawData(data, (int)size) != (int)size)
+    {
+    _stream.setStatus(QDataStream::ReadPastEnd);
+    }
+  }
+
+bool DebugCompactReader::readThreadTime(xuint64 thread, xint64 &nanoseconds)
+  {
+  const xuint8 sequence = readByte();
+  const xuint64 encoded = readUnsigned();
+  const xint64 value = unzigzag(encoded >> 1);
+
+  DebugManagerImpl::ThreadTime &state = g_manager->_threadTimes[thread];
+  if(encoded & 1)
+    {
+    state.last = value;
+    state.valid = true;
+    }
+  else if(state.valid && sequence == state.nextSequence)
+    {
+    state.last += value;
+    }
+  else
+    {
+    // a frame was lost, or the stream was joined part way, deltas are meaningless until
+    // the next keyframe.
+    state.valid = false;
+    }
+
+  state.nextSequence = sequence + 1;
+  nanoseconds = state.valid ? state.last : 0;
+  return state.valid;
+  }
+
+void DebugCompactReader::resetThreadTimes()
+  {
+  g_manager->_threadTimes.clear();
+  }
+
+xuint8 DebugCompactReader::readByte()
+  {
+  char byte = 0;
+  if(_stream.readRawData(&byte, 1) != 1)
+    {
+    _stream.setStatus(QDataStream::ReadPastEnd);
+    }
+  return (xuint8)byte;
+  }
+
+}
@@ -0,0 +1,98 @@
+#include "XDebugCompression.h"
+#include "XDebugLz.h"
+#include "Math/XMathHelpers.h"
+#include "QtEndian"
+#include <cstring>
+
+namespace Eks
+{
+
+void DebugStreamCompressor::compressBlocks(const char *data, xsize size, QByteArray &out)
+  {
+  while(size)
+    {
+    const xsize raw = xMin(size, (xsize)DebugLz::MaxBlockSize);
+
+    const xsize start = (xsize)out.size();
+    out.resize((int)(start + BlockHeaderSize + DebugLz::compressBound(raw)));
+
+    char *block = out.data() + start;
+    xsize stored = DebugLz::compress(data, raw, block + BlockHeaderSize);
+    xuint32 storedField = (xuint32)stored;
+    if(stored >= raw)
+      {
+      memcpy(block + BlockHeaderSize, data, raw);
+      stored = raw;
+      storedField = (xuint32)raw | StoredRawFlag;
+      }
+
+    qToBigEndian((xuint32)raw, (uchar *)block);
+    qToBigEndian(storedField, (uchar *)block + sizeof(xuint32));
+    out.resize((int)(start + BlockHeaderSize + stored));
+
+    data += raw;
+    size -= raw;
+    }
+  }
+
+void DebugStreamCompressor::compress(const QByteArray &data)
+  {
+  QByteArray out;
+  compressBlocks(data.constData(), data.size(), out);
+  if(!out.isEmpty())
+    {
+    emit compressed(out);
+    }
+  }
+
+DebugStreamDecompressor::DebugStreamDecompressor()
+    : _input(DebugLz::MaxBlockSize * 2)
+  {
+  }
+
+bool DebugStreamDecompressor::decode(DebugReceiveBuffer &out, xsize &produced)
+  {
+  produced = 0;
+  while(_input.size() >= DebugStreamCompressor::BlockHeaderSize)
+    {
+    const uchar *header = (const uchar *)_input.data();
+    const xuint32 raw = qFromBigEndian<xuint32>(header);
+    const xuint32 storedField = qFromBigEndian<xuint32>(header + sizeof(xuint32));
+    const xuint32 stored = storedField & ~(xuint32)DebugStreamCompressor::StoredRawFlag;
+
+    if(raw > (xuint32)DebugLz::MaxBlockSize || stored > DebugLz::compressBound(DebugLz::MaxBlockSize))
+      {
+      return false;
+      }
+
+    if(_input.size() < DebugStreamCompressor::BlockHeaderSize + stored)
+      {
+      break;
+      }
+
+    const char *block = _input.data() + DebugStreamCompressor::BlockHeaderSize;
+    if(storedField & DebugStreamCompressor::StoredRawFlag)
+      {
+      if(stored != raw)
+        {
+        return false;
+        }
+      out.append(block, raw);
+      }
+    else
+      {
+      if(!DebugLz::decompress(block, stored, out.reserve(raw), raw))
+        {
+        return false;
+        }
+      out.commit(raw);
+      }
+
+    produced += raw;
+    _input.consume(DebugStreamCompressor::BlockHeaderSize + stored);
+    }
+
+  return true;
+  }
+
+}
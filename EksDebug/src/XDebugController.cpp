@@ -1,6 +1,7 @@
 #include "XDebugController.h"
 #include "XCore.h"
 #include "QDebug"
+#include "QVector"
 
 
 namespace Eks
@@ -8,7 +9,32 @@ namespace Eks
 
 X_IMPLEMENT_DEBUG_INTERFACE(DebugController)
 
-#define VERSION 1
+// 2: Init carries the client's capabilities.
+// 3: the server answers Init with the capabilities it accepts, CompressionStart.
+// 4: SetupInterface identifies types by hash, naming each once per session.
+// 5: FlowControl, GrantCredit.
+// 6: the SendStatistics capability, SetSendLimit and InterfaceStatistics.
+// 7: the Monitor capability.
+// 8: InterfaceState.
+#define VERSION 8
+// first version a client accepts SetSendLimit.
+#define SEND_LIMIT_VERSION 6
+
+// capabilities the server can accept from a client.
+static const xuint32 AcceptedCapabilities =
+  DebugManager::CompactEncoding |
+  DebugManager::Compression |
+  DebugManager::FlowControl |
+  DebugManager::SendStatistics |
+  DebugManager::Monitor;
+// capabilities the client only uses once the server answers Init accepting them.
+// CompactEncoding isn't one of them, frames are encoded on each sending thread as they are
+// staged, so there is no single point in the stream the encoding could switch at.
+static const xuint32 NegotiatedCapabilities =
+  DebugManager::Compression |
+  DebugManager::FlowControl |
+  DebugManager::SendStatistics |
+  DebugManager::Monitor;
 
 struct Init
   {
@@ -17,19 +43,28 @@ struct Init
     DebugMessageType = 1
     };
   xuint32 version;
+  xuint32 capabilities;
   };
 
 QDataStream &operator<<(QDataStream& s, const Init& i)
   {
-  return s << i.version;
+  return s << i.version << i.capabilities;
   }
 
 QDataStream &operator>>(QDataStream& s, Init& i)
   {
-  return s >> i.version;
+  s >> i.version;
+
+  i.capabilities = 0;
+  if(i.version >= 2)
+    {
+    s >> i.capabilities;
+    }
+  return s;
   }
 
-struct SetupInterface
+// sent by clients before version 4.
+struct SetupInterfaceByName
   {
   enum
     {
@@ -39,38 +74,242 @@ struct SetupInterface
   QString typeName;
   };
 
-QDataStream &operator<<(QDataStream& s, const SetupInterface& i)
+template <> struct DebugCompactEncoding<SetupInterfaceByName>
+  {
+  enum
+    {
+    Enabled = 1
+    };
+  };
+
+QDataStream &operator<<(QDataStream& s, const SetupInterfaceByName& i)
   {
   return s << i.id << i.typeName;
   }
 
-QDataStream &operator>>(QDataStream& s, SetupInterface& i)
+QDataStream &operator>>(QDataStream& s, SetupInterfaceByName& i)
+  {
+  return s >> i.id >> i.typeName;
+  }
+
+DebugCompactWriter &operator<<(DebugCompactWriter& s, const SetupInterfaceByName& i)
+  {
+  return s << i.id << i.typeName;
+  }
+
+DebugCompactReader &operator>>(DebugCompactReader& s, SetupInterfaceByName& i)
   {
   return s >> i.id >> i.typeName;
   }
 
+struct SetupInterface
+  {
+  enum
+    {
+    DebugMessageType = 4
+    };
+  xuint32 id;
+  xuint32 typeHash;
+  // empty once the type has been named this session.
+  QString typeName;
+  };
+
+template <> struct DebugCompactEncoding<SetupInterface>
+  {
+  enum
+    {
+    Enabled = 1
+    };
+  };
+
+QDataStream &operator<<(QDataStream& s, const SetupInterface& i)
+  {
+  return s << i.id << i.typeHash << i.typeName;
+  }
+
+QDataStream &operator>>(QDataStream& s, SetupInterface& i)
+  {
+  return s >> i.id >> i.typeHash >> i.typeName;
+  }
+
+DebugCompactWriter &operator<<(DebugCompactWriter& s, const SetupInterface& i)
+  {
+  return s << i.id << i.typeHash << i.typeName;
+  }
+
+DebugCompactReader &operator>>(DebugCompactReader& s, SetupInterface& i)
+  {
+  return s >> i.id >> i.typeHash >> i.typeName;
+  }
+
+struct CompressionStart
+  {
+  enum
+    {
+    DebugMessageType = 3
+    };
+  };
+
+struct GrantCredit
+  {
+  enum
+    {
+    DebugMessageType = 5
+    };
+  xuint64 bytes;
+  };
+
+QDataStream &operator<<(QDataStream& s, const GrantCredit& g)
+  {
+  return s << g.bytes;
+  }
+
+QDataStream &operator>>(QDataStream& s, GrantCredit& g)
+  {
+  return s >> g.bytes;
+  }
+
+struct SetSendLimit
+  {
+  enum
+    {
+    DebugMessageType = 6
+    };
+  xuint32 id;
+  DebugManager::SendLimit limit;
+  };
+
+QDataStream &operator<<(QDataStream& s, const SetSendLimit& l)
+  {
+  return s << l.id << l.limit.rate << l.limit.burst << l.limit.sampleInterval;
+  }
+
+QDataStream &operator>>(QDataStream& s, SetSendLimit& l)
+  {
+  return s >> l.id >> l.limit.rate >> l.limit.burst >> l.limit.sampleInterval;
+  }
+
+struct InterfaceStatistics
+  {
+  enum
+    {
+    DebugMessageType = 7
+    };
+
+  struct Entry
+    {
+    xuint32 id;
+    DebugManager::SendStatistics stats;
+    };
+  QVector<Entry> entries;
+  };
+
+QDataStream &operator<<(QDataStream& s, const InterfaceStatistics& i)
+  {
+  s << (xuint32)i.entries.size();
+  xForeach(const InterfaceStatistics::Entry &e, i.entries)
+    {
+    s << e.id << e.stats.sent << e.stats.dropped;
+    }
+  return s;
+  }
+
+QDataStream &operator>>(QDataStream& s, InterfaceStatistics& i)
+  {
+  xuint32 count = 0;
+  s >> count;
+
+  i.entries.clear();
+  for(xuint32 n = 0; n < count && s.status() == QDataStream::Ok; ++n)
+    {
+    InterfaceStatistics::Entry e;
+    s >> e.id >> e.stats.sent >> e.stats.dropped;
+    i.entries << e;
+    }
+  return s;
+  }
+
+struct InterfaceState
+  {
+  enum
+    {
+    DebugMessageType = 8
+    };
+  xuint32 id;
+  // the interface's message, its type and then its data.
+  QByteArray message;
+  };
+
+QDataStream &operator<<(QDataStream& s, const InterfaceState& i)
+  {
+  return s << i.id << i.message;
+  }
+
+QDataStream &operator>>(QDataStream& s, InterfaceState& i)
+  {
+  return s >> i.id >> i.message;
+  }
+
+QDataStream &operator<<(QDataStream& s, const CompressionStart&)
+  {
+  return s;
+  }
+
+QDataStream &operator>>(QDataStream& s, CompressionStart&)
+  {
+  return s;
+  }
+
+namespace
+{
+
+template <typename T> void writeSnapshotFrame(QDataStream &s, const T &msg)
+  {
+  QIODevice *dev = s.device();
+  const qint64 start = dev->pos();
+
+  // the controller's id, then a length backpatched once the message is written.
+  s << (xuint32)0 << (xuint32)0 << (xuint8)T::DebugMessageType;
+  detail::DebugMessageCodec<T>::write(s, msg);
+
+  const qint64 end = dev->pos();
+  dev->seek(start + sizeof(xuint32));
+  s << (xuint32)(end - start - 2 * sizeof(xuint32));
+  dev->seek(end);
+  }
+
+}
+
 DebugController::DebugController(DebugManager *m, bool client)
     : _createdInterfaces(Eks::Core::defaultAllocator())
   {
   _manager = m;
   _isClient = client;
+  _remoteVersion = 0;
   _maxInteface = 0;
   setInterfaceID(0);
 
   static Reciever recv[] =
     {
     recieveFunction<Init, DebugController, &DebugController::onInit>(),
-    recieveFunction<SetupInterface, DebugController, &DebugController::onSetupInterface>()
+    recieveFunction<SetupInterfaceByName, DebugController, &DebugController::onSetupInterfaceByName>(),
+    recieveFunction<SetupInterface, DebugController, &DebugController::onSetupInterface>(),
+    recieveFunction<CompressionStart, DebugController, &DebugController::onCompressionStart>(),
+    recieveFunction<GrantCredit, DebugController, &DebugController::onGrantCredit>(),
+    recieveFunction<SetSendLimit, DebugController, &DebugController::onSetSendLimit>(),
+    recieveFunction<InterfaceStatistics, DebugController, &DebugController::onInterfaceStatistics>(),
+    recieveFunction<InterfaceState, DebugController, &DebugController::onInterfaceState>()
     };
 
-  setRecievers(recv, X_ARRAY_COUNT(recv));
+  static const DispatchTable dispatch(recv, X_ARRAY_COUNT(recv));
+  setRecievers(dispatch);
   }
 
 DebugController::~DebugController()
   {
   xForeach(DebugInterface *ifc, _createdInterfaces)
     {
-    const DebugInterfaceType *def = DebugManager::findInterfaceType(ifc->typeName());
+    const DebugInterfaceType *def = DebugManager::findInterfaceType(ifc->typeHash());
 
     DebugManager::unregisterInterface(ifc);
     def->destroy(ifc);
@@ -83,45 +322,211 @@ void DebugController::onDebuggerConnected(bool client)
     {
     Init init;
     init.version = VERSION;
+    init.capabilities = DebugManager::capabilities();
     sendData(init);
     }
   }
 
-void DebugController::setupInterface(DebugInterface *ifc)
+QByteArray DebugController::setupSnapshot(const Eks::Vector<DebugInterface *> &interfaces)
   {
-  xAssert(ifc->interfaceID() == std::numeric_limits<xuint32>::max());
-  ifc->setInterfaceID(++_maxInteface);
+  QByteArray snapshot;
+  QDataStream s(&snapshot, QIODevice::WriteOnly);
+
+  // the snapshot is read uncompressed, whatever the live stream does.
+  Init init;
+  init.version = VERSION;
+  init.capabilities = DebugManager::capabilities() & ~NegotiatedCapabilities;
+  writeSnapshotFrame(s, init);
+
+  xForeach(DebugInterface *ifc, interfaces)
+    {
+    if(!ifc || ifc == this)
+      {
+      continue;
+      }
+
+    SetupInterface setup;
+    setup.id = ifc->interfaceID();
+    setup.typeHash = ifc->typeHash();
+    setup.typeName = ifc->typeName();
+    writeSnapshotFrame(s, setup);
+    }
+
+  std::lock_guard<std::mutex> lock(_stateLock);
+  xForeach(const auto &sent, _state)
+    {
+    InterfaceState state;
+    state.id = sent.first->interfaceID();
+    state.message = sent.second;
+    writeSnapshotFrame(s, state);
+    }
+
+  return snapshot;
+  }
+
+xuint32 DebugController::allocateInterfaceID()
+  {
+  return ++_maxInteface;
+  }
+
+void DebugController::announceInterface(DebugInterface *ifc)
+  {
+  xAssert(ifc->interfaceID() < DebugInterface::PendingInterfaceID);
 
   SetupInterface setup;
-  setup.typeName = ifc->typeName();
   setup.id = ifc->interfaceID();
+  setup.typeHash = ifc->typeHash();
+  if(!_typeNames.contains(setup.typeHash))
+    {
+    setup.typeName = ifc->typeName();
+    _typeNames.insert(setup.typeHash, setup.typeName);
+    }
   sendData(setup);
   }
 
+QByteArray DebugController::compressionStartFrame()
+  {
+  QByteArray frame;
+  QDataStream s(&frame, QIODevice::WriteOnly);
+  writeSnapshotFrame(s, CompressionStart());
+  return frame;
+  }
+
+void DebugController::sendCredit(xuint64 bytes)
+  {
+  GrantCredit grant;
+  grant.bytes = bytes;
+  sendData(grant);
+  }
+
+void DebugController::sendSendLimit(DebugInterface *ifc, const DebugManager::SendLimit &limit)
+  {
+  xAssert(!_isClient);
+  if(_remoteVersion < SEND_LIMIT_VERSION)
+    {
+    qWarning() << "Client is too old to limit" << ifc->typeName();
+    return;
+    }
+
+  SetSendLimit msg;
+  msg.id = ifc->interfaceID();
+  msg.limit = limit;
+  sendData(msg);
+  }
+
+void DebugController::sendInterfaceStatistics(const Eks::Vector<DebugInterface *> &interfaces)
+  {
+  InterfaceStatistics msg;
+  xForeach(DebugInterface *ifc, interfaces)
+    {
+    if(!ifc || ifc == this)
+      {
+      continue;
+      }
+
+    InterfaceStatistics::Entry entry;
+    entry.id = ifc->interfaceID();
+    entry.stats = ifc->sendStatistics();
+    msg.entries << entry;
+    }
+
+  if(!msg.entries.isEmpty())
+    {
+    sendData(msg);
+    }
+  }
+
+void DebugController::sendInterfaceState(DebugInterface *ifc, const QByteArray &message)
+  {
+  xAssert(_isClient);
+
+  InterfaceState state;
+  state.id = ifc->interfaceID();
+  state.message = message;
+
+  // kept before it is staged, a snapshot taken meanwhile either holds it or precedes it.
+    {
+    std::lock_guard<std::mutex> lock(_stateLock);
+    _state << qMakePair(ifc, message);
+    }
+
+  sendData(state);
+  }
+
+void DebugController::forgetState(DebugInterface *ifc)
+  {
+  std::lock_guard<std::mutex> lock(_stateLock);
+  for(int i = _state.size() - 1; i >= 0; --i)
+    {
+    if(_state[i].first == ifc)
+      {
+      _state.remove(i);
+      }
+    }
+  }
+
 void DebugController::onInit(const Init &i)
   {
+  if(_isClient)
+    {
+    // the server's answer, negotiated capabilities start only once both ends agree.
+    DebugManager::setAcceptedCapabilities(i.capabilities);
+    return;
+    }
+
   qDebug() << "Debugger Connected";
 
-  if(i.version != VERSION)
+  if(i.version < 1 || i.version > VERSION)
     {
     qWarning() << "Invalid client version";
     }
+
+  _remoteVersion = i.version;
+
+  // the client encodes with these from its first message, follow it.
+  DebugManager::setRemoteCapabilities(i.capabilities);
+
+  // older clients never expect an answer, and only negotiated capabilities need one.
+  if(i.capabilities & NegotiatedCapabilities)
+    {
+    Init accepted;
+    accepted.version = VERSION;
+    accepted.capabilities = i.capabilities & AcceptedCapabilities;
+    sendData(accepted);
+
+    DebugManager::setAcceptedCapabilities(accepted.capabilities);
+    }
+  }
+
+void DebugController::onSetupInterfaceByName(const SetupInterfaceByName &ifcDesc)
+  {
+  SetupInterface setup;
+  setup.id = ifcDesc.id;
+  setup.typeHash = detail::debugTypeHash(ifcDesc.typeName.toUtf8().constData());
+  setup.typeName = ifcDesc.typeName;
+  onSetupInterface(setup);
   }
 
 void DebugController::onSetupInterface(const SetupInterface &ifcDesc)
   {
-  const DebugInterfaceType *def = DebugManager::findInterfaceType(ifcDesc.typeName);
+  if(!ifcDesc.typeName.isEmpty())
+    {
+    _typeNames.insert(ifcDesc.typeHash, ifcDesc.typeName);
+    }
 
+  const DebugInterfaceType *def = DebugManager::findInterfaceType(ifcDesc.typeHash);
   if(!def)
     {
     xAssertFail();
-    qCritical() << "Interface" << ifcDesc.typeName << "not registered";
+    qCritical() << "Interface" << _typeNames.value(ifcDesc.typeHash) << ifcDesc.typeHash << "not registered";
+    return;
     }
 
   DebugInterface *ifc = def->create(_manager, _isClient);
   if(!ifc)
     {
     qCritical() << "Creation of interface" << def->type << "failed";
+    return;
     }
 
   ifc->setInterfaceID(ifcDesc.id);
@@ -130,4 +535,50 @@ void DebugController::onSetupInterface(const SetupInterface &ifcDesc)
   _createdInterfaces << ifc;
   }
 
+void DebugController::onCompressionStart(const CompressionStart &)
+  {
+  DebugManager::beginDecompression();
+  }
+
+void DebugController::onGrantCredit(const GrantCredit &g)
+  {
+  DebugManager::grantCredit(g.bytes);
+  }
+
+void DebugController::onSetSendLimit(const SetSendLimit &l)
+  {
+  DebugInterface *ifc = DebugManager::findInterface(l.id);
+  if(!ifc || ifc == this)
+    {
+    qWarning() << "Send limit requested for unknown interface" << l.id;
+    return;
+    }
+
+  ifc->setSendLimit(l.limit);
+  }
+
+void DebugController::onInterfaceState(const InterfaceState &i)
+  {
+  DebugInterface *ifc = DebugManager::findInterface(i.id);
+  if(!ifc || ifc == this)
+    {
+    qWarning() << "State recieved for unknown interface" << i.id;
+    return;
+    }
+
+  QDataStream s(i.message);
+  ifc->onDataRecieved(s);
+  }
+
+void DebugController::onInterfaceStatistics(const InterfaceStatistics &i)
+  {
+  xForeach(const InterfaceStatistics::Entry &e, i.entries)
+    {
+    if(DebugInterface *ifc = DebugManager::findInterface(e.id))
+      {
+      ifc->setSendStatistics(e.stats);
+      }
+    }
+  }
+
 }
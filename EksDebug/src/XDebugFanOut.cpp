@@ -0,0 +1,207 @@
+#include "XDebugFanOut.h"
+#include "Utilities/XAssert.h"
+#include "Math/XMathHelpers.h"
+#include "QIODevice"
+#include "QDebug"
+
+namespace Eks
+{
+
+DebugFanOut::DebugFanOut()
+    : _end(0),
+      _backlogLimit(DefaultBacklogLimit),
+      _droppedSubscribers(0)
+  {
+  }
+
+DebugFanOut::~DebugFanOut()
+  {
+  clear();
+  }
+
+void DebugFanOut::clear()
+  {
+  while(!_subscribers.isEmpty())
+    {
+    QIODevice *device = _subscribers.takeLast().device;
+    disconnect(device, 0, this, 0);
+    delete device;
+    }
+
+  _blocks.clear();
+  }
+
+void DebugFanOut::addSubscriber(QIODevice *device, const QByteArray &snapshot)
+  {
+  xAssert(device && device->isOpen());
+
+  Subscriber sub;
+  sub.device = device;
+  sub.position = _end;
+  sub.snapshot = snapshot;
+  sub.snapshotWritten = 0;
+  _subscribers << sub;
+
+  connect(device, SIGNAL(bytesWritten(qint64)), this, SLOT(pump()));
+  connect(device, &QIODevice::aboutToClose, this, [this, device]() { removeDevice(device); });
+  }
+
+DebugManager::SubscriberStatistics DebugFanOut::statistics() const
+  {
+  DebugManager::SubscriberStatistics stats;
+  stats.subscribers = _subscribers.size();
+  stats.droppedSubscribers = _droppedSubscribers;
+  stats.bufferedBytes = 0;
+  stats.largestBacklog = 0;
+
+  xForeach(const Block &block, _blocks)
+    {
+    stats.bufferedBytes += block.data.size();
+    }
+
+  xForeach(const Subscriber &sub, _subscribers)
+    {
+    stats.largestBacklog = xMax(stats.largestBacklog, _end - sub.position);
+    }
+
+  return stats;
+  }
+
+void DebugFanOut::append(const char *data, xsize size)
+  {
+  if(_subscribers.isEmpty())
+    {
+    // nobody will read it, skip ahead.
+    _end += size;
+    return;
+    }
+
+  while(size)
+    {
+    if(_blocks.isEmpty() || (xsize)_blocks.last().data.size() == BlockSize)
+      {
+      Block block;
+      block.start = _end;
+      block.data.reserve(BlockSize);
+      _blocks << block;
+      }
+
+    QByteArray &last = _blocks.last().data;
+    const xsize run = xMin(size, BlockSize - (xsize)last.size());
+    last.append(data, (int)run);
+
+    _end += run;
+    data += run;
+    size -= run;
+    }
+  }
+
+void DebugFanOut::pump()
+  {
+  for(int i = 0; i < _subscribers.size();)
+    {
+    Subscriber &sub = _subscribers[i];
+    if(!write(sub) || _end - sub.position > _backlogLimit)
+      {
+      drop(i);
+      continue;
+      }
+    ++i;
+    }
+
+  releaseBlocks();
+  }
+
+bool DebugFanOut::write(Subscriber &sub)
+  {
+  QIODevice *device = sub.device;
+
+  if(sub.snapshotWritten < (xsize)sub.snapshot.size())
+    {
+    const qint64 written = device->write(
+      sub.snapshot.constData() + sub.snapshotWritten,
+      sub.snapshot.size() - sub.snapshotWritten);
+    if(written < 0)
+      {
+      return false;
+      }
+
+    sub.snapshotWritten += written;
+    if(sub.snapshotWritten < (xsize)sub.snapshot.size())
+      {
+      return true;
+      }
+    sub.snapshot = QByteArray();
+    }
+
+  // blocks are contiguous in stream position, find the one holding this subscriber's.
+  int index = 0;
+  while(index < _blocks.size() && _blocks[index].start + _blocks[index].data.size() <= sub.position)
+    {
+    ++index;
+    }
+
+  for(; index < _blocks.size() && device->bytesToWrite() < WriteHighWater; ++index)
+    {
+    const Block &block = _blocks[index];
+    const xsize offset = sub.position - block.start;
+    const qint64 written = device->write(block.data.constData() + offset, block.data.size() - offset);
+    if(written < 0)
+      {
+      return false;
+      }
+
+    sub.position += written;
+    if(offset + written < (xsize)block.data.size())
+      {
+      break;
+      }
+    }
+
+  return true;
+  }
+
+void DebugFanOut::drop(int index)
+  {
+  QIODevice *device = _subscribers[index].device;
+  qWarning() << "Dropping debug subscriber" << _end - _subscribers[index].position << "bytes behind";
+
+  _subscribers.removeAt(index);
+  ++_droppedSubscribers;
+
+  disconnect(device, 0, this, 0);
+  device->close();
+  device->deleteLater();
+  }
+
+void DebugFanOut::removeDevice(QIODevice *device)
+  {
+  for(int i = 0; i < _subscribers.size(); ++i)
+    {
+    if(_subscribers[i].device == device)
+      {
+      _subscribers.removeAt(i);
+      disconnect(device, 0, this, 0);
+      device->deleteLater();
+      break;
+      }
+    }
+
+  releaseBlocks();
+  }
+
+void DebugFanOut::releaseBlocks()
+  {
+  xuint64 oldest = _end;
+  xForeach(const Subscriber &sub, _subscribers)
+    {
+    oldest = xMin(oldest, sub.position);
+    }
+
+  while(!_blocks.isEmpty() && _blocks.first().start + _blocks.first().data.size() <= oldest)
+    {
+    _blocks.removeFirst();
+    }
+  }
+
+}
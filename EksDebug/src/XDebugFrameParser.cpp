@@ -0,0 +1,102 @@
+#include "XDebugFrameParser.h"
+#include "Utilities/XAssert.h"
+#include "Math/XMathHelpers.h"
+#include "QtEndian"
+#include <cstring>
+
+namespace Eks
+{
+
+DebugFrameParser::DebugFrameParser()
+    : _buffer(InitialCapacity),
+      _state(ReadingHeader),
+      _frameID(0),
+      _frameLength(0),
+      _stream(&_view)
+  {
+  }
+
+bool DebugFrameParser::nextFrame(Frame &frame)
+  {
+  if(_state == ReadingHeader)
+    {
+    if(_buffer.size() < HeaderSize)
+      {
+      return false;
+      }
+
+    const uchar *header = (const uchar *)_buffer.data();
+    _frameID = qFromBigEndian<xuint32>(header);
+    _frameLength = qFromBigEndian<xuint32>(header + sizeof(xuint32));
+    _buffer.consume(HeaderSize);
+    _state = ReadingPayload;
+    }
+
+  if(_buffer.size() < _frameLength)
+    {
+    return false;
+    }
+
+  frame.id = _frameID;
+  frame.data = _buffer.data();
+  frame.size = _frameLength;
+
+  _buffer.consume(_frameLength);
+  _state = ReadingHeader;
+  return true;
+  }
+
+QDataStream &DebugFrameParser::stream(const Frame &frame)
+  {
+  _view.reset(frame.data, frame.size);
+  _stream.resetStatus();
+  return _stream;
+  }
+
+void DebugFrameParser::takeUnparsed(DebugReceiveBuffer &dst)
+  {
+  xAssert(_state == ReadingHeader);
+  dst.append(_buffer.data(), _buffer.size());
+  _buffer.truncate(0);
+  }
+
+void DebugFrameParser::clear()
+  {
+  _buffer.clear();
+  _state = ReadingHeader;
+  }
+
+DebugFrameParser::View::View()
+    : _data(0),
+      _size(0),
+      _read(0)
+  {
+  open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+  }
+
+void DebugFrameParser::View::reset(const char *data, xsize size)
+  {
+  _data = data;
+  _size = size;
+  _read = 0;
+  }
+
+qint64 DebugFrameParser::View::bytesAvailable() const
+  {
+  return (_size - _read) + QIODevice::bytesAvailable();
+  }
+
+qint64 DebugFrameParser::View::readData(char *data, qint64 len)
+  {
+  const xsize count = xMin((xsize)len, _size - _read);
+  memcpy(data, _data + _read, count);
+  _read += count;
+  return count;
+  }
+
+qint64 DebugFrameParser::View::writeData(const char *, qint64)
+  {
+  return -1;
+  }
+
+}
@@ -2,6 +2,8 @@
 #include "Math/XMathHelpers.h"
 #include "QDataStream"
 #include "QDebug"
+#include <chrono>
+#include <cstring>
 
 namespace Eks
 {
@@ -17,9 +19,26 @@ DebugInterface::OutputTunnel::~OutputTunnel()
   }
 
 DebugInterface::DebugInterface()
-    : _interfaceID(Eks::maxFor(_interfaceID)),
-      _dataModel(0)
+    : _dataModel(0),
+      _dispatch(0),
+      _flowControlPolicy(DebugManager::FlowControlPolicy::Block),
+      _sampleInterval(1),
+      _sampleCounter(0),
+      _sendLimited(false),
+      _sendSampleInterval(1),
+      _sendSampleCounter(0),
+      _emissionInterval(0),
+      _burstTolerance(0),
+      _theoreticalArrival(0),
+      _droppedMessages(0),
+      _sentMessages(0),
+      _sentBytes(0),
+      _counterSlot(NoCounterSlot),
+      _interfaceID(InvalidInterfaceID),
+      _pendingID(InvalidInterfaceID),
+      _nextPendingSetup(0)
   {
+  memset(&_sendLimit, 0, sizeof(_sendLimit));
   DebugManager::registerInterface(this);
   }
 
@@ -28,27 +47,92 @@ DebugInterface::~DebugInterface()
   DebugManager::unregisterInterface(this);
   }
 
-void DebugInterface::setRecievers(const Reciever *r, xsize c)
+void DebugInterface::setFlowControlPolicy(DebugManager::FlowControlPolicy policy, xuint32 sampleInterval)
   {
-  _recievers = r;
-  _recieverCount = c;
+  _flowControlPolicy = policy;
+  _sampleInterval = xMax(sampleInterval, (xuint32)1);
   }
 
-void DebugInterface::onDataRecieved(QDataStream& data)
+void DebugInterface::setSendLimit(const DebugManager::SendLimit &limit)
   {
-  xuint8 id;
-  data >> id;
+  static const xint64 NanosecondsPerSecond = 1000000000;
+
+  _sendLimit = limit;
+
+  const xuint32 interval = xMax(limit.sampleInterval, (xuint32)1);
+  const xint64 emission = limit.rate ? NanosecondsPerSecond / limit.rate : 0;
+  _sendSampleInterval.store(interval, std::memory_order_relaxed);
+  _emissionInterval.store(emission, std::memory_order_relaxed);
+  _burstTolerance.store(emission * (xMax(limit.burst, (xuint32)1) - 1), std::memory_order_relaxed);
+  _theoreticalArrival.store(0, std::memory_order_relaxed);
+
+  _sendLimited.store(interval > 1 || emission, std::memory_order_relaxed);
+  }
+
+DebugManager::SendStatistics DebugInterface::sendStatistics() const
+  {
+  DebugManager::SendStatistics stats;
+  stats.sent = DebugManager::sentMessages(this);
+  stats.dropped = _droppedMessages.load(std::memory_order_relaxed);
+  return stats;
+  }
+
+void DebugInterface::setSendStatistics(const DebugManager::SendStatistics &stats)
+  {
+  // sends are counted per thread, only the offset applied to their sum can be reset.
+  const xuint64 sent = DebugManager::sentMessages(this);
+  _sentMessages.fetch_add(stats.sent - sent, std::memory_order_relaxed);
+  _droppedMessages.store(stats.dropped, std::memory_order_relaxed);
+  }
+
+bool DebugInterface::admitSend()
+  {
+  const xuint32 interval = _sendSampleInterval.load(std::memory_order_relaxed);
+  if(interval > 1 && _sendSampleCounter.fetch_add(1, std::memory_order_relaxed) % interval != 0)
+    {
+    _droppedMessages.fetch_add(1, std::memory_order_relaxed);
+    return false;
+    }
+
+  const xint64 emission = _emissionInterval.load(std::memory_order_relaxed);
+  if(!emission)
+    {
+    return true;
+    }
 
-  for(xsize i = 0; i < _recieverCount; ++i)
+  // the bucket holds [burst] messages, each send pushes the time it is empty again on
+  // by one emission interval. A send too far ahead of now finds the bucket empty.
+  const xint64 now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+  const xint64 tolerance = _burstTolerance.load(std::memory_order_relaxed);
+
+  xint64 arrival = _theoreticalArrival.load(std::memory_order_relaxed);
+  for(;;)
     {
-    const Reciever &r = _recievers[i];
+    const xint64 start = xMax(arrival, now);
+    if(start - now > tolerance)
+      {
+      _droppedMessages.fetch_add(1, std::memory_order_relaxed);
+      return false;
+      }
 
-    if(r.type == id)
+    if(_theoreticalArrival.compare_exchange_weak(arrival, start + emission, std::memory_order_relaxed))
       {
-      r.fn(id, this, data);
-      return;
+      return true;
       }
     }
+  }
+
+void DebugInterface::onDataRecieved(QDataStream& data)
+  {
+  xuint8 id;
+  data >> id;
+
+  if(Reciever::RecieveFunction fn = _dispatch ? _dispatch->find(id) : 0)
+    {
+    fn(id, this, data);
+    return;
+    }
 
   xAssertFail();
   qWarning() << "Unknown message type recieved";
@@ -1,15 +1,268 @@
-#if 0
 #include "XDebugLogger.h"
 #include "QDataStream"
 #include "QDebug"
-#include "QtGui/QStandardItemModel"
-#include "Containers/XVector.h"
-#include "QtWidgets/QApplication"
 #include "QThread"
+#include "QtEndian"
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <mutex>
 
 namespace Eks
 {
 
+/// \brief A thread's events, waiting for the drain thread.
+/// \note  Only the recording thread stores the write positions, only the drain thread
+///        stores the read positions.
+class DebugEventRing
+  {
+public:
+  DebugEventRing(xuint64 t)
+      : thread(t),
+        write(0),
+        read(0),
+        dropped(0),
+        logWrite(0),
+        logRead(0),
+        logDropped(0),
+        nextDuration(0),
+        next(0)
+    {
+    }
+
+  const xuint64 thread;
+  std::atomic<xuint64> write;
+  std::atomic<xuint64> read;
+  std::atomic<xuint64> dropped;
+
+  // in bytes, records are contiguous but for wrapping.
+  std::atomic<xuint64> logWrite;
+  std::atomic<xuint64> logRead;
+  std::atomic<xuint64> logDropped;
+
+  xuint32 nextDuration;
+
+  DebugEventRing *next;
+  DebugLogger::Event events[DebugLogger::EventRingCapacity];
+  char logBytes[DebugLogger::LogRingCapacity];
+  };
+
+namespace
+{
+
+// a value only one thread writes, readers on other threads just need a whole value.
+inline void bump(std::atomic<xuint64> &value, xuint64 delta)
+  {
+  value.store(value.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+  }
+
+std::atomic<DebugLogger *> g_logger(0);
+std::atomic<xuint32> g_generation(0);
+
+// every location recorded, indexed by id.
+std::mutex g_locationsLock;
+QVector<DebugLogger::Location *> g_locations;
+std::atomic<xuint32> g_locationCount(0);
+
+QtMessageHandler g_oldHandler;
+// Qt messages are recorded already formatted, as the single argument.
+DebugLogger::Location g_qtMessageLocation = { "", "", 0, "%1", { DebugLogger::InvalidLocation } };
+
+void copyToRing(char *ring, xuint64 position, const char *data, xsize size)
+  {
+  const xsize start = (xsize)(position % DebugLogger::LogRingCapacity);
+  const xsize first = xMin(size, (xsize)DebugLogger::LogRingCapacity - start);
+  memcpy(ring + start, data, first);
+  memcpy(ring, data + first, size - first);
+  }
+
+void copyFromRing(const char *ring, xuint64 position, char *data, xsize size)
+  {
+  const xsize start = (xsize)(position % DebugLogger::LogRingCapacity);
+  const xsize first = xMin(size, (xsize)DebugLogger::LogRingCapacity - start);
+  memcpy(data, ring + start, first);
+  memcpy(data + first, ring, size - first);
+  }
+
+QString levelName(xuint32 level)
+  {
+  static const QString statuses[] =
+    {
+    "Debug",
+    "Warning",
+    "Critical",
+    "Fatal",
+    "System"
+    };
+
+  if(level < X_ARRAY_COUNT(statuses))
+    {
+    return statuses[level];
+    }
+  return QStringLiteral("Log");
+  }
+
+/// Decode the whole records in [data], stopping at the first malformed one.
+void parseLogRecords(const char *data, xsize size, QVector<DebugLogger::LogRecordList::Record> &records)
+  {
+  typedef DebugLogger::LogArgumentType Type;
+  const xsize HeaderSize = DebugLogger::LogRecord::HeaderSize;
+
+  xsize pos = 0;
+  while(size - pos >= HeaderSize)
+    {
+    const uchar *header = (const uchar *)data + pos;
+    const xuint32 recordSize = qFromLittleEndian<xuint32>(header);
+    if(recordSize < HeaderSize || recordSize > size - pos)
+      {
+      return;
+      }
+
+    DebugLogger::LogRecordList::Record r;
+    r.location = qFromLittleEndian<xuint32>(header + sizeof(xuint32));
+    r.time = qFromLittleEndian<xint64>(header + sizeof(xuint32) * 2);
+    r.level = header[sizeof(xuint32) * 2 + sizeof(xint64)];
+
+    const xsize end = pos + recordSize;
+    xsize arg = pos + HeaderSize;
+    while(arg < end)
+      {
+      const Type type = (Type)data[arg++];
+      const uchar *value = (const uchar *)data + arg;
+
+      if(type == Type::String || type == Type::Utf16String)
+        {
+        if(end - arg < sizeof(xuint32))
+          {
+          break;
+          }
+        const xsize count = qFromLittleEndian<xuint32>(value);
+        const xsize unit = type == Type::String ? 1 : sizeof(xuint16);
+        arg += sizeof(xuint32);
+        if(count > (end - arg) / unit)
+          {
+          break;
+          }
+
+        if(type == Type::String)
+          {
+          r.arguments << QString::fromUtf8(data + arg, (int)count);
+          }
+        else
+          {
+          QString str((int)count, Qt::Uninitialized);
+          for(xsize i = 0; i < count; ++i)
+            {
+            str[(int)i] = QChar(qFromLittleEndian<xuint16>((const uchar *)data + arg + i * unit));
+            }
+          r.arguments << str;
+          }
+        arg += count * unit;
+        continue;
+        }
+
+      if(end - arg < sizeof(xuint64))
+        {
+        break;
+        }
+      const xuint64 v = qFromLittleEndian<xuint64>(value);
+      arg += sizeof(xuint64);
+
+      if(type == Type::Signed)
+        {
+        r.arguments << QVariant((qlonglong)v);
+        }
+      else if(type == Type::Unsigned)
+        {
+        r.arguments << QVariant((qulonglong)v);
+        }
+      else if(type == Type::Double)
+        {
+        double d;
+        memcpy(&d, &v, sizeof(d));
+        r.arguments << QVariant(d);
+        }
+      else if(type == Type::Pointer)
+        {
+        r.arguments << QVariant(QStringLiteral("0x") + QString::number(v, 16));
+        }
+      else
+        {
+        break;
+        }
+      }
+
+    records << r;
+    pos = end;
+    }
+  }
+
+}
+
+bool DebugLogger::LogRecord::reserve(xsize size)
+  {
+  return _size + size <= MaxLogRecordSize;
+  }
+
+void DebugLogger::LogRecord::addValue(LogArgumentType type, xuint64 v)
+  {
+  if(!reserve(1 + sizeof(xuint64)))
+    {
+    return;
+    }
+
+  _data[_size++] = (char)type;
+  qToLittleEndian<xuint64>(v, (uchar *)_data + _size);
+  _size += sizeof(xuint64);
+  }
+
+void DebugLogger::LogRecord::addDouble(double v)
+  {
+  xuint64 bits;
+  memcpy(&bits, &v, sizeof(bits));
+  addValue(LogArgumentType::Double, bits);
+  }
+
+void DebugLogger::LogRecord::add(const char *v)
+  {
+  if(!reserve(1 + sizeof(xuint32)))
+    {
+    return;
+    }
+
+  const xsize length = v ? strlen(v) : 0;
+  const xsize count = xMin(length, (xsize)MaxLogRecordSize - _size - 1 - sizeof(xuint32));
+
+  _data[_size++] = (char)LogArgumentType::String;
+  qToLittleEndian<xuint32>((xuint32)count, (uchar *)_data + _size);
+  _size += sizeof(xuint32);
+  memcpy(_data + _size, v, count);
+  _size += count;
+  }
+
+void DebugLogger::LogRecord::add(const QString &v)
+  {
+  if(!reserve(1 + sizeof(xuint32)))
+    {
+    return;
+    }
+
+  const xsize count = xMin((xsize)v.size(), ((xsize)MaxLogRecordSize - _size - 1 - sizeof(xuint32)) / sizeof(xuint16));
+
+  _data[_size++] = (char)LogArgumentType::Utf16String;
+  qToLittleEndian<xuint32>((xuint32)count, (uchar *)_data + _size);
+  _size += sizeof(xuint32);
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+  memcpy(_data + _size, v.utf16(), count * sizeof(xuint16));
+#else
+  for(xsize i = 0; i < count; ++i)
+    {
+    qToLittleEndian<xuint16>(v.utf16()[i], (uchar *)_data + _size + i * sizeof(xuint16));
+    }
+#endif
+  _size += count * sizeof(xuint16);
+  }
+
 QDataStream &operator<<(QDataStream &s, const DebugLogger::LogEntry &l)
   {
   return s << l.time << (xuint64)l.thread << l.level << l.entry;
@@ -20,211 +273,715 @@ QDataStream &operator>>(QDataStream &s, DebugLogger::LogEntry &l)
   xuint64 thr;
   s >> l.time >> thr >> l.level >> l.entry;
   l.thread = (void*)thr;
+  l.timeKnown = true;
   return s;
   }
 
-QDataStream &operator<<(QDataStream &s, const ThreadEventLogger::EventItem &l)
+DebugCompactWriter &operator<<(DebugCompactWriter &s, const DebugLogger::LogEntry &l)
   {
-  return s << l.time << (const xuint8&)l.type << l.location << l.id;
+  const xuint64 thr = (xuint64)l.thread;
+  s.writeUnsigned(thr);
+  s.writeThreadTime(thr, l.time.nanoseconds());
+  s.writeUnsigned(l.level);
+  s.writeString(l.entry);
+  return s;
   }
 
-QDataStream &operator>>(QDataStream &s, ThreadEventLogger::EventItem &l)
+DebugCompactReader &operator>>(DebugCompactReader &s, DebugLogger::LogEntry &l)
   {
-  s >> l.time >> (xuint8&)l.type >> l.location >> l.id;
-
+  const xuint64 thr = s.readUnsigned();
+  xint64 ns = 0;
+  l.timeKnown = s.readThreadTime(thr, ns);
+  l.time.set(ns / 1000000000, ns % 1000000000);
+  l.thread = (void*)thr;
+  l.level = (xuint32)s.readUnsigned();
+  l.entry = s.readString();
   return s;
   }
 
-QDataStream &operator<<(QDataStream &s, const EventLogger::LocationReference &l)
+QDataStream &operator<<(QDataStream &s, const DebugLogger::EventList &l)
   {
-  return s << l.id << l.data << l.file << l.function << l.line;
+  s << l.thread << (xuint32)(l.spanSizes[0] + l.spanSizes[1]);
+  for(xsize span = 0; span < X_ARRAY_COUNT(l.spans); ++span)
+    {
+    for(xsize i = 0; i < l.spanSizes[span]; ++i)
+      {
+      const DebugLogger::Event &e = l.spans[span][i];
+      s << e.time << e.location << e.id << (xuint8)e.type;
+      }
+    }
+  return s;
   }
 
-QDataStream &operator>>(QDataStream &s, DebugLogger::DebugLocationWithData &l)
+QDataStream &operator>>(QDataStream &s, DebugLogger::EventList &l)
   {
-  auto readStr = [&s]()
+  xuint32 count;
+  s >> l.thread >> count;
+
+  l.events.clear();
+  for(xuint32 i = 0; i < count && s.status() == QDataStream::Ok; ++i)
     {
-    quint32 len;
-    s >> len;
+    DebugLogger::Event e;
+    xuint8 type;
+    s >> e.time >> e.location >> e.id >> type;
+    e.type = (DebugLogger::EventType)type;
+    l.events << e;
+    }
+  return s;
+  }
 
-    char *data = (char *)alloca(len);
-    s.readRawData(data, len);
+// times are sent as deltas within the frame, the drain thread isn't the recording thread,
+// so writeThreadTime's per thread state doesn't apply.
+DebugCompactWriter &operator<<(DebugCompactWriter &s, const DebugLogger::EventList &l)
+  {
+  s.writeUnsigned(l.thread);
+  s.writeUnsigned(l.spanSizes[0] + l.spanSizes[1]);
 
-    if(len > 1)
+  xint64 last = 0;
+  for(xsize span = 0; span < X_ARRAY_COUNT(l.spans); ++span)
+    {
+    for(xsize i = 0; i < l.spanSizes[span]; ++i)
       {
-      return QString::fromUtf8(data, len - 1);
+      const DebugLogger::Event &e = l.spans[span][i];
+      s.writeSigned(e.time - last);
+      s.writeUnsigned(e.location);
+      s.writeUnsigned(e.id);
+      s.writeUnsigned((xuint8)e.type);
+      last = e.time;
       }
+    }
+  return s;
+  }
 
-    return QString();
-    };
+DebugCompactReader &operator>>(DebugCompactReader &s, DebugLogger::EventList &l)
+  {
+  l.thread = s.readUnsigned();
+  const xuint64 count = s.readUnsigned();
+
+  l.events.clear();
+  xint64 last = 0;
+  for(xuint64 i = 0; i < count && s.isValid(); ++i)
+    {
+    DebugLogger::Event e;
+    e.time = last + s.readSigned();
+    e.location = (xuint32)s.readUnsigned();
+    e.id = (xuint32)s.readUnsigned();
+    e.type = (DebugLogger::EventType)s.readUnsigned();
+    last = e.time;
+    l.events << e;
+    }
+  return s;
+  }
+
+QDataStream &operator<<(QDataStream &s, const DebugLogger::Clock &c)
+  {
+  const DebugTimestamp::Calibration &cal = c.calibration;
+  return s << (xuint8)cal.source << cal.stamp << cal.nanoseconds << cal.nanosecondsPerStamp;
+  }
+
+QDataStream &operator>>(QDataStream &s, DebugLogger::Clock &c)
+  {
+  DebugTimestamp::Calibration &cal = c.calibration;
+  xuint8 source;
+  s >> source >> cal.stamp >> cal.nanoseconds >> cal.nanosecondsPerStamp;
+  cal.source = (DebugTimestamp::Source)source;
+  return s;
+  }
+
+QDataStream &operator<<(QDataStream &s, const DebugLogger::LogRecordList &l)
+  {
+  s << l.thread << (xuint32)(l.spanSizes[0] + l.spanSizes[1]);
+  s.writeRawData(l.spans[0], (int)l.spanSizes[0]);
+  s.writeRawData(l.spans[1], (int)l.spanSizes[1]);
+  return s;
+  }
+
+QDataStream &operator>>(QDataStream &s, DebugLogger::LogRecordList &l)
+  {
+  xuint32 size;
+  s >> l.thread >> size;
+
+  l.records.clear();
+  if(size > DebugLogger::MaxLogBytesPerFrame)
+    {
+    s.setStatus(QDataStream::ReadCorruptData);
+    return s;
+    }
 
-  QString file, function, data;
-  decltype(EventLogger::LocationReference::line) line;
-  EventLocation::ID id;
-  s >> id;
-  l.setData(readStr());
-  l.setFile(readStr());
-  l.setFunction(readStr());
-  s >> line;
+  QByteArray data((int)size, Qt::Uninitialized);
+  if(s.readRawData(data.data(), (int)size) == (int)size)
+    {
+    parseLogRecords(data.constData(), size, l.records);
+    }
+  return s;
+  }
 
-  l.setId(id);
-  l.setLine(line);
+// records are already compact, they are copied as they are.
+DebugCompactWriter &operator<<(DebugCompactWriter &s, const DebugLogger::LogRecordList &l)
+  {
+  s.writeUnsigned(l.thread);
+  s.writeUnsigned(l.spanSizes[0] + l.spanSizes[1]);
+  s.writeBytes(l.spans[0], l.spanSizes[0]);
+  s.writeBytes(l.spans[1], l.spanSizes[1]);
+  return s;
+  }
+
+DebugCompactReader &operator>>(DebugCompactReader &s, DebugLogger::LogRecordList &l)
+  {
+  l.thread = s.readUnsigned();
+  const xuint64 size = s.readUnsigned();
+
+  l.records.clear();
+  if(size > DebugLogger::MaxLogBytesPerFrame || !s.canRead(size))
+    {
+    return s;
+    }
 
+  QByteArray data((int)size, Qt::Uninitialized);
+  s.readBytes(data.data(), (xsize)size);
+  if(s.isValid())
+    {
+    parseLogRecords(data.constData(), (xsize)size, l.records);
+    }
   return s;
   }
 
 QDataStream &operator<<(QDataStream &s, const DebugLogger::LocationList &l)
   {
-  return s << *l.embeddedLocations;
+  s << l.firstString << (xuint32)l.strings.size();
+  xForeach(const QByteArray &str, l.strings)
+    {
+    s << str;
+    }
+
+  s << l.firstLocation << (xuint32)l.locations.size();
+  xForeach(const DebugLogger::LocationList::Record &r, l.locations)
+    {
+    s << r.file << r.function << r.line << r.data;
+    }
+  return s;
   }
 
 QDataStream &operator>>(QDataStream &s, DebugLogger::LocationList &l)
   {
-  return s >> l.allocatedLocations;
-  }
+  xuint32 count;
+  s >> l.firstString >> count;
 
+  l.strings.clear();
+  for(xuint32 i = 0; i < count && s.status() == QDataStream::Ok; ++i)
+    {
+    QByteArray str;
+    s >> str;
+    l.strings << str;
+    }
 
-QDataStream &operator<<(QDataStream &s, const DebugLogger::EventList &l)
+  s >> l.firstLocation >> count;
+
+  l.locations.clear();
+  for(xuint32 i = 0; i < count && s.status() == QDataStream::Ok; ++i)
+    {
+    DebugLogger::LocationList::Record r;
+    s >> r.file >> r.function >> r.line >> r.data;
+    l.locations << r;
+    }
+  return s;
+  }
+
+DebugCompactWriter &operator<<(DebugCompactWriter &s, const DebugLogger::LocationList &l)
   {
-  return s << (xuint64)l.thread << *l.events;
+  s.writeUnsigned(l.firstString);
+  s.writeUnsigned(l.strings.size());
+  xForeach(const QByteArray &str, l.strings)
+    {
+    s.writeUnsigned(str.size());
+    s.writeBytes(str.constData(), str.size());
+    }
+
+  s.writeUnsigned(l.firstLocation);
+  s.writeUnsigned(l.locations.size());
+  xForeach(const DebugLogger::LocationList::Record &r, l.locations)
+    {
+    s.writeUnsigned(r.file);
+    s.writeUnsigned(r.function);
+    s.writeUnsigned(r.line);
+    s.writeUnsigned(r.data);
+    }
+  return s;
   }
 
-QDataStream &operator>>(QDataStream &s, DebugLogger::EventList &l)
+DebugCompactReader &operator>>(DebugCompactReader &s, DebugLogger::LocationList &l)
   {
-  xuint64 thr;
-  s >> thr >> l.inPlaceEvents;
-  l.events = &l.inPlaceEvents;
-  l.thread = (void*)thr;
+  l.firstString = (xuint32)s.readUnsigned();
+  xuint64 count = s.readUnsigned();
+
+  l.strings.clear();
+  for(xuint64 i = 0; i < count && s.isValid(); ++i)
+    {
+    const xuint64 size = s.readUnsigned();
+    if(!s.canRead(size))
+      {
+      break;
+      }
+
+    QByteArray str((int)size, Qt::Uninitialized);
+    s.readBytes(str.data(), (xsize)size);
+    l.strings << str;
+    }
+
+  l.firstLocation = (xuint32)s.readUnsigned();
+  count = s.readUnsigned();
+
+  l.locations.clear();
+  for(xuint64 i = 0; i < count && s.isValid(); ++i)
+    {
+    DebugLogger::LocationList::Record r;
+    r.file = (xuint32)s.readUnsigned();
+    r.function = (xuint32)s.readUnsigned();
+    r.line = (xuint32)s.readUnsigned();
+    r.data = (xuint32)s.readUnsigned();
+    l.locations << r;
+    }
   return s;
   }
 
-DebugLogger *g_logger;
-QtMessageHandler g_oldHandler;
 void handler(QtMsgType t, const QMessageLogContext &c, const QString &m)
   {
-  static bool inHandler = false;
+  // messages logged while this thread records one are only passed on.
+  static thread_local bool t_inHandler = false;
   if(g_oldHandler)
     {
     g_oldHandler(t, c, m);
     }
 
-  if(inHandler)
+  if(t_inHandler)
     {
     return;
     }
-  inHandler = true;
+  t_inHandler = true;
 
-  DebugLogger::LogEntry e;
-  e.level = t;
-  e.entry = m;
-  e.time = Time::now();
-  e.thread = QThread::currentThread();
-
-  xAssert(g_logger)
-  g_logger->emitLogMessage(e);
+  DebugLogger *logger = g_logger.load(std::memory_order_acquire);
+  if(logger && (xsize)m.size() > (xsize)DebugLogger::LogRecord::MaxUtf16Argument)
+    {
+    // too long for a record, rare enough to format and send here rather than cut it.
+    DebugLogger::LogEntry e;
+    e.level = t;
+    e.entry = m;
+    e.time = Time::now();
+    e.thread = QThread::currentThread();
+    logger->emitLogMessage(e);
+    }
+  else
+    {
+    DebugLogger::LogRecord r;
+    r.add(m);
+    DebugLogger::recordLog(g_qtMessageLocation, t, r);
+    }
 
-  inHandler = false;
+  t_inHandler = false;
 }
 
 X_IMPLEMENT_DEBUG_INTERFACE(DebugLogger)
 
 DebugLogger::DebugLogger(DebugManager *, bool client)
+    : _generation(++g_generation),
+      _rings(0),
+      _draining(false),
+      _sentLocations(0),
+      _calibrationSent(0)
   {
-  // we need an instance to flush on close.
-  xAssert(QApplication::instance());
-
   static Reciever recv[] =
     {
     recieveFunction<LogEntry, DebugLogger, &DebugLogger::onLogMessage>(),
     recieveFunction<EventList, DebugLogger, &DebugLogger::onEventList>(),
-    recieveFunction<LocationList, DebugLogger, &DebugLogger::onCodeLocations>()
+    recieveFunction<LocationList, DebugLogger, &DebugLogger::onCodeLocations>(),
+    recieveFunction<LogRecordList, DebugLogger, &DebugLogger::onLogRecords>(),
+    recieveFunction<Clock, DebugLogger, &DebugLogger::onClock>()
     };
 
-  setRecievers(recv, X_ARRAY_COUNT(recv));
+  static const DispatchTable dispatch(recv, X_ARRAY_COUNT(recv));
+  setRecievers(dispatch);
 
   if(client)
     {
-    xAssert(!g_logger);
-    g_logger = this;
+    xAssert(!g_logger.load());
+    g_logger.store(this, std::memory_order_release);
     g_oldHandler = qInstallMessageHandler(handler);
 
-#if X_EVENT_LOGGING_ENABLED
-    Core::eventLogger()->setEventWatcher(this);
-#endif
+    _draining.store(true);
+    _drainThread = std::thread([this]() { drainLoop(); });
     }
   else
     {
     _server = Eks::Core::defaultAllocator()->createUnique<ServerData>();
     _server->model = createDataModel<DebugLoggerData>();
-    }
 
-#if X_EVENT_LOGGING_ENABLED
-  startTimer(25);
-#endif
+    // until the client sends its calibration, stamps are nanoseconds.
+    _server->clock.source = DebugTimestamp::Source::Clock;
+    _server->clock.stamp = 0;
+    _server->clock.nanoseconds = 0;
+    _server->clock.nanosecondsPerStamp = 1.0;
+    _server->untimedLogMessages = 0;
+    }
   }
 
 DebugLogger::~DebugLogger()
   {
-  Core::eventLogger()->syncCachedEvents();
-
-  if(g_logger)
+  if(g_logger.load() == this)
     {
+    // threads must have stopped recording by now, their rings go with the logger.
+    g_logger.store(0, std::memory_order_release);
     qInstallMessageHandler(g_oldHandler);
-
-    g_logger = 0;
     g_oldHandler = 0;
 
-#if X_EVENT_LOGGING_ENABLED
-    Core::eventLogger()->setEventWatcher(0);
-#endif
+    _draining.store(false);
+    _drainThread.join();
+    drain();
+    }
+
+  DebugEventRing *ring = _rings.load();
+  while(ring)
+    {
+    DebugEventRing *next = ring->next;
+    delete ring;
+    ring = next;
     }
   }
 
-void DebugLogger::emitLogMessage(const LogEntry &e)
+void DebugLogger::moment(Location &l)
   {
-  sendData(e);
+  if(g_logger.load(std::memory_order_acquire))
+    {
+    record(EventType::Moment, locationID(l), 0);
+    }
   }
 
-void DebugLogger::timerEvent(QTimerEvent*)
+xuint32 DebugLogger::begin(Location &l)
   {
-#if X_EVENT_LOGGING_ENABLED
-    Core::eventLogger()->syncCachedEvents();
-#endif
+  DebugLogger *logger = g_logger.load(std::memory_order_acquire);
+  if(!logger)
+    {
+    return 0;
+    }
+
+  const xuint32 id = logger->ring()->nextDuration++;
+  record(EventType::Begin, locationID(l), id);
+  return id;
   }
 
-void DebugLogger::onEvents(const QThread *thread, const ThreadEventLogger::EventVector &events)
+void DebugLogger::end(xuint32 duration)
   {
-  EventList l;
-  l.thread = thread;
-  l.events = &events;
+  record(EventType::End, InvalidLocation, duration);
+  }
 
-  sendData(l);
+xuint64 DebugLogger::droppedEvents() const
+  {
+  xuint64 dropped = 0;
+  for(DebugEventRing *ring = _rings.load(std::memory_order_acquire); ring; ring = ring->next)
+    {
+    dropped += ring->dropped.load(std::memory_order_relaxed);
+    }
+  return dropped;
   }
 
-void DebugLogger::onLocations(const EventLogger::EventLocationVector &locations)
+xuint64 DebugLogger::droppedLogRecords() const
   {
-  LocationList l = { &locations, Eks::Vector<DebugLocationWithData, 1024>() };
-  sendData(l);
+  xuint64 dropped = 0;
+  for(DebugEventRing *ring = _rings.load(std::memory_order_acquire); ring; ring = ring->next)
+    {
+    dropped += ring->logDropped.load(std::memory_order_relaxed);
+    }
+  return dropped;
   }
 
-void DebugLogger::onLogMessage(const LogEntry &e)
+bool DebugLogger::isRecording()
   {
-  if(_server)
+  return g_logger.load(std::memory_order_acquire) != 0;
+  }
+
+void DebugLogger::recordLog(Location &l, xuint32 level, LogRecord &r)
+  {
+  DebugLogger *logger = g_logger.load(std::memory_order_acquire);
+  if(!logger)
+    {
+    return;
+    }
+
+  const xsize size = r.size();
+  uchar *header = (uchar *)r.header();
+  qToLittleEndian<xuint32>((xuint32)size, header);
+  qToLittleEndian<xuint32>(locationID(l), header + sizeof(xuint32));
+  qToLittleEndian<xint64>(DebugTimestamp::now(), header + sizeof(xuint32) * 2);
+  header[sizeof(xuint32) * 2 + sizeof(xint64)] = (uchar)level;
+
+  DebugEventRing *ring = logger->ring();
+  const xuint64 write = ring->logWrite.load(std::memory_order_relaxed);
+  if(write + size - ring->logRead.load(std::memory_order_acquire) > LogRingCapacity)
+    {
+    bump(ring->logDropped, 1);
+    return;
+    }
+
+  copyToRing(ring->logBytes, write, r.data(), size);
+  ring->logWrite.store(write + size, std::memory_order_release);
+  }
+
+void DebugLogger::record(EventType type, xuint32 location, xuint32 id)
+  {
+  DebugLogger *logger = g_logger.load(std::memory_order_acquire);
+  if(!logger)
+    {
+    return;
+    }
+
+  DebugEventRing *ring = logger->ring();
+  const xuint64 write = ring->write.load(std::memory_order_relaxed);
+  if(write - ring->read.load(std::memory_order_acquire) >= EventRingCapacity)
+    {
+    bump(ring->dropped, 1);
+    return;
+    }
+
+  Event &e = ring->events[write % EventRingCapacity];
+  e.time = DebugTimestamp::now();
+  e.location = location;
+  e.id = id;
+  e.type = type;
+
+  ring->write.store(write + 1, std::memory_order_release);
+  }
+
+xuint32 DebugLogger::locationID(Location &l)
+  {
+  const xuint32 id = l.id.load(std::memory_order_acquire);
+  if(id != InvalidLocation)
+    {
+    return id;
+    }
+
+  std::lock_guard<std::mutex> lock(g_locationsLock);
+  // another thread may have registered it while we waited.
+  if(l.id.load(std::memory_order_relaxed) == InvalidLocation)
+    {
+    l.id.store((xuint32)g_locations.size(), std::memory_order_release);
+    g_locations << &l;
+    g_locationCount.store((xuint32)g_locations.size(), std::memory_order_release);
+    }
+
+  return l.id.load(std::memory_order_relaxed);
+  }
+
+DebugEventRing *DebugLogger::ring()
+  {
+  static thread_local DebugEventRing *t_ring = 0;
+  static thread_local xuint32 t_generation = 0;
+
+  if(t_generation != _generation)
+    {
+    t_ring = new DebugEventRing((xuint64)QThread::currentThread());
+    t_generation = _generation;
+
+    t_ring->next = _rings.load(std::memory_order_relaxed);
+    while(!_rings.compare_exchange_weak(
+            t_ring->next,
+            t_ring,
+            std::memory_order_release,
+            std::memory_order_relaxed))
+      {
+      }
+    }
+
+  return t_ring;
+  }
+
+void DebugLogger::drainLoop()
+  {
+  while(_draining.load(std::memory_order_acquire))
+    {
+    if(!drain())
+      {
+      std::this_thread::sleep_for(std::chrono::milliseconds(DrainIdleInterval));
+      }
+    }
+  }
+
+bool DebugLogger::drain()
+  {
+  // before the first events, and then periodically as the counter's rate is refined.
+  if(!_calibrationSent ||
+     Time::now().nanoseconds() - _calibrationSent >= (xint64)CalibrationInterval * 1000000)
+    {
+    sendCalibration();
+    }
+
+  bool drained = false;
+  for(DebugEventRing *ring = _rings.load(std::memory_order_acquire); ring; ring = ring->next)
+    {
+    drained = drainEvents(ring) || drained;
+    drained = drainLogs(ring) || drained;
+    }
+
+  return drained;
+  }
+
+bool DebugLogger::drainEvents(DebugEventRing *ring)
+  {
+  const xuint64 write = ring->write.load(std::memory_order_acquire);
+  xuint64 read = ring->read.load(std::memory_order_relaxed);
+  if(read == write)
+    {
+    return false;
+    }
+
+  // the events up to [write] were recorded after their locations were registered,
+  // send those first so the server can always resolve them.
+  sendLocations();
+
+  while(read != write)
     {
-    static const QString statuses[] =
+    const xsize count = (xsize)xMin(write - read, (xuint64)MaxEventsPerFrame);
+    const xsize start = (xsize)(read % EventRingCapacity);
+    const xsize first = xMin(count, (xsize)EventRingCapacity - start);
+
+    EventList l;
+    l.thread = ring->thread;
+    l.spans[0] = ring->events + start;
+    l.spanSizes[0] = first;
+    l.spans[1] = ring->events;
+    l.spanSizes[1] = count - first;
+    sendData(l);
+
+    read += count;
+    ring->read.store(read, std::memory_order_release);
+    }
+
+  return true;
+  }
+
+bool DebugLogger::drainLogs(DebugEventRing *ring)
+  {
+  const xuint64 write = ring->logWrite.load(std::memory_order_acquire);
+  xuint64 read = ring->logRead.load(std::memory_order_relaxed);
+  if(read == write)
+    {
+    return false;
+    }
+
+  sendLocations();
+
+  while(read != write)
+    {
+    // whole records, as many as fit the frame.
+    xuint64 end = read;
+    while(end != write)
       {
-      "Debug",
-      "Warning",
-      "Critical",
-      "Fatal",
-      "System"
-      };
+      char header[sizeof(xuint32)];
+      copyFromRing(ring->logBytes, end, header, sizeof(header));
+      const xuint32 size = qFromLittleEndian<xuint32>((const uchar *)header);
+      if(end != read && end + size - read > MaxLogBytesPerFrame)
+        {
+        break;
+        }
+      end += size;
+      }
+
+    const xsize count = (xsize)(end - read);
+    const xsize start = (xsize)(read % LogRingCapacity);
+    const xsize first = xMin(count, (xsize)LogRingCapacity - start);
+
+    LogRecordList l;
+    l.thread = ring->thread;
+    l.spans[0] = ring->logBytes + start;
+    l.spanSizes[0] = first;
+    l.spans[1] = ring->logBytes;
+    l.spanSizes[1] = count - first;
+    sendData(l);
+
+    read = end;
+    ring->logRead.store(read, std::memory_order_release);
+    }
+
+  return true;
+  }
+
+void DebugLogger::sendLocations()
+  {
+  if(g_locationCount.load(std::memory_order_acquire) == _sentLocations)
+    {
+    return;
+    }
+
+  LocationList l;
+  l.firstString = (xuint32)_sentStrings.size();
+  l.firstLocation = (xuint32)_sentLocations;
+
+  auto intern = [this, &l](const char *str)
+    {
+    const QByteArray key = QByteArray::fromRawData(str ? str : "", str ? (int)strlen(str) : 0);
+    auto it = _sentStrings.constFind(key);
+    if(it != _sentStrings.constEnd())
+      {
+      return *it;
+      }
+
+    // the hash outlives the raw data, it keeps a deep copy.
+    const QByteArray copy(key.constData(), key.size());
+    const xuint32 id = (xuint32)_sentStrings.size();
+    _sentStrings.insert(copy, id);
+    l.strings << copy;
+    return id;
+    };
+
+    {
+    std::lock_guard<std::mutex> lock(g_locationsLock);
+    for(xsize i = _sentLocations; i < (xsize)g_locations.size(); ++i)
+      {
+      const Location *loc = g_locations[(int)i];
+
+      LocationList::Record r;
+      r.file = intern(loc->file);
+      r.function = intern(loc->function);
+      r.line = loc->line;
+      r.data = intern(loc->data);
+      l.locations << r;
+      }
+    _sentLocations = g_locations.size();
+    }
+
+  // a lost list would leave its locations unnamed for the rest of the session.
+  sendState(l);
+  }
+
+void DebugLogger::sendCalibration()
+  {
+  Clock c;
+  c.calibration = DebugTimestamp::calibrate();
+  sendData(c);
+
+  _calibrationSent = Time::now().nanoseconds();
+  }
+
+void DebugLogger::emitLogMessage(const LogEntry &e)
+  {
+  sendData(e);
+  }
 
+void DebugLogger::onLogMessage(const LogEntry &e)
+  {
+  // lost with an earlier frame, or from before a capture or subscriber began, it can't be
+  // placed on the timeline.
+  if(_server && !e.timeKnown)
+    {
+    ++_server->untimedLogMessages;
+    return;
+    }
+
+  if(_server)
+    {
     Q_EMIT _server->model->eventCreated(
           e.time,
-          ThreadEventLogger::EventType::Moment,
+          EventType::Moment,
           (xuint64)e.thread,
-          statuses[e.level] + ":\n" + e.entry,
+          levelName(e.level) + ":\n" + e.entry,
           std::numeric_limits<xsize>::max(),
           nullptr);
     }
@@ -234,10 +991,12 @@ void DebugLogger::onEventList(const EventList &list)
   {
   if (_server)
     {
-    xForeach(const auto &evt, *list.events)
+    xForeach(const auto &evt, list.events)
       {
-      if(evt.type == ThreadEventLogger::EventType::Begin ||
-         evt.type == ThreadEventLogger::EventType::Moment)
+      const Eks::Time time = DebugTimestamp::toTime(evt.time, _server->clock);
+
+      if(evt.type == EventType::Begin ||
+         evt.type == EventType::Moment)
         {
         auto location = findLocation(evt.location);
 
@@ -255,39 +1014,113 @@ void DebugLogger::onEventList(const EventList &list)
           }
 
         Q_EMIT _server->model->eventCreated(
-              evt.time,
+              time,
               evt.type,
-              (xuint64)list.thread,
+              list.thread,
               display,
               evt.id,
               location);
         }
-      else if(evt.type == ThreadEventLogger::EventType::End)
+      else if(evt.type == EventType::End)
         {
-        Q_EMIT _server->model->eventEndUpdated(evt.id, (xuint64)list.thread, evt.time);
+        Q_EMIT _server->model->eventEndUpdated(evt.id, list.thread, time);
         }
       }
     }
   }
 
+void DebugLogger::onLogRecords(const LogRecordList &l)
+  {
+  if(_server)
+    {
+    xForeach(const auto &r, l.records)
+      {
+      const DebugLocationWithData *location = findLocation(r.location);
+
+      QString text = location ? location->data() : QString();
+      xForeach(const QVariant &arg, r.arguments)
+        {
+        switch(arg.type())
+          {
+        case QVariant::LongLong:
+          text = text.arg(arg.toLongLong());
+          break;
+        case QVariant::ULongLong:
+          text = text.arg(arg.toULongLong());
+          break;
+        case QVariant::Double:
+          text = text.arg(arg.toDouble());
+          break;
+        default:
+          text = text.arg(arg.toString());
+          break;
+          }
+        }
+
+      const Eks::Time time = DebugTimestamp::toTime(r.time, _server->clock);
+
+      Q_EMIT _server->model->eventCreated(
+            time,
+            EventType::Moment,
+            l.thread,
+            levelName(r.level) + ":\n" + text,
+            std::numeric_limits<xsize>::max(),
+            location);
+      }
+    }
+  }
+
+void DebugLogger::onClock(const Clock &c)
+  {
+  if(_server)
+    {
+    _server->clock = c.calibration;
+    }
+  }
+
 void DebugLogger::onCodeLocations(const LocationList &e)
   {
   xAssert(_server);
 
-  xForeach(const auto &ev, e.allocatedLocations)
+  QVector<QString> &strings = _server->_strings;
+  auto &locations = _server->_locations;
+
+  // lists continue the tables, or repeat lists a snapshot already held.
+  if(e.firstString > (xuint32)strings.size() || e.firstLocation > locations.size())
+    {
+    qWarning() << "Code locations recieved out of order";
+    return;
+    }
+
+  if(strings.size() < (int)(e.firstString + e.strings.size()))
+    {
+    strings.resize(e.firstString + e.strings.size());
+    }
+  for(int i = 0; i < e.strings.size(); ++i)
+    {
+    strings[e.firstString + i] = QString::fromUtf8(e.strings[i]);
+    }
+
+  auto string = [&strings](xuint32 id)
+    {
+    return id < (xuint32)strings.size() ? strings[id] : QString();
+    };
+
+  locations.resize(xMax(locations.size(), (xsize)e.firstLocation + e.locations.size()));
+  for(int i = 0; i < e.locations.size(); ++i)
     {
-    auto id = (xsize)ev.id();
-    _server->_locations.resize(xMax(_server->_locations.size(), id+1));
+    const LocationList::Record &r = e.locations[i];
 
-    auto &location = _server->_locations[id];
-    location.setFile(ev.file());
-    location.setLine(ev.line());
-    location.setFunction(ev.function());
-    location.setData(ev.data());
+    auto &location = locations[e.firstLocation + i];
+    location.setId(e.firstLocation + i);
+    location.setFile(string(r.file));
+    location.setLine(r.line);
+    location.setFunction(string(r.function));
+    location.setData(string(r.data));
     }
   }
 
-const DebugLogger::DebugLocationWithData *DebugLogger::findLocation(Eks::EventLocation::ID id)
+const DebugLogger::DebugLocationWithData *DebugLogger::findLocation(xuint32 id)
   {
   if(id >= _server->_locations.size())
     {
@@ -298,5 +1131,3 @@ const DebugLogger::DebugLocationWithData *DebugLogger::findLocation(Eks::EventLo
   }
 
 }
-
-#endif
@@ -0,0 +1,214 @@
+#include "XDebugLz.h"
+#include <cstring>
+
+namespace Eks
+{
+
+namespace DebugLz
+{
+
+namespace
+{
+
+enum
+  {
+  MinMatch = 4,
+  // the format requires the final bytes of a block to be literals.
+  LastLiterals = 5,
+  MatchSearchMargin = 12,
+  HashBits = 12,
+  MaxOffset = 65535
+  };
+
+inline xuint32 read32(const char *p)
+  {
+  xuint32 v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+  }
+
+inline xuint32 hash(xuint32 v)
+  {
+  return (v * 2654435761U) >> (32 - HashBits);
+  }
+
+inline char *writeLength(char *op, xsize length)
+  {
+  while(length >= 255)
+    {
+    *op++ = (char)255;
+    length -= 255;
+    }
+  *op++ = (char)length;
+  return op;
+  }
+
+char *writeSequence(
+    char *op,
+    const char *literals,
+    xsize literalCount,
+    xsize offset,
+    xsize matchLength)
+  {
+  char *token = op++;
+
+  xuint8 tok = 0;
+  if(literalCount >= 15)
+    {
+    tok = 15 << 4;
+    op = writeLength(op, literalCount - 15);
+    }
+  else
+    {
+    tok = (xuint8)(literalCount << 4);
+    }
+
+  memcpy(op, literals, literalCount);
+  op += literalCount;
+
+  if(matchLength)
+    {
+    *op++ = (char)(offset & 0xFF);
+    *op++ = (char)(offset >> 8);
+
+    const xsize encodedMatch = matchLength - MinMatch;
+    if(encodedMatch >= 15)
+      {
+      tok |= 15;
+      op = writeLength(op, encodedMatch - 15);
+      }
+    else
+      {
+      tok |= (xuint8)encodedMatch;
+      }
+    }
+
+  *token = (char)tok;
+  return op;
+  }
+
+}
+
+xsize compress(const char *src, xsize size, char *dst)
+  {
+  char *op = dst;
+  xsize anchor = 0;
+
+  if(size > MatchSearchMargin)
+    {
+    xint32 table[1 << HashBits];
+    memset(table, 0xFF, sizeof(table));
+
+    const xsize searchLimit = size - MatchSearchMargin;
+    const xsize matchLimit = size - LastLiterals;
+
+    xsize ip = 0;
+    while(ip < searchLimit)
+      {
+      const xuint32 sequence = read32(src + ip);
+      const xuint32 h = hash(sequence);
+      const xint32 ref = table[h];
+      table[h] = (xint32)ip;
+
+      if(ref < 0 || ip - ref > MaxOffset || read32(src + ref) != sequence)
+        {
+        ++ip;
+        continue;
+        }
+
+      xsize length = MinMatch;
+      while(ip + length < matchLimit && src[ref + length] == src[ip + length])
+        {
+        ++length;
+        }
+
+      op = writeSequence(op, src + anchor, ip - anchor, ip - ref, length);
+      ip += length;
+      anchor = ip;
+      }
+    }
+
+  op = writeSequence(op, src + anchor, size - anchor, 0, 0);
+  return op - dst;
+  }
+
+bool decompress(const char *src, xsize srcSize, char *dst, xsize dstSize)
+  {
+  const xuint8 *ip = (const xuint8 *)src;
+  const xuint8 *ipEnd = ip + srcSize;
+  xsize op = 0;
+
+  auto readLength = [&ip, ipEnd](xsize &length) -> bool
+    {
+    xuint8 b;
+    do
+      {
+      if(ip >= ipEnd)
+        {
+        return false;
+        }
+      b = *ip++;
+      length += b;
+      } while(b == 255);
+    return true;
+    };
+
+  while(ip < ipEnd)
+    {
+    const xuint8 token = *ip++;
+
+    xsize literals = token >> 4;
+    if(literals == 15 && !readLength(literals))
+      {
+      return false;
+      }
+
+    if(literals > (xsize)(ipEnd - ip) || literals > dstSize - op)
+      {
+      return false;
+      }
+
+    memcpy(dst + op, ip, literals);
+    ip += literals;
+    op += literals;
+
+    // the last sequence has no match.
+    if(ip == ipEnd)
+      {
+      break;
+      }
+
+    if(ipEnd - ip < 2)
+      {
+      return false;
+      }
+    const xsize offset = ip[0] | (ip[1] << 8);
+    ip += 2;
+
+    xsize length = token & 15;
+    if(length == 15 && !readLength(length))
+      {
+      return false;
+      }
+    length += MinMatch;
+
+    if(!offset || offset > op || length > dstSize - op)
+      {
+      return false;
+      }
+
+    // matches may overlap their own output, so copy forwards byte by byte.
+    const char *match = dst + op - offset;
+    for(xsize i = 0; i < length; ++i)
+      {
+      dst[op + i] = match[i];
+      }
+    op += length;
+    }
+
+  return op == dstSize;
+  }
+
+}
+
+}
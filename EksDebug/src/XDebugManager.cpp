@@ -2,24 +2,31 @@
 #include "XDebugInterface.h"
 #include "XDebugController.h"
 #include "XDebugManagerImpl.h"
+#include "XDebugCompactEncoding.h"
 #include "Utilities/XAssert.h"
 
 namespace Eks
 {
 
-DebugInterfaceType *g_lastInterface = 0;
+// registered types, chained by hash. Plain pointers, so registration from
+// static initialisers never depends on construction order.
+static const xsize InterfaceTypeBucketCount = 64;
+DebugInterfaceType *g_interfaceTypes[InterfaceTypeBucketCount] = { 0 };
 DebugManagerImpl *g_manager = 0;
-DebugManager::DebugManager(bool client, Watcher *w)
+DebugManager::DebugManager(bool client, Watcher *w, Transport transport, xuint32 caps, bool ioThread)
   {
   xAssert(!g_manager);
-  g_manager = new Impl(this, client);
+  g_manager = new Impl(this, client, transport, caps, ioThread);
 
-  g_manager->setupController();
+  g_manager->runOnManagerThread([w, client]()
+    {
+    g_manager->setupController();
 
-  g_manager->_watcher = w;
+    g_manager->_watcher = w;
 
-  // fake connected straight away, data is buffered locally.
-  g_manager->_controller->onDebuggerConnected(client);
+    // fake connected straight away, data is buffered locally.
+    g_manager->_controller->onDebuggerConnected(client);
+    });
   }
 
 DebugManager::~DebugManager()
@@ -29,11 +36,11 @@ DebugManager::~DebugManager()
   g_manager = 0;
   }
 
-const DebugInterfaceType *DebugManager::findInterfaceType(const QString &t)
+const DebugInterfaceType *DebugManager::findInterfaceType(xuint32 typeHash)
   {
-  for(auto ifc = g_lastInterface; ifc != 0; ifc = ifc->next)
+  for(auto ifc = g_interfaceTypes[typeHash % InterfaceTypeBucketCount]; ifc != 0; ifc = ifc->next)
     {
-    if(ifc->type == t)
+    if(ifc->typeHash == typeHash)
       {
       return ifc;
       }
@@ -42,37 +49,50 @@ const DebugInterfaceType *DebugManager::findInterfaceType(const QString &t)
   return 0;
   }
 
+const DebugInterfaceType *DebugManager::findInterfaceType(const QString &t)
+  {
+  return findInterfaceType(detail::debugTypeHash(t.toUtf8().constData()));
+  }
+
 void DebugManager::registerInterfaceType(DebugInterfaceType *t)
   {
-  t->next = g_lastInterface;
-  g_lastInterface = t;
+  // two names sharing a hash can't be told apart on the wire.
+  xAssert(!findInterfaceType(t->typeHash));
+
+  DebugInterfaceType *&bucket = g_interfaceTypes[t->typeHash % InterfaceTypeBucketCount];
+  t->next = bucket;
+  bucket = t;
   }
 
 void DebugManager::registerInterface(DebugInterface *ifc)
   {
-  g_manager->_interfaces << ifc;
+  g_manager->runOnManagerThread([ifc]()
+    {
+    g_manager->assignCounterSlot(ifc);
+    g_manager->_interfaces << ifc;
+    });
   }
 
 void DebugManager::unregisterInterface(DebugInterface *ifc)
   {
-  if(g_manager->_watcher)
+  g_manager->runOnManagerThread([ifc]()
     {
-    g_manager->_watcher->onInterfaceUnregistered(ifc);
-    }
+    // [ifc] may still be queued for setup, but is part destroyed and cant be announced.
+    g_manager->announcePendingInterfaces(ifc);
 
-  g_manager->_interfaces.removeAll(ifc);
-
-  for(auto it = g_manager->_interfaceMap.begin(); it != g_manager->_interfaceMap.end();)
-    {
-    if (it->second == ifc)
+    if(g_manager->_watcher)
       {
-      it = g_manager->_interfaceMap.erase(it);
+      g_manager->_watcher->onInterfaceUnregistered(ifc);
       }
-    else
+
+    g_manager->_interfaces.removeAll(ifc);
+    g_manager->releaseCounterSlot(ifc);
+    g_manager->removeInterfaceLookup(ifc);
+    if(g_manager->_controller)
       {
-      ++it;
+      g_manager->_controller->forgetState(ifc);
       }
-    }
+    });
   }
 
 void DebugManager::addInterfaceLookup(DebugInterface *ifc)
@@ -80,31 +100,171 @@ void DebugManager::addInterfaceLookup(DebugInterface *ifc)
   g_manager->addInterfaceLookup(ifc);
   }
 
+DebugInterface *DebugManager::findInterface(xuint32 id)
+  {
+  return g_manager->findInterface(id);
+  }
+
+xuint32 DebugManager::capabilities()
+  {
+  return g_manager->_capabilities;
+  }
+
+void DebugManager::setRemoteCapabilities(xuint32 caps)
+  {
+  g_manager->_capabilities = caps;
+  DebugCompactReader::resetThreadTimes();
+  }
+
+void DebugManager::setAcceptedCapabilities(xuint32 caps)
+  {
+  g_manager->acceptCapabilities(caps);
+  }
+
+void DebugManager::beginDecompression()
+  {
+  g_manager->beginDecompression();
+  }
+
+void DebugManager::grantCredit(xuint64 bytes)
+  {
+  g_manager->grantCredit(bytes);
+  }
+
+void DebugManager::setFlowControlBound(xsize bytes)
+  {
+  g_manager->_flowControlBound = bytes;
+  }
+
+void DebugManager::requestSendLimit(DebugInterface *ifc, const SendLimit &limit)
+  {
+  g_manager->runOnManagerThread([ifc, &limit]() { g_manager->_controller->sendSendLimit(ifc, limit); });
+  }
+
+DebugManager::QueueStatistics DebugManager::queueStatistics()
+  {
+  QueueStatistics stats;
+  g_manager->runOnManagerThread([&stats]() { stats = g_manager->queueStatistics(); });
+  return stats;
+  }
+
 QDataStream &DebugManager::lockOutputStream(DebugInterface *ifc)
   {
-  xAssert(!g_manager->_outputLocked);
+  DebugThreadOutput *out = g_manager->threadOutput();
+  xAssert(!out->locked);
 
-  if(ifc->interfaceID() == std::numeric_limits<xuint32>::max())
+  if(ifc->interfaceID() >= DebugInterface::PendingInterfaceID)
     {
-    g_manager->_controller->setupInterface(ifc);
-
-    g_manager->addInterfaceLookup(ifc);
+    g_manager->setupInterface(ifc);
     }
 
-  g_manager->_outputLocked = ifc;
+  out->locked = ifc;
+  g_manager->beginFrame(out);
 
-  g_manager->_scratchImpl.buffer().clear();
-  g_manager->_scratchImpl.reset();
-  return g_manager->_scratchBuffer;
+  return out->stream;
   }
 
 void DebugManager::unlockOutputStream()
   {
-  xAssert(g_manager->_outputLocked);
+  DebugThreadOutput *out = g_manager->threadOutput();
+  xAssert(out->locked);
 
+  g_manager->endFrame(out);
+  xAssert(!out->locked);
+  }
+
+void DebugManager::sendInterfaceState(DebugInterface *ifc, const QByteArray &message)
+  {
+  // the state names [ifc] by id, so its setup must be queued first.
+  if(ifc->interfaceID() >= DebugInterface::PendingInterfaceID)
+    {
+    g_manager->setupInterface(ifc);
+    }
+
+  g_manager->countSent(g_manager->threadOutput(), ifc, message.size());
+  g_manager->_controller->sendInterfaceState(ifc, message);
+  }
+
+xuint64 DebugManager::sentMessages(const DebugInterface *ifc)
+  {
+  // the thread outputs are only walked on the manager thread, which frees retired ones.
+  xuint64 messages = 0;
+  g_manager->runOnManagerThread([ifc, &messages]()
+    {
+    xuint64 bytes = 0;
+    g_manager->sentTotals(ifc, messages, bytes);
+    });
+  return messages;
+  }
+
+void DebugManager::flush()
+  {
   g_manager->flush();
+  }
+
+void DebugManager::setPreConnectBudget(
+    xsize bytes,
+    PreConnectPolicy policy,
+    const QString &spillPath)
+  {
+  g_manager->runOnManagerThread([bytes, policy, &spillPath]()
+    {
+    g_manager->_preConnect.configure(bytes, policy, spillPath);
+    });
+  }
+
+DebugManager::PreConnectStatistics DebugManager::preConnectStatistics()
+  {
+  PreConnectStatistics stats;
+  g_manager->runOnManagerThread([&stats]() { stats = g_manager->_preConnect.statistics(); });
+  return stats;
+  }
 
-  g_manager->_outputLocked = 0;
+bool DebugManager::startCapture(const QString &path)
+  {
+  bool started = false;
+  g_manager->runOnManagerThread([&started, &path]() { started = g_manager->startCapture(path); });
+  return started;
+  }
+
+void DebugManager::stopCapture()
+  {
+  g_manager->runOnManagerThread([]() { g_manager->stopCapture(); });
+  }
+
+DebugManager::CaptureStatistics DebugManager::captureStatistics()
+  {
+  CaptureStatistics stats;
+  g_manager->runOnManagerThread([&stats]() { stats = g_manager->captureStatistics(); });
+  return stats;
+  }
+
+void DebugManager::addSubscriber(QIODevice *device)
+  {
+  // the device is written from the manager thread from now on.
+  device->setParent(0);
+  device->moveToThread(g_manager->managerThread());
+
+  g_manager->runOnManagerThread([device]() { g_manager->addSubscriber(device); });
+  }
+
+void DebugManager::setSubscriberBacklogLimit(xsize bytes)
+  {
+  g_manager->runOnManagerThread([bytes]() { g_manager->_fanOut.setBacklogLimit(bytes); });
+  }
+
+DebugManager::SubscriberStatistics DebugManager::subscriberStatistics()
+  {
+  SubscriberStatistics stats;
+  g_manager->runOnManagerThread([&stats]() { stats = g_manager->_fanOut.statistics(); });
+  return stats;
+  }
+
+bool DebugManager::replayCapture(const QString &path)
+  {
+  bool started = false;
+  g_manager->runOnManagerThread([&started, &path]() { started = g_manager->replayCapture(path); });
+  return started;
   }
 
 }
@@ -1,56 +1,326 @@
 #include "XDebugManagerImpl.h"
 #include "XDebugInterface.h"
+#include "XDebugTransport.h"
+#include "XDebugCompression.h"
+#include "XDebugCaptureWriter.h"
+#include "XDebugManagerMonitor.h"
 #include "Math/XMathHelpers.h"
-#include "QBuffer"
-#include "QTcpServer"
-#include "QTcpSocket"
+#include "QThread"
+#include "QSemaphore"
+#include "QCoreApplication"
+#include "QDebug"
+#include "QtEndian"
+#include "QFile"
+#include <chrono>
+#include <cstring>
 
 namespace Eks
 {
 
-DebugManagerImpl::DebugManagerImpl(DebugManager *m, bool client)
+static std::atomic<xuint32> g_generation(0);
+extern DebugManagerImpl *g_manager;
+
+namespace
+{
+
+// retires the thread's output when the thread exits, for the manager to free once drained.
+struct ThreadOutputGuard
+  {
+  ~ThreadOutputGuard()
+    {
+    // outputs belonging to an earlier manager were freed with it.
+    if(output && g_manager && g_manager->_generation == generation)
+      {
+      output->retired.store(true, std::memory_order_release);
+      }
+    }
+
+  DebugThreadOutput *output;
+  xuint32 generation;
+  };
+
+thread_local ThreadOutputGuard t_outputGuard = { 0, 0 };
+
+xint64 monotonicNanoseconds()
+  {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+// a counter only one thread writes, readers on other threads just need a whole value.
+inline void bump(std::atomic<xuint64> &counter, xuint64 value)
+  {
+  counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+  }
+
+}
+
+DebugThreadOutput::DebugThreadOutput(DebugManagerImpl *m, xsize ringCapacity)
+    : ring(ringCapacity),
+      device(this),
+      stream(&device),
+      manager(m),
+      locked(0),
+      frameStart(0),
+      overflowed(false),
+      discarding(false),
+      frames(0),
+      bytes(0),
+      serialiseNanoseconds(0),
+      serialiseSamples(0),
+      serialiseStart(0),
+      retired(false),
+      next(0)
+  {
+  for(xsize i = 0; i < CounterSlots; ++i)
+    {
+    sentMessages[i].store(0, std::memory_order_relaxed);
+    sentBytes[i].store(0, std::memory_order_relaxed);
+    }
+  }
+
+DebugThreadOutput::RingDevice::RingDevice(DebugThreadOutput *out)
+    : _output(out)
+  {
+  open(QIODevice::WriteOnly | QIODevice::Unbuffered);
+  }
+
+qint64 DebugThreadOutput::RingDevice::readData(char *, qint64)
+  {
+  return -1;
+  }
+
+qint64 DebugThreadOutput::RingDevice::writeData(const char *data, qint64 len)
+  {
+  if(_output->discarding)
+    {
+    return len;
+    }
+
+  if(!_output->overflowed && _output->manager->reserve(_output, (xsize)len))
+    {
+    _output->ring.append(data, (xsize)len);
+    }
+  else
+    {
+    _output->overflowed = true;
+    }
+
+  // keep the stream healthy, an overflowed frame is discarded when it ends.
+  return len;
+  }
+
+DebugManagerImpl::DebugManagerImpl(
+    DebugManager *m,
+    bool client,
+    DebugManager::Transport transport,
+    xuint32 capabilities,
+    bool ioThread)
   : _controller(0),
     _watcher(0),
-    _interfaceMap(Eks::Core::defaultAllocator()),
-    _clientStream(&_preConnectClientData, QIODevice::WriteOnly),
-    _scratchBuffer(&_scratchImpl),
-    _outputLocked(0),
-    _server(0),
+    _interfaceTable(Eks::Core::defaultAllocator()),
+    _clientStream(&_preConnect),
+    _outputs(0),
+    _localOutput(0),
+    _generation(++g_generation),
+    _pendingSetups(0),
+    _drainScheduled(false),
+    _batchScheduled(false),
+    _draining(false),
+    _transport(0),
     _client(0),
-    _readingID(Eks::maxFor(_readingID)),
-    _bytesNeeded(0),
-    _manager(m)
+    _isClient(client),
+    _capabilities(client ? capabilities : 0),
+    _compressThread(0),
+    _compressor(0),
+    _decompressor(0),
+    _flowControlled(false),
+    _grantingCredit(false),
+    _credit(0),
+    _processedBytes(0),
+    _congested(false),
+    _flowControlBound(StagingRingCapacity / 2),
+    _droppedFrames(0),
+    _sampledOutFrames(0),
+    _monitor(0),
+    _monitoring(false),
+    _drainRequested(0),
+    _flushLatency(DebugManagerMonitor::FlushLatencyBuckets, 0),
+    _dataReadyIterations(0),
+    _transportWrites(0),
+    _capture(0),
+    _replayFile(0),
+    _replayData(0),
+    _replaySize(0),
+    _replayPosition(0),
+    _threadTimes(Eks::Core::defaultAllocator()),
+    _manager(m),
+    _ioThread(0),
+    _ownerThread(QThread::currentThread())
+  {
+  memset(&_lastCaptureStatistics, 0, sizeof(_lastCaptureStatistics));
+
+  // handed out lowest first.
+  for(xuint32 i = DebugThreadOutput::CounterSlots; i > 0; --i)
+    {
+    _freeCounterSlots << (i - 1);
+    }
+
+  // children follow the manager to its thread.
+  _batchTimer.setParent(this);
+  _statisticsTimer.setParent(this);
+  _monitorTimer.setParent(this);
+  _fanOut.setParent(this);
+
+  if(client && ioThread)
+    {
+    // producers only stage frames into their rings, so a slow transport, compression or
+    // a drain never stalls the application's threads.
+    _ioThread = new QThread;
+    _ioThread->setObjectName("EksDebug I/O");
+    moveToThread(_ioThread);
+    _ioThread->start();
+    }
+
+  runOnManagerThread([this, transport, client]() { start(transport, client); });
+  }
+
+DebugManagerImpl::~DebugManagerImpl()
+  {
+  runOnManagerThread([this]() { shutdown(); });
+
+  if(_ioThread)
+    {
+    _ioThread->quit();
+    _ioThread->wait();
+    delete _ioThread;
+    _ioThread = 0;
+    }
+
+  // threads which outlive the manager notice the generation change and start again.
+  DebugThreadOutput *out = _outputs.exchange(0);
+  while(out)
+    {
+    DebugThreadOutput *next = out->next;
+    delete out;
+    out = next;
+    }
+  }
+
+void DebugManagerImpl::start(DebugManager::Transport transport, bool client)
   {
-  _scratchImpl.open(QIODevice::WriteOnly);
+  _localOutput = threadOutput();
+
+  _batchTimer.setSingleShot(true);
+  _batchTimer.setInterval(BatchMaxLatency);
+  connect(&_batchTimer, SIGNAL(timeout()), this, SLOT(drain()));
+
+  _statisticsTimer.setInterval(SendStatisticsInterval);
+  connect(&_statisticsTimer, SIGNAL(timeout()), this, SLOT(reportSendStatistics()));
+
+  _monitorTimer.setInterval(DebugManagerMonitor::ReportInterval);
+  connect(&_monitorTimer, SIGNAL(timeout()), this, SLOT(reportMonitor()));
+
+  _transport = DebugTransport::create(transport, this);
 
   if(client)
     {
-    _client = new QTcpSocket(this);
-    _client->connectToHost(QHostAddress::LocalHost, 12345);
+    connect(_transport, SIGNAL(connected()), this, SLOT(onConnected()));
+    _client = _transport->connectToServer();
 
-    connect(_client, SIGNAL(connected()), this, SLOT(onConnected()));
     setupClient();
     }
   else
     {
-    _server = new QTcpServer(this);
-    connect(_server, SIGNAL(newConnection()), this, SLOT(onNewConnection()));
-    _server->listen(QHostAddress::Any, 12345);
+    connect(_transport, SIGNAL(newConnection()), this, SLOT(onNewConnection()));
+    if(!_transport->listen())
+      {
+      qCritical() << "Failed to listen for debug clients";
+      }
     }
   }
 
-DebugManagerImpl::~DebugManagerImpl()
+void DebugManagerImpl::shutdown()
   {
+  drain();
+  stopCapture();
+  endCompression();
+
   if(_client)
     {
-    _client->flush();
-    _client->waitForBytesWritten(100);
+    _transport->flush(_client, 100);
 
     _client = 0;
     }
 
-  _server = 0;
+  // the watcher may be going too, a replay cut short by shutdown isn't reported.
+  endReplay(false);
   clear();
+
+  _batchTimer.stop();
+  _statisticsTimer.stop();
+  _monitorTimer.stop();
+  _fanOut.clear();
+  delete _transport;
+  _transport = 0;
+
+  if(_ioThread)
+    {
+    // the I/O thread is about to stop, whatever is left is destroyed by the owner.
+    moveToThread(_ownerThread);
+    }
+  }
+
+namespace
+{
+
+class DebugManagerTask : public QEvent
+  {
+public:
+  DebugManagerTask(const std::function<void()> &fn, QSemaphore *done)
+      : QEvent(eventType()),
+        function(fn),
+        finished(done)
+    {
+    }
+
+  static QEvent::Type eventType()
+    {
+    static const QEvent::Type type = (QEvent::Type)QEvent::registerEventType();
+    return type;
+    }
+
+  std::function<void()> function;
+  QSemaphore *finished;
+  };
+
+}
+
+void DebugManagerImpl::runOnManagerThread(const std::function<void()> &fn)
+  {
+  if(QThread::currentThread() == thread())
+    {
+    fn();
+    return;
+    }
+
+  // the manager thread never waits on another thread's event loop, so this can't deadlock.
+  QSemaphore done;
+  QCoreApplication::postEvent(this, new DebugManagerTask(fn, &done));
+  done.acquire();
+  }
+
+bool DebugManagerImpl::event(QEvent *e)
+  {
+  if(e->type() != DebugManagerTask::eventType())
+    {
+    return QObject::event(e);
+    }
+
+  DebugManagerTask *task = static_cast<DebugManagerTask *>(e);
+  task->function();
+  task->finished->release();
+  return true;
   }
 
 void DebugManagerImpl::setupClient()
@@ -60,16 +330,34 @@ void DebugManagerImpl::setupClient()
 
 void DebugManagerImpl::addInterfaceLookup(DebugInterface *ifc)
   {
-  xAssert(!_interfaceMap.contains(ifc->interfaceID()));
-  xAssert(ifc->interfaceID() != std::numeric_limits<xuint32>::max());
-  _interfaceMap[ifc->interfaceID()] = ifc;
+  const xuint32 id = ifc->interfaceID();
+  xAssert(id < DebugInterface::PendingInterfaceID);
+  xAssert(!findInterface(id));
+
+  while(_interfaceTable.size() <= id)
+    {
+    _interfaceTable.pushBack(0);
+    }
+  _interfaceTable[id] = ifc;
 
   if(_watcher)
     {
     _watcher->onInterfaceRegistered(ifc);
     }
+  }
+
+void DebugManagerImpl::removeInterfaceLookup(DebugInterface *ifc)
+  {
+  const xuint32 id = ifc->interfaceID();
+  if(findInterface(id) == ifc)
+    {
+    _interfaceTable[id] = 0;
+    }
+  }
 
-  xAssert(_interfaces.size() == (int)_interfaceMap.size());
+DebugInterface *DebugManagerImpl::findInterface(xuint32 id) const
+  {
+  return id < _interfaceTable.size() ? _interfaceTable[id] : 0;
   }
 
 void DebugManagerImpl::setupController()
@@ -81,76 +369,1017 @@ void DebugManagerImpl::setupController()
 
 void DebugManagerImpl::clear()
   {
-  xAssert(!_outputLocked);
+  xAssert(!_localOutput->locked);
   _client = 0;
 
-  _readingID = Eks::maxFor(_readingID);
-  _bytesNeeded = 0;
-  _preConnectClientData.clear();
+  endReplay();
+  delete _decompressor;
+  _decompressor = 0;
+  _parser.clear();
+
+  _flowControlled = false;
+  _grantingCredit = false;
+  _credit = 0;
+  _processedBytes = 0;
+  _congested = false;
+  _statisticsTimer.stop();
+  _preConnect.clear();
+
+  _monitorTimer.stop();
+  _monitoring = false;
+  if(_monitor)
+    {
+    Eks::Core::defaultAllocator()->destroy(_monitor);
+    _monitor = 0;
+    }
+  _threadTimes.clear();
 
   DebugManager::unregisterInterface(_controller);
   Eks::Core::defaultAllocator()->destroy(_controller);
   _controller = 0;
   }
 
-void DebugManagerImpl::flush()
+DebugThreadOutput *DebugManagerImpl::threadOutput()
   {
-  xuint32 id = _outputLocked->interfaceID();
+  ThreadOutputGuard &guard = t_outputGuard;
+
+  if(guard.generation != _generation)
+    {
+    DebugThreadOutput *out = new DebugThreadOutput(this, StagingRingCapacity);
+    guard.output = out;
+    guard.generation = _generation;
 
-  QByteArray& buf = _scratchImpl.buffer();
+    out->next = _outputs.load(std::memory_order_relaxed);
+    while(!_outputs.compare_exchange_weak(
+            out->next,
+            out,
+            std::memory_order_release,
+            std::memory_order_relaxed))
+      {
+      }
+    }
 
-  _clientStream << id << (xuint32)buf.length();
-  _clientStream.writeRawData(buf, buf.length());
+  return guard.output;
   }
 
-void DebugManagerImpl::onConnected()
+void DebugManagerImpl::setupInterface(DebugInterface *ifc)
   {
-  _clientStream.setDevice(_client);
-  _clientStream.writeRawData(_preConnectClientData, _preConnectClientData.size());
-  _preConnectClientData.clear();
-  _preConnectClientData.squeeze();
+  xuint32 expected = DebugInterface::InvalidInterfaceID;
+  if(!ifc->_interfaceID.compare_exchange_strong(expected, DebugInterface::PendingInterfaceID))
+    {
+    while(ifc->interfaceID() == DebugInterface::PendingInterfaceID)
+      {
+      QThread::yieldCurrentThread();
+      }
+    return;
+    }
+
+  // Queue the setup before publishing the id, any thread which then stages a frame
+  // using the id is guaranteed the manager sees the setup first.
+  ifc->_pendingID = _controller->allocateInterfaceID();
+  ifc->_nextPendingSetup = _pendingSetups.load(std::memory_order_relaxed);
+  while(!_pendingSetups.compare_exchange_weak(
+          ifc->_nextPendingSetup,
+          ifc,
+          std::memory_order_release,
+          std::memory_order_relaxed))
+    {
+    }
+
+  ifc->setInterfaceID(ifc->_pendingID);
+
+  // the manager thread announces straight away, so its own frames follow the setup.
+  if(QThread::currentThread() == thread())
+    {
+    drainOutput(_localOutput);
+    }
   }
 
-void DebugManagerImpl::onDataReady()
+void DebugManagerImpl::beginFrame(DebugThreadOutput *out)
   {
-  xAssert(!_outputLocked);
+  xAssert(out->locked);
+  out->overflowed = false;
+  out->frameStart = out->ring.position();
+
+  out->discarding = discardFrame(out);
+  if(out->discarding)
+    {
+    return;
+    }
 
-  static const xsize HeaderSize = 8;
+  out->serialiseStart = 0;
+  if(_monitoring.load(std::memory_order_relaxed) &&
+     out->frames.load(std::memory_order_relaxed) % SerialiseSampleInterval == 0)
+    {
+    out->serialiseStart = monotonicNanoseconds();
+    }
+
+  // the length is backpatched once the payload is serialised.
+  const xuint32 header[] =
+    {
+    qToBigEndian(out->locked->interfaceID()),
+    0
+    };
+
+  if(reserve(out, sizeof(header)))
+    {
+    out->ring.append(header, sizeof(header));
+    }
+  else
+    {
+    out->overflowed = true;
+    }
+  }
 
-  xAssert(_interfaces.size() == (int)_interfaceMap.size());
+bool DebugManagerImpl::reserve(DebugThreadOutput *out, xsize size)
+  {
+  if(out->ring.uncommitted() + size > out->ring.capacity())
+    {
+    return false;
+    }
 
-  // while headers are available
-  xuint32 av = _client->bytesAvailable();
-  while(av > HeaderSize)
+  while(!out->ring.canAppend(size))
     {
-    if(_readingID == Eks::maxFor(_readingID))
+    if(out == _localOutput)
+      {
+      // mid frame this thread can't announce setups, but its committed frames
+      // never need one, so releasing those is enough.
+      writeRing(out, out->ring.acquire());
+      }
+    else if(_congested.load(std::memory_order_relaxed))
       {
-      _clientStream >> _readingID >> _bytesNeeded;
-      av -= HeaderSize;
+      // blocked on the debugger, which may take a while to grant credit.
+      scheduleDrain();
+      QThread::msleep(1);
       }
+    else
+      {
+      scheduleDrain();
+      QThread::yieldCurrentThread();
+      }
+    }
+
+  return true;
+  }
+
+bool DebugManagerImpl::discardFrame(DebugThreadOutput *out)
+  {
+  DebugInterface *ifc = out->locked;
+  if(!_congested.load(std::memory_order_relaxed) ||
+     ifc == _controller ||
+     ifc->_flowControlPolicy == DebugManager::FlowControlPolicy::Block ||
+     out->ring.used() < _flowControlBound.load(std::memory_order_relaxed))
+    {
+    return false;
+    }
+
+  if(ifc->_flowControlPolicy == DebugManager::FlowControlPolicy::Sample &&
+     ifc->_sampleCounter.fetch_add(1, std::memory_order_relaxed) % ifc->_sampleInterval == 0)
+    {
+    return false;
+    }
+
+  std::atomic<xuint64> &counter =
+    ifc->_flowControlPolicy == DebugManager::FlowControlPolicy::Drop ? _droppedFrames : _sampledOutFrames;
+  counter.fetch_add(1, std::memory_order_relaxed);
+  return true;
+  }
+
+void DebugManagerImpl::endFrame(DebugThreadOutput *out)
+  {
+  // the frame is released before anything drains, draining may announce setups,
+  // which are themselves frames sent from this thread.
+  DebugInterface *ifc = out->locked;
+  out->locked = 0;
+
+  if(out->discarding)
+    {
+    // passed the send limit, so it counts as sent, flow control counts the drop.
+    out->discarding = false;
+    countSent(out, ifc, 0);
+    return;
+    }
+
+  if(out->overflowed)
+    {
+    // a single frame larger than the ring can never be staged.
+    xAssertFail();
+    out->ring.rollback();
+    countSent(out, ifc, 0);
+    return;
+    }
+
+  const xsize frameSize = out->ring.position() - out->frameStart;
+  const xuint32 length = qToBigEndian((xuint32)(frameSize - HeaderSize));
+  out->ring.patch(out->frameStart + sizeof(xuint32), &length, sizeof(length));
+  out->ring.commit();
+
+  bump(out->frames, 1);
+  bump(out->bytes, frameSize);
+  if(out->serialiseStart)
+    {
+    bump(out->serialiseNanoseconds, monotonicNanoseconds() - out->serialiseStart);
+    bump(out->serialiseSamples, 1);
+    }
+  countSent(out, ifc, frameSize);
+
+  // controller messages are never held back, a debugger needs them to decode anything else.
+  const bool urgent = ifc == _controller || out->ring.used() >= BatchFlushSize;
+  if(!urgent)
+    {
+    scheduleBatch(out);
+    }
+  else if(out == _localOutput)
+    {
+    drainOutput(out);
+    }
+  else
+    {
+    scheduleDrain();
+    }
+  }
+
+
+void DebugManagerImpl::countSent(DebugThreadOutput *out, DebugInterface *ifc, xuint64 bytes)
+  {
+  const xuint32 slot = ifc->_counterSlot;
+  if(slot < DebugThreadOutput::CounterSlots)
+    {
+    bump(out->sentMessages[slot], 1);
+    bump(out->sentBytes[slot], bytes);
+    return;
+    }
 
-    // not enough data yet
-    if(av < _bytesNeeded)
+  ifc->_sentMessages.fetch_add(1, std::memory_order_relaxed);
+  ifc->_sentBytes.fetch_add(bytes, std::memory_order_relaxed);
+  }
+
+void DebugManagerImpl::assignCounterSlot(DebugInterface *ifc)
+  {
+  xAssert(QThread::currentThread() == thread());
+  ifc->_sentMessages.store(0, std::memory_order_relaxed);
+  ifc->_sentBytes.store(0, std::memory_order_relaxed);
+  if(_freeCounterSlots.isEmpty())
+    {
+    ifc->_counterSlot = DebugInterface::NoCounterSlot;
+    return;
+    }
+
+  ifc->_counterSlot = _freeCounterSlots.takeLast();
+
+  // the slot still holds its last interface's totals, which are offset away.
+  xuint64 messages = 0;
+  xuint64 bytes = 0;
+  sumCounterSlot(ifc->_counterSlot, messages, bytes);
+  ifc->_sentMessages.store(0 - messages, std::memory_order_relaxed);
+  ifc->_sentBytes.store(0 - bytes, std::memory_order_relaxed);
+  }
+
+void DebugManagerImpl::releaseCounterSlot(DebugInterface *ifc)
+  {
+  xAssert(QThread::currentThread() == thread());
+  if(ifc->_counterSlot < DebugThreadOutput::CounterSlots)
+    {
+    _freeCounterSlots << ifc->_counterSlot;
+    }
+  ifc->_counterSlot = DebugInterface::NoCounterSlot;
+  }
+
+void DebugManagerImpl::sumCounterSlot(xuint32 slot, xuint64 &messages, xuint64 &bytes) const
+  {
+  xAssert(slot < DebugThreadOutput::CounterSlots);
+  xAssert(QThread::currentThread() == thread());
+  for(DebugThreadOutput *out = _outputs.load(std::memory_order_acquire); out; out = out->next)
+    {
+    messages += out->sentMessages[slot].load(std::memory_order_relaxed);
+    bytes += out->sentBytes[slot].load(std::memory_order_relaxed);
+    }
+  }
+
+void DebugManagerImpl::sentTotals(const DebugInterface *ifc, xuint64 &messages, xuint64 &bytes) const
+  {
+  // with a slot these are offsets, wrapping back to the interface's own totals.
+  messages = ifc->_sentMessages.load(std::memory_order_relaxed);
+  bytes = ifc->_sentBytes.load(std::memory_order_relaxed);
+  if(ifc->_counterSlot < DebugThreadOutput::CounterSlots)
+    {
+    sumCounterSlot(ifc->_counterSlot, messages, bytes);
+    }
+  }
+
+void DebugManagerImpl::announcePendingInterfaces(DebugInterface *skip)
+  {
+  DebugInterface *pending = _pendingSetups.exchange(0, std::memory_order_acquire);
+  if(!pending)
+    {
+    return;
+    }
+
+  // the stack is newest first, announce in allocation order.
+  DebugInterface *ordered = 0;
+  while(pending)
+    {
+    DebugInterface *next = pending->_nextPendingSetup;
+    pending->_nextPendingSetup = ordered;
+    ordered = pending;
+    pending = next;
+    }
+
+  while(ordered)
+    {
+    DebugInterface *ifc = ordered;
+    ordered = ifc->_nextPendingSetup;
+    ifc->_nextPendingSetup = 0;
+
+    if(ifc == skip)
       {
-      return;
+      continue;
       }
 
-    DebugInterface *ifc = _interfaceMap.value(_readingID, 0);
-    xAssert(ifc);
+    _controller->announceInterface(ifc);
+    addInterfaceLookup(ifc);
+    }
+  }
+
+void DebugManagerImpl::flush()
+  {
+  if(QThread::currentThread() == thread())
+    {
+    drain();
+    }
+  else
+    {
+    scheduleDrain();
+    }
+  }
+
+void DebugManagerImpl::scheduleDrain()
+  {
+  if(!_drainScheduled.exchange(true, std::memory_order_acq_rel))
+    {
+    noteDrainRequest();
+    QMetaObject::invokeMethod(this, "drain", Qt::QueuedConnection);
+    }
+  }
+
+void DebugManagerImpl::noteDrainRequest()
+  {
+  if(!_monitoring.load(std::memory_order_relaxed))
+    {
+    return;
+    }
+
+  // the flush latency runs from the first request a drain serves.
+  xint64 none = 0;
+  _drainRequested.compare_exchange_strong(none, monotonicNanoseconds(), std::memory_order_relaxed);
+  }
 
-    ifc->onDataRecieved(_clientStream);
-    _readingID = Eks::maxFor(_readingID);
+void DebugManagerImpl::scheduleBatch(DebugThreadOutput *out)
+  {
+  if(out == _localOutput)
+    {
+    noteDrainRequest();
+    startBatchTimer();
+    }
+  else if(!_batchScheduled.exchange(true, std::memory_order_acq_rel))
+    {
+    noteDrainRequest();
+    QMetaObject::invokeMethod(this, "startBatchTimer", Qt::QueuedConnection);
+    }
+  }
 
-    av = _client->bytesAvailable();
+void DebugManagerImpl::startBatchTimer()
+  {
+  if(!_batchTimer.isActive())
+    {
+    _batchTimer.start();
+    }
+  }
+
+void DebugManagerImpl::drain()
+  {
+  xAssert(QThread::currentThread() == thread());
+  if(_draining)
+    {
+    return;
+    }
+
+  // everything staged so far goes out now, in one write per ring span.
+  _draining = true;
+  _batchTimer.stop();
+  _batchScheduled.exchange(false, std::memory_order_acq_rel);
+  _drainScheduled.exchange(false, std::memory_order_acq_rel);
+  const xint64 requested = _drainRequested.exchange(0, std::memory_order_relaxed);
+
+  for(DebugThreadOutput *out = _outputs.load(std::memory_order_acquire); out; out = out->next)
+    {
+    writeStaged(out);
+    }
+  releaseRetiredOutputs();
+
+  _draining = false;
+  finishDrain();
+
+  if(requested)
+    {
+    ++_flushLatency[(int)DebugManagerMonitor::flushLatencyBucket(monotonicNanoseconds() - requested)];
+    }
+  }
+
+void DebugManagerImpl::drainOutput(DebugThreadOutput *out)
+  {
+  if(_draining)
+    {
+    return;
+    }
+
+  _draining = true;
+  writeStaged(out);
+  _draining = false;
+  finishDrain();
+  }
+
+
+void DebugManagerImpl::releaseRetiredOutputs()
+  {
+  DebugThreadOutput *prev = 0;
+  DebugThreadOutput *out = _outputs.load(std::memory_order_acquire);
+  while(out)
+    {
+    DebugThreadOutput *next = out->next;
+
+    // a retired thread stages nothing more, but its frames may still wait on credit.
+    const bool release = out != _localOutput &&
+        out->retired.load(std::memory_order_acquire) &&
+        out->ring.acquire() == out->ring.tail();
+    if(!release)
+      {
+      prev = out;
+      out = next;
+      continue;
+      }
+
+    if(prev)
+      {
+      prev->next = next;
+      }
+    else
+      {
+      DebugThreadOutput *head = out;
+      if(!_outputs.compare_exchange_strong(head, next, std::memory_order_acq_rel))
+        {
+        // a thread pushed its output in front, [out] is released on a later drain.
+        prev = out;
+        out = next;
+        continue;
+        }
+      }
+
+    // the totals outlive the thread, the local output is only written on this thread too.
+    bump(_localOutput->frames, out->frames.load(std::memory_order_relaxed));
+    bump(_localOutput->bytes, out->bytes.load(std::memory_order_relaxed));
+    bump(_localOutput->serialiseNanoseconds, out->serialiseNanoseconds.load(std::memory_order_relaxed));
+    bump(_localOutput->serialiseSamples, out->serialiseSamples.load(std::memory_order_relaxed));
+    for(xsize i = 0; i < DebugThreadOutput::CounterSlots; ++i)
+      {
+      bump(_localOutput->sentMessages[i], out->sentMessages[i].load(std::memory_order_relaxed));
+      bump(_localOutput->sentBytes[i], out->sentBytes[i].load(std::memory_order_relaxed));
+      }
+
+    delete out;
+    out = next;
+    }
+  }
+
+void DebugManagerImpl::writeStaged(DebugThreadOutput *out)
+  {
+  const xsize end = out->ring.acquire();
+
+  // acquiring [out] makes every setup queued before its frames visible,
+  // those go out first, through the local ring.
+  announcePendingInterfaces();
+  writeRing(_localOutput, creditedEnd(_localOutput, _localOutput->ring.acquire()));
+
+  // out of credit the local ring may not be fully written, nor may anything relying on it.
+  if(out != _localOutput)
+    {
+    writeRing(out, creditedEnd(out, end));
+    }
+
+  if(_flowControlled)
+    {
+    _congested.store(_credit <= 0, std::memory_order_relaxed);
+    }
+  }
+
+void DebugManagerImpl::writeRing(DebugThreadOutput *out, xsize end)
+  {
+  if(_flowControlled)
+    {
+    _credit -= (xint64)(end - out->ring.tail());
+    }
+
+  out->ring.consume(end, [this](const char *data, xsize size)
+    {
+    if(_capture)
+      {
+      _capture->write(data, size);
+      }
+
+    _fanOut.append(data, size);
+
+    if(_compressor)
+      {
+      _compressInput.append(data, (int)size);
+      }
+    else
+      {
+      _clientStream.writeRawData(data, (int)size);
+      ++_transportWrites;
+      }
+    });
+
+  // each call consumes whole frames, so is recorded or dropped as one batch.
+  if(_capture)
+    {
+    _capture->commit();
+    }
+  }
+
+xsize DebugManagerImpl::creditedEnd(DebugThreadOutput *out, xsize end) const
+  {
+  if(!_flowControlled)
+    {
+    return end;
+    }
+
+  // whole frames only, while any credit remains. One frame may overdraw it, so a frame
+  // larger than the credit window still goes out.
+  xint64 credit = _credit;
+  xsize pos = out->ring.tail();
+  while(pos != end && credit > 0)
+    {
+    xuint32 header[2];
+    out->ring.read(pos, header, sizeof(header));
+    const xsize frameSize = HeaderSize + qFromBigEndian(header[1]);
+
+    pos += frameSize;
+    credit -= (xint64)frameSize;
+    }
+
+  return pos;
+  }
+
+void DebugManagerImpl::finishDrain()
+  {
+  submitCompression();
+
+  if(_fanOut.hasSubscribers())
+    {
+    _fanOut.pump();
+    }
+  }
+
+void DebugManagerImpl::submitCompression()
+  {
+  if(!_compressor || _compressInput.isEmpty())
+    {
+    return;
+    }
+
+  // the compressor thread takes the whole batch, this thread only ever copies spans.
+  QMetaObject::invokeMethod(_compressor, "compress", Qt::QueuedConnection, Q_ARG(QByteArray, _compressInput));
+  _compressInput = QByteArray();
+  }
+
+void DebugManagerImpl::acceptCapabilities(xuint32 caps)
+  {
+  if(!_isClient)
+    {
+    if(caps & DebugManager::FlowControl)
+      {
+      _grantingCredit = true;
+      _processedBytes = 0;
+      _credit = InitialCredit;
+      _controller->sendCredit(InitialCredit);
+      }
+    return;
+    }
+
+  caps &= _capabilities;
+
+  // the pre-connect buffer may have dropped the keyframes its oldest frames need.
+  DebugCompactWriter::forceKeyframes();
+
+  if(caps & DebugManager::Compression)
+    {
+    beginCompression();
+    }
+
+  if(caps & DebugManager::FlowControl)
+    {
+    // nothing more is written until the server's first grant.
+    _flowControlled = true;
+    _credit = 0;
+    }
+
+  if(caps & DebugManager::SendStatistics)
+    {
+    _statisticsTimer.start();
+    }
+
+  if((caps & DebugManager::Monitor) && !_monitor)
+    {
+    _monitor = Eks::Core::defaultAllocator()->create<DebugManagerMonitor>(_manager, true);
+    _monitoring = true;
+    _monitorTimer.start();
+    }
+  }
+
+void DebugManagerImpl::reportMonitor()
+  {
+  DebugManagerMonitor::Report report;
+  xForeach(DebugInterface *ifc, _interfaceTable)
+    {
+    if(!ifc || ifc == _controller)
+      {
+      continue;
+      }
+
+    DebugManagerMonitor::Report::InterfaceEntry entry;
+    entry.id = ifc->interfaceID();
+    sentTotals(ifc, entry.messages, entry.bytes);
+    report.interfaces << entry;
+    }
+
+  report.frames = 0;
+  report.bytes = 0;
+  report.serialiseNanoseconds = 0;
+  report.serialiseSamples = 0;
+  for(DebugThreadOutput *out = _outputs.load(std::memory_order_acquire); out; out = out->next)
+    {
+    report.frames += out->frames.load(std::memory_order_relaxed);
+    report.bytes += out->bytes.load(std::memory_order_relaxed);
+    report.serialiseNanoseconds += out->serialiseNanoseconds.load(std::memory_order_relaxed);
+    report.serialiseSamples += out->serialiseSamples.load(std::memory_order_relaxed);
+    }
+
+  report.dataReadyIterations = _dataReadyIterations;
+  report.preConnectBytes = _preConnect.statistics().bufferedBytes;
+  report.writeQueueBytes = _client ? _client->bytesToWrite() : 0;
+
+  report.flushLatency = _flushLatency;
+  _flushLatency.fill(0);
+
+  _monitor->sendReport(report);
+  }
+
+void DebugManagerImpl::reportSendStatistics()
+  {
+  _controller->sendInterfaceStatistics(_interfaceTable);
+  }
+
+void DebugManagerImpl::grantCredit(xuint64 bytes)
+  {
+  xAssert(_isClient);
+  if(!_flowControlled)
+    {
+    return;
+    }
+
+  _credit += (xint64)bytes;
+  if(_credit > 0)
+    {
+    _congested.store(false, std::memory_order_relaxed);
+    drain();
+    }
+  }
+
+DebugManager::QueueStatistics DebugManagerImpl::queueStatistics() const
+  {
+  DebugManager::QueueStatistics stats;
+  stats.credit = _credit;
+  stats.queuedBytes = 0;
+  stats.transportBytes = 0;
+  stats.droppedFrames = _droppedFrames.load(std::memory_order_relaxed);
+  stats.sampledOutFrames = _sampledOutFrames.load(std::memory_order_relaxed);
+  stats.transportWrites = _transportWrites;
+  stats.threadOutputs = 0;
+
+  if(_isClient)
+    {
+    for(DebugThreadOutput *out = _outputs.load(std::memory_order_acquire); out; out = out->next)
+      {
+      stats.queuedBytes += out->ring.acquire() - out->ring.tail();
+      ++stats.threadOutputs;
+      }
+    stats.transportBytes = _client ? _client->bytesToWrite() : 0;
+    }
+  else
+    {
+    stats.queuedBytes = _parser.buffer().size() + (_decompressor ? _decompressor->input().size() : 0);
+    stats.transportBytes = _client ? _client->bytesAvailable() : 0;
+    }
+
+  return stats;
+  }
+
+void DebugManagerImpl::beginCompression()
+  {
+  xAssert(QThread::currentThread() == thread());
+  if(_compressor || !_client)
+    {
+    return;
+    }
+
+  // the marker is the last uncompressed frame. Captures and subscribers are sent the stream
+  // before compression, so it bypasses the rings and goes to the transport alone.
+  const QByteArray marker = _controller->compressionStartFrame();
+  _clientStream.writeRawData(marker.constData(), marker.size());
+  ++_transportWrites;
+
+  _compressThread = new QThread;
+  _compressor = new DebugStreamCompressor;
+  _compressor->moveToThread(_compressThread);
+  connect(_compressor, SIGNAL(compressed(QByteArray)), this, SLOT(onCompressed(QByteArray)));
+  _compressThread->start(QThread::LowPriority);
+  }
+
+void DebugManagerImpl::endCompression()
+  {
+  if(!_compressor)
+    {
+    return;
+    }
+
+  // queued calls run in order, so once this returns every batch has been compressed.
+  QMetaObject::invokeMethod(_compressor, "compress", Qt::BlockingQueuedConnection, Q_ARG(QByteArray, _compressInput));
+  _compressInput = QByteArray();
+
+  _compressThread->quit();
+  _compressThread->wait();
+
+  // write the blocks still queued to this thread.
+  QCoreApplication::sendPostedEvents(this, QEvent::MetaCall);
+
+  delete _compressor;
+  _compressor = 0;
+  delete _compressThread;
+  _compressThread = 0;
+  }
+
+void DebugManagerImpl::onCompressed(const QByteArray &data)
+  {
+  if(_client)
+    {
+    _clientStream.writeRawData(data.constData(), data.size());
+    ++_transportWrites;
+    }
+  }
+
+void DebugManagerImpl::beginDecompression()
+  {
+  xAssert(!_decompressor);
+  if(!_client)
+    {
+    // replaying a capture, which holds the stream before compression.
+    return;
+    }
+
+  // bytes already read past the marker are blocks, as is everything still to come.
+  _decompressor = new DebugStreamDecompressor;
+  _parser.takeUnparsed(_decompressor->input());
+  }
+
+bool DebugManagerImpl::readInput()
+  {
+  if(!_decompressor)
+    {
+    const qint64 read = _client->read(_parser.buffer().reserve(ReadChunkSize), ReadChunkSize);
+    _parser.buffer().commit(read > 0 ? (xsize)read : 0);
+    return read > 0;
+    }
+
+  DebugReceiveBuffer &input = _decompressor->input();
+  const qint64 read = _client->read(input.reserve(ReadChunkSize), ReadChunkSize);
+  input.commit(read > 0 ? (xsize)read : 0);
+
+  xsize produced = 0;
+  if(!_decompressor->decode(_parser.buffer(), produced))
+    {
+    qCritical() << "Corrupt compressed block from debug client";
+    input.clear();
+    return false;
+    }
+
+  // compressed bytes may arrive without completing a block.
+  return produced > 0 || read > 0;
+  }
+
+void DebugManagerImpl::onConnected()
+  {
+  _clientStream.setDevice(_client);
+  _preConnect.replay(_client);
+  }
+
+void DebugManagerImpl::dispatchFrame(const DebugFrameParser::Frame &frame)
+  {
+  DebugInterface *ifc = findInterface(frame.id);
+  if(!ifc)
+    {
+    xAssertFail();
+    qWarning() << "Data recieved for unknown interface" << frame.id;
+    return;
+    }
+
+  ifc->onDataRecieved(_parser.stream(frame));
+  }
+
+void DebugManagerImpl::onDataReady()
+  {
+  xAssert(!_localOutput->locked);
+
+  // frames are delimited by the parser, so a reciever can't desync the stream.
+  while(_client && readInput())
+    {
+    ++_dataReadyIterations;
+
+    DebugFrameParser::Frame frame;
+    while(_client && _parser.nextFrame(frame))
+      {
+      dispatchFrame(frame);
+
+      if(_grantingCredit)
+        {
+        _processedBytes += HeaderSize + frame.size;
+        _credit -= (xint64)(HeaderSize + frame.size);
+        }
+      }
+    }
+
+  // credit is granted for what has been processed, so a slow debugger slows the client.
+  if(_client && _grantingCredit && _processedBytes >= CreditGrantSize)
+    {
+    _controller->sendCredit(_processedBytes);
+    _credit += (xint64)_processedBytes;
+    _processedBytes = 0;
+    }
+  }
+
+void DebugManagerImpl::addSubscriber(QIODevice *device)
+  {
+  xAssert(QThread::currentThread() == thread());
+
+  // like a capture, the subscriber starts from a frame boundary with every setup so far,
+  // and each thread's next time is a keyframe it can resolve.
+  DebugCompactWriter::forceKeyframes();
+  drain();
+  _fanOut.addSubscriber(device, _controller->setupSnapshot(_interfaceTable));
+  _fanOut.pump();
+  }
+
+bool DebugManagerImpl::startCapture(const QString &path)
+  {
+  xAssert(QThread::currentThread() == thread());
+  stopCapture();
+
+  // frames staged before now aren't recorded, the snapshot holds the setups they relied on.
+  // Times are deltas, so each thread's next is forced to be a keyframe.
+  DebugCompactWriter::forceKeyframes();
+  drain();
+
+  _capture = new DebugCaptureWriter;
+  if(!_capture->start(path))
+    {
+    delete _capture;
+    _capture = 0;
+    return false;
+    }
+
+  const QByteArray snapshot = _controller->setupSnapshot(_interfaceTable);
+  _capture->write(snapshot.constData(), snapshot.size());
+  _capture->commit();
+  return true;
+  }
+
+void DebugManagerImpl::stopCapture()
+  {
+  if(!_capture)
+    {
+    return;
+    }
+
+  drain();
+
+  _capture->stop();
+  _lastCaptureStatistics = _capture->statistics();
+  delete _capture;
+  _capture = 0;
+  }
+
+DebugManager::CaptureStatistics DebugManagerImpl::captureStatistics() const
+  {
+  return _capture ? _capture->statistics() : _lastCaptureStatistics;
+  }
+
+bool DebugManagerImpl::replayCapture(const QString &path)
+  {
+  QFile *file = new QFile(path);
+  const uchar *data = 0;
+  if(file->open(QIODevice::ReadOnly))
+    {
+    data = file->map(0, file->size());
+    }
+
+  if(!data ||
+     file->size() < DebugCaptureWriter::HeaderSize ||
+     memcmp(data, DebugCaptureWriter::CaptureMagic, DebugCaptureWriter::HeaderSize) != 0)
+    {
+    qWarning() << "Failed to open capture" << path;
+    delete file;
+    return false;
+    }
+
+  // a capture replaces whatever was shown, as if a new client connected.
+  clear();
+  setupController();
+
+  _replayFile = file;
+  _replayData = data;
+  _replaySize = (xsize)file->size();
+  _replayPosition = DebugCaptureWriter::HeaderSize;
+
+  QMetaObject::invokeMethod(this, "continueReplay", Qt::QueuedConnection);
+  return true;
+  }
+
+void DebugManagerImpl::continueReplay()
+  {
+  if(!_replayFile)
+    {
+    return;
+    }
+
+  const xsize end = xMin(_replaySize, _replayPosition + ReplayChunkSize);
+  _parser.buffer().append((const char *)_replayData + _replayPosition, end - _replayPosition);
+  _replayPosition = end;
+
+  DebugFrameParser::Frame frame;
+  while(_replayFile && _parser.nextFrame(frame))
+    {
+    // a capture cut short keeps its preallocated tail, which reads as empty controller frames.
+    if(frame.id == 0 && frame.size == 0)
+      {
+      _replayPosition = _replaySize;
+      break;
+      }
+
+    dispatchFrame(frame);
+    }
+
+  if(!_replayFile)
+    {
+    return;
+    }
+
+  if(_replayPosition < _replaySize)
+    {
+    // yield to the event loop between chunks, so long captures keep the debugger responsive.
+    QMetaObject::invokeMethod(this, "continueReplay", Qt::QueuedConnection);
+    }
+  else
+    {
+    _parser.clear();
+    endReplay();
+    }
+  }
+
+void DebugManagerImpl::endReplay(bool notify)
+  {
+  if(!_replayFile)
+    {
+    return;
+    }
+
+  _replayFile->unmap(const_cast<uchar *>(_replayData));
+  delete _replayFile;
+  _replayFile = 0;
+  _replayData = 0;
+  _replaySize = _replayPosition = 0;
+
+  if(notify && _watcher)
+    {
+    _watcher->onReplayFinished();
     }
   }
 
 void DebugManagerImpl::onNewConnection()
   {
-  while(QTcpSocket *s = _server->nextPendingConnection())
+  while(QIODevice *s = _transport->nextPendingConnection())
     {
     if(_client)
       {
+      // clients fan out to several debuggers themselves, a debugger shows one client at a time.
       qCritical() << "New client detected, clearing old data.";
       clear();
       setupController();
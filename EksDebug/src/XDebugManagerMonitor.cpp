@@ -0,0 +1,188 @@
+#include "XDebugManagerMonitor.h"
+#include "Math/XMathHelpers.h"
+#include "QDataStream"
+
+namespace Eks
+{
+
+X_IMPLEMENT_DEBUG_INTERFACE(DebugManagerMonitor)
+
+QDataStream &operator<<(QDataStream &s, const DebugManagerMonitor::Report &r)
+  {
+  s << (xuint32)r.interfaces.size();
+  xForeach(const DebugManagerMonitor::Report::InterfaceEntry &e, r.interfaces)
+    {
+    s << e.id << e.messages << e.bytes;
+    }
+
+  return s << r.frames
+           << r.bytes
+           << r.serialiseNanoseconds
+           << r.serialiseSamples
+           << r.dataReadyIterations
+           << r.preConnectBytes
+           << r.writeQueueBytes
+           << r.flushLatency;
+  }
+
+QDataStream &operator>>(QDataStream &s, DebugManagerMonitor::Report &r)
+  {
+  xuint32 count = 0;
+  s >> count;
+
+  r.interfaces.clear();
+  for(xuint32 i = 0; i < count && s.status() == QDataStream::Ok; ++i)
+    {
+    DebugManagerMonitor::Report::InterfaceEntry e;
+    s >> e.id >> e.messages >> e.bytes;
+    r.interfaces << e;
+    }
+
+  return s >> r.frames
+           >> r.bytes
+           >> r.serialiseNanoseconds
+           >> r.serialiseSamples
+           >> r.dataReadyIterations
+           >> r.preConnectBytes
+           >> r.writeQueueBytes
+           >> r.flushLatency;
+  }
+
+DebugManagerMonitor::DebugManagerMonitor(DebugManager *, bool client)
+  {
+  if(!client)
+    {
+    _model = createDataModel<DebugMonitorModel>();
+    }
+
+  static Reciever recv[] =
+    {
+    recieveFunction<Report, DebugManagerMonitor, &DebugManagerMonitor::onReport>(),
+    };
+
+  static const DispatchTable dispatch(recv, X_ARRAY_COUNT(recv));
+  setRecievers(dispatch);
+  }
+
+DebugManagerMonitor::~DebugManagerMonitor()
+  {
+  }
+
+xsize DebugManagerMonitor::flushLatencyBucket(xint64 nanoseconds)
+  {
+  xsize bucket = 0;
+  for(xint64 us = nanoseconds / 1000; us > 0 && bucket < FlushLatencyBuckets - 1; us >>= 1)
+    {
+    ++bucket;
+    }
+  return bucket;
+  }
+
+void DebugManagerMonitor::sendReport(const Report &r)
+  {
+  sendData(r);
+  }
+
+void DebugManagerMonitor::onReport(const Report &r)
+  {
+  if(_model.value())
+    {
+    _model->setReport(r);
+    }
+  }
+
+DebugMonitorModel::DebugMonitorModel()
+    : _flushLatency(DebugManagerMonitor::FlushLatencyBuckets, 0),
+      _lastSerialiseNanoseconds(0),
+      _lastSerialiseSamples(0)
+  {
+  }
+
+void DebugMonitorModel::setReport(const DebugManagerMonitor::Report &r)
+  {
+  Rows rows;
+  rows << qMakePair(QString("Frames"), QString::number(r.frames));
+  rows << qMakePair(QString("Bytes"), QString::number(r.bytes));
+  rows << qMakePair(QString("Pre-connect buffer"), QString::number(r.preConnectBytes));
+  rows << qMakePair(QString("Socket write queue"), QString::number(r.writeQueueBytes));
+  rows << qMakePair(QString("onDataReady iterations"), QString::number(r.dataReadyIterations));
+
+  // the mean over frames timed since the last report, most aren't.
+  const xuint64 samples = r.serialiseSamples - _lastSerialiseSamples;
+  if(samples)
+    {
+    const xuint64 mean = (r.serialiseNanoseconds - _lastSerialiseNanoseconds) / samples;
+    rows << qMakePair(QString("Serialise time (ns)"), QString::number(mean));
+    }
+  else
+    {
+    rows << qMakePair(QString("Serialise time (ns)"), QString("-"));
+    }
+  _lastSerialiseNanoseconds = r.serialiseNanoseconds;
+  _lastSerialiseSamples = r.serialiseSamples;
+
+  for(int i = 0; i < r.flushLatency.size() && i < _flushLatency.size(); ++i)
+    {
+    _flushLatency[i] += r.flushLatency[i];
+    }
+
+  for(int i = 0; i < _flushLatency.size(); ++i)
+    {
+    const QString name = i == _flushLatency.size() - 1 ?
+      QString("Flush latency >= %1us").arg(1 << (i - 1)) :
+      QString("Flush latency < %1us").arg(1 << i);
+    rows << qMakePair(name, QString::number(_flushLatency[i]));
+    }
+
+  xForeach(const DebugManagerMonitor::Report::InterfaceEntry &e, r.interfaces)
+    {
+    DebugInterface *ifc = DebugManager::findInterface(e.id);
+    const QString name = QString("%1 %2").arg(ifc ? ifc->typeName() : QString("Interface")).arg(e.id);
+    rows << qMakePair(name, QString("%1 messages, %2 bytes").arg(e.messages).arg(e.bytes));
+    }
+
+  if(rows.size() == _rows.size())
+    {
+    _rows = rows;
+    emit dataChanged(index(0, 0), index(_rows.size() - 1, 1));
+    }
+  else
+    {
+    beginResetModel();
+    _rows = rows;
+    endResetModel();
+    }
+  }
+
+int DebugMonitorModel::rowCount(const QModelIndex &parent) const
+  {
+  return parent.isValid() ? 0 : _rows.size();
+  }
+
+int DebugMonitorModel::columnCount(const QModelIndex &parent) const
+  {
+  return parent.isValid() ? 0 : 2;
+  }
+
+QVariant DebugMonitorModel::data(const QModelIndex &index, int role) const
+  {
+  if(role != Qt::DisplayRole || !index.isValid() || index.row() >= _rows.size())
+    {
+    return QVariant();
+    }
+
+  const QPair<QString, QString> &row = _rows[index.row()];
+  return index.column() == 0 ? row.first : row.second;
+  }
+
+QVariant DebugMonitorModel::headerData(int section, Qt::Orientation orientation, int role) const
+  {
+  if(role != Qt::DisplayRole || orientation != Qt::Horizontal)
+    {
+    return QVariant();
+    }
+
+  return section == 0 ? QString("Statistic") : QString("Value");
+  }
+
+}
@@ -0,0 +1,495 @@
+#include "XDebugMetrics.h"
+#include "Math/XMathHelpers.h"
+#include "QDataStream"
+
+namespace Eks
+{
+
+X_IMPLEMENT_DEBUG_INTERFACE(DebugMetricsInterface)
+
+static std::atomic<xuint32> g_metricsSerial(0);
+
+namespace
+{
+
+// a value only one thread writes, readers on other threads just need a whole value.
+template <typename T> inline void bump(std::atomic<T> &value, T delta)
+  {
+  value.store(value.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+  }
+
+xsize highestBit(xuint64 v)
+  {
+  xsize bit = 0;
+  for(xsize shift = 32; shift; shift >>= 1)
+    {
+    if(v >> shift)
+      {
+      v >>= shift;
+      bit += shift;
+      }
+    }
+  return bit;
+  }
+
+/// The lowest value of the bucket holding the [rank]th value, counting from 1.
+xint64 rankValue(const std::vector<xuint64> &buckets, xuint64 rank)
+  {
+  xuint64 seen = 0;
+  for(xsize i = 0; i < buckets.size(); ++i)
+    {
+    seen += buckets[i];
+    if(seen >= rank)
+      {
+      return DebugMetricsInterface::histogramBucketValue(i);
+      }
+    }
+  return 0;
+  }
+
+xuint64 percentileRank(xuint64 count, xuint64 percent)
+  {
+  return xMax((xuint64)1, (count * percent + 99) / 100);
+  }
+
+}
+
+QDataStream &operator<<(QDataStream &s, const DebugMetricsInterface::Definition &d)
+  {
+  return s << d.metric << (xuint8)d.type << d.name;
+  }
+
+QDataStream &operator>>(QDataStream &s, DebugMetricsInterface::Definition &d)
+  {
+  xuint8 type = 0;
+  s >> d.metric >> type >> d.name;
+  d.type = (DebugMetricsInterface::MetricType)type;
+  return s;
+  }
+
+QDataStream &operator<<(QDataStream &s, const DebugMetricsInterface::Summary &sum)
+  {
+  s << sum.time << (xuint32)sum.entries.size();
+  xForeach(const DebugMetricsInterface::Summary::Entry &e, sum.entries)
+    {
+    s << e.metric << (xuint8)e.type << e.value << e.count;
+    if(e.type == DebugMetricsInterface::MetricType::Histogram)
+      {
+      s << e.min << e.p50 << e.p90 << e.p99 << e.max;
+      }
+    }
+  return s;
+  }
+
+QDataStream &operator>>(QDataStream &s, DebugMetricsInterface::Summary &sum)
+  {
+  xuint32 count = 0;
+  s >> sum.time >> count;
+
+  sum.entries.clear();
+  for(xuint32 i = 0; i < count && s.status() == QDataStream::Ok; ++i)
+    {
+    DebugMetricsInterface::Summary::Entry e = { 0, DebugMetricsInterface::MetricType::Gauge, 0, 0, 0, 0, 0, 0, 0 };
+    xuint8 type = 0;
+    s >> e.metric >> type >> e.value >> e.count;
+    e.type = (DebugMetricsInterface::MetricType)type;
+    if(e.type == DebugMetricsInterface::MetricType::Histogram)
+      {
+      s >> e.min >> e.p50 >> e.p90 >> e.p99 >> e.max;
+      }
+    sum.entries << e;
+    }
+  return s;
+  }
+
+DebugMetricsInterface::Histogram::Histogram()
+  {
+  for(xsize i = 0; i < HistogramBuckets; ++i)
+    {
+    buckets[i].store(0, std::memory_order_relaxed);
+    }
+  sum.store(0, std::memory_order_relaxed);
+  }
+
+DebugMetricsInterface::Shard::Shard()
+    : thread(std::this_thread::get_id()),
+      next(0)
+  {
+  for(xsize i = 0; i < MaxMetrics; ++i)
+    {
+    counters[i].store(0, std::memory_order_relaxed);
+    histograms[i].store(0, std::memory_order_relaxed);
+    }
+  }
+
+DebugMetricsInterface::DebugMetricsInterface(DebugManager *, bool client)
+    : _serial(++g_metricsSerial),
+      _shards(0),
+      _metricCount(0),
+      _summaries(0)
+  {
+  for(xsize i = 0; i < MaxMetrics; ++i)
+    {
+    _gauges[i].store(0, std::memory_order_relaxed);
+    _lastCounters[i] = 0;
+    }
+
+  if(client)
+    {
+    startTimer(SummaryInterval);
+    }
+  else
+    {
+    _model = createDataModel<DebugMetricsData>();
+    }
+
+  static Reciever recv[] =
+    {
+    recieveFunction<Definition, DebugMetricsInterface, &DebugMetricsInterface::onDefinition>(),
+    recieveFunction<Summary, DebugMetricsInterface, &DebugMetricsInterface::onSummary>(),
+    };
+
+  static const DispatchTable dispatch(recv, X_ARRAY_COUNT(recv));
+  setRecievers(dispatch);
+  }
+
+DebugMetricsInterface::~DebugMetricsInterface()
+  {
+  auto alloc = Eks::Core::defaultAllocator();
+  for(Shard *s = _shards.load(std::memory_order_acquire); s;)
+    {
+    for(xsize i = 0; i < MaxMetrics; ++i)
+      {
+      if(Histogram *h = s->histograms[i].load(std::memory_order_relaxed))
+        {
+        alloc->destroy(h);
+        }
+      }
+
+    Shard *next = s->next;
+    alloc->destroy(s);
+    s = next;
+    }
+  }
+
+DebugMetricsInterface::Metric DebugMetricsInterface::addMetric(const QString &name, MetricType type)
+  {
+  std::lock_guard<std::mutex> lock(_definitionLock);
+
+  const Metric metric = _metricCount.load(std::memory_order_relaxed);
+  if(metric == MaxMetrics)
+    {
+    return InvalidMetric;
+    }
+
+  _types[metric] = type;
+  _names[metric] = name;
+  _metricCount.store(metric + 1, std::memory_order_release);
+
+  const Definition d = { metric, type, name };
+  sendData(d);
+
+  return metric;
+  }
+
+void DebugMetricsInterface::setGauge(Metric metric, xint64 value)
+  {
+  xAssert(metric < _metricCount.load(std::memory_order_relaxed));
+  xAssert(_types[metric] == MetricType::Gauge);
+
+  _gauges[metric].store(value, std::memory_order_relaxed);
+  }
+
+void DebugMetricsInterface::addCount(Metric metric, xint64 delta)
+  {
+  xAssert(metric < _metricCount.load(std::memory_order_relaxed));
+  xAssert(_types[metric] == MetricType::Counter);
+
+  bump(shard()->counters[metric], delta);
+  }
+
+void DebugMetricsInterface::recordValue(Metric metric, xint64 value)
+  {
+  xAssert(metric < _metricCount.load(std::memory_order_relaxed));
+  xAssert(_types[metric] == MetricType::Histogram);
+
+  value = xMax(value, (xint64)0);
+
+  Histogram *h = histogram(shard(), metric);
+  bump(h->buckets[histogramBucket(value)], (xuint64)1);
+  bump(h->sum, value);
+  }
+
+DebugMetricsInterface::Shard *DebugMetricsInterface::shard()
+  {
+  static thread_local xuint32 t_serial = 0;
+  static thread_local Shard *t_shard = 0;
+
+  if(t_serial == _serial)
+    {
+    return t_shard;
+    }
+
+  // the cache may have moved to another interface since, so look before adding a shard.
+  const std::thread::id self = std::this_thread::get_id();
+  Shard *s = _shards.load(std::memory_order_acquire);
+  while(s && s->thread != self)
+    {
+    s = s->next;
+    }
+
+  if(!s)
+    {
+    s = Eks::Core::defaultAllocator()->create<Shard>();
+
+    s->next = _shards.load(std::memory_order_relaxed);
+    while(!_shards.compare_exchange_weak(
+            s->next,
+            s,
+            std::memory_order_release,
+            std::memory_order_relaxed))
+      {
+      }
+    }
+
+  t_serial = _serial;
+  t_shard = s;
+  return s;
+  }
+
+DebugMetricsInterface::Histogram *DebugMetricsInterface::histogram(Shard *s, Metric metric)
+  {
+  // only this thread sets its shard's histograms.
+  Histogram *h = s->histograms[metric].load(std::memory_order_relaxed);
+  if(!h)
+    {
+    h = Eks::Core::defaultAllocator()->create<Histogram>();
+    s->histograms[metric].store(h, std::memory_order_release);
+    }
+  return h;
+  }
+
+xsize DebugMetricsInterface::histogramBucket(xint64 value)
+  {
+  if(value < HistogramSubBuckets)
+    {
+    return value < 0 ? 0 : (xsize)value;
+    }
+
+  const xuint64 v = (xuint64)value;
+  const xsize exponent = highestBit(v);
+  const xsize subBucket = (xsize)(v >> (exponent - HistogramSubBucketBits)) & (HistogramSubBuckets - 1);
+
+  return (exponent - HistogramSubBucketBits + 1) * HistogramSubBuckets + subBucket;
+  }
+
+xint64 DebugMetricsInterface::histogramBucketValue(xsize bucket)
+  {
+  if(bucket < HistogramSubBuckets)
+    {
+    return (xint64)bucket;
+    }
+
+  const xsize exponent = bucket / HistogramSubBuckets + HistogramSubBucketBits - 1;
+  const xint64 subBucket = (xint64)(bucket % HistogramSubBuckets);
+
+  return (HistogramSubBuckets + subBucket) << (exponent - HistogramSubBucketBits);
+  }
+
+DebugMetricsInterface::Summary DebugMetricsInterface::summarise()
+  {
+  std::lock_guard<std::mutex> lock(_summaryLock);
+
+  Summary summary;
+  summary.time = Eks::Time::now();
+
+  const xuint32 count = _metricCount.load(std::memory_order_acquire);
+  Shard *shards = _shards.load(std::memory_order_acquire);
+
+  std::vector<xuint64> buckets;
+  for(Metric m = 0; m < count; ++m)
+    {
+    Summary::Entry e = { m, _types[m], 0, 0, 0, 0, 0, 0, 0 };
+
+    if(e.type == MetricType::Gauge)
+      {
+      e.value = _gauges[m].load(std::memory_order_relaxed);
+      }
+    else if(e.type == MetricType::Counter)
+      {
+      xint64 total = 0;
+      for(Shard *s = shards; s; s = s->next)
+        {
+        total += s->counters[m].load(std::memory_order_relaxed);
+        }
+
+      e.value = total;
+      e.count = total - _lastCounters[m];
+      _lastCounters[m] = total;
+      }
+    else
+      {
+      if(_lastHistograms.size() <= m)
+        {
+        _lastHistograms.resize(count);
+        }
+
+      HistogramTotals &last = _lastHistograms[m];
+      if(last.buckets.empty())
+        {
+        last.buckets.resize(HistogramBuckets, 0);
+        last.sum = 0;
+        }
+
+      buckets.assign(HistogramBuckets, 0);
+      xint64 sum = 0;
+      for(Shard *s = shards; s; s = s->next)
+        {
+        if(Histogram *h = s->histograms[m].load(std::memory_order_acquire))
+          {
+          for(xsize i = 0; i < HistogramBuckets; ++i)
+            {
+            buckets[i] += h->buckets[i].load(std::memory_order_relaxed);
+            }
+          sum += h->sum.load(std::memory_order_relaxed);
+          }
+        }
+
+      // keep the totals and summarise the difference, values recorded since the last summary.
+      xuint64 recorded = 0;
+      for(xsize i = 0; i < HistogramBuckets; ++i)
+        {
+        const xuint64 total = buckets[i];
+        buckets[i] = total - last.buckets[i];
+        last.buckets[i] = total;
+        recorded += buckets[i];
+        }
+
+      const xint64 recordedSum = sum - last.sum;
+      last.sum = sum;
+
+      e.count = (xint64)recorded;
+      if(recorded)
+        {
+        e.value = recordedSum / (xint64)recorded;
+        e.min = rankValue(buckets, 1);
+        e.p50 = rankValue(buckets, percentileRank(recorded, 50));
+        e.p90 = rankValue(buckets, percentileRank(recorded, 90));
+        e.p99 = rankValue(buckets, percentileRank(recorded, 99));
+        e.max = rankValue(buckets, recorded);
+        }
+      }
+
+    summary.entries << e;
+    }
+
+  return summary;
+  }
+
+void DebugMetricsInterface::sendSummary()
+  {
+  const Summary summary = summarise();
+  if(summary.entries.isEmpty())
+    {
+    return;
+    }
+
+  if(_summaries.fetch_add(1, std::memory_order_relaxed) % DefinitionInterval == DefinitionInterval - 1)
+    {
+    sendDefinitions();
+    }
+
+  sendData(summary);
+  }
+
+void DebugMetricsInterface::sendDefinitions()
+  {
+  std::lock_guard<std::mutex> lock(_definitionLock);
+
+  const xuint32 count = _metricCount.load(std::memory_order_relaxed);
+  for(Metric m = 0; m < count; ++m)
+    {
+    const Definition d = { m, _types[m], _names[m] };
+    sendData(d);
+    }
+  }
+
+void DebugMetricsInterface::timerEvent(QTimerEvent *)
+  {
+  sendSummary();
+  }
+
+void DebugMetricsInterface::onDefinition(const Definition &d)
+  {
+  if(_model.value())
+    {
+    _model->setDefinition(d);
+    }
+  }
+
+void DebugMetricsInterface::onSummary(const Summary &s)
+  {
+  if(_model.value())
+    {
+    _model->addSummary(s);
+    }
+  }
+
+void DebugMetricsData::setDefinition(const DebugMetricsInterface::Definition &d)
+  {
+  const xsize i = findSeries(d.metric);
+  if(i != X_SIZE_SENTINEL)
+    {
+    Series &series = _series[(int)i];
+    series.type = d.type;
+    series.name = d.name;
+    emit seriesChanged(i);
+    return;
+    }
+
+  Series series;
+  series.metric = d.metric;
+  series.type = d.type;
+  series.name = d.name;
+  _series << series;
+  emit seriesAdded(_series.size() - 1);
+  }
+
+void DebugMetricsData::addSummary(const DebugMetricsInterface::Summary &s)
+  {
+  xForeach(const DebugMetricsInterface::Summary::Entry &e, s.entries)
+    {
+    xsize i = findSeries(e.metric);
+    if(i == X_SIZE_SENTINEL)
+      {
+      // the definition was missed, it is sent again soon.
+      Series series;
+      series.metric = e.metric;
+      series.type = e.type;
+      series.name = QString("Metric %1").arg(e.metric);
+      _series << series;
+
+      i = _series.size() - 1;
+      emit seriesAdded(i);
+      }
+
+    const Point p = { s.time, e };
+    _series[(int)i].points << p;
+    }
+
+  emit summaryAdded(s.time);
+  }
+
+xsize DebugMetricsData::findSeries(DebugMetricsInterface::Metric metric) const
+  {
+  for(int i = 0; i < _series.size(); ++i)
+    {
+    if(_series[i].metric == metric)
+      {
+      return (xsize)i;
+      }
+    }
+  return X_SIZE_SENTINEL;
+  }
+
+}
@@ -0,0 +1,292 @@
+#include "XDebugPreConnectBuffer.h"
+#include "Utilities/XAssert.h"
+#include "Math/XMathHelpers.h"
+#include "QtEndian"
+#include "QDebug"
+#include <cstring>
+
+namespace Eks
+{
+
+static const xsize DefaultPreConnectBudget = 4 * 1024 * 1024;
+// the controller always owns interface id 0.
+static const xuint32 ControllerInterfaceID = 0;
+
+DebugPreConnectBuffer::DebugPreConnectBuffer()
+    : _policy(DebugManager::PreConnectPolicy::DropOldest),
+      _head(0),
+      _tail(0),
+      _headerBytes(0),
+      _frameID(0),
+      _frameRemaining(0),
+      _frameDropped(false)
+  {
+  memset(&_statistics, 0, sizeof(_statistics));
+  _ring.resize((int)DefaultPreConnectBudget);
+
+  open(QIODevice::WriteOnly | QIODevice::Unbuffered);
+  }
+
+DebugPreConnectBuffer::~DebugPreConnectBuffer()
+  {
+  clear();
+  }
+
+void DebugPreConnectBuffer::configure(
+    xsize budget,
+    DebugManager::PreConnectPolicy policy,
+    const QString &spillPath)
+  {
+  xAssert(_headerBytes == 0);
+
+  QByteArray held;
+  held.reserve((int)(_head - _tail));
+  for(xsize pos = _tail; pos != _head;)
+    {
+    const xsize offset = pos % _ring.size();
+    const xsize run = xMin(_head - pos, _ring.size() - offset);
+    held.append(_ring.constData() + offset, (int)run);
+    pos += run;
+    }
+
+  _policy = policy;
+  _spillPath = spillPath;
+
+  _ring.resize((int)budget);
+  _ring.squeeze();
+  _head = _tail = 0;
+
+  // push the held frames back through, applying the new budget and policy.
+  writeData(held.constData(), held.size());
+  }
+
+DebugManager::PreConnectStatistics DebugPreConnectBuffer::statistics() const
+  {
+  DebugManager::PreConnectStatistics stats = _statistics;
+  stats.bufferedBytes = (_head - _tail) + _controlFrames.size();
+  return stats;
+  }
+
+void DebugPreConnectBuffer::replay(QIODevice *device)
+  {
+  xAssert(_headerBytes == 0);
+
+  device->write(_controlFrames);
+
+  if(_spill.isOpen())
+    {
+    _spill.close();
+    if(_spill.open(QIODevice::ReadOnly))
+      {
+      while(!_spill.atEnd())
+        {
+        device->write(_spill.read(64 * 1024));
+        }
+      }
+    }
+
+  for(xsize pos = _tail; pos != _head;)
+    {
+    const xsize offset = pos % _ring.size();
+    const xsize run = xMin(_head - pos, _ring.size() - offset);
+    device->write(_ring.constData() + offset, run);
+    pos += run;
+    }
+
+  clear();
+  }
+
+void DebugPreConnectBuffer::clear()
+  {
+  _controlFrames.clear();
+  _head = _tail = 0;
+  _headerBytes = 0;
+  _frameRemaining = 0;
+
+  if(_spill.isOpen() || _spill.exists())
+    {
+    _spill.close();
+    _spill.remove();
+    }
+  }
+
+qint64 DebugPreConnectBuffer::readData(char *, qint64)
+  {
+  return -1;
+  }
+
+qint64 DebugPreConnectBuffer::writeData(const char *data, qint64 len)
+  {
+  xsize size = (xsize)len;
+  while(size)
+    {
+    if(_headerBytes < HeaderSize)
+      {
+      const xsize run = xMin(HeaderSize - _headerBytes, size);
+      memcpy(_header + _headerBytes, data, run);
+      _headerBytes += run;
+      data += run;
+      size -= run;
+
+      if(_headerBytes == HeaderSize)
+        {
+        beginFrame();
+        }
+      }
+    else
+      {
+      const xsize run = xMin(_frameRemaining, size);
+      appendFrameBytes(data, run);
+      _frameRemaining -= run;
+      data += run;
+      size -= run;
+      }
+
+    if(_headerBytes == HeaderSize && _frameRemaining == 0)
+      {
+      _headerBytes = 0;
+      }
+    }
+
+  return len;
+  }
+
+void DebugPreConnectBuffer::beginFrame()
+  {
+  _frameID = qFromBigEndian<xuint32>((const uchar *)_header);
+  _frameRemaining = qFromBigEndian<xuint32>((const uchar *)_header + sizeof(xuint32));
+  _frameDropped = false;
+
+  const xsize frameSize = HeaderSize + _frameRemaining;
+  if(_frameID == ControllerInterfaceID)
+    {
+    // an application sending controller frames without bound loses the newest.
+    if((xsize)_controlFrames.size() + frameSize > MaxControlBytes)
+      {
+      if(!_statistics.droppedControlFrames)
+        {
+        qWarning() << "Dropping debug controller frames beyond" << MaxControlBytes << "bytes before connecting";
+        }
+      _frameDropped = true;
+      ++_statistics.droppedControlFrames;
+      _statistics.droppedControlBytes += frameSize;
+      return;
+      }
+
+    _controlFrames.append(_header, HeaderSize);
+    return;
+    }
+
+  if(!makeSpace(frameSize))
+    {
+    _frameDropped = true;
+    ++_statistics.droppedFrames;
+    _statistics.droppedBytes += frameSize;
+    return;
+    }
+
+  ringWrite(_header, HeaderSize);
+  }
+
+void DebugPreConnectBuffer::appendFrameBytes(const char *data, xsize size)
+  {
+  if(_frameDropped)
+    {
+    return;
+    }
+
+  if(_frameID == ControllerInterfaceID)
+    {
+    _controlFrames.append(data, (int)size);
+    }
+  else
+    {
+    ringWrite(data, size);
+    }
+  }
+
+bool DebugPreConnectBuffer::makeSpace(xsize size)
+  {
+  const xsize capacity = _ring.size();
+  if(size > capacity ||
+     (_policy == DebugManager::PreConnectPolicy::DropNewest && capacity - (_head - _tail) < size))
+    {
+    return false;
+    }
+
+  while(capacity - (_head - _tail) < size)
+    {
+    evictOldest();
+    }
+
+  return true;
+  }
+
+void DebugPreConnectBuffer::evictOldest()
+  {
+  xAssert(_head != _tail);
+
+  char header[HeaderSize];
+  ringRead(_tail, header, HeaderSize);
+  const xsize frameSize = HeaderSize + qFromBigEndian<xuint32>((const uchar *)header + sizeof(xuint32));
+
+  if(_policy == DebugManager::PreConnectPolicy::SpillToFile && !_spillPath.isEmpty())
+    {
+    if(!_spill.isOpen())
+      {
+      _spill.setFileName(_spillPath);
+      _spill.open(QIODevice::WriteOnly | QIODevice::Truncate);
+      }
+
+    QByteArray frame((int)frameSize, Qt::Uninitialized);
+    ringRead(_tail, frame.data(), frameSize);
+
+    if(_spill.write(frame) == frame.size())
+      {
+      ++_statistics.spilledFrames;
+      _statistics.spilledBytes += frameSize;
+      }
+    else
+      {
+      ++_statistics.droppedFrames;
+      _statistics.droppedBytes += frameSize;
+      }
+    }
+  else
+    {
+    ++_statistics.droppedFrames;
+    _statistics.droppedBytes += frameSize;
+    }
+
+  _tail += frameSize;
+  }
+
+void DebugPreConnectBuffer::ringWrite(const char *data, xsize size)
+  {
+  while(size)
+    {
+    const xsize offset = _head % _ring.size();
+    const xsize run = xMin(size, _ring.size() - offset);
+    memcpy(_ring.data() + offset, data, run);
+
+    _head += run;
+    data += run;
+    size -= run;
+    }
+  }
+
+void DebugPreConnectBuffer::ringRead(xsize position, char *data, xsize size) const
+  {
+  while(size)
+    {
+    const xsize offset = position % _ring.size();
+    const xsize run = xMin(size, _ring.size() - offset);
+    memcpy(data, _ring.constData() + offset, run);
+
+    position += run;
+    data += run;
+    size -= run;
+    }
+  }
+
+}
@@ -0,0 +1,715 @@
+#include "XDebugProfiler.h"
+#include "Math/XMathHelpers.h"
+#include "QDataStream"
+#include "QProcess"
+#include "QSet"
+#include "QStringList"
+#include <algorithm>
+#include <atomic>
+
+#if defined(Q_OS_LINUX) || defined(Q_OS_MAC)
+# define X_DEBUG_PROFILER_SIGPROF
+# include <execinfo.h>
+# include <dlfcn.h>
+# include <pthread.h>
+# include <signal.h>
+# include <sys/time.h>
+# include <cerrno>
+#endif
+
+#if defined(Q_OS_LINUX)
+# include <link.h>
+#endif
+
+namespace Eks
+{
+
+X_IMPLEMENT_DEBUG_INTERFACE(DebugProfilerInterface)
+
+namespace
+{
+
+struct ProfileSample
+  {
+  std::atomic<xuint32> ready;
+  xuint64 thread;
+  xuint32 depth;
+  void *frames[DebugProfilerInterface::MaxDepth];
+  };
+
+// the ring the signal handler writes, allocated by the first profiler and kept, as a handler
+// may still be running on another thread when profiling stops.
+std::atomic<ProfileSample *> g_samples(0);
+std::atomic<xuint64> g_write(0);
+std::atomic<xuint64> g_read(0);
+std::atomic<xuint32> g_dropped(0);
+std::atomic<bool> g_sampling(false);
+std::atomic<DebugProfilerInterface *> g_owner(0);
+
+#if defined(X_DEBUG_PROFILER_SIGPROF)
+// the handler and the signal trampoline.
+const int SkippedFrames = 2;
+
+void onProfileSignal(int)
+  {
+  const int savedErrno = errno;
+
+  ProfileSample *samples = g_samples.load(std::memory_order_acquire);
+  if(!samples || !g_sampling.load(std::memory_order_relaxed))
+    {
+    errno = savedErrno;
+    return;
+    }
+
+  xuint64 write = g_write.load(std::memory_order_relaxed);
+  do
+    {
+    if(write - g_read.load(std::memory_order_acquire) >= DebugProfilerInterface::RingCapacity)
+      {
+      g_dropped.fetch_add(1, std::memory_order_relaxed);
+      errno = savedErrno;
+      return;
+      }
+    } while(!g_write.compare_exchange_weak(write, write + 1, std::memory_order_relaxed));
+
+  ProfileSample &sample = samples[write % DebugProfilerInterface::RingCapacity];
+
+  void *frames[DebugProfilerInterface::MaxDepth + SkippedFrames];
+  const int depth = xMax(backtrace(frames, DebugProfilerInterface::MaxDepth + SkippedFrames) - SkippedFrames, 0);
+
+  sample.thread = (xuint64)pthread_self();
+  sample.depth = (xuint32)depth;
+  for(int i = 0; i < depth; ++i)
+    {
+    sample.frames[i] = frames[i + SkippedFrames];
+    }
+  sample.ready.store(1, std::memory_order_release);
+
+  errno = savedErrno;
+  }
+
+#if defined(Q_OS_LINUX)
+struct LoadBiasSearch
+  {
+  quintptr address;
+  quintptr bias;
+  };
+
+// the load bias of the object with a segment holding the address.
+int findLoadBias(dl_phdr_info *info, size_t, void *data)
+  {
+  LoadBiasSearch *search = (LoadBiasSearch *)data;
+  for(int i = 0; i < info->dlpi_phnum; ++i)
+    {
+    const ElfW(Phdr) &segment = info->dlpi_phdr[i];
+    const quintptr start = info->dlpi_addr + segment.p_vaddr;
+    if(segment.p_type == PT_LOAD && search->address >= start && search->address - start < segment.p_memsz)
+      {
+      search->bias = info->dlpi_addr;
+      return 1;
+      }
+    }
+  return 0;
+  }
+#endif
+
+void setProfileTimer(xuint32 rate)
+  {
+  itimerval timer;
+  timer.it_interval.tv_sec = 0;
+  timer.it_interval.tv_usec = rate ? xMax(1000000 / (long)rate, 1L) : 0;
+  timer.it_value = timer.it_interval;
+  setitimer(ITIMER_PROF, &timer, 0);
+  }
+#endif
+
+}
+
+QDataStream &operator<<(QDataStream &s, const DebugProfilerInterface::Module &m)
+  {
+  return s << m.id << m.path << m.linkBase;
+  }
+
+QDataStream &operator>>(QDataStream &s, DebugProfilerInterface::Module &m)
+  {
+  s >> m.id >> m.path;
+
+  // clients before the link base only sent position independent offsets.
+  m.linkBase = 0;
+  if(!s.atEnd())
+    {
+    s >> m.linkBase;
+    }
+  return s;
+  }
+
+QDataStream &operator<<(QDataStream &s, const DebugProfilerInterface::Stack &st)
+  {
+  s << st.id << (xuint32)st.frames.size();
+  xForeach(const DebugProfilerInterface::Frame &f, st.frames)
+    {
+    s << f.module << f.offset;
+    }
+  return s;
+  }
+
+QDataStream &operator>>(QDataStream &s, DebugProfilerInterface::Stack &st)
+  {
+  xuint32 count = 0;
+  s >> st.id >> count;
+
+  st.frames.clear();
+  for(xuint32 i = 0; i < count && s.status() == QDataStream::Ok; ++i)
+    {
+    DebugProfilerInterface::Frame f;
+    s >> f.module >> f.offset;
+    st.frames << f;
+    }
+  return s;
+  }
+
+QDataStream &operator<<(QDataStream &s, const DebugProfilerInterface::Samples &sm)
+  {
+  s << sm.interval << sm.sampleRate << sm.dropped << (xuint32)sm.entries.size();
+  xForeach(const DebugProfilerInterface::Samples::Entry &e, sm.entries)
+    {
+    s << e.thread << e.stack << e.count;
+    }
+  return s;
+  }
+
+QDataStream &operator>>(QDataStream &s, DebugProfilerInterface::Samples &sm)
+  {
+  xuint32 count = 0;
+  s >> sm.interval >> sm.sampleRate >> sm.dropped >> count;
+
+  sm.entries.clear();
+  for(xuint32 i = 0; i < count && s.status() == QDataStream::Ok; ++i)
+    {
+    DebugProfilerInterface::Samples::Entry e;
+    s >> e.thread >> e.stack >> e.count;
+    sm.entries << e;
+    }
+  return s;
+  }
+
+QDataStream &operator<<(QDataStream &s, const DebugProfilerInterface::SetSampleRate &r)
+  {
+  return s << r.rate;
+  }
+
+QDataStream &operator>>(QDataStream &s, DebugProfilerInterface::SetSampleRate &r)
+  {
+  return s >> r.rate;
+  }
+
+DebugProfilerInterface::DebugProfilerInterface(DebugManager *, bool client)
+    : _sampleRate(0),
+      _profiling(false)
+  {
+  if(client)
+    {
+    _sinceSend.start();
+    startTimer(SendInterval);
+    setSampleRate(DefaultSampleRate);
+    }
+  else
+    {
+    _model = createDataModel<DebugProfilerModel>();
+    }
+
+  static Reciever recv[] =
+    {
+    recieveFunction<Module, DebugProfilerInterface, &DebugProfilerInterface::onModule>(),
+    recieveFunction<Stack, DebugProfilerInterface, &DebugProfilerInterface::onStack>(),
+    recieveFunction<Samples, DebugProfilerInterface, &DebugProfilerInterface::onSamples>(),
+    recieveFunction<SetSampleRate, DebugProfilerInterface, &DebugProfilerInterface::onSetSampleRate>(),
+    };
+
+  static const DispatchTable dispatch(recv, X_ARRAY_COUNT(recv));
+  setRecievers(dispatch);
+  }
+
+DebugProfilerInterface::~DebugProfilerInterface()
+  {
+  setSampleRate(0);
+  }
+
+bool DebugProfilerInterface::setSampleRate(xuint32 rate)
+  {
+#if defined(X_DEBUG_PROFILER_SIGPROF)
+  rate = xMin(rate, (xuint32)MaxSampleRate);
+
+  if(!_profiling)
+    {
+    if(!rate)
+      {
+      return true;
+      }
+
+    DebugProfilerInterface *none = 0;
+    if(!g_owner.compare_exchange_strong(none, this))
+      {
+      return false;
+      }
+
+    if(!g_samples.load(std::memory_order_relaxed))
+      {
+      g_samples.store(new ProfileSample[RingCapacity](), std::memory_order_release);
+      }
+
+    // backtrace loads its unwinder on first use, which can't happen in the handler.
+    void *frames[1];
+    backtrace(frames, 1);
+
+    struct sigaction action;
+    action.sa_handler = onProfileSignal;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGPROF, &action, 0);
+
+    g_sampling.store(true, std::memory_order_relaxed);
+    _profiling = true;
+    }
+
+  _sampleRate = rate;
+  setProfileTimer(rate);
+
+  if(!rate)
+    {
+    // leave the handler, a signal may still be pending.
+    g_sampling.store(false, std::memory_order_relaxed);
+    g_owner.store(0);
+    _profiling = false;
+    }
+
+  return true;
+#else
+  return rate == 0;
+#endif
+  }
+
+void DebugProfilerInterface::requestSampleRate(xuint32 rate)
+  {
+  const SetSampleRate r = { rate };
+  sendData(r);
+  }
+
+bool DebugProfilerInterface::resolveFrame(void *address, bool returnAddress, Frame &frame)
+  {
+#if defined(X_DEBUG_PROFILER_SIGPROF)
+  Dl_info info;
+  if(!dladdr(address, &info) || !info.dli_fname)
+    {
+    return false;
+    }
+
+  const QString path = QString::fromUtf8(info.dli_fname);
+  auto it = _moduleIds.find(path);
+  if(it == _moduleIds.end())
+    {
+    Module m;
+    m.id = (xuint32)_moduleIds.size();
+    m.path = path;
+
+    // offsets are from the module's base, which is only its link address less the load bias.
+    quintptr bias = (quintptr)info.dli_fbase;
+#if defined(Q_OS_LINUX)
+    LoadBiasSearch search = { (quintptr)address, bias };
+    dl_iterate_phdr(findLoadBias, &search);
+    bias = search.bias;
+#endif
+    m.linkBase = (quintptr)info.dli_fbase - bias;
+
+    it = _moduleIds.insert(path, m.id);
+    _pendingModules << m;
+    }
+
+  // a return address is past the call, step back into it.
+  frame.module = it.value();
+  frame.offset = (quintptr)address - (quintptr)info.dli_fbase - (returnAddress ? 1 : 0);
+  return true;
+#else
+  (void)address;
+  (void)returnAddress;
+  (void)frame;
+  return false;
+#endif
+  }
+
+DebugProfilerInterface::Samples DebugProfilerInterface::collect()
+  {
+  Samples samples;
+  samples.interval = (xuint32)_sinceSend.restart();
+  samples.sampleRate = _sampleRate;
+  samples.dropped = g_dropped.exchange(0, std::memory_order_relaxed);
+
+  ProfileSample *ring = g_samples.load(std::memory_order_acquire);
+  if(!ring || g_owner.load() != this)
+    {
+    return samples;
+    }
+
+  QHash<QPair<xuint64, xuint32>, xuint32> counts;
+
+  xuint64 read = g_read.load(std::memory_order_relaxed);
+  while(read != g_write.load(std::memory_order_acquire))
+    {
+    ProfileSample &sample = ring[read % RingCapacity];
+    // claimed, but the handler hasn't finished with it.
+    if(!sample.ready.load(std::memory_order_acquire))
+      {
+      break;
+      }
+
+    const QByteArray key((const char *)sample.frames, (int)(sample.depth * sizeof(void *)));
+    auto id = _stackIds.find(key);
+    if(id == _stackIds.end())
+      {
+      Stack stack;
+      stack.id = (xuint32)_stackIds.size();
+      for(xuint32 i = 0; i < sample.depth; ++i)
+        {
+        Frame frame;
+        if(resolveFrame(sample.frames[i], i != 0, frame))
+          {
+          stack.frames << frame;
+          }
+        }
+
+      id = _stackIds.insert(key, stack.id);
+      _pendingStacks << stack;
+      }
+
+    ++counts[qMakePair(sample.thread, id.value())];
+
+    sample.ready.store(0, std::memory_order_relaxed);
+    g_read.store(++read, std::memory_order_release);
+    }
+
+  for(auto it = counts.begin(); it != counts.end(); ++it)
+    {
+    const Samples::Entry e = { it.key().first, it.key().second, it.value() };
+    samples.entries << e;
+    }
+
+  return samples;
+  }
+
+void DebugProfilerInterface::sendSamples()
+  {
+  const Samples samples = collect();
+
+  // stacks refer to modules, and samples to stacks, so they go first.
+  xForeach(const Module &m, _pendingModules)
+    {
+    sendData(m);
+    }
+  _pendingModules.clear();
+
+  xForeach(const Stack &s, _pendingStacks)
+    {
+    sendData(s);
+    }
+  _pendingStacks.clear();
+
+  if(samples.entries.size() || samples.dropped)
+    {
+    sendData(samples);
+    }
+  }
+
+void DebugProfilerInterface::timerEvent(QTimerEvent *)
+  {
+  if(_profiling)
+    {
+    sendSamples();
+    }
+  }
+
+void DebugProfilerInterface::onModule(const Module &m)
+  {
+  if(_model.value())
+    {
+    _model->addModule(m);
+    }
+  }
+
+void DebugProfilerInterface::onStack(const Stack &s)
+  {
+  if(_model.value())
+    {
+    _model->addStack(s);
+    }
+  }
+
+void DebugProfilerInterface::onSamples(const Samples &s)
+  {
+  if(_model.value())
+    {
+    _model->addSamples(s);
+    }
+  }
+
+void DebugProfilerInterface::onSetSampleRate(const SetSampleRate &r)
+  {
+  setSampleRate(r.rate);
+  }
+
+DebugProfilerModel::DebugProfilerModel()
+    : _samples(0),
+      _sampleRate(0)
+  {
+  }
+
+void DebugProfilerModel::addModule(const DebugProfilerInterface::Module &m)
+  {
+  _modules[m.id] = m;
+  }
+
+void DebugProfilerModel::addStack(const DebugProfilerInterface::Stack &s)
+  {
+  _stacks[s.id] = s.frames;
+  }
+
+void DebugProfilerModel::addSamples(const DebugProfilerInterface::Samples &s)
+  {
+  if(s.sampleRate != _sampleRate)
+    {
+    _sampleRate = s.sampleRate;
+    emit sampleRateChanged(_sampleRate);
+    }
+
+  QVector<xuint32> stacks;
+  xForeach(const DebugProfilerInterface::Samples::Entry &e, s.entries)
+    {
+    stacks << e.stack;
+    _stackSamples[e.stack] += e.count;
+    _samples += e.count;
+    }
+  symbolise(stacks);
+
+  rebuildRows();
+  }
+
+void DebugProfilerModel::clear()
+  {
+  beginResetModel();
+  _rows.clear();
+  _rowIndex.clear();
+  _stackSamples.clear();
+  _samples = 0;
+  endResetModel();
+  }
+
+void DebugProfilerModel::symbolise(const QVector<xuint32> &stacks)
+  {
+  // batch the new frames by module, one addr2line run each.
+  QSet<xuint32> modules;
+  xForeach(xuint32 stack, stacks)
+    {
+    xForeach(const DebugProfilerInterface::Frame &f, _stacks.value(stack))
+      {
+      const FrameKey key(f.module, f.offset);
+      if(!_symbols.contains(key))
+        {
+        _symbols.insert(key, QString());
+        _queuedOffsets[f.module] << f.offset;
+        modules << f.module;
+        }
+      }
+    }
+
+  xForeach(xuint32 module, modules)
+    {
+    startLookup(module);
+    }
+  }
+
+void DebugProfilerModel::startLookup(xuint32 module)
+  {
+  for(auto it = _lookups.begin(); it != _lookups.end(); ++it)
+    {
+    // the queued offsets go in the next run, once this one finishes.
+    if(it.value().module == module)
+      {
+      return;
+      }
+    }
+
+  Lookup lookup;
+  lookup.module = module;
+  lookup.offsets = _queuedOffsets.take(module);
+  if(lookup.offsets.isEmpty())
+    {
+    return;
+    }
+
+#if defined(Q_OS_LINUX)
+  const DebugProfilerInterface::Module m = _modules.value(module);
+  QStringList args;
+  args << "-f" << "-C" << "-e" << m.path;
+  xForeach(xuint64 offset, lookup.offsets)
+    {
+    args << QString("0x%1").arg(m.linkBase + offset, 0, 16);
+    }
+
+  QProcess *addr2line = new QProcess(this);
+  _lookups.insert(addr2line, lookup);
+  connect(addr2line, SIGNAL(finished(int, QProcess::ExitStatus)), this, SLOT(onLookupFinished()));
+  connect(addr2line, SIGNAL(error(QProcess::ProcessError)), this, SLOT(onLookupFinished()));
+  addr2line->start("addr2line", args);
+#else
+  // frames keep their module and offset names.
+  xForeach(xuint64 offset, lookup.offsets)
+    {
+    const DebugProfilerInterface::Frame frame = { module, offset };
+    _symbols[FrameKey(module, offset)] = symbol(frame);
+    }
+#endif
+  }
+
+void DebugProfilerModel::onLookupFinished()
+  {
+  QProcess *addr2line = qobject_cast<QProcess *>(sender());
+  // a run which fails reports an error, and finishing too if it had started.
+  auto it = _lookups.find(addr2line);
+  if(it == _lookups.end() || addr2line->state() != QProcess::NotRunning)
+    {
+    return;
+    }
+  const Lookup lookup = it.value();
+  _lookups.erase(it);
+
+  QStringList names;
+  if(addr2line->exitStatus() == QProcess::NormalExit)
+    {
+    // a function line, then a file line, for each address.
+    const QStringList lines = QString::fromUtf8(addr2line->readAllStandardOutput()).split('\n');
+    for(int i = 0; i + 1 < lines.size(); i += 2)
+      {
+      names << lines[i];
+      }
+    }
+  addr2line->deleteLater();
+
+  for(int i = 0; i < lookup.offsets.size(); ++i)
+    {
+    const DebugProfilerInterface::Frame frame = { lookup.module, lookup.offsets[i] };
+    QString name = i < names.size() ? names[i] : QString();
+    if(name.isEmpty() || name == "??")
+      {
+      name = symbol(frame);
+      }
+    _symbols[FrameKey(frame.module, frame.offset)] = name;
+    }
+
+  startLookup(lookup.module);
+  rebuildRows();
+  }
+
+QString DebugProfilerModel::symbol(const DebugProfilerInterface::Frame &f) const
+  {
+  const QString name = _symbols.value(FrameKey(f.module, f.offset));
+  if(!name.isEmpty())
+    {
+    return name;
+    }
+
+  const QString module = _modules.value(f.module).path.section('/', -1);
+  return QString("%1+0x%2").arg(module).arg(f.offset, 0, 16);
+  }
+
+void DebugProfilerModel::rebuildRows()
+  {
+  beginResetModel();
+  _rows.clear();
+  _rowIndex.clear();
+
+  for(auto stack = _stackSamples.begin(); stack != _stackSamples.end(); ++stack)
+    {
+    const QVector<DebugProfilerInterface::Frame> frames = _stacks.value(stack.key());
+    const xuint64 count = stack.value();
+
+    // a recursive function counts once towards its total.
+    QSet<int> counted;
+    for(int i = 0; i < frames.size(); ++i)
+      {
+      const QString function = symbol(frames[i]);
+
+      auto row = _rowIndex.find(function);
+      if(row == _rowIndex.end())
+        {
+        const Row r = { function, 0, 0 };
+        _rows << r;
+        row = _rowIndex.insert(function, _rows.size() - 1);
+        }
+
+      if(i == 0)
+        {
+        _rows[row.value()].self += count;
+        }
+      if(!counted.contains(row.value()))
+        {
+        counted << row.value();
+        _rows[row.value()].total += count;
+        }
+      }
+    }
+
+  std::sort(_rows.begin(), _rows.end(), [](const Row &a, const Row &b)
+    {
+    return a.self != b.self ? a.self > b.self : a.total > b.total;
+    });
+  _rowIndex.clear();
+  for(int i = 0; i < _rows.size(); ++i)
+    {
+    _rowIndex.insert(_rows[i].function, i);
+    }
+  endResetModel();
+  }
+
+int DebugProfilerModel::rowCount(const QModelIndex &parent) const
+  {
+  return parent.isValid() ? 0 : _rows.size();
+  }
+
+int DebugProfilerModel::columnCount(const QModelIndex &parent) const
+  {
+  return parent.isValid() ? 0 : 4;
+  }
+
+QVariant DebugProfilerModel::data(const QModelIndex &index, int role) const
+  {
+  if(role != Qt::DisplayRole || !index.isValid() || index.row() >= _rows.size())
+    {
+    return QVariant();
+    }
+
+  const Row &row = _rows[index.row()];
+  const double percent = _samples ? 100.0 / _samples : 0.0;
+  switch(index.column())
+    {
+  case 0:
+    return row.function;
+  case 1:
+    return QString::number(row.self * percent, 'f', 1);
+  case 2:
+    return QString::number(row.total * percent, 'f', 1);
+  default:
+    return QString::number(row.self);
+    }
+  }
+
+QVariant DebugProfilerModel::headerData(int section, Qt::Orientation orientation, int role) const
+  {
+  if(role != Qt::DisplayRole || orientation != Qt::Horizontal)
+    {
+    return QVariant();
+    }
+
+  static const char *headers[] = { "Function", "Self %", "Total %", "Samples" };
+  return section < (int)X_ARRAY_COUNT(headers) ? QString(headers[section]) : QVariant();
+  }
+
+}
@@ -0,0 +1,72 @@
+#include "XDebugReceiveBuffer.h"
+#include "Utilities/XAssert.h"
+#include "Math/XMathHelpers.h"
+#include <cstring>
+
+namespace Eks
+{
+
+DebugReceiveBuffer::DebugReceiveBuffer(xsize capacity)
+    : _begin(0),
+      _end(0)
+  {
+  _data.resize((int)capacity);
+  }
+
+char *DebugReceiveBuffer::reserve(xsize size)
+  {
+  if(capacity() - _end < size)
+    {
+    const xsize used = _end - _begin;
+    if(_begin)
+      {
+      memmove(_data.data(), _data.constData() + _begin, used);
+      _begin = 0;
+      _end = used;
+      }
+
+    if(capacity() - _end < size)
+      {
+      _data.resize((int)xMax(capacity() * 2, _end + size));
+      }
+    }
+
+  return _data.data() + _end;
+  }
+
+void DebugReceiveBuffer::commit(xsize size)
+  {
+  xAssert(_end + size <= capacity());
+  _end += size;
+  }
+
+void DebugReceiveBuffer::append(const char *data, xsize size)
+  {
+  memcpy(reserve(size), data, size);
+  commit(size);
+  }
+
+void DebugReceiveBuffer::consume(xsize size)
+  {
+  xAssert(size <= this->size());
+  _begin += size;
+
+  // start again from the front, saving a move on the next reserve.
+  if(_begin == _end)
+    {
+    _begin = _end = 0;
+    }
+  }
+
+void DebugReceiveBuffer::truncate(xsize size)
+  {
+  xAssert(size <= this->size());
+  _end = _begin + size;
+  }
+
+void DebugReceiveBuffer::clear()
+  {
+  _begin = _end = 0;
+  }
+
+}
@@ -0,0 +1,392 @@
+#include "XDebugSharedMemoryTransport.h"
+#include "Utilities/XAssert.h"
+#include "Math/XMathHelpers.h"
+#include "QDebug"
+#include "QThread"
+#include <cstring>
+#include <new>
+
+namespace Eks
+{
+
+static const int PollInterval = 1;
+static const int AttachInterval = 500;
+
+void DebugSharedMemoryRing::reset()
+  {
+  head.store(0);
+  tail.store(0);
+  }
+
+xsize DebugSharedMemoryRing::write(const char *src, xsize size)
+  {
+  const xuint64 h = head.load(std::memory_order_relaxed);
+  const xsize space = Capacity - (xsize)(h - tail.load(std::memory_order_acquire));
+  const xsize count = xMin(space, size);
+
+  for(xsize done = 0; done < count;)
+    {
+    const xsize offset = (xsize)((h + done) % Capacity);
+    const xsize run = xMin(count - done, Capacity - offset);
+    memcpy(data + offset, src + done, run);
+    done += run;
+    }
+
+  head.store(h + count, std::memory_order_release);
+  return count;
+  }
+
+xsize DebugSharedMemoryRing::read(char *dst, xsize size)
+  {
+  const xuint64 t = tail.load(std::memory_order_relaxed);
+  const xsize count = xMin((xsize)(head.load(std::memory_order_acquire) - t), size);
+
+  for(xsize done = 0; done < count;)
+    {
+    const xsize offset = (xsize)((t + done) % Capacity);
+    const xsize run = xMin(count - done, Capacity - offset);
+    memcpy(dst + done, data + offset, run);
+    done += run;
+    }
+
+  tail.store(t + count, std::memory_order_release);
+  return count;
+  }
+
+xsize DebugSharedMemoryRing::available() const
+  {
+  return (xsize)(head.load(std::memory_order_acquire) - tail.load(std::memory_order_relaxed));
+  }
+
+DebugSharedMemoryDevice::DebugSharedMemoryDevice(QObject *parent)
+    : QIODevice(parent),
+      _input(0),
+      _output(0),
+      _heartbeat(0),
+      _session(0),
+      _sessionID(0),
+      _abandoned(false)
+  {
+  open(QIODevice::ReadWrite | QIODevice::Unbuffered);
+  }
+
+void DebugSharedMemoryDevice::attach(
+    DebugSharedMemoryRing *input,
+    DebugSharedMemoryRing *output,
+    std::atomic<xuint64> *heartbeat,
+    const std::atomic<xuint32> *session)
+  {
+  _input = input;
+  _output = output;
+  _heartbeat = heartbeat;
+  _session = session;
+  _sessionID = session ? session->load(std::memory_order_acquire) : 0;
+  }
+
+bool DebugSharedMemoryDevice::isDropped() const
+  {
+  return _abandoned || (_session && _session->load(std::memory_order_acquire) != _sessionID);
+  }
+
+void DebugSharedMemoryDevice::abandon()
+  {
+  attach(0, 0);
+  _overflow.clear();
+  _abandoned = true;
+  }
+
+void DebugSharedMemoryDevice::poll()
+  {
+  if(_heartbeat)
+    {
+    _heartbeat->fetch_add(1, std::memory_order_relaxed);
+    }
+
+  pushOverflow();
+
+  if(_input && _input->available())
+    {
+    Q_EMIT readyRead();
+    }
+  }
+
+qint64 DebugSharedMemoryDevice::bytesAvailable() const
+  {
+  return QIODevice::bytesAvailable() + (_input ? _input->available() : 0);
+  }
+
+qint64 DebugSharedMemoryDevice::bytesToWrite() const
+  {
+  return _overflow.size();
+  }
+
+bool DebugSharedMemoryDevice::waitForBytesWritten(int msecs)
+  {
+  QElapsedTimer timer;
+  timer.start();
+
+  pushOverflow();
+  while(!_overflow.isEmpty() && timer.elapsed() < msecs)
+    {
+    QThread::yieldCurrentThread();
+    pushOverflow();
+    }
+
+  return _overflow.isEmpty();
+  }
+
+qint64 DebugSharedMemoryDevice::readData(char *data, qint64 maxSize)
+  {
+  if(!_input)
+    {
+    return 0;
+    }
+
+  return _input->read(data, (xsize)maxSize);
+  }
+
+qint64 DebugSharedMemoryDevice::writeData(const char *data, qint64 size)
+  {
+  // the rings may already belong to another client.
+  if(isDropped())
+    {
+    abandon();
+    return size;
+    }
+
+  pushOverflow();
+
+  xsize written = 0;
+  if(_output && _overflow.isEmpty())
+    {
+    written = _output->write(data, (xsize)size);
+    }
+
+  const xsize remaining = (xsize)size - written;
+  if(!remaining)
+    {
+    return size;
+    }
+
+  // the reader has fallen behind, hold the writer back rather than buffer without bound.
+  if((xsize)_overflow.size() + remaining > MaxOverflow)
+    {
+    QElapsedTimer timer;
+    timer.start();
+    while((xsize)_overflow.size() + remaining > MaxOverflow)
+      {
+      if(timer.elapsed() >= WriteTimeout)
+        {
+        setErrorString("The shared memory reader stopped reading");
+        return -1;
+        }
+
+      // waiting on the reader isn't a sign of a dead client.
+      if(_heartbeat)
+        {
+        _heartbeat->fetch_add(1, std::memory_order_relaxed);
+        }
+
+      QThread::msleep(1);
+      pushOverflow();
+      }
+    }
+
+  _overflow.append(data + written, (int)remaining);
+  return size;
+  }
+
+void DebugSharedMemoryDevice::pushOverflow()
+  {
+  if(_output && !_overflow.isEmpty())
+    {
+    const xsize written = _output->write(_overflow.constData(), _overflow.size());
+    _overflow.remove(0, (int)written);
+    }
+  }
+
+DebugSharedMemoryTransport::DebugSharedMemoryTransport(QObject *parent)
+    : DebugTransport(parent),
+      _memory(ServerName),
+      _isServer(false),
+      _device(0),
+      _pendingConnection(0),
+      _detached(0),
+      _lastHeartbeat(0)
+  {
+  _poll.setTimerType(Qt::PreciseTimer);
+  _poll.setInterval(PollInterval);
+  connect(&_poll, &QTimer::timeout, this, &DebugSharedMemoryTransport::poll);
+  }
+
+DebugSharedMemoryTransport::~DebugSharedMemoryTransport()
+  {
+  _poll.stop();
+  if(_memory.isAttached() && !_isServer && !_device->isDropped())
+    {
+    xuint32 expected = ClientAttached;
+    layout()->clientState.compare_exchange_strong(expected, ClientDetached, std::memory_order_acq_rel);
+    }
+  }
+
+QIODevice *DebugSharedMemoryTransport::connectToServer()
+  {
+  _isServer = false;
+  _device = new DebugSharedMemoryDevice(this);
+
+  // the debugger may not exist yet, keep trying to attach from the poll.
+  _poll.start(AttachInterval);
+  return _device;
+  }
+
+bool DebugSharedMemoryTransport::listen()
+  {
+  _isServer = true;
+
+  if(!_memory.create(sizeof(Layout)))
+    {
+    // a segment left by a crashed debugger is released once every user detaches.
+    if(_memory.error() != QSharedMemory::AlreadyExists ||
+       !_memory.attach() ||
+       !_memory.detach() ||
+       !_memory.create(sizeof(Layout)))
+      {
+      return false;
+      }
+    }
+
+  Layout *l = new(_memory.data()) Layout;
+  l->clientState.store(ClientFree);
+  l->session.store(0);
+  l->clientHeartbeat.store(0);
+  l->toServer.reset();
+  l->toClient.reset();
+
+  _poll.start();
+  return true;
+  }
+
+QIODevice *DebugSharedMemoryTransport::nextPendingConnection()
+  {
+  DebugSharedMemoryDevice *dev = _pendingConnection;
+  _pendingConnection = 0;
+  return dev;
+  }
+
+void DebugSharedMemoryTransport::flush(QIODevice *device, int msecs)
+  {
+  device->waitForBytesWritten(msecs);
+  }
+
+void DebugSharedMemoryTransport::poll()
+  {
+  if(_isServer)
+    {
+    Layout *l = layout();
+    const xuint32 state = l->clientState.load(std::memory_order_acquire);
+    if(_device && state == ClientDetached)
+      {
+      onClientDetached();
+      }
+    else if(_device)
+      {
+      // a client which crashed or was killed never marks itself detached.
+      const xuint64 beat = l->clientHeartbeat.load(std::memory_order_relaxed);
+      if(beat != _lastHeartbeat)
+        {
+        _lastHeartbeat = beat;
+        _heartbeatTimer.restart();
+        }
+      else if(_heartbeatTimer.elapsed() >= ClientTimeout)
+        {
+        qWarning() << "Shared memory debug client stopped responding, dropping it";
+        onClientDetached();
+        }
+      }
+    else if(state == ClientAttached)
+      {
+      _device = new DebugSharedMemoryDevice(this);
+      _device->attach(&l->toServer, &l->toClient);
+      _lastHeartbeat = l->clientHeartbeat.load(std::memory_order_relaxed);
+      _heartbeatTimer.start();
+
+      // the manager has dropped the last client by the time it takes this one.
+      if(_detached)
+        {
+        _detached->deleteLater();
+        _detached = 0;
+        }
+
+      _pendingConnection = _device;
+      Q_EMIT newConnection();
+      }
+    }
+  else if(!_memory.isAttached())
+    {
+    if(!attachClient())
+      {
+      return;
+      }
+
+    _poll.setInterval(PollInterval);
+    Q_EMIT connected();
+    }
+  else if(_device->isDropped())
+    {
+    // dropped as unresponsive, the rings may already belong to another client.
+    qWarning() << "The debugger dropped this client as unresponsive, no longer sending";
+    _device->abandon();
+    _memory.detach();
+    _poll.stop();
+    return;
+    }
+
+  if(_device)
+    {
+    _device->poll();
+    }
+  }
+
+bool DebugSharedMemoryTransport::attachClient()
+  {
+  if(!_memory.attach())
+    {
+    return false;
+    }
+
+  // another client is connected, or the last one's data is still being cleared.
+  Layout *l = layout();
+  xuint32 expected = ClientFree;
+  if(!l->clientState.compare_exchange_strong(expected, ClientAttached, std::memory_order_acq_rel))
+    {
+    _memory.detach();
+    return false;
+    }
+
+  _device->attach(&l->toClient, &l->toServer, &l->clientHeartbeat, &l->session);
+  return true;
+  }
+
+void DebugSharedMemoryTransport::onClientDetached()
+  {
+  // the manager may still hold the device, so it is closed now and deleted later.
+  _device->attach(0, 0);
+  _device->close();
+  delete _detached;
+  _detached = _device;
+  _device = 0;
+  _pendingConnection = 0;
+
+  Layout *l = layout();
+  l->toServer.reset();
+  l->toClient.reset();
+  l->session.fetch_add(1, std::memory_order_relaxed);
+  l->clientState.store(ClientFree, std::memory_order_release);
+  }
+
+DebugSharedMemoryTransport::Layout *DebugSharedMemoryTransport::layout()
+  {
+  return static_cast<Layout *>(_memory.data());
+  }
+
+}
@@ -0,0 +1,93 @@
+#include "XDebugStagingRing.h"
+#include "Utilities/XAssert.h"
+#include <cstring>
+
+namespace Eks
+{
+
+DebugStagingRing::DebugStagingRing(xsize capacity)
+    : _mask(capacity - 1),
+      _pending(0),
+      _committed(0),
+      _head(0),
+      _tail(0)
+  {
+  // power of two sizes let positions grow forever and wrap with a mask.
+  xAssert(capacity && (capacity & _mask) == 0);
+  _data.resize((int)capacity);
+  }
+
+bool DebugStagingRing::canAppend(xsize size) const
+  {
+  const xsize used = _pending - _tail.load(std::memory_order_acquire);
+  return used + size <= capacity();
+  }
+
+void DebugStagingRing::append(const void *data, xsize size)
+  {
+  xAssert(canAppend(size));
+
+  const char *src = static_cast<const char *>(data);
+  while(size)
+    {
+    const xsize offset = _pending & _mask;
+    const xsize run = xMin(size, capacity() - offset);
+    memcpy(_data.data() + offset, src, run);
+
+    _pending += run;
+    src += run;
+    size -= run;
+    }
+  }
+
+void DebugStagingRing::commit()
+  {
+  _committed = _pending;
+  _head.store(_pending, std::memory_order_release);
+  }
+
+void DebugStagingRing::rollback()
+  {
+  _pending = _committed;
+  }
+
+void DebugStagingRing::patch(xsize position, const void *data, xsize size)
+  {
+  xAssert(position >= _committed && position + size <= _pending);
+
+  const char *src = static_cast<const char *>(data);
+  while(size)
+    {
+    const xsize offset = position & _mask;
+    const xsize run = xMin(size, capacity() - offset);
+    memcpy(_data.data() + offset, src, run);
+
+    position += run;
+    src += run;
+    size -= run;
+    }
+  }
+
+xsize DebugStagingRing::acquire() const
+  {
+  return _head.load(std::memory_order_acquire);
+  }
+
+void DebugStagingRing::read(xsize position, void *data, xsize size) const
+  {
+  xAssert(position - tail() + size <= capacity());
+
+  char *dst = static_cast<char *>(data);
+  while(size)
+    {
+    const xsize offset = position & _mask;
+    const xsize run = xMin(size, capacity() - offset);
+    memcpy(dst, _data.constData() + offset, run);
+
+    position += run;
+    dst += run;
+    size -= run;
+    }
+  }
+
+}
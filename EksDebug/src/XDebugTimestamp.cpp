@@ -0,0 +1,177 @@
+#include "XDebugTimestamp.h"
+#include "XDebugLogger.h"
+#include "QtGlobal"
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#if defined(Q_PROCESSOR_X86)
+# if defined(_MSC_VER)
+#  include <intrin.h>
+# else
+#  include <x86intrin.h>
+#  include <cpuid.h>
+# endif
+#endif
+
+namespace Eks
+{
+
+namespace
+{
+
+enum
+  {
+  // ms spent measuring the counter's rate when it is selected.
+  InitialCalibrationTime = 10,
+  // pairs read for each calibration point, the tightest is kept.
+  CalibrationReads = 5
+  };
+
+std::atomic<DebugTimestamp::Source> g_source(DebugTimestamp::Source::Clock);
+
+// the point the rate is measured from.
+xint64 g_baseStamp = 0;
+xint64 g_baseNanoseconds = 0;
+
+inline xint64 clockNanoseconds()
+  {
+  return Time::now().nanoseconds();
+  }
+
+inline xint64 readTsc()
+  {
+#if defined(Q_PROCESSOR_X86)
+  return (xint64)__rdtsc();
+#else
+  return 0;
+#endif
+  }
+
+/// Read the counter between two clock reads, keeping the read with the least time between them.
+void readPair(xint64 &stamp, xint64 &nanoseconds)
+  {
+  xint64 window = X_INT64_MAX;
+  for(xsize i = 0; i < CalibrationReads; ++i)
+    {
+    const xint64 before = clockNanoseconds();
+    const xint64 tsc = readTsc();
+    const xint64 after = clockNanoseconds();
+
+    if(after - before < window)
+      {
+      window = after - before;
+      stamp = tsc;
+      nanoseconds = before + window / 2;
+      }
+    }
+  }
+
+}
+
+bool DebugTimestamp::tscAvailable()
+  {
+#if defined(Q_PROCESSOR_X86)
+  // CPUID 0x80000007, EDX bit 8 is the invariant TSC.
+# if defined(_MSC_VER)
+  int regs[4];
+  __cpuid(regs, 0x80000000);
+  if((unsigned)regs[0] < 0x80000007)
+    {
+    return false;
+    }
+  __cpuid(regs, 0x80000007);
+  return (regs[3] & (1 << 8)) != 0;
+# else
+  unsigned a, b, c, d;
+  if(!__get_cpuid(0x80000007, &a, &b, &c, &d))
+    {
+    return false;
+    }
+  return (d & (1 << 8)) != 0;
+# endif
+#else
+  return false;
+#endif
+  }
+
+bool DebugTimestamp::setSource(Source source)
+  {
+  if(DebugLogger::isRecording())
+    {
+    return false;
+    }
+
+  if(source == Source::Tsc)
+    {
+    if(!tscAvailable())
+      {
+      return false;
+      }
+
+    readPair(g_baseStamp, g_baseNanoseconds);
+    }
+
+  g_source.store(source, std::memory_order_release);
+  return true;
+  }
+
+DebugTimestamp::Source DebugTimestamp::source()
+  {
+  return g_source.load(std::memory_order_acquire);
+  }
+
+xint64 DebugTimestamp::now()
+  {
+  if(g_source.load(std::memory_order_relaxed) == Source::Tsc)
+    {
+    return readTsc();
+    }
+  return clockNanoseconds();
+  }
+
+DebugTimestamp::Calibration DebugTimestamp::calibrate()
+  {
+  Calibration c;
+  c.source = source();
+
+  if(c.source == Source::Clock)
+    {
+    c.stamp = 0;
+    c.nanoseconds = 0;
+    c.nanosecondsPerStamp = 1.0;
+    return c;
+    }
+
+  readPair(c.stamp, c.nanoseconds);
+  if(c.nanoseconds - g_baseNanoseconds < InitialCalibrationTime * 1000000)
+    {
+    // too close to the base to measure the rate, wait for a usable baseline.
+    std::this_thread::sleep_for(std::chrono::milliseconds(InitialCalibrationTime));
+    readPair(c.stamp, c.nanoseconds);
+    }
+
+  c.nanosecondsPerStamp = (double)(c.nanoseconds - g_baseNanoseconds) / (double)(c.stamp - g_baseStamp);
+  return c;
+  }
+
+xint64 DebugTimestamp::toNanoseconds(xint64 stamp, const Calibration &c)
+  {
+  if(c.source == Source::Clock)
+    {
+    return stamp;
+    }
+
+  return c.nanoseconds + (xint64)((double)(stamp - c.stamp) * c.nanosecondsPerStamp);
+  }
+
+Eks::Time DebugTimestamp::toTime(xint64 stamp, const Calibration &c)
+  {
+  const xint64 ns = toNanoseconds(stamp, c);
+
+  Eks::Time t;
+  t.set(ns / 1000000000, ns % 1000000000);
+  return t;
+  }
+
+}
@@ -0,0 +1,585 @@
+#include "XDebugTrace.h"
+#include "QDataStream"
+#include "QDebug"
+#include "QDir"
+#include "QtEndian"
+#include <cstring>
+#include <limits>
+
+namespace Eks
+{
+
+const char DebugTraceWriter::IndexMagic[8] = { 'E', 'K', 'S', 'T', 'R', 'A', 'C', 'E' };
+
+namespace
+{
+
+const xsize IndexHeaderSize = sizeof(DebugTraceWriter::IndexMagic) + sizeof(xuint32);
+
+const char *const IndexName = "index";
+const char *const TimeName = "time.col";
+const char *const SessionName = "session.col";
+const char *const ThreadName = "thread.col";
+const char *const LocationName = "location.col";
+const char *const DurationName = "duration.col";
+const char *const TypeName = "type.col";
+// each row's end offset in message.dat, its message follows the previous row's.
+const char *const MessageEndName = "message.col";
+const char *const MessageDataName = "message.dat";
+const char *const LocationsName = "locations";
+
+template <typename T> bool writeColumn(QFile &file, const QVector<T> &values)
+  {
+  QByteArray data(values.size() * (int)sizeof(T), Qt::Uninitialized);
+  for(int i = 0; i < values.size(); ++i)
+    {
+    qToLittleEndian<T>(values[i], (uchar *)data.data() + i * sizeof(T));
+    }
+  return file.write(data) == data.size();
+  }
+
+template <typename T> bool readColumn(const QString &path, xuint64 first, xuint32 count, QVector<T> &values)
+  {
+  QFile file(path);
+  if(!file.open(QIODevice::ReadOnly) || !file.seek(first * sizeof(T)))
+    {
+    return false;
+    }
+
+  const QByteArray data = file.read(count * sizeof(T));
+  if(data.size() != (int)(count * sizeof(T)))
+    {
+    return false;
+    }
+
+  values.resize(count);
+  for(xuint32 i = 0; i < count; ++i)
+    {
+    values[i] = qFromLittleEndian<T>((const uchar *)data.constData() + i * sizeof(T));
+    }
+  return true;
+  }
+
+bool readLocation(QDataStream &s, xuint32 &session, DebugLogger::DebugLocationWithData &l)
+  {
+  xuint32 id, line;
+  QString file, function, data;
+  s >> session >> id >> file >> function >> line >> data;
+  if(s.status() != QDataStream::Ok)
+    {
+    return false;
+    }
+
+  l.setId(id);
+  l.setFile(file);
+  l.setFunction(function);
+  l.setLine(line);
+  l.setData(data);
+  return true;
+  }
+
+bool readIndex(QFile &index, QVector<DebugTraceReader::Block> &blocks)
+  {
+  blocks.clear();
+
+  const QByteArray header = index.read(IndexHeaderSize);
+  if(header.size() != (int)IndexHeaderSize ||
+     memcmp(header.constData(), DebugTraceWriter::IndexMagic, sizeof(DebugTraceWriter::IndexMagic)) != 0 ||
+     qFromLittleEndian<xuint32>((const uchar *)header.constData() + sizeof(DebugTraceWriter::IndexMagic)) != DebugTraceWriter::FormatVersion)
+    {
+    qWarning() << "Not a trace index" << index.fileName();
+    return false;
+    }
+
+  // a crash may leave part of an entry, which is ignored.
+  const QByteArray entries = index.readAll();
+  for(int i = 0; i + DebugTraceWriter::IndexEntrySize <= entries.size(); i += DebugTraceWriter::IndexEntrySize)
+    {
+    const uchar *e = (const uchar *)entries.constData() + i;
+
+    DebugTraceReader::Block b;
+    b.firstRow = qFromLittleEndian<xuint64>(e);
+    b.rows = qFromLittleEndian<xuint32>(e + sizeof(xuint64));
+    b.minTime = qFromLittleEndian<xint64>(e + sizeof(xuint64) + sizeof(xuint32));
+    b.maxTime = qFromLittleEndian<xint64>(e + sizeof(xuint64) + sizeof(xuint32) + sizeof(xint64));
+    blocks << b;
+    }
+
+  return true;
+  }
+
+}
+
+DebugTraceWriter::DebugTraceWriter()
+    : _rows(0),
+      _messageBytes(0),
+      _lastSession(0)
+  {
+  }
+
+DebugTraceWriter::~DebugTraceWriter()
+  {
+  close();
+  }
+
+bool DebugTraceWriter::open(const QString &directory)
+  {
+  close();
+
+  if(!QDir().mkpath(directory))
+    {
+    qWarning() << "Failed to create trace" << directory;
+    return false;
+    }
+  _directory = directory;
+
+  QDir dir(directory);
+  _index.setFileName(dir.filePath(IndexName));
+  if(!_index.open(QIODevice::ReadWrite))
+    {
+    qWarning() << "Failed to open trace index" << _index.fileName() << _index.errorString();
+    return false;
+    }
+
+  _rows = 0;
+  _messageBytes = 0;
+  if(_index.size() == 0)
+    {
+    char header[IndexHeaderSize];
+    memcpy(header, IndexMagic, sizeof(IndexMagic));
+    qToLittleEndian<xuint32>(FormatVersion, (uchar *)header + sizeof(IndexMagic));
+    _index.write(header, sizeof(header));
+    }
+  else
+    {
+    QVector<DebugTraceReader::Block> blocks;
+    if(!readIndex(_index, blocks))
+      {
+      _index.close();
+      return false;
+      }
+
+    if(!blocks.isEmpty())
+      {
+      _rows = blocks.back().firstRow + blocks.back().rows;
+      }
+    _index.resize(IndexHeaderSize + blocks.size() * IndexEntrySize);
+    }
+  _index.seek(_index.size());
+
+  // columns may run past the index after a crash, the rows beyond it are discarded.
+  if(!openColumn(_time, TimeName, _rows * sizeof(xint64)) ||
+     !openColumn(_session, SessionName, _rows * sizeof(xuint32)) ||
+     !openColumn(_thread, ThreadName, _rows * sizeof(xuint64)) ||
+     !openColumn(_location, LocationName, _rows * sizeof(xuint32)) ||
+     !openColumn(_duration, DurationName, _rows * sizeof(xint64)) ||
+     !openColumn(_type, TypeName, _rows * sizeof(xuint8)) ||
+     !openColumn(_messageEnd, MessageEndName, _rows * sizeof(xuint64)))
+    {
+    close();
+    return false;
+    }
+
+  // sessions only increase, the last row's is the latest with rows.
+  _lastSession = 0;
+  if(_rows)
+    {
+    QVector<xuint64> lastEnd;
+    QVector<xuint32> lastSession;
+    if(!readColumn(dir.filePath(MessageEndName), _rows - 1, 1, lastEnd) ||
+       !readColumn(dir.filePath(SessionName), _rows - 1, 1, lastSession))
+      {
+      close();
+      return false;
+      }
+    _messageBytes = lastEnd[0];
+    _lastSession = lastSession[0];
+    }
+
+  if(!openColumn(_messageData, MessageDataName, _messageBytes))
+    {
+    close();
+    return false;
+    }
+
+  _locations.clear();
+  _locationFile.setFileName(dir.filePath(LocationsName));
+  if(!_locationFile.open(QIODevice::ReadWrite))
+    {
+    qWarning() << "Failed to open trace locations" << _locationFile.fileName() << _locationFile.errorString();
+    close();
+    return false;
+    }
+
+  QDataStream s(&_locationFile);
+  qint64 valid = 0;
+  xuint32 session;
+  DebugLogger::DebugLocationWithData l;
+  while(!_locationFile.atEnd() && readLocation(s, session, l))
+    {
+    _locations << qMakePair(session, l.id());
+    _lastSession = xMax(_lastSession, session);
+    valid = _locationFile.pos();
+    }
+  _locationFile.resize(valid);
+  _locationFile.seek(valid);
+
+  return true;
+  }
+
+bool DebugTraceWriter::openColumn(QFile &file, const QString &name, xuint64 size)
+  {
+  file.setFileName(QDir(_directory).filePath(name));
+  if(!file.open(QIODevice::ReadWrite))
+    {
+    qWarning() << "Failed to open trace column" << file.fileName() << file.errorString();
+    return false;
+    }
+
+  if((xuint64)file.size() < size)
+    {
+    qWarning() << "Trace column is shorter than its index" << file.fileName();
+    return false;
+    }
+
+  return file.resize(size) && file.seek(size);
+  }
+
+void DebugTraceWriter::close()
+  {
+  if(isOpen())
+    {
+    flush();
+    }
+
+  _index.close();
+  _time.close();
+  _session.close();
+  _thread.close();
+  _location.close();
+  _duration.close();
+  _type.close();
+  _messageEnd.close();
+  _messageData.close();
+  _locationFile.close();
+  }
+
+xuint32 DebugTraceWriter::beginSession()
+  {
+  return ++_lastSession;
+  }
+
+void DebugTraceWriter::addRow(const Row &row)
+  {
+  _times << row.time;
+  _sessions << row.session;
+  _threads << row.thread;
+  _locationIds << row.location;
+  _durations << row.duration;
+  _types << (xuint8)row.type;
+
+  _messages += row.message.toUtf8();
+  _messageEnds << _messageBytes + _messages.size();
+
+  if(_times.size() >= BlockRows)
+    {
+    flush();
+    }
+  }
+
+void DebugTraceWriter::addLocation(xuint32 session, const DebugLogger::DebugLocationWithData &l)
+  {
+  if(!isOpen() || hasLocation(session, l.id()))
+    {
+    return;
+    }
+  _locations << qMakePair(session, l.id());
+
+  QDataStream s(&_locationFile);
+  s << session << l.id() << l.file() << l.function() << (xuint32)l.line() << l.data();
+  _locationFile.flush();
+  }
+
+bool DebugTraceWriter::flush()
+  {
+  if(_times.isEmpty() || !isOpen())
+    {
+    return true;
+    }
+
+  const bool written =
+      writeColumn(_time, _times) &&
+      writeColumn(_session, _sessions) &&
+      writeColumn(_thread, _threads) &&
+      writeColumn(_location, _locationIds) &&
+      writeColumn(_duration, _durations) &&
+      _type.write((const char *)_types.constData(), _types.size()) == _types.size() &&
+      writeColumn(_messageEnd, _messageEnds) &&
+      _messageData.write(_messages) == _messages.size() &&
+      _time.flush() &&
+      _session.flush() &&
+      _thread.flush() &&
+      _location.flush() &&
+      _duration.flush() &&
+      _type.flush() &&
+      _messageEnd.flush() &&
+      _messageData.flush();
+
+  if(!written)
+    {
+    // the next open discards whatever part of the block was written.
+    qWarning() << "Failed to write trace block" << _directory;
+    clearBlock();
+    close();
+    return false;
+    }
+
+  xint64 minTime = std::numeric_limits<xint64>::max();
+  xint64 maxTime = std::numeric_limits<xint64>::min();
+  xForeach(xint64 t, _times)
+    {
+    minTime = xMin(minTime, t);
+    maxTime = xMax(maxTime, t);
+    }
+
+  uchar entry[IndexEntrySize];
+  qToLittleEndian<xuint64>(_rows, entry);
+  qToLittleEndian<xuint32>((xuint32)_times.size(), entry + sizeof(xuint64));
+  qToLittleEndian<xint64>(minTime, entry + sizeof(xuint64) + sizeof(xuint32));
+  qToLittleEndian<xint64>(maxTime, entry + sizeof(xuint64) + sizeof(xuint32) + sizeof(xint64));
+  _index.write((const char *)entry, sizeof(entry));
+  _index.flush();
+
+  _rows += _times.size();
+  _messageBytes += _messages.size();
+
+  clearBlock();
+  return true;
+  }
+
+void DebugTraceWriter::clearBlock()
+  {
+  _times.clear();
+  _sessions.clear();
+  _threads.clear();
+  _locationIds.clear();
+  _durations.clear();
+  _types.clear();
+  _messageEnds.clear();
+  _messages.clear();
+  }
+
+bool DebugTraceReader::open(const QString &directory)
+  {
+  _directory = directory;
+  _blocks.clear();
+  _locations.clear();
+
+  QDir dir(directory);
+  QFile index(dir.filePath(IndexName));
+  if(!index.open(QIODevice::ReadOnly))
+    {
+    qWarning() << "Failed to open trace index" << index.fileName() << index.errorString();
+    return false;
+    }
+  if(!readIndex(index, _blocks))
+    {
+    return false;
+    }
+
+  QFile locations(dir.filePath(LocationsName));
+  if(locations.open(QIODevice::ReadOnly))
+    {
+    QDataStream s(&locations);
+    xuint32 session;
+    DebugLogger::DebugLocationWithData l;
+    while(!locations.atEnd() && readLocation(s, session, l))
+      {
+      _locations.insert(qMakePair(session, l.id()), l);
+      }
+    }
+
+  return true;
+  }
+
+const DebugLogger::DebugLocationWithData *DebugTraceReader::location(xuint32 session, xuint32 id) const
+  {
+  auto it = _locations.find(qMakePair(session, id));
+  return it == _locations.end() ? 0 : &it.value();
+  }
+
+QVector<DebugTraceWriter::Row> DebugTraceReader::query(xint64 from, xint64 to) const
+  {
+  QVector<DebugTraceWriter::Row> rows;
+  QDir dir(_directory);
+
+  xForeach(const Block &b, _blocks)
+    {
+    if(!b.rows || b.maxTime < from || b.minTime > to)
+      {
+      continue;
+      }
+
+    QVector<xint64> times, durations;
+    QVector<xuint64> threads, messageEnds;
+    QVector<xuint32> sessions, locations;
+    QVector<xuint8> types;
+
+    // the previous row's end is where the block's first message starts.
+    const xuint64 endsFrom = b.firstRow ? b.firstRow - 1 : 0;
+    const xuint32 endsCount = b.rows + (b.firstRow ? 1 : 0);
+    if(!readColumn(dir.filePath(TimeName), b.firstRow, b.rows, times) ||
+       !readColumn(dir.filePath(SessionName), b.firstRow, b.rows, sessions) ||
+       !readColumn(dir.filePath(ThreadName), b.firstRow, b.rows, threads) ||
+       !readColumn(dir.filePath(LocationName), b.firstRow, b.rows, locations) ||
+       !readColumn(dir.filePath(DurationName), b.firstRow, b.rows, durations) ||
+       !readColumn(dir.filePath(TypeName), b.firstRow, b.rows, types) ||
+       !readColumn(dir.filePath(MessageEndName), endsFrom, endsCount, messageEnds))
+      {
+      qWarning() << "Failed to read trace block at row" << b.firstRow;
+      continue;
+      }
+
+    const xuint64 messageStart = b.firstRow ? messageEnds[0] : 0;
+    const xuint64 *ends = messageEnds.constData() + (b.firstRow ? 1 : 0);
+
+    QFile messageFile(dir.filePath(MessageDataName));
+    QByteArray messages;
+    if(messageFile.open(QIODevice::ReadOnly) && messageFile.seek(messageStart))
+      {
+      messages = messageFile.read(ends[b.rows - 1] - messageStart);
+      }
+
+    xuint64 start = messageStart;
+    for(xuint32 i = 0; i < b.rows; ++i)
+      {
+      const xuint64 end = ends[i];
+      if(times[i] >= from && times[i] <= to)
+        {
+        DebugTraceWriter::Row r;
+        r.time = times[i];
+        r.session = sessions[i];
+        r.thread = threads[i];
+        r.location = locations[i];
+        r.duration = durations[i];
+        r.type = (DebugTraceWriter::RowType)types[i];
+        if(end > start && end - messageStart <= (xuint64)messages.size())
+          {
+          r.message = QString::fromUtf8(messages.constData() + (start - messageStart), (int)(end - start));
+          }
+        rows << r;
+        }
+      start = end;
+      }
+    }
+
+  return rows;
+  }
+
+DebugTraceRecorder::DebugTraceRecorder(DebugTraceWriter *writer, DebugLoggerData *data)
+    : _writer(writer),
+      _session(writer->beginSession())
+  {
+  connect(
+    data,
+    &DebugLoggerData::eventCreated,
+    this,
+    [this](const Eks::Time &time,
+        DebugLogger::EventType type,
+        xuint64 thread,
+        const QString &display,
+        const xsize durationId,
+        const DebugLogger::DebugLocationWithData *loc)
+      {
+      addLocation(loc);
+
+      DebugTraceWriter::Row row;
+      row.time = time.nanoseconds();
+      row.session = _session;
+      row.thread = thread;
+      row.location = loc ? loc->id() : DebugLogger::InvalidLocation;
+      row.duration = 0;
+
+      if(type == DebugLogger::EventType::Begin)
+        {
+        if(_open.size() < MaxOpenDurations)
+          {
+          OpenDuration d = { row.time, row.location };
+          _open.insert(qMakePair(thread, durationId), d);
+          return;
+          }
+
+        row.type = DebugTraceWriter::RowType::Duration;
+        row.duration = -1;
+        }
+      else if(durationId == std::numeric_limits<xsize>::max())
+        {
+        row.type = DebugTraceWriter::RowType::Log;
+        row.message = display;
+        }
+      else
+        {
+        row.type = DebugTraceWriter::RowType::Moment;
+        }
+
+      _writer->addRow(row);
+      });
+
+  connect(
+    data,
+    &DebugLoggerData::eventEndUpdated,
+    this,
+    [this](const xsize id, const xsize thread, const Eks::Time &endTime)
+      {
+      auto it = _open.find(qMakePair((xuint64)thread, id));
+      if(it == _open.end())
+        {
+        return;
+        }
+
+      DebugTraceWriter::Row row;
+      row.time = it->time;
+      row.session = _session;
+      row.thread = thread;
+      row.location = it->location;
+      row.duration = endTime.nanoseconds() - it->time;
+      row.type = DebugTraceWriter::RowType::Duration;
+      _writer->addRow(row);
+
+      _open.erase(it);
+      });
+
+  startTimer(FlushInterval);
+  }
+
+DebugTraceRecorder::~DebugTraceRecorder()
+  {
+  for(auto it = _open.begin(); it != _open.end(); ++it)
+    {
+    DebugTraceWriter::Row row;
+    row.time = it->time;
+    row.session = _session;
+    row.thread = it.key().first;
+    row.location = it->location;
+    row.duration = -1;
+    row.type = DebugTraceWriter::RowType::Duration;
+    _writer->addRow(row);
+    }
+
+  _writer->flush();
+  }
+
+void DebugTraceRecorder::timerEvent(QTimerEvent *)
+  {
+  _writer->flush();
+  }
+
+void DebugTraceRecorder::addLocation(const DebugLogger::DebugLocationWithData *location)
+  {
+  if(location && !_writer->hasLocation(_session, location->id()))
+    {
+    _writer->addLocation(_session, *location);
+    }
+  }
+
+}
@@ -0,0 +1,170 @@
+#include "XDebugTransport.h"
+#include "XDebugSharedMemoryTransport.h"
+#include "QTcpServer"
+#include "QTcpSocket"
+#include "QLocalServer"
+#include "QLocalSocket"
+
+namespace Eks
+{
+
+const char *DebugTransport::ServerName = "EksDebug";
+
+class DebugTcpTransport : public DebugTransport
+  {
+public:
+  DebugTcpTransport(QObject *parent)
+      : DebugTransport(parent),
+        _server(0)
+    {
+    }
+
+  QIODevice *connectToServer() X_OVERRIDE
+    {
+    QTcpSocket *socket = new QTcpSocket(this);
+    connect(socket, &QTcpSocket::connected, this, &DebugTransport::connected);
+    socket->connectToHost(QHostAddress::LocalHost, TcpPort);
+    return socket;
+    }
+
+  bool listen() X_OVERRIDE
+    {
+    _server = new QTcpServer(this);
+    connect(_server, &QTcpServer::newConnection, this, &DebugTransport::newConnection);
+    return _server->listen(QHostAddress::Any, TcpPort);
+    }
+
+  QIODevice *nextPendingConnection() X_OVERRIDE
+    {
+    return _server->nextPendingConnection();
+    }
+
+  void flush(QIODevice *device, int msecs) X_OVERRIDE
+    {
+    QTcpSocket *socket = static_cast<QTcpSocket *>(device);
+    socket->flush();
+    socket->waitForBytesWritten(msecs);
+    }
+
+private:
+  QTcpServer *_server;
+  };
+
+class DebugLocalTransport : public DebugTransport
+  {
+public:
+  DebugLocalTransport(QObject *parent)
+      : DebugTransport(parent),
+        _server(0)
+    {
+    }
+
+  QIODevice *connectToServer() X_OVERRIDE
+    {
+    QLocalSocket *socket = new QLocalSocket(this);
+    connect(socket, &QLocalSocket::connected, this, &DebugTransport::connected);
+    socket->connectToServer(ServerName);
+    return socket;
+    }
+
+  bool listen() X_OVERRIDE
+    {
+    _server = new QLocalServer(this);
+    connect(_server, &QLocalServer::newConnection, this, &DebugTransport::newConnection);
+
+    // a crashed debugger can leave its socket file behind.
+    QLocalServer::removeServer(ServerName);
+    return _server->listen(ServerName);
+    }
+
+  QIODevice *nextPendingConnection() X_OVERRIDE
+    {
+    return _server->nextPendingConnection();
+    }
+
+  void flush(QIODevice *device, int msecs) X_OVERRIDE
+    {
+    QLocalSocket *socket = static_cast<QLocalSocket *>(device);
+    socket->flush();
+    socket->waitForBytesWritten(msecs);
+    }
+
+private:
+  QLocalServer *_server;
+  };
+
+class DebugNullDevice : public QIODevice
+  {
+public:
+  DebugNullDevice(QObject *parent)
+      : QIODevice(parent)
+    {
+    open(QIODevice::ReadWrite | QIODevice::Unbuffered);
+    }
+
+  bool isSequential() const X_OVERRIDE { return true; }
+
+protected:
+  qint64 readData(char *, qint64) X_OVERRIDE
+    {
+    return 0;
+    }
+
+  qint64 writeData(const char *, qint64 len) X_OVERRIDE
+    {
+    return len;
+    }
+  };
+
+class DebugNullTransport : public DebugTransport
+  {
+public:
+  DebugNullTransport(QObject *parent)
+      : DebugTransport(parent)
+    {
+    }
+
+  QIODevice *connectToServer() X_OVERRIDE
+    {
+    // connected from the event loop, as a real transport would be.
+    QMetaObject::invokeMethod(this, "connected", Qt::QueuedConnection);
+    return new DebugNullDevice(this);
+    }
+
+  bool listen() X_OVERRIDE
+    {
+    return true;
+    }
+
+  QIODevice *nextPendingConnection() X_OVERRIDE
+    {
+    return 0;
+    }
+
+  void flush(QIODevice *, int) X_OVERRIDE
+    {
+    }
+  };
+
+DebugTransport::DebugTransport(QObject *parent)
+    : QObject(parent)
+  {
+  }
+
+DebugTransport *DebugTransport::create(DebugManager::Transport type, QObject *parent)
+  {
+  switch(type)
+    {
+  case DebugManager::Transport::LocalSocket:
+    return new DebugLocalTransport(parent);
+  case DebugManager::Transport::SharedMemory:
+    return new DebugSharedMemoryTransport(parent);
+  case DebugManager::Transport::Null:
+    return new DebugNullTransport(parent);
+  case DebugManager::Transport::Tcp:
+  default:
+    return new DebugTcpTransport(parent);
+    }
+  }
+
+}
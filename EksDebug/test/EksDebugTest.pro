@@ -0,0 +1,29 @@
+#-------------------------------------------------
+#
+# EksDebug unit tests
+#
+#-------------------------------------------------
+
+QT       += network testlib
+QT       -= gui
+
+include("../../EksCore/GeneralOptions.pri")
+
+TARGET = EksDebugTest
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+
+SOURCES += XDebugTest.cpp
+
+DEFINES += SRCDIR=\\\"$$PWD/\\\"
+
+INCLUDEPATH += $$ROOT/Eks/EksCore/include \
+    $$ROOT/Eks/EksDebug/include
+
+LIBS += -lEksCore -lEksDebug
+
+HEADERS += \
+    XDebugTest.h
@@ -0,0 +1,1351 @@
+#include "XDebugTest.h"
+#include "XDebugInterface.h"
+#include "XDebugManager.h"
+#include "XDebugFrameParser.h"
+#include "XDebugCompression.h"
+#include "XDebugCompactEncoding.h"
+#include "XDebugPreConnectBuffer.h"
+#include "XDebugMetrics.h"
+#include "XDebugAllocatorTracker.h"
+#include "XDebugProfiler.h"
+#include "XDebugLogger.h"
+#include "XDebugTimestamp.h"
+#include "XDebugTrace.h"
+#include "Math/XMathHelpers.h"
+#include "QTcpServer"
+#include "QTcpSocket"
+#include "QElapsedTimer"
+#include "QTemporaryDir"
+#include "QBuffer"
+#include "QThread"
+#include "QDir"
+#include <QtTest>
+#include <atomic>
+#include <limits>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace Eks
+{
+
+class StressInterface : public DebugInterface
+  {
+  X_DEBUG_INTERFACE(StressInterface)
+
+public:
+  struct Message
+    {
+    enum
+      {
+      DebugMessageType = 1
+      };
+
+    xuint32 thread;
+    xuint32 sequence;
+    QByteArray payload;
+    };
+
+  void emitMessage(const Message &m)
+    {
+    sendData(m);
+    }
+
+private:
+  void onMessage(const Message &)
+    {
+    }
+  };
+
+QDataStream &operator<<(QDataStream &s, const StressInterface::Message &m)
+  {
+  return s << m.thread << m.sequence << m.payload;
+  }
+
+QDataStream &operator>>(QDataStream &s, StressInterface::Message &m)
+  {
+  return s >> m.thread >> m.sequence >> m.payload;
+  }
+
+X_IMPLEMENT_DEBUG_INTERFACE(StressInterface)
+
+StressInterface::StressInterface(DebugManager *, bool)
+  {
+  static Reciever recv[] =
+    {
+    recieveFunction<Message, StressInterface, &StressInterface::onMessage>(),
+    };
+
+  static const DispatchTable dispatch(recv, X_ARRAY_COUNT(recv));
+  setRecievers(dispatch);
+  }
+
+}
+
+namespace
+{
+
+QByteArray stressPayload(xuint32 thread, xuint32 sequence)
+  {
+  QByteArray data((sequence * 7 + thread) % 200, 0);
+  for(int i = 0; i < data.size(); ++i)
+    {
+    data[i] = (char)(thread * 31 + sequence + i);
+    }
+  return data;
+  }
+
+/// Reads the framed stream written by a client DebugManager, checking each frame.
+class FrameChecker
+  {
+public:
+  FrameChecker(xuint32 threads)
+      : frames(0),
+        compressionMarkers(0),
+        failed(false),
+        _nextSequence((int)threads, 0)
+    {
+    }
+
+  void append(const QByteArray &data)
+    {
+    _buffer += data;
+
+    static const int HeaderSize = 8;
+    while(!failed && _buffer.size() >= HeaderSize)
+      {
+      QDataStream header(_buffer);
+      xuint32 id, length;
+      header >> id >> length;
+      if(_buffer.size() < HeaderSize + (int)length)
+        {
+        return;
+        }
+
+      check(id, _buffer.mid(HeaderSize, length));
+      _buffer.remove(0, HeaderSize + length);
+      }
+    }
+
+  xuint32 frames;
+  // CompressionStart frames, which only the debugger should be sent.
+  xuint32 compressionMarkers;
+  bool failed;
+
+private:
+  void check(xuint32 id, const QByteArray &payload)
+    {
+    QDataStream s(payload);
+    xuint8 type;
+    s >> type;
+
+    if(id == 0)
+      {
+      if(type == 4)
+        {
+        xuint32 newID, typeHash;
+        QString typeName;
+        s >> newID >> typeHash >> typeName;
+
+        // each type is named only with its first setup.
+        if(!typeName.isEmpty())
+          {
+          _typeNames[typeHash] = typeName;
+          }
+        _announced[newID] = _typeNames.value(typeHash);
+        }
+      else if(type == 3)
+        {
+        ++compressionMarkers;
+        }
+      return;
+      }
+
+    Eks::StressInterface::Message msg;
+    s >> msg;
+
+    // frames must follow their setup, keep their length and arrive in thread order.
+    if(_announced.value(id) != "StressInterface" ||
+       !s.atEnd() ||
+       s.status() != QDataStream::Ok ||
+       msg.thread >= (xuint32)_nextSequence.size() ||
+       msg.sequence != _nextSequence[msg.thread] ||
+       msg.payload != stressPayload(msg.thread, msg.sequence))
+      {
+      failed = true;
+      return;
+      }
+
+    ++_nextSequence[msg.thread];
+    ++frames;
+    }
+
+  QByteArray _buffer;
+  QHash<xuint32, QString> _announced;
+  QHash<xuint32, QString> _typeNames;
+  std::vector<xuint32> _nextSequence;
+  };
+
+struct RecordedFrame
+  {
+  xuint32 id;
+  QByteArray payload;
+  };
+
+/// A frame for [id], holding [size] bytes of [fill].
+QByteArray preConnectFrame(xuint32 id, xuint32 size, char fill)
+  {
+  QByteArray frame;
+  QDataStream s(&frame, QIODevice::WriteOnly);
+  s << id << size;
+  frame.append(QByteArray((int)size, fill));
+  return frame;
+  }
+
+/// Builds a framed stream, mostly small frames with some larger than the parser's buffer.
+QByteArray recordStream(std::mt19937 &rng, std::vector<RecordedFrame> &frames)
+  {
+  QByteArray stream;
+  QDataStream s(&stream, QIODevice::WriteOnly);
+
+  for(xuint32 i = 0; i < 2000; ++i)
+    {
+    const xuint32 size = rng() % 50 == 0 ? rng() % (600 * 1024) : rng() % 300;
+
+    RecordedFrame frame = { rng() % 64, QByteArray((int)size, Qt::Uninitialized) };
+    for(int b = 0; b < frame.payload.size(); ++b)
+      {
+      // compressible, but not trivially.
+      frame.payload[b] = (char)(rng() % 4 ? b % 13 : rng());
+      }
+
+    s << frame.id << (xuint32)size;
+    s.writeRawData(frame.payload.constData(), frame.payload.size());
+    frames.push_back(frame);
+    }
+
+  return stream;
+  }
+
+xsize chunkSize(std::mt19937 &rng)
+  {
+  switch(rng() % 3)
+    {
+  case 0:
+    return 1 + rng() % 8;
+  case 1:
+    return 1 + rng() % 2048;
+  default:
+    return 1 + rng() % (128 * 1024);
+    }
+  }
+
+/// Parses all complete frames, checking them against the recording, false on a mismatch.
+bool checkFrames(Eks::DebugFrameParser &parser, const std::vector<RecordedFrame> &frames, xsize &next)
+  {
+  Eks::DebugFrameParser::Frame frame;
+  while(parser.nextFrame(frame))
+    {
+    if(next >= frames.size() ||
+       frame.id != frames[next].id ||
+       QByteArray(frame.data, (int)frame.size) != frames[next].payload)
+      {
+      return false;
+      }
+
+    // the reciever's view reads exactly the frame.
+    QByteArray read((int)frame.size, Qt::Uninitialized);
+    QDataStream &s = parser.stream(frame);
+    if(s.readRawData(read.data(), read.size()) != read.size() || !s.atEnd() || read != frames[next].payload)
+      {
+      return false;
+      }
+
+    ++next;
+    }
+
+  return true;
+  }
+
+}
+
+void EksDebugTest::frameParserFuzzTest()
+  {
+  for(xuint32 seed = 0; seed < 8; ++seed)
+    {
+    std::mt19937 rng(seed);
+    std::vector<RecordedFrame> frames;
+    const QByteArray stream = recordStream(rng, frames);
+
+    Eks::DebugFrameParser parser;
+    xsize next = 0;
+    for(xsize pos = 0; pos < (xsize)stream.size();)
+      {
+      const xsize chunk = xMin(chunkSize(rng), stream.size() - pos);
+      parser.buffer().append(stream.constData() + pos, chunk);
+      pos += chunk;
+
+      QVERIFY(checkFrames(parser, frames, next));
+      }
+
+    QCOMPARE(next, frames.size());
+    QCOMPARE(parser.buffer().size(), (xsize)0);
+    }
+  }
+
+void EksDebugTest::compressedFrameParserFuzzTest()
+  {
+  for(xuint32 seed = 0; seed < 8; ++seed)
+    {
+    std::mt19937 rng(seed);
+    std::vector<RecordedFrame> frames;
+    const QByteArray raw = recordStream(rng, frames);
+
+    QByteArray stream;
+    Eks::DebugStreamCompressor::compressBlocks(raw.constData(), raw.size(), stream);
+    QVERIFY(stream.size() < raw.size());
+
+    Eks::DebugStreamDecompressor decompressor;
+    Eks::DebugFrameParser parser;
+    xsize next = 0;
+    for(xsize pos = 0; pos < (xsize)stream.size();)
+      {
+      const xsize chunk = xMin(chunkSize(rng), stream.size() - pos);
+      decompressor.input().append(stream.constData() + pos, chunk);
+      pos += chunk;
+
+      xsize produced = 0;
+      QVERIFY(decompressor.decode(parser.buffer(), produced));
+      QVERIFY(checkFrames(parser, frames, next));
+      }
+
+    QCOMPARE(next, frames.size());
+    }
+  }
+
+void EksDebugTest::preConnectBufferTest()
+  {
+  typedef Eks::DebugManager::PreConnectPolicy Policy;
+
+  static const xuint32 PayloadSize = 100;
+  static const xsize FrameSize = 8 + PayloadSize;
+  static const xuint32 FrameCount = 5;
+
+  const QByteArray init = preConnectFrame(0, 8, 'i');
+  const QByteArray setup = preConnectFrame(0, 12, 's');
+
+  // room for three frames. The controller's frames come after data, and go out first.
+  auto fill = [&](Eks::DebugPreConnectBuffer &buffer, Policy policy, const QString &spill, bool bytewise)
+    {
+    buffer.configure(FrameSize * 3, policy, spill);
+
+    QByteArray stream = init;
+    for(xuint32 i = 0; i < FrameCount; ++i)
+      {
+      stream += preConnectFrame(1, PayloadSize, (char)('0' + i));
+      if(i == 1)
+        {
+        stream += setup;
+        }
+      }
+
+    if(bytewise)
+      {
+      for(int i = 0; i < stream.size(); ++i)
+        {
+        buffer.write(stream.constData() + i, 1);
+        }
+      }
+    else
+      {
+      buffer.write(stream);
+      }
+    };
+
+  auto replay = [](Eks::DebugPreConnectBuffer &buffer)
+    {
+    QBuffer out;
+    out.open(QIODevice::WriteOnly);
+    buffer.replay(&out);
+    return out.data();
+    };
+
+  auto frames = [&](const char *kept)
+    {
+    QByteArray expected = init + setup;
+    for(const char *c = kept; *c; ++c)
+      {
+      expected += preConnectFrame(1, PayloadSize, *c);
+      }
+    return expected;
+    };
+
+  for(int bytewise = 0; bytewise < 2; ++bytewise)
+    {
+      {
+      Eks::DebugPreConnectBuffer buffer;
+      fill(buffer, Policy::DropOldest, QString(), bytewise != 0);
+
+      const Eks::DebugManager::PreConnectStatistics stats = buffer.statistics();
+      QCOMPARE(stats.droppedFrames, (xuint64)2);
+      QCOMPARE(stats.droppedBytes, (xuint64)(2 * FrameSize));
+      QCOMPARE(stats.spilledFrames, (xuint64)0);
+      QCOMPARE(stats.bufferedBytes, (xsize)(3 * FrameSize + init.size() + setup.size()));
+
+      QCOMPARE(replay(buffer), frames("234"));
+      QCOMPARE(buffer.statistics().bufferedBytes, (xsize)0);
+      }
+
+      {
+      Eks::DebugPreConnectBuffer buffer;
+      fill(buffer, Policy::DropNewest, QString(), bytewise != 0);
+
+      const Eks::DebugManager::PreConnectStatistics stats = buffer.statistics();
+      QCOMPARE(stats.droppedFrames, (xuint64)2);
+      QCOMPARE(stats.droppedBytes, (xuint64)(2 * FrameSize));
+      QCOMPARE(replay(buffer), frames("012"));
+      }
+
+      {
+      QTemporaryDir dir;
+      QVERIFY(dir.isValid());
+
+      Eks::DebugPreConnectBuffer buffer;
+      fill(buffer, Policy::SpillToFile, dir.filePath("spill"), bytewise != 0);
+
+      // nothing is lost, the oldest frames wait in the spill file.
+      const Eks::DebugManager::PreConnectStatistics stats = buffer.statistics();
+      QCOMPARE(stats.droppedFrames, (xuint64)0);
+      QCOMPARE(stats.spilledFrames, (xuint64)2);
+      QCOMPARE(stats.spilledBytes, (xuint64)(2 * FrameSize));
+      QCOMPARE(replay(buffer), frames("01234"));
+      QVERIFY(!QFile::exists(dir.filePath("spill")));
+      }
+    }
+
+  // a frame larger than the budget is never held, whatever the policy.
+  Eks::DebugPreConnectBuffer buffer;
+  buffer.configure(FrameSize, Policy::DropOldest, QString());
+  buffer.write(init);
+  buffer.write(preConnectFrame(1, PayloadSize * 2, 'x'));
+  QCOMPARE(buffer.statistics().droppedFrames, (xuint64)1);
+  QCOMPARE(replay(buffer), init);
+
+  // controller frames are held outside the budget, but only up to MaxControlBytes.
+  static const xuint32 ControlSize = Eks::DebugPreConnectBuffer::MaxControlBytes / 4;
+  Eks::DebugPreConnectBuffer control;
+  QByteArray held;
+  for(xuint32 i = 0; i < 3; ++i)
+    {
+    held += preConnectFrame(0, ControlSize - 8, (char)('a' + i));
+    }
+  control.write(held);
+  control.write(preConnectFrame(0, ControlSize, 'x'));
+  control.write(setup);
+  const Eks::DebugManager::PreConnectStatistics stats = control.statistics();
+  QCOMPARE(stats.droppedControlFrames, (xuint64)1);
+  QCOMPARE(stats.droppedControlBytes, (xuint64)(ControlSize + 8));
+  QCOMPARE(replay(control), held + setup);
+  }
+
+void EksDebugTest::compactTimeTest()
+  {
+  Eks::DebugManager manager(false);
+
+  // each time in its own frame, so frames can be lost.
+  auto write = [](xint64 ns)
+    {
+    QByteArray frame;
+    QDataStream s(&frame, QIODevice::WriteOnly);
+    Eks::DebugCompactWriter w(s);
+    w.writeThreadTime(1, ns);
+    w.flush();
+    return frame;
+    };
+  auto read = [](const QByteArray &frame, xint64 &ns)
+    {
+    QDataStream s(frame);
+    Eks::DebugCompactReader r(s);
+    return r.readThreadTime(1, ns);
+    };
+
+  Eks::DebugCompactWriter::forceKeyframes();
+  const QByteArray first = write(1000);
+  const QByteArray second = write(1500);
+  const QByteArray lost = write(2500);
+  const QByteArray afterGap = write(3000);
+
+  xint64 ns = 0;
+  QVERIFY(read(first, ns));
+  QCOMPARE(ns, (xint64)1000);
+  QVERIFY(read(second, ns));
+  QCOMPARE(ns, (xint64)1500);
+  Q_UNUSED(lost);
+
+  // a delta after a gap is reported unresolved, not as a stale time.
+  QVERIFY(!read(afterGap, ns));
+  QCOMPARE(ns, (xint64)0);
+
+  Eks::DebugCompactWriter::forceKeyframes();
+  QVERIFY(read(write(4000), ns));
+  QCOMPARE(ns, (xint64)4000);
+
+  // a reader joining part way can't resolve deltas until a keyframe is forced.
+  Eks::DebugCompactReader::resetThreadTimes();
+  QVERIFY(!read(write(5000), ns));
+  Eks::DebugCompactWriter::forceKeyframes();
+  QVERIFY(read(write(6000), ns));
+  QCOMPARE(ns, (xint64)6000);
+  }
+
+void EksDebugTest::sendLimitTest()
+  {
+  Eks::DebugManager manager(true);
+  Eks::StressInterface ifc(0, true);
+
+  auto send = [&ifc]()
+    {
+    for(xuint32 seq = 0; seq < 100; ++seq)
+      {
+      Eks::StressInterface::Message msg = { 0, seq, QByteArray() };
+      ifc.emitMessage(msg);
+      }
+    return ifc.sendStatistics();
+    };
+
+  const Eks::DebugManager::SendLimit sampled = { 0, 0, 4 };
+  ifc.setSendLimit(sampled);
+
+  Eks::DebugManager::SendStatistics stats = send();
+  QCOMPARE(stats.sent, (xuint64)25);
+  QCOMPARE(stats.dropped, (xuint64)75);
+
+  // one a second, so little more than the burst gets through while sending.
+  const Eks::DebugManager::SendLimit limited = { 1, 10, 1 };
+  ifc.setSendLimit(limited);
+  const Eks::DebugManager::SendStatistics cleared = { 0, 0 };
+  ifc.setSendStatistics(cleared);
+
+  stats = send();
+  QVERIFY(stats.sent >= 10 && stats.sent <= 11);
+  QCOMPARE(stats.sent + stats.dropped, (xuint64)100);
+
+  // sends are counted on each sending thread and summed.
+  const Eks::DebugManager::SendLimit unlimited = { 0, 0, 1 };
+  ifc.setSendLimit(unlimited);
+  ifc.setSendStatistics(cleared);
+  std::thread other([&send]() { send(); });
+  other.join();
+  stats = send();
+  QCOMPARE(stats.sent, (xuint64)200);
+  QCOMPARE(stats.dropped, (xuint64)0);
+
+  // an interface given a freed counter slot starts from zero.
+  {
+  Eks::StressInterface before(0, true);
+  Eks::StressInterface::Message msg = { 0, 0, QByteArray() };
+  before.emitMessage(msg);
+  QCOMPARE(before.sendStatistics().sent, (xuint64)1);
+  }
+  Eks::StressInterface after(0, true);
+  QCOMPARE(after.sendStatistics().sent, (xuint64)0);
+  }
+
+void EksDebugTest::metricsTest()
+  {
+  typedef Eks::DebugMetricsInterface Metrics;
+
+  // buckets follow the value, and hold values within 1/16 of their lowest.
+  xsize last = 0;
+  for(xint64 v = 0; v < 100000; ++v)
+    {
+    const xsize bucket = Metrics::histogramBucket(v);
+    QVERIFY(bucket == last || bucket == last + 1);
+    QVERIFY(Metrics::histogramBucketValue(bucket) <= v);
+    QVERIFY((v - Metrics::histogramBucketValue(bucket)) * Metrics::HistogramSubBuckets <= v);
+    last = bucket;
+    }
+  QVERIFY(Metrics::histogramBucket(std::numeric_limits<xint64>::max()) < Metrics::HistogramBuckets);
+
+  Eks::DebugManager manager(true);
+  Metrics metrics(0, true);
+
+  const Metrics::Metric gauge = metrics.addMetric("Gauge", Metrics::MetricType::Gauge);
+  const Metrics::Metric counter = metrics.addMetric("Counter", Metrics::MetricType::Counter);
+  const Metrics::Metric latency = metrics.addMetric("Latency", Metrics::MetricType::Histogram);
+
+  static const xuint32 ThreadCount = 4;
+  static const xint64 Values = 10000;
+  std::vector<std::thread> threads;
+  for(xuint32 i = 0; i < ThreadCount; ++i)
+    {
+    threads.emplace_back([&metrics, counter, latency]()
+      {
+      for(xint64 v = 1; v <= Values; ++v)
+        {
+        metrics.addCount(counter);
+        metrics.recordValue(latency, v);
+        }
+      });
+    }
+
+  for(auto &t : threads)
+    {
+    t.join();
+    }
+  metrics.setGauge(gauge, 42);
+
+  Metrics::Summary summary = metrics.summarise();
+  QCOMPARE(summary.entries.size(), 3);
+  QCOMPARE(summary.entries[gauge].value, (xint64)42);
+  QCOMPARE(summary.entries[counter].value, (xint64)(ThreadCount * Values));
+  QCOMPARE(summary.entries[counter].count, (xint64)(ThreadCount * Values));
+
+  const Metrics::Summary::Entry &hist = summary.entries[latency];
+  QCOMPARE(hist.count, (xint64)(ThreadCount * Values));
+  QCOMPARE(hist.value, (Values + 1) / 2);
+  QCOMPARE(hist.min, (xint64)1);
+  QVERIFY(hist.p50 <= Values / 2 && hist.p50 * 17 / 16 >= Values / 2);
+  QVERIFY(hist.p99 <= Values * 99 / 100 && hist.p99 * 17 / 16 >= Values * 99 / 100);
+  QVERIFY(hist.max <= Values && hist.max * 17 / 16 >= Values);
+
+  // the next summary only holds what was recorded since.
+  metrics.recordValue(latency, 7);
+  summary = metrics.summarise();
+  QCOMPARE(summary.entries[counter].count, (xint64)0);
+  QCOMPARE(summary.entries[latency].count, (xint64)1);
+  QCOMPARE(summary.entries[latency].p50, (xint64)7);
+  }
+
+void EksDebugTest::allocatorTrackerTest()
+  {
+  Eks::DebugTrackingAllocator tracker(Eks::Core::defaultAllocator(), "Test");
+
+  std::vector<void *> blocks;
+  for(xsize i = 1; i <= 64; ++i)
+    {
+    void *mem = tracker.alloc(i * 8, 16);
+    QVERIFY(mem);
+    QCOMPARE((xsize)mem % 16, (xsize)0);
+    blocks.push_back(mem);
+    }
+
+  QCOMPARE(tracker.liveAllocations(), (xuint64)64);
+  QCOMPARE(tracker.liveBytes(), (xuint64)(8 * 64 * 65 / 2));
+
+  const xuint64 peak = tracker.liveBytes();
+  for(void *mem : blocks)
+    {
+    tracker.free(mem);
+    }
+
+  QCOMPARE(tracker.liveAllocations(), (xuint64)0);
+  QCOMPARE(tracker.liveBytes(), (xuint64)0);
+  QCOMPARE(tracker.peakBytes(), peak);
+  QCOMPARE(tracker.allocations(), (xuint64)64);
+
+  Eks::DebugAllocatorInterface::setSampleInterval(4);
+  for(xsize i = 0; i < 64; ++i)
+    {
+    tracker.free(tracker.alloc(32, 8));
+    }
+  Eks::DebugAllocatorInterface::setSampleInterval(0);
+
+  Eks::DebugAllocatorInterface ifc(0, true);
+  const Eks::DebugAllocatorInterface::Summary summary = ifc.summarise();
+
+  bool found = false;
+  xForeach(const Eks::DebugAllocatorInterface::Summary::AllocatorEntry &e, summary.allocators)
+    {
+    found |= e.name == "Test" && e.allocations == 128 && e.peakBytes == peak;
+    }
+  QVERIFY(found);
+
+  xuint64 samples = 0;
+  xForeach(const Eks::DebugAllocatorInterface::Summary::SiteEntry &e, summary.sites)
+    {
+    samples += e.samples;
+    }
+  QCOMPARE(samples, (xuint64)16);
+  }
+
+void EksDebugTest::profilerTest()
+  {
+#if defined(Q_OS_LINUX)
+  Eks::DebugProfilerInterface profiler(0, true);
+  QVERIFY(profiler.setSampleRate(1000));
+
+  // a second profiler can't take the signal from the first.
+  Eks::DebugProfilerInterface other(0, true);
+  QCOMPARE(other.sampleRate(), (xuint32)0);
+
+  QElapsedTimer timer;
+  timer.start();
+  volatile xuint64 spin = 0;
+  while(timer.elapsed() < 200)
+    {
+    ++spin;
+    }
+
+  const Eks::DebugProfilerInterface::Samples samples = profiler.collect();
+  QVERIFY(profiler.setSampleRate(0));
+
+  xuint32 count = 0;
+  xForeach(const Eks::DebugProfilerInterface::Samples::Entry &e, samples.entries)
+    {
+    count += e.count;
+    }
+  QVERIFY(count + samples.dropped > 20);
+
+  // the debugger's model shows frames straight away, addr2line names them in the background.
+  typedef Eks::DebugProfilerInterface Profiler;
+  Eks::DebugProfilerModel model;
+  Profiler::Module module;
+  module.id = 0;
+  module.path = "/nonexistent/module.so";
+  module.linkBase = 0;
+  model.addModule(module);
+
+  Profiler::Stack stack;
+  stack.id = 0;
+  const Profiler::Frame frame = { 0, 0x10 };
+  stack.frames << frame;
+  model.addStack(stack);
+
+  Profiler::Samples sampled;
+  sampled.interval = Profiler::SendInterval;
+  sampled.sampleRate = Profiler::DefaultSampleRate;
+  sampled.dropped = 0;
+  const Profiler::Samples::Entry entry = { 1, 0, 5 };
+  sampled.entries << entry;
+  model.addSamples(sampled);
+
+  QCOMPARE(model.rowCount(QModelIndex()), 1);
+  QCOMPARE(model.data(model.index(0, 0), Qt::DisplayRole).toString(), QString("module.so+0x10"));
+  QTRY_VERIFY_WITH_TIMEOUT(!model.isSymbolising(), 10000);
+  // addr2line can't read the module, so the frame keeps its offset name.
+  QCOMPARE(model.data(model.index(0, 0), Qt::DisplayRole).toString(), QString("module.so+0x10"));
+  QCOMPARE(model.data(model.index(0, 3), Qt::DisplayRole).toString(), QString("5"));
+#else
+  QSKIP("Profiling needs SIGPROF");
+#endif
+  }
+
+void EksDebugTest::loggerTest()
+  {
+  typedef Eks::DebugLogger Logger;
+
+  QTcpServer server;
+  QVERIFY(server.listen(QHostAddress::LocalHost, 12345));
+
+  Eks::DebugManager manager(true);
+
+  QVERIFY(server.waitForNewConnection(5000));
+  QTcpSocket *reader = server.nextPendingConnection();
+  QVERIFY(reader);
+
+  static Logger::Location scope = { __FILE__, Q_FUNC_INFO, __LINE__, "Scope", { Logger::InvalidLocation } };
+  static Logger::Location moment = { __FILE__, Q_FUNC_INFO, __LINE__, "Moment", { Logger::InvalidLocation } };
+
+  // without a client logger, recording does nothing.
+  QCOMPARE(Logger::begin(scope), (xuint32)0);
+  Logger::moment(moment);
+  QCOMPARE(moment.id.load(), (xuint32)Logger::InvalidLocation);
+
+  Logger logger(0, true);
+
+  // the debugger's end, decoding the client logger's frames from the stream.
+  Logger decoder(0, false);
+  Eks::DebugLoggerData *data = static_cast<Eks::DebugLoggerData *>(decoder.dataModel());
+
+  xuint64 received = 0;
+  xuint64 unmatched = 0;
+  QHash<xuint64, QSet<xsize>> open;
+  bool logging = false;
+  QStringList logs;
+  QObject::connect(data, &Eks::DebugLoggerData::eventCreated, [&](
+      const Eks::Time &,
+      Logger::EventType type,
+      xuint64 thread,
+      const QString &display,
+      const xsize id,
+      const Logger::DebugLocationWithData *)
+    {
+    if(logging)
+      {
+      logs << display;
+      return;
+      }
+
+    ++received;
+    if(type == Logger::EventType::Begin)
+      {
+      open[thread].insert(id);
+      }
+    });
+  QObject::connect(data, &Eks::DebugLoggerData::eventEndUpdated, [&](
+      const xsize id,
+      const xsize thread,
+      const Eks::Time &)
+    {
+    ++received;
+    if(!open[thread].remove(id))
+      {
+      ++unmatched;
+      }
+    });
+
+  // more events than a thread's ring holds, so some may be dropped if the drain falls behind.
+  static const xuint32 ThreadCount = 4;
+  static const xuint32 Events = 2000;
+  static const xuint64 Recorded = ThreadCount * Events * 3;
+
+  std::vector<std::thread> threads;
+  for(xuint32 i = 0; i < ThreadCount; ++i)
+    {
+    threads.emplace_back([]()
+      {
+      for(xuint32 e = 0; e < Events; ++e)
+        {
+        Logger::Scope s(scope);
+        Logger::moment(moment);
+        }
+      });
+    }
+
+  for(auto &t : threads)
+    {
+    t.join();
+    }
+
+  // each location is registered once, however many threads raced to record it.
+  QVERIFY(scope.id.load() != Logger::InvalidLocation);
+  QVERIFY(moment.id.load() != Logger::InvalidLocation);
+  QVERIFY(scope.id.load() != moment.id.load());
+
+  const xuint32 loggerHash = Eks::detail::debugTypeHash("DebugLogger");
+  xuint32 loggerID = Eks::DebugInterface::InvalidInterfaceID;
+
+  Eks::DebugFrameParser parser;
+  auto read = [&]()
+    {
+    QCoreApplication::processEvents();
+    reader->waitForReadyRead(1);
+    const QByteArray bytes = reader->readAll();
+    parser.buffer().append(bytes.constData(), bytes.size());
+
+    Eks::DebugFrameParser::Frame frame;
+    while(parser.nextFrame(frame))
+      {
+      QDataStream s(QByteArray::fromRawData(frame.data, (int)frame.size));
+      if(frame.id != 0)
+        {
+        if(frame.id == loggerID)
+          {
+          decoder.onDataRecieved(s);
+          }
+        continue;
+        }
+
+      xuint8 type;
+      s >> type;
+      if(type == 4)
+        {
+        // SetupInterface.
+        xuint32 id, typeHash;
+        s >> id >> typeHash;
+        if(typeHash == loggerHash)
+          {
+          loggerID = id;
+          }
+        }
+      else if(type == 8)
+        {
+        // InterfaceState, the logger's code locations.
+        xuint32 id;
+        QByteArray message;
+        s >> id >> message;
+        if(id == loggerID)
+          {
+          QDataStream state(message);
+          decoder.onDataRecieved(state);
+          }
+        }
+      }
+    };
+
+  QElapsedTimer timer;
+  timer.start();
+  while(received + logger.droppedEvents() < Recorded && timer.elapsed() < 20000)
+    {
+    read();
+    }
+
+  // every event recorded arrives, or is counted as dropped.
+  QCOMPARE(received + logger.droppedEvents(), Recorded);
+
+  // durations end on the thread they began, after they began. Dropping either half of a
+  // pair leaves the other unmatched.
+  xuint64 unended = 0;
+  xForeach(const QSet<xsize> &ids, open)
+    {
+    unended += ids.size();
+    }
+  QVERIFY(unmatched + unended <= logger.droppedEvents());
+
+  // Qt messages too long for a record arrive whole.
+  logging = true;
+  const QString longMessage(Logger::LogRecord::MaxUtf16Argument * 2, QChar('y'));
+  qDebug("%s", qPrintable(longMessage));
+  qDebug("short");
+
+  timer.restart();
+  while(logs.size() < 2 && timer.elapsed() < 5000)
+    {
+    read();
+    }
+  QCOMPARE(logs.size(), 2);
+  QVERIFY(logs.contains("Debug:\n" + longMessage));
+  QVERIFY(logs.contains("Debug:\nshort"));
+
+  // log records hold each argument's type and raw value, long strings are cut to fit.
+  Logger::LogRecord record;
+  record.add(42);
+  record.add("abc");
+  QCOMPARE(record.size(), (xsize)(Logger::LogRecord::HeaderSize + 9 + 5 + 3));
+
+  Logger::LogRecord cut;
+  cut.add(QString(Logger::MaxLogRecordSize, QChar('x')));
+  QVERIFY(cut.size() <= (xsize)Logger::MaxLogRecordSize);
+  QVERIFY(cut.size() > (xsize)Logger::MaxLogRecordSize - sizeof(xuint16));
+  }
+
+void EksDebugTest::loggerSnapshotTest()
+  {
+  typedef Eks::DebugLogger Logger;
+
+  Eks::DebugManager manager(true, 0, Eks::DebugManager::Transport::Null);
+  Logger logger(0, true);
+
+  // every other message is dropped, the locations must still get through.
+  const Eks::DebugManager::SendLimit sampled = { 0, 0, 2 };
+  logger.setSendLimit(sampled);
+
+  static Logger::Location moment = { __FILE__, Q_FUNC_INFO, __LINE__, "Snapshot", { Logger::InvalidLocation } };
+  Logger::moment(moment);
+
+  // the calibration, the locations and the events.
+  QElapsedTimer timer;
+  timer.start();
+  while(logger.sendStatistics().sent + logger.sendStatistics().dropped < 3 && timer.elapsed() < 5000)
+    {
+    QCoreApplication::processEvents();
+    QThread::msleep(1);
+    }
+  QVERIFY(logger.sendStatistics().sent + logger.sendStatistics().dropped >= 3);
+
+  // a subscriber joining now is sent the locations with the setups.
+  QBuffer *subscriber = new QBuffer;
+  subscriber->open(QIODevice::WriteOnly);
+  Eks::DebugManager::addSubscriber(subscriber);
+
+  const QByteArray data = subscriber->data();
+  QDataStream s(data);
+
+  bool found = false;
+  while(!s.atEnd() && s.status() == QDataStream::Ok)
+    {
+    xuint32 id, length;
+    s >> id >> length;
+
+    QByteArray payload(length, Qt::Uninitialized);
+    s.readRawData(payload.data(), length);
+
+    QDataStream frame(payload);
+    xuint8 type;
+    frame >> type;
+
+    // InterfaceState, holding a LocationList.
+    if(id == 0 && type == 8)
+      {
+      xuint32 stateID;
+      QByteArray message;
+      frame >> stateID >> message;
+      found |= stateID == logger.interfaceID() && !message.isEmpty() && message[0] == (char)3;
+      }
+    }
+
+  QVERIFY(found);
+  }
+
+void EksDebugTest::timestampTest()
+  {
+  typedef Eks::DebugTimestamp Timestamp;
+
+  // a 3 stamps per ns counter, calibrated at stamp 3000 = 1000ns.
+  const Timestamp::Calibration c = { Timestamp::Source::Tsc, 3000, 1000, 1.0 / 3.0 };
+  QCOMPARE(Timestamp::toNanoseconds(3000, c), (xint64)1000);
+  QCOMPARE(Timestamp::toNanoseconds(6000, c), (xint64)2000);
+  QCOMPARE(Timestamp::toNanoseconds(0, c), (xint64)0);
+
+  const Timestamp::Calibration clock = { Timestamp::Source::Clock, 0, 0, 1.0 };
+  QCOMPARE(Timestamp::toNanoseconds(12345, clock), (xint64)12345);
+
+  // the source can't change under a client logger's drain thread.
+    {
+    Eks::DebugManager manager(true, 0, Eks::DebugManager::Transport::Null);
+    Eks::DebugLogger logger(0, true);
+    QVERIFY(!Timestamp::setSource(Timestamp::Source::Clock));
+    }
+
+  if(!Timestamp::setSource(Timestamp::Source::Tsc))
+    {
+    QSKIP("No invariant TSC");
+    }
+
+  const Timestamp::Calibration tsc = Timestamp::calibrate();
+  const xint64 stamp = Timestamp::now();
+  const xint64 expected = Eks::Time::now().nanoseconds();
+  Timestamp::setSource(Timestamp::Source::Clock);
+
+  // converted stamps land within a millisecond of the clock they were calibrated against.
+  QVERIFY(tsc.nanosecondsPerStamp > 0.0);
+  QVERIFY(qAbs(Timestamp::toNanoseconds(stamp, tsc) - expected) < 1000000);
+  }
+
+void EksDebugTest::traceTest()
+  {
+  typedef Eks::DebugTraceWriter Writer;
+
+  QTemporaryDir dir;
+  QVERIFY(dir.isValid());
+
+  auto row = [](xint64 time)
+    {
+    Writer::Row r;
+    r.time = time;
+    r.session = time < Writer::BlockRows ? 1 : 2;
+    r.thread = (xuint64)(time % 3);
+    r.location = (xuint32)(time % 5);
+    r.duration = time % 2 ? 10 : 0;
+    r.type = time % 2 ? Writer::RowType::Duration : Writer::RowType::Log;
+    r.message = time % 2 ? QString() : QString("Row %1").arg(time);
+    return r;
+    };
+
+  const xint64 Rows = Writer::BlockRows * 2 + 10;
+    {
+    Writer writer;
+    QVERIFY(writer.open(dir.path()));
+    QCOMPARE(writer.beginSession(), (xuint32)1);
+    for(xint64 t = 0; t < Rows; ++t)
+      {
+      if(t == Writer::BlockRows)
+        {
+        QCOMPARE(writer.beginSession(), (xuint32)2);
+        }
+      writer.addRow(row(t));
+      }
+    }
+
+  // a crash leaves rows past the index, which reopening discards before appending.
+    {
+    QFile time(QDir(dir.path()).filePath("time.col"));
+    QVERIFY(time.open(QIODevice::Append));
+    time.write("garbage");
+    }
+
+    {
+    Writer writer;
+    QVERIFY(writer.open(dir.path()));
+    QCOMPARE(writer.rowCount(), (xuint64)Rows);
+    writer.addRow(row(Rows));
+    }
+
+  // each client numbers its locations from 0, a reopened trace continues the sessions.
+  Eks::DebugLogger::DebugLocationWithData location;
+  location.setId(0);
+  for(xuint32 i = 0; i < 2; ++i)
+    {
+    Writer writer;
+    QVERIFY(writer.open(dir.path()));
+    const xuint32 session = writer.beginSession();
+    QCOMPARE(session, (xuint32)3 + i);
+    QVERIFY(!writer.hasLocation(session, 0));
+
+    location.setData(QString("Session %1").arg(session));
+    writer.addLocation(session, location);
+    QVERIFY(writer.hasLocation(session, 0));
+    }
+
+  Eks::DebugTraceReader reader;
+  QVERIFY(reader.open(dir.path()));
+  QCOMPARE(reader.blocks().size(), 4);
+
+  const QVector<Writer::Row> all = reader.query(0, Rows);
+  QCOMPARE(all.size(), (int)Rows + 1);
+  for(int i = 0; i < all.size(); ++i)
+    {
+    const Writer::Row expected = row(i);
+    QCOMPARE(all[i].time, expected.time);
+    QCOMPARE(all[i].session, expected.session);
+    QCOMPARE(all[i].thread, expected.thread);
+    QCOMPARE(all[i].location, expected.location);
+    QCOMPARE(all[i].duration, expected.duration);
+    QVERIFY(all[i].type == expected.type);
+    QCOMPARE(all[i].message, expected.message);
+    }
+
+  const QVector<Writer::Row> range = reader.query(Writer::BlockRows + 5, Writer::BlockRows + 8);
+  QCOMPARE(range.size(), 4);
+  QCOMPARE(range[1].message, QString("Row %1").arg(Writer::BlockRows + 6));
+
+  QVERIFY(reader.location(3, 0));
+  QVERIFY(reader.location(4, 0));
+  QCOMPARE(reader.location(3, 0)->data(), QString("Session 3"));
+  QCOMPARE(reader.location(4, 0)->data(), QString("Session 4"));
+  QVERIFY(!reader.location(1, 0));
+  }
+
+void EksDebugTest::multiThreadedSendTest()
+  {
+  static const xuint32 ThreadCount = 12;
+  static const xuint32 MessagesPerThread = 5000;
+
+  QTcpServer server;
+  QVERIFY(server.listen(QHostAddress::LocalHost, 12345));
+
+  Eks::DebugManager manager(true);
+
+  QVERIFY(server.waitForNewConnection(5000));
+  QTcpSocket *reader = server.nextPendingConnection();
+  QVERIFY(reader);
+
+  // one interface shared by every thread races to set itself up, the others are private.
+  Eks::StressInterface shared(0, true);
+  std::vector<Eks::UniquePointer<Eks::StressInterface>> owned;
+  for(xuint32 i = 0; i < ThreadCount; ++i)
+    {
+    owned.push_back(Eks::Core::defaultAllocator()->createUnique<Eks::StressInterface>(nullptr, true));
+    }
+
+  const xsize outputs = Eks::DebugManager::queueStatistics().threadOutputs;
+
+  std::atomic<xuint32> finished(0);
+  std::vector<std::thread> threads;
+  for(xuint32 i = 0; i < ThreadCount; ++i)
+    {
+    Eks::StressInterface *own = owned[i].value();
+    threads.emplace_back([i, own, &shared, &finished]()
+      {
+      for(xuint32 seq = 0; seq < MessagesPerThread; ++seq)
+        {
+        Eks::StressInterface::Message msg = { i, seq, stressPayload(i, seq) };
+        (seq & 1 ? own : &shared)->emitMessage(msg);
+        }
+      ++finished;
+      });
+    }
+
+  FrameChecker checker(ThreadCount);
+  QElapsedTimer timer;
+  timer.start();
+
+  auto pump = [&]()
+    {
+    QCoreApplication::processEvents();
+    reader->waitForReadyRead(1);
+    checker.append(reader->readAll());
+    };
+
+  // producers block once their ring fills, so keep draining while they run.
+  while(finished < ThreadCount)
+    {
+    pump();
+    }
+
+  for(auto &t : threads)
+    {
+    t.join();
+    }
+
+  while(!checker.failed &&
+        checker.frames < ThreadCount * MessagesPerThread &&
+        timer.elapsed() < 20000)
+    {
+    pump();
+    }
+
+  QVERIFY(!checker.failed);
+  QCOMPARE(checker.frames, ThreadCount * MessagesPerThread);
+
+  // the exited threads' outputs are freed once drained, keeping what they counted.
+  while(Eks::DebugManager::queueStatistics().threadOutputs > outputs && timer.elapsed() < 20000)
+    {
+    Eks::DebugManager::flush();
+    pump();
+    }
+  QCOMPARE(Eks::DebugManager::queueStatistics().threadOutputs, outputs);
+  QCOMPARE(shared.sendStatistics().sent, (xuint64)ThreadCount * MessagesPerThread / 2);
+  QCOMPARE(owned[0]->sendStatistics().sent, (xuint64)MessagesPerThread / 2);
+  }
+
+void EksDebugTest::compressedSubscriberTest()
+  {
+  static const xuint32 Messages = 200;
+
+  QTcpServer server;
+  QVERIFY(server.listen(QHostAddress::LocalHost, 12345));
+
+  // on this thread, so the subscribers are written here.
+  Eks::DebugManager manager(true, 0, Eks::DebugManager::Transport::Tcp, Eks::DebugManager::Compression, false);
+  Eks::StressInterface ifc(0, true);
+
+  QVERIFY(server.waitForNewConnection(5000));
+  QTcpSocket *reader = server.nextPendingConnection();
+  QVERIFY(reader);
+
+  auto send = [&ifc](xuint32 thread)
+    {
+    for(xuint32 i = 0; i < Messages; ++i)
+      {
+      Eks::StressInterface::Message m = { thread, i, stressPayload(thread, i) };
+      ifc.emitMessage(m);
+      }
+    Eks::DebugManager::flush();
+    QElapsedTimer timer;
+    timer.start();
+    while(Eks::DebugManager::queueStatistics().queuedBytes && timer.elapsed() < 5000)
+      {
+      QCoreApplication::processEvents();
+      }
+    };
+
+  QBuffer *before = new QBuffer;
+  before->open(QIODevice::WriteOnly);
+  Eks::DebugManager::addSubscriber(before);
+  send(0);
+
+  // accept compression, as a debugger answering Init would.
+  QByteArray accept;
+  QDataStream a(&accept, QIODevice::WriteOnly);
+  a << (xuint32)0 << (xuint32)9 << (xuint8)1 << (xuint32)8 << (xuint32)Eks::DebugManager::Compression;
+  reader->write(accept);
+  reader->flush();
+
+  // the debugger is sent the marker, then blocks.
+  Eks::DebugFrameParser parser;
+  bool compressed = false;
+  QElapsedTimer timer;
+  timer.start();
+  while(!compressed && timer.elapsed() < 5000)
+    {
+    QCoreApplication::processEvents();
+    reader->waitForReadyRead(1);
+    const QByteArray bytes = reader->readAll();
+    parser.buffer().append(bytes.constData(), bytes.size());
+
+    Eks::DebugFrameParser::Frame frame;
+    while(!compressed && parser.nextFrame(frame))
+      {
+      compressed = frame.id == 0 && frame.size == 1 && frame.data[0] == 3;
+      }
+    }
+  QVERIFY(compressed);
+
+  QBuffer *after = new QBuffer;
+  after->open(QIODevice::WriteOnly);
+  Eks::DebugManager::addSubscriber(after);
+  send(1);
+
+  // both subscribers read plain frames, without the marker.
+  FrameChecker beforeChecker(2);
+  beforeChecker.append(before->data());
+  QVERIFY(!beforeChecker.failed);
+  QCOMPARE(beforeChecker.frames, Messages * 2);
+  QCOMPARE(beforeChecker.compressionMarkers, (xuint32)0);
+
+  FrameChecker afterChecker(2);
+  afterChecker.append(after->data());
+  QVERIFY(!afterChecker.failed);
+  QCOMPARE(afterChecker.frames, Messages);
+  QCOMPARE(afterChecker.compressionMarkers, (xuint32)0);
+  }
+
+void EksDebugTest::setupWhileSendingControlTest()
+  {
+  static const xuint32 ThreadCount = 4;
+  static const xuint32 InterfacesPerThread = 500;
+
+  QTcpServer server;
+  QVERIFY(server.listen(QHostAddress::LocalHost, 12345));
+
+  Eks::DebugManager manager(true);
+
+  QVERIFY(server.waitForNewConnection(5000));
+  QTcpSocket *reader = server.nextPendingConnection();
+  QVERIFY(reader);
+
+  // the controller is always the first interface.
+  Eks::DebugInterface *controller = Eks::DebugManager::findInterface(0);
+  QVERIFY(controller);
+
+  // each message goes through a fresh interface, so setups are queued while this
+  // thread sends controller frames, which drain as soon as they are staged.
+  std::vector<std::vector<Eks::UniquePointer<Eks::StressInterface>>> owned(ThreadCount);
+  std::atomic<xuint32> finished(0);
+  std::vector<std::thread> threads;
+  for(xuint32 i = 0; i < ThreadCount; ++i)
+    {
+    std::vector<Eks::UniquePointer<Eks::StressInterface>> *own = &owned[i];
+    threads.emplace_back([i, own, &finished]()
+      {
+      for(xuint32 seq = 0; seq < InterfacesPerThread; ++seq)
+        {
+        own->push_back(Eks::Core::defaultAllocator()->createUnique<Eks::StressInterface>(nullptr, true));
+
+        Eks::StressInterface::Message msg = { i, seq, stressPayload(i, seq) };
+        own->back()->emitMessage(msg);
+        }
+      ++finished;
+      });
+    }
+
+  FrameChecker checker(ThreadCount);
+  QElapsedTimer timer;
+  timer.start();
+
+  auto pump = [&]()
+    {
+    QCoreApplication::processEvents();
+    reader->waitForReadyRead(1);
+    checker.append(reader->readAll());
+    };
+
+  while(finished < ThreadCount)
+    {
+    // a message type no controller handles, the checker skips it.
+    QDataStream &s = Eks::DebugManager::lockOutputStream(controller);
+    s << (xuint8)0xFF;
+    Eks::DebugManager::unlockOutputStream();
+
+    pump();
+    }
+
+  for(auto &t : threads)
+    {
+    t.join();
+    }
+
+  while(!checker.failed &&
+        checker.frames < ThreadCount * InterfacesPerThread &&
+        timer.elapsed() < 20000)
+    {
+    pump();
+    }
+
+  QVERIFY(!checker.failed);
+  QCOMPARE(checker.frames, ThreadCount * InterfacesPerThread);
+  }
+
+QTEST_GUILESS_MAIN(EksDebugTest)
@@ -0,0 +1,41 @@
+#ifndef XDEBUGTEST_H
+#define XDEBUGTEST_H
+
+#include "QObject"
+#include "XCore"
+
+class EksDebugTest : public QObject
+  {
+  Q_OBJECT
+
+public:
+  EksDebugTest()
+    {
+    }
+
+  ~EksDebugTest()
+    {
+    }
+
+private Q_SLOTS:
+  void multiThreadedSendTest();
+  void setupWhileSendingControlTest();
+  void compressedSubscriberTest();
+  void preConnectBufferTest();
+  void frameParserFuzzTest();
+  void compressedFrameParserFuzzTest();
+  void compactTimeTest();
+  void sendLimitTest();
+  void metricsTest();
+  void allocatorTrackerTest();
+  void profilerTest();
+  void loggerTest();
+  void loggerSnapshotTest();
+  void timestampTest();
+  void traceTest();
+
+private:
+  Eks::Core core;
+  };
+
+#endif // XDEBUGTEST_H
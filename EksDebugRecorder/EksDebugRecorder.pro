@@ -0,0 +1,24 @@
+#-------------------------------------------------
+#
+# Headless recorder, writes DebugLogger events to a columnar trace
+#
+#-------------------------------------------------
+
+QT       += network
+QT       -= gui
+
+include("../EksCore/GeneralOptions.pri")
+
+TARGET = EksDebugRecorder
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+
+SOURCES += main.cpp
+
+INCLUDEPATH += $$ROOT/Eks/EksCore/include \
+    $$ROOT/Eks/EksDebug/include
+
+LIBS += -lEksCore -lEksDebug
@@ -0,0 +1,130 @@
+#include <QtCore/QCoreApplication>
+#include <QtCore/QCommandLineParser>
+#include "XDebugInterface.h"
+#include "XDebugManager.h"
+#include "XDebugLogger.h"
+#include "XDebugTrace.h"
+#include "XCore"
+
+/// Records each DebugLogger the client announces, while it is connected.
+class Watcher : public Eks::DebugManager::Watcher
+  {
+public:
+  Watcher(Eks::DebugTraceWriter *writer)
+      : _writer(writer),
+        _logIfc(0),
+        _recorder(0)
+    {
+    }
+
+  ~Watcher()
+    {
+    delete _recorder;
+    }
+
+  void onInterfaceRegistered(Eks::DebugInterface *ifc) X_OVERRIDE
+    {
+    if(ifc->typeName() == "DebugLogger")
+      {
+      delete _recorder;
+
+      _logIfc = ifc;
+      _recorder = new Eks::DebugTraceRecorder(
+        _writer,
+        static_cast<Eks::DebugLoggerData *>(ifc->dataModel()));
+      }
+    }
+
+  void onInterfaceUnregistered(Eks::DebugInterface *ifc) X_OVERRIDE
+    {
+    if(_logIfc == ifc)
+      {
+      stop();
+      }
+    }
+
+  void onReplayFinished() X_OVERRIDE
+    {
+    // only --replay replays, and exits once the capture is converted.
+    QCoreApplication::quit();
+    }
+
+  /// Write the durations still open and the last block.
+  void stop()
+    {
+    delete _recorder;
+    _recorder = 0;
+    _logIfc = 0;
+    }
+
+private:
+  Eks::DebugTraceWriter *_writer;
+  Eks::DebugInterface *_logIfc;
+  Eks::DebugTraceRecorder *_recorder;
+  };
+
+int main(int argc, char *argv[])
+  {
+  QCoreApplication a(argc, argv);
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription(
+    "Accepts EksDebug clients without a GUI, writing their DebugLogger events to a columnar trace.");
+  parser.addHelpOption();
+  QCommandLineOption transportOption(
+    "transport",
+    "Transport the client uses: tcp, local or shm.",
+    "transport",
+    "tcp");
+  parser.addOption(transportOption);
+  QCommandLineOption outputOption(
+    "output",
+    "Trace directory, an existing trace is appended to.",
+    "directory",
+    "trace");
+  parser.addOption(outputOption);
+  QCommandLineOption replayOption(
+    "replay",
+    "Convert a capture recorded with DebugManager::startCapture, then exit.",
+    "capture");
+  parser.addOption(replayOption);
+  parser.process(a);
+
+  auto transport = Eks::DebugManager::Transport::Tcp;
+  const QString transportName = parser.value(transportOption);
+  if(transportName == "local")
+    {
+    transport = Eks::DebugManager::Transport::LocalSocket;
+    }
+  else if(transportName == "shm")
+    {
+    transport = Eks::DebugManager::Transport::SharedMemory;
+    }
+
+  Eks::Core core;
+
+  Eks::DebugTraceWriter writer;
+  if(!writer.open(parser.value(outputOption)))
+    {
+    return 1;
+    }
+
+  Watcher watch(&writer);
+  Eks::DebugManager m(false, &watch, transport);
+
+  if(parser.isSet(replayOption))
+    {
+    if(!Eks::DebugManager::replayCapture(parser.value(replayOption)))
+      {
+      return 1;
+      }
+
+    // the capture is fed through from the event loop, which quits once it ends.
+    a.exec();
+    watch.stop();
+    writer.close();
+    return 0;
+    }
+
+  return a.exec();
+  }
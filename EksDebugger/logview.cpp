@@ -1,6 +1,7 @@
 #include "logview.h"
 #include "QtCore/QAbstractItemModel"
 #include "XDebugLogger.h"
+#include "XDebugMetrics.h"
 #include "QtWidgets/QGraphicsItem"
 #include "QtWidgets/QGraphicsTextItem"
 #include "QtWidgets/QGraphicsSceneMouseEvent"
@@ -19,6 +20,7 @@ static const float updateTimeInterval = 100;
 static const float timelineTextDrop = 30;
 static const float maxContainerMs = 500;
 static const int cachedImageWidth = 256;
+static const float metricTrackHeight = 60.0f;
 
 class ThreadsItem : public QGraphicsItem
   {
@@ -96,6 +98,236 @@ public:
     }
   };
 
+class MetricTrackItem : public QGraphicsItem
+  {
+public:
+  MetricTrackItem(LogView *log, const Eks::DebugMetricsData *data, xsize series, QGraphicsItem *parent)
+      : QGraphicsItem(parent),
+        _log(log),
+        _data(data),
+        _series(series),
+        _measured(0),
+        _peak(0.0)
+    {
+    setFlag(QGraphicsItem::ItemUsesExtendedStyleOption, true);
+    }
+
+  const Eks::DebugMetricsData::Series &series() const
+    {
+    return _data->series(_series);
+    }
+
+  QRectF boundingRect() const X_OVERRIDE
+    {
+    const auto &points = series().points;
+
+    QRectF r;
+    r.setTop(0);
+    r.setBottom(metricTrackHeight);
+    r.setLeft(_log->timeToX(_log->start()));
+    r.setRight(points.size() ? _log->timeToX(points.back().time) : r.left());
+
+    return r.adjusted(-threadPad, -threadPad, threadPad, threadPad);
+    }
+
+  void timeConversionChanged()
+    {
+    prepareGeometryChange();
+    }
+
+  void pointsAdded()
+    {
+    const auto &points = series().points;
+    for(; _measured < (xsize)points.size(); ++_measured)
+      {
+      const auto &p = points[(int)_measured];
+      _peak = xMax(_peak, value(p, _measured ? &points[(int)_measured - 1] : nullptr));
+      if(series().type == Eks::DebugMetricsInterface::MetricType::Histogram)
+        {
+        _peak = xMax(_peak, (double)p.entry.p99);
+        }
+      }
+
+    prepareGeometryChange();
+    }
+
+  void paint(QPainter *p, const QStyleOptionGraphicsItem *option, QWidget *) X_OVERRIDE
+    {
+    p->setPen(Qt::darkGray);
+    p->setBrush(Qt::white);
+    p->drawRoundedRect(boundingRect(), threadPad, threadPad);
+
+    const auto &s = series();
+    const auto &points = s.points;
+
+    QString label = s.name;
+    if(points.size())
+      {
+      const xsize last = points.size() - 1;
+      label += ": " + QString::number(value(points.back(), last ? &points[(int)last - 1] : nullptr));
+      if(s.type == Eks::DebugMetricsInterface::MetricType::Counter)
+        {
+        label += "/s";
+        }
+      else if(s.type == Eks::DebugMetricsInterface::MetricType::Histogram)
+        {
+        label += " mean, " + QString::number(points.back().entry.p99) + " p99";
+        }
+      }
+
+    auto exposed = option->exposedRect;
+    p->setPen(Qt::black);
+    p->drawText(QPointF(xMax((float)exposed.left(), _log->timeToX(_log->start())) + infoPad, 12.0f), label);
+
+    if(_peak <= 0.0)
+      {
+      return;
+      }
+
+    p->setRenderHint(QPainter::Antialiasing, true);
+
+    QPolygonF line;
+    QPolygonF upper;
+    for(int i = 0; i < points.size(); ++i)
+      {
+      const auto &pt = points[i];
+      const float x = _log->timeToX(pt.time);
+
+      // keep one point either side of the exposed area, so the lines leave it.
+      if(x < exposed.left() && i + 1 < points.size() && _log->timeToX(points[i + 1].time) < exposed.left())
+        {
+        continue;
+        }
+
+      line << QPointF(x, toY(value(pt, i ? &points[i - 1] : nullptr)));
+      if(s.type == Eks::DebugMetricsInterface::MetricType::Histogram)
+        {
+        upper << QPointF(x, toY((double)pt.entry.p99));
+        }
+
+      if(x > exposed.right())
+        {
+        break;
+        }
+      }
+
+    if(upper.size())
+      {
+      p->setPen(QPen(Qt::red, 1.0f));
+      p->drawPolyline(upper);
+      }
+
+    p->setPen(QPen(Qt::blue, 1.5f));
+    p->drawPolyline(line);
+    }
+
+private:
+  /// The value plotted, a counter's rate per second, or a histogram's median.
+  double value(const Eks::DebugMetricsData::Point &p, const Eks::DebugMetricsData::Point *previous) const
+    {
+    switch(series().type)
+      {
+    case Eks::DebugMetricsInterface::MetricType::Counter:
+      {
+      const double ms = previous ?
+        (double)(p.time - previous->time).milliseconds() :
+        (double)Eks::DebugMetricsInterface::SummaryInterval;
+      return ms > 0.0 ? p.entry.count * 1000.0 / ms : 0.0;
+      }
+    case Eks::DebugMetricsInterface::MetricType::Histogram:
+      return (double)p.entry.p50;
+    default:
+      return (double)p.entry.value;
+      }
+    }
+
+  float toY(double v) const
+    {
+    static const float top = 16.0f;
+    return metricTrackHeight - (float)(v / _peak) * (metricTrackHeight - top);
+    }
+
+  LogView *_log;
+  const Eks::DebugMetricsData *_data;
+  xsize _series;
+  // points already included in the peak.
+  xsize _measured;
+  double _peak;
+  };
+
+class MetricsItem : public QGraphicsItem
+  {
+public:
+  MetricsItem(LogView *log)
+      : _log(log),
+        _data(nullptr)
+    {
+    }
+
+  QRectF boundingRect() const X_OVERRIDE
+    {
+    return QRectF();
+    }
+
+  void paint(QPainter *, const QStyleOptionGraphicsItem *, QWidget *) X_OVERRIDE
+    {
+    }
+
+  void setData(const Eks::DebugMetricsData *data)
+    {
+    xForeach(auto track, _tracks)
+      {
+      delete track;
+      }
+    _tracks.clear();
+
+    _data = data;
+    if(_data)
+      {
+      for(xsize i = 0; i < _data->seriesCount(); ++i)
+        {
+        addTrack(i);
+        }
+      }
+    }
+
+  void addTrack(xsize series)
+    {
+    xAssert(series == (xsize)_tracks.size());
+
+    auto track = new MetricTrackItem(_log, _data, series, this);
+    track->setY(_tracks.size() * (metricTrackHeight + 2 * threadPad));
+    track->pointsAdded();
+    _tracks << track;
+    }
+
+  void trackChanged(xsize series)
+    {
+    _tracks[(int)series]->update();
+    }
+
+  void pointsAdded()
+    {
+    xForeach(auto track, _tracks)
+      {
+      track->pointsAdded();
+      }
+    }
+
+  void timeConversionChanged()
+    {
+    xForeach(auto track, _tracks)
+      {
+      track->timeConversionChanged();
+      }
+    }
+
+private:
+  LogView *_log;
+  const Eks::DebugMetricsData *_data;
+  QVector<MetricTrackItem *> _tracks;
+  };
+
 class DurationItem : public EventItem
   {
 XProperties:
@@ -295,9 +527,10 @@ void ThreadItem::endDuration(xsize id, const Eks::Time &time)
       }
     }
 
+  // the begin may have been dropped from a full ring.
   if(!e)
     {
-    xAssertFail();
+    return;
     }
   e->setEnd(time);
 
@@ -600,6 +833,11 @@ TimelineItem::TimelineItem(Eks::AllocatorBase *alloc, LogView *log) : _log(log)
   _threads = new ThreadsItem(alloc, log);
   _threads->setParentItem(this);
 
+  // metric tracks sit under the timeline's times.
+  _metrics = new MetricsItem(log);
+  _metrics->setParentItem(this);
+  _metrics->setY(timelineTextDrop + 2 * timelinePad);
+
   setFlag(QGraphicsItem::ItemUsesExtendedStyleOption, true);
   }
 
@@ -705,6 +943,11 @@ ThreadsItem *TimelineItem::threads()
   return _threads;
   }
 
+MetricsItem *TimelineItem::metrics()
+  {
+  return _metrics;
+  }
+
 void TimelineItem::layoutThreads()
   {
   if(!_pendingLayoutThread)
@@ -744,6 +987,7 @@ void TimelineItem::setCurrentTime(const Eks::Time &)
 void TimelineItem::timeConversionChanged()
   {
   prepareGeometryChange();
+  _metrics->timeConversionChanged();
   }
 
 
@@ -765,13 +1009,13 @@ LogView::LogView(QObject *model)
     qobject_cast<Eks::DebugLoggerData*>(model),
     &Eks::DebugLoggerData::eventCreated,
     [this, model](const Eks::Time &time,
-        Eks::ThreadEventLogger::EventType type,
+        Eks::DebugLogger::EventType type,
         xuint64 thread,
         const QString &display,
         const xsize durationId,
         const Eks::DebugLogger::DebugLocationWithData *loc)
       {
-      if (type == Eks::ThreadEventLogger::EventType::Moment)
+      if (type == Eks::DebugLogger::EventType::Moment)
         {
         addMoment(time, display, thread, loc);
         }
@@ -803,6 +1047,37 @@ LogView::LogView(QObject *model)
   setScene(&_scene);
   }
 
+void LogView::setMetrics(Eks::DebugMetricsData *metrics)
+  {
+  _timelineRoot->metrics()->setData(metrics);
+  if(!metrics)
+    {
+    return;
+    }
+
+  connect(metrics, &Eks::DebugMetricsData::seriesAdded, this, [this](xsize series)
+    {
+    _timelineRoot->metrics()->addTrack(series);
+    });
+
+  connect(metrics, &Eks::DebugMetricsData::seriesChanged, this, [this](xsize series)
+    {
+    _timelineRoot->metrics()->trackChanged(series);
+    });
+
+  connect(metrics, &Eks::DebugMetricsData::summaryAdded, this, [this](const Eks::Time &t)
+    {
+    _min = xMin(_min, t);
+    _max = xMax(_max, t);
+    _timelineRoot->metrics()->pointsAdded();
+    });
+
+  connect(metrics, &QObject::destroyed, this, [this]()
+    {
+    _timelineRoot->metrics()->setData(nullptr);
+    });
+  }
+
 void LogView::timerEvent(QTimerEvent *)
   {
   _timelineRoot->setCurrentTime(Eks::Time::now());
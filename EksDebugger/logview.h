@@ -3,7 +3,6 @@
 
 #include "QtWidgets/QGraphicsView"
 #include "QtWidgets/QGraphicsItem"
-#include "XEventLogger"
 #include "XDebugLogger.h"
 #include "XUnorderedMap"
 #include "QtCore/QPersistentModelIndex"
@@ -13,6 +12,11 @@
 class QGraphicsScene;
 class QAbstractItemModel;
 
+namespace Eks
+{
+class DebugMetricsData;
+}
+
 class EventItem;
 class ThreadItem;
 class MomentItem;
@@ -20,6 +24,7 @@ class DurationItem;
 class InfoItem;
 class TimelineItem;
 class ThreadsItem;
+class MetricsItem;
 
 class LogView : public QGraphicsView
   {
@@ -39,6 +44,9 @@ public:
   Eks::Time timeFromX(float x, bool offset) const;
   Eks::Time timeFromTimelineX(float x) const;
 
+  /// \brief Plot each of [metrics]' series as a track below the timeline.
+  void setMetrics(Eks::DebugMetricsData *metrics);
+
 protected:
   void timerEvent(QTimerEvent *) X_OVERRIDE;
 
@@ -95,6 +103,7 @@ public:
   void paint(QPainter *painter, const QStyleOptionGraphicsItem *, QWidget *) X_OVERRIDE;
 
   ThreadsItem *threads();
+  MetricsItem *metrics();
   void setCurrentTime(const Eks::Time &);
 
 public slots:
@@ -106,6 +115,7 @@ protected:
 
 private:
   ThreadsItem *_threads;
+  MetricsItem *_metrics;
   LogView *_log;
   bool _pendingLayoutThread;
   };
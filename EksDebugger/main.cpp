@@ -1,7 +1,17 @@
 #include <QtWidgets/QApplication>
 #include <QtWidgets/QDockWidget>
+#include <QtWidgets/QTableView>
+#include <QtWidgets/QHeaderView>
+#include <QtWidgets/QSplitter>
+#include <QtWidgets/QSpinBox>
+#include <QtWidgets/QVBoxLayout>
+#include <QtCore/QCommandLineParser>
 #include "XDebugInterface.h"
 #include "XDebugManager.h"
+#include "XDebugManagerMonitor.h"
+#include "XDebugMetrics.h"
+#include "XDebugAllocatorTracker.h"
+#include "XDebugProfiler.h"
 #include "mainwindow.h"
 #include "logview.h"
 #include "XCore"
@@ -13,7 +23,15 @@ public:
       : _main(w)
     {
     _log = 0;
+    _logView = 0;
     _logIfc = 0;
+    _metricsIfc = 0;
+    _monitor = 0;
+    _monitorIfc = 0;
+    _allocations = 0;
+    _allocationsIfc = 0;
+    _profiler = 0;
+    _profilerIfc = 0;
     }
 
   void onInterfaceRegistered(Eks::DebugInterface *ifc) X_OVERRIDE
@@ -21,8 +39,70 @@ public:
     if(ifc->typeName() == "DebugLogger")
       {
       _logIfc = ifc;
-      auto log = new LogView(ifc->dataModel());
-      _log = addDock(log);
+      _logView = new LogView(ifc->dataModel());
+      _log = addDock(_logView);
+      if(_metricsIfc)
+        {
+        _logView->setMetrics(static_cast<Eks::DebugMetricsData *>(_metricsIfc->dataModel()));
+        }
+      }
+    else if(ifc->typeName() == "DebugMetricsInterface")
+      {
+      // plotted alongside the log, once there is one.
+      _metricsIfc = ifc;
+      if(_logView)
+        {
+        _logView->setMetrics(static_cast<Eks::DebugMetricsData *>(ifc->dataModel()));
+        }
+      }
+    else if(ifc->typeName() == "DebugManagerMonitor")
+      {
+      _monitorIfc = ifc;
+      auto view = createTable(static_cast<Eks::DebugMonitorModel *>(ifc->dataModel()));
+      view->setObjectName("Debug Overhead");
+      _monitor = addDock(view);
+      }
+    else if(ifc->typeName() == "DebugAllocatorInterface")
+      {
+      _allocationsIfc = ifc;
+      auto model = static_cast<Eks::DebugAllocatorModel *>(ifc->dataModel());
+
+      auto splitter = new QSplitter(Qt::Vertical);
+      splitter->setObjectName("Allocations");
+      splitter->addWidget(createTable(model));
+      splitter->addWidget(createTable(model->sites()));
+      _allocations = addDock(splitter);
+      }
+    else if(ifc->typeName() == "DebugProfilerInterface")
+      {
+      _profilerIfc = ifc;
+      auto profiler = static_cast<Eks::DebugProfilerInterface *>(ifc);
+      auto model = static_cast<Eks::DebugProfilerModel *>(ifc->dataModel());
+
+      auto widget = new QWidget;
+      widget->setObjectName("Profiler");
+      auto layout = new QVBoxLayout(widget);
+
+      // the client's rate, until the first samples arrive.
+      auto rate = new QSpinBox;
+      rate->setRange(0, Eks::DebugProfilerInterface::MaxSampleRate);
+      rate->setValue(Eks::DebugProfilerInterface::DefaultSampleRate);
+      rate->setSuffix(" samples/s");
+      rate->setKeyboardTracking(false);
+      layout->addWidget(rate);
+      layout->addWidget(createTable(model));
+
+      QObject::connect(model, &Eks::DebugProfilerModel::sampleRateChanged, rate, [rate](xuint32 r)
+        {
+        QSignalBlocker block(rate);
+        rate->setValue((int)r);
+        });
+      QObject::connect(rate, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged), [profiler](int r)
+        {
+        profiler->requestSampleRate((xuint32)r);
+        });
+
+      _profiler = addDock(widget);
       }
     }
 
@@ -32,7 +112,36 @@ public:
       {
       delete _log;
       _log = 0;
+      _logView = 0;
+      }
+    else if(_metricsIfc == ifc)
+      {
+      _metricsIfc = 0;
+      }
+    else if(_monitorIfc == ifc)
+      {
+      delete _monitor;
+      _monitor = 0;
+      }
+    else if(_allocationsIfc == ifc)
+      {
+      delete _allocations;
+      _allocations = 0;
       }
+    else if(_profilerIfc == ifc)
+      {
+      delete _profiler;
+      _profiler = 0;
+      }
+    }
+
+  QTableView *createTable(QAbstractItemModel *model)
+    {
+    auto view = new QTableView;
+    view->setModel(model);
+    view->horizontalHeader()->setStretchLastSection(true);
+    view->verticalHeader()->hide();
+    return view;
     }
 
   QWidget *addDock(QWidget *widg)
@@ -52,19 +161,62 @@ public:
   MainWindow *_main;
 
   QWidget *_log;
+  LogView *_logView;
   Eks::DebugInterface *_logIfc;
+
+  Eks::DebugInterface *_metricsIfc;
+
+  QWidget *_monitor;
+  Eks::DebugInterface *_monitorIfc;
+
+  QWidget *_allocations;
+  Eks::DebugInterface *_allocationsIfc;
+
+  QWidget *_profiler;
+  Eks::DebugInterface *_profilerIfc;
   };
 
 int main(int argc, char *argv[])
   {
   QApplication a(argc, argv);
 
+  QCommandLineParser parser;
+  parser.addHelpOption();
+  QCommandLineOption transportOption(
+    "transport",
+    "Transport the client uses: tcp, local or shm.",
+    "transport",
+    "tcp");
+  parser.addOption(transportOption);
+  QCommandLineOption replayOption(
+    "replay",
+    "Replay a capture recorded with DebugManager::startCapture.",
+    "capture");
+  parser.addOption(replayOption);
+  parser.process(a);
+
+  auto transport = Eks::DebugManager::Transport::Tcp;
+  const QString transportName = parser.value(transportOption);
+  if(transportName == "local")
+    {
+    transport = Eks::DebugManager::Transport::LocalSocket;
+    }
+  else if(transportName == "shm")
+    {
+    transport = Eks::DebugManager::Transport::SharedMemory;
+    }
+
   Eks::Core core;
   
   MainWindow w;
 
   Watcher watch(&w);
-  Eks::DebugManager m(false, &watch);
+  Eks::DebugManager m(false, &watch, transport);
+
+  if(parser.isSet(replayOption) && !Eks::DebugManager::replayCapture(parser.value(replayOption)))
+    {
+    return 1;
+    }
 
   w.show();
 